@@ -25,9 +25,13 @@
 #define MAVPROXY_CHAN2_DEVICE_NAME "usb"
 #define FS_DEVICE_NAME             "sd0"
 #define GPS_SERIAL_DEVICE_NAME     "serial3"
+#define HIL_BRIDGE_DEVICE_NAME     "usb"
 #define MPU6000_SPI_DEVICE_NAME    "spi1_dev4"
 #define L3GD20H_SPI_DEVICE_NAME    "spi1_dev2"
 #define MS5611_SPI_DEVICE_NAME     "spi1_dev3"
 #define LSM303D_SPI_DEVICE_NAME    "spi1_dev1"
 
+// Device Pin
+#define MPU6000_DRDY_PIN           62 /* PD15 */
+
 #endif
\ No newline at end of file
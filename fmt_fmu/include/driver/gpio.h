@@ -38,5 +38,8 @@ rt_err_t gpio_drv_init(void);
 void gpio_pin_mode(rt_device_t dev, rt_base_t pin, rt_base_t mode, rt_base_t otype);
 int gpio_pin_read(rt_device_t dev, rt_base_t pin);
 void gpio_pin_write(rt_device_t dev, rt_base_t pin, rt_base_t value);
+rt_err_t gpio_pin_attach_irq(rt_device_t dev, rt_base_t pin, rt_base_t mode, void (*hdr)(void* args), void* args);
+rt_err_t gpio_pin_detach_irq(rt_device_t dev, rt_base_t pin);
+rt_err_t gpio_pin_irq_enable(rt_device_t dev, rt_base_t pin, rt_base_t enabled);
 
 #endif
@@ -15,8 +15,6 @@
 
 #define CONFIGURE_RETRY_MAX		2
 
-#define RD_ONLY_POSLLH			1
-#define RD_ONLY_VELNED			2
 #define RD_COMPLETED_REPORT		3
 #define RD_SVINFO				4
 #define GPS_REPORT_READY        5
@@ -57,6 +55,19 @@ struct vehicle_gps_position_s {
 	float vdop;
 	float tdop;
 	uint32_t alt_ellipsoid;
+
+	uint64_t timestamp_us;				/**< Local time (us) of the navigation epoch, aligned to GPS time of week */
+	uint64_t rx_timestamp_us;			/**< Local time (us) the navigation solution was received */
+	uint32_t iTOW;						/**< GPS time of week (ms) of the navigation epoch */
+	uint8_t carr_soln;					/**< Carrier phase solution: 0 none, 1 float, 2 fixed */
+
+	uint8_t rel_pos_valid;				/**< Flag to indicate if relative position (RTK/moving baseline) is valid */
+	uint8_t heading_valid;				/**< Flag to indicate if moving baseline heading is valid */
+	float rel_pos_n_m;					/**< North component of relative position to base in m */
+	float rel_pos_e_m;					/**< East component of relative position to base in m */
+	float rel_pos_d_m;					/**< Down component of relative position to base in m */
+	float heading_rad;					/**< Heading of the moving baseline vector in rad, -PI..PI */
+	float heading_acc_rad;				/**< Heading accuracy estimate in rad */
 });
 
 rt_err_t drv_gps_init(char* serial_device_name);
@@ -31,6 +31,7 @@
 #define UBX_ID_NAV_VELNED	0x12
 #define UBX_ID_NAV_TIMEUTC	0x21
 #define UBX_ID_NAV_SVINFO	0x30
+#define UBX_ID_NAV_RELPOSNED	0x3C
 #define UBX_ID_ACK_NAK		0x00
 #define UBX_ID_ACK_ACK		0x01
 #define UBX_ID_CFG_PRT		0x00
@@ -49,6 +50,7 @@
 #define UBX_MSG_NAV_VELNED	((UBX_CLASS_NAV) | UBX_ID_NAV_VELNED << 8)
 #define UBX_MSG_NAV_TIMEUTC	((UBX_CLASS_NAV) | UBX_ID_NAV_TIMEUTC << 8)
 #define UBX_MSG_NAV_SVINFO	((UBX_CLASS_NAV) | UBX_ID_NAV_SVINFO << 8)
+#define UBX_MSG_NAV_RELPOSNED	((UBX_CLASS_NAV) | UBX_ID_NAV_RELPOSNED << 8)
 #define UBX_MSG_ACK_NAK		((UBX_CLASS_ACK) | UBX_ID_ACK_NAK << 8)
 #define UBX_MSG_ACK_ACK		((UBX_CLASS_ACK) | UBX_ID_ACK_ACK << 8)
 #define UBX_MSG_CFG_PRT		((UBX_CLASS_CFG) | UBX_ID_CFG_PRT << 8)
@@ -70,6 +72,15 @@
 #define UBX_RX_NAV_PVT_FLAGS_DIFFSOLN		0x02	/**< diffSoln (1 if differential corrections were applied) */
 #define UBX_RX_NAV_PVT_FLAGS_PSMSTATE		0x1C	/**< psmState (Power Save Mode state (see Power Management)) */
 #define UBX_RX_NAV_PVT_FLAGS_HEADVEHVALID	0x20	/**< headVehValid (Heading of vehicle is valid) */
+#define UBX_RX_NAV_PVT_FLAGS_CARRSOLN		0xC0	/**< carrSoln (Carrier phase range solution status: 0 none, 1 float, 2 fixed) */
+
+/* RX NAV-RELPOSNED message content details */
+#define UBX_RX_NAV_RELPOSNED_FLAGS_GNSSFIXOK		0x001	/**< gnssFixOK (A valid fix) */
+#define UBX_RX_NAV_RELPOSNED_FLAGS_DIFFSOLN			0x002	/**< diffSoln (1 if differential corrections were applied) */
+#define UBX_RX_NAV_RELPOSNED_FLAGS_RELPOSVALID		0x004	/**< relPosValid (Relative position components and accuracies are valid) */
+#define UBX_RX_NAV_RELPOSNED_FLAGS_CARRSOLN			0x018	/**< carrSoln (Carrier phase range solution status: 0 none, 1 float, 2 fixed) */
+#define UBX_RX_NAV_RELPOSNED_FLAGS_ISMOVING			0x020	/**< isMoving (1 if the receiver is operating in moving baseline mode) */
+#define UBX_RX_NAV_RELPOSNED_FLAGS_HEADINGVALID		0x100	/**< relPosHeadingValid (relPosHeading is valid) */
 
 /* RX NAV-TIMEUTC message content details */
 /*   Bitfield "valid" masks */
@@ -81,14 +92,16 @@
 /* TX CFG-PRT message contents */
 #define UBX_TX_CFG_PRT_PORTID		0x01		/**< UART1 */
 #define UBX_TX_CFG_PRT_MODE		0x000008D0	/**< 0b0000100011010000: 8N1 */
-#define UBX_TX_CFG_PRT_BAUDRATE		38400		/**< choose 38400 as GPS baudrate */
+#define UBX_TX_CFG_PRT_BAUDRATE		115200		/**< choose 115200 as GPS baudrate, enough for NAV-PVT at 25Hz */
 #define UBX_TX_CFG_PRT_INPROTOMASK	0x01		/**< UBX in */
 #define UBX_TX_CFG_PRT_OUTPROTOMASK	0x01		/**< UBX out */
 
 /* TX CFG-RATE message contents */
 #define UBX_TX_CFG_RATE_MEASINTERVAL	100		/**< 100ms for 10Hz */
+#define UBX_TX_CFG_RATE_MIN_HZ			1		/**< lowest configurable navigation rate */
+#define UBX_TX_CFG_RATE_MAX_HZ			25		/**< highest configurable navigation rate (ubx-m8/f9) */
 #define UBX_TX_CFG_RATE_NAVRATE		1		/**< cannot be changed */
-#define UBX_TX_CFG_RATE_TIMEREF		0		/**< 0: UTC, 1: GPS time */
+#define UBX_TX_CFG_RATE_TIMEREF		1		/**< 0: UTC, 1: GPS time, epochs are aligned to gps time of week */
 
 /* TX CFG-NAV5 message contents */
 #define UBX_TX_CFG_NAV5_MASK		0x0005		/**< Only update dynamic model and fix mode */
@@ -208,6 +221,31 @@ typedef struct {
 #define UBX_PAYLOAD_RX_NAV_PVT_SIZE_UBX7	(sizeof(ubx_payload_rx_nav_pvt_t) - 8)
 #define UBX_PAYLOAD_RX_NAV_PVT_SIZE_UBX8	(sizeof(ubx_payload_rx_nav_pvt_t))
 
+/* Rx NAV-RELPOSNED (F9, protocol 27+, version 1) */
+typedef struct {
+	uint8_t		version;		/**< Message version (0x01) */
+	uint8_t		reserved0;
+	uint16_t	refStationId;	/**< Reference station ID */
+	uint32_t	iTOW;			/**< GPS Time of Week [ms] */
+	int32_t		relPosN;		/**< North component of relative position vector [cm] */
+	int32_t		relPosE;		/**< East component of relative position vector [cm] */
+	int32_t		relPosD;		/**< Down component of relative position vector [cm] */
+	int32_t		relPosLength;	/**< Length of the relative position vector [cm] */
+	int32_t		relPosHeading;	/**< Heading of the relative position vector [1e-5 deg] */
+	uint32_t	reserved1;
+	int8_t		relPosHPN;		/**< High-precision north component [0.1 mm] */
+	int8_t		relPosHPE;		/**< High-precision east component [0.1 mm] */
+	int8_t		relPosHPD;		/**< High-precision down component [0.1 mm] */
+	int8_t		relPosHPLength;	/**< High-precision length [0.1 mm] */
+	uint32_t	accN;			/**< Accuracy of north component [0.1 mm] */
+	uint32_t	accE;			/**< Accuracy of east component [0.1 mm] */
+	uint32_t	accD;			/**< Accuracy of down component [0.1 mm] */
+	uint32_t	accLength;		/**< Accuracy of length [0.1 mm] */
+	uint32_t	accHeading;		/**< Accuracy of heading [1e-5 deg] */
+	uint32_t	reserved2;
+	uint32_t	flags;			/**< Flags (see UBX_RX_NAV_RELPOSNED_FLAGS_...) */
+} ubx_payload_rx_nav_relposned_t;
+
 /* Rx NAV-TIMEUTC */
 typedef struct {
 	uint32_t	iTOW;		/**< GPS Time of Week [ms] */
@@ -401,6 +439,7 @@ typedef union {
 	ubx_payload_rx_nav_svinfo_part1_t	payload_rx_nav_svinfo_part1;
 	ubx_payload_rx_nav_svinfo_part2_t	payload_rx_nav_svinfo_part2;
 	ubx_payload_rx_nav_velned_t		payload_rx_nav_velned;
+	ubx_payload_rx_nav_relposned_t		payload_rx_nav_relposned;
 	ubx_payload_rx_mon_hw_ubx6_t		payload_rx_mon_hw_ubx6;
 	ubx_payload_rx_mon_hw_ubx7_t		payload_rx_mon_hw_ubx7;
 	ubx_payload_rx_mon_ver_part1_t		payload_rx_mon_ver_part1;
@@ -35,7 +35,12 @@
 #include <module/module_common.h>
 
 /* Thread Prority */
+#define SIH_THREAD_PRIORITY        2 /* simulated plant, see plant_model.h */
 #define VEHICLE_THREAD_PRIORITY    3
+#define MODEL_THREAD_PRIORITY      4 /* assigned by model period */
+#define MODEL_THREAD_PRIORITY_MAX  7
+#define GPS_THREAD_PRIORITY        8
+#define HIL_BRIDGE_THREAD_PRIORITY 8 /* below models, see hil_bridge.h */
 #define FMTIO_THREAD_PRIORITY      9
 #define LOGGER_THREAD_PRIORITY     10
 #define MAVLINK_RX_THREAD_PRIORITY 11
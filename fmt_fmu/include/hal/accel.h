@@ -31,6 +31,7 @@
 /* accel read pos */
 #define ACCEL_RD_RAW   1
 #define ACCEL_RD_SCALE 2
+#define ACCEL_RD_TIMESTAMP 3 /* sample timestamp (uint64_t, us) of last read */
 
 /* default config for accel sensor */
 #define ACCEL_CONFIG_DEFAULT                                   \
@@ -44,6 +44,7 @@ typedef struct {
     int32_t pressure_Pa;
     float altitude_m;
     uint32_t timestamp_ms;
+    uint64_t timestamp_us;
 } baro_report_t;
 
 struct baro_configure {
@@ -36,9 +36,12 @@ extern USB_OTG_CORE_HANDLE USB_OTG_dev;
 
 uint8_t usb_cdc_init(void);
 void cdc_send_data(uint8_t* pbuf, uint32_t buf_len);
-uint8_t cdc_receive_data(uint8_t* pbuf, uint32_t len);
+uint32_t cdc_receive_data(uint8_t* pbuf, uint32_t len);
+uint32_t cdc_peek_data(uint8_t** pbuf);
+void cdc_consume_data(uint32_t len);
 uint8_t cdc_check_sent(void);
 uint8_t cdc_check_receive(void);
 uint32_t cdc_get_receive_cnt(void);
+void cdc_rx_start(void);
 
 #endif
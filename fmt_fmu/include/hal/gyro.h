@@ -31,6 +31,11 @@
 /* accel read pos */
 #define GYRO_RD_RAW 1
 #define GYRO_RD_SCALE 2
+#define GYRO_RD_TIMESTAMP 3 /* sample timestamp (uint64_t, us) of last read */
+
+/* gyro device command */
+#define GYRO_CMD_ENABLE_DRDY  0x20 /* notify rx_indicate on hardware data-ready */
+#define GYRO_CMD_DISABLE_DRDY 0x21
 
 /* default config for accel sensor */
 #define GYRO_CONFIG_DEFAULT                        \
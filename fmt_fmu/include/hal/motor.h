@@ -52,6 +52,23 @@
 #define MOTOR_CMD_CHANNEL_DISABLE 0x22
 #define MOTOR_CMD_SET_FREQUENCY   0x23
 #define MOTOR_CMD_SET_DIRECTION   0x24
+#define MOTOR_CMD_SET_PROTOCOL    0x25
+#define MOTOR_CMD_GET_ERPM        0x26
+
+/* output protocol, arg of MOTOR_CMD_SET_PROTOCOL */
+#define MOTOR_PROTOCOL_PWM      0
+#define MOTOR_PROTOCOL_DSHOT150 1
+#define MOTOR_PROTOCOL_DSHOT300 2
+#define MOTOR_PROTOCOL_DSHOT600 3
+/* or'ed with dshot protocol to enable bidirectional telemetry */
+#define MOTOR_PROTOCOL_BIDIR 0x80
+
+/* arg of MOTOR_CMD_GET_ERPM */
+struct motor_erpm {
+    rt_uint32_t timestamp_ms; /* time of latest telemetry */
+    rt_uint16_t valid_mask;   /* channels with valid telemetry */
+    rt_uint32_t erpm[MAX_MOTOR_CHANNEL_NUM];
+};
 
 /* default config for motor device */
 #define MOTOR_CONFIG_DEFAULT           \
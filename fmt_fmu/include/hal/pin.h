@@ -29,6 +29,19 @@
 #define PIN_OUT_TYPE_PP 0x00
 #define PIN_OUT_TYPE_OD 0x01
 
+#define PIN_IRQ_MODE_RISING         0x00
+#define PIN_IRQ_MODE_FALLING        0x01
+#define PIN_IRQ_MODE_RISING_FALLING 0x02
+
+#define PIN_IRQ_DISABLE 0x00
+#define PIN_IRQ_ENABLE  0x01
+
+/* pin device command */
+#define PIN_CMD_SET_MODE   0x00
+#define PIN_CMD_ATTACH_IRQ 0x20
+#define PIN_CMD_DETACH_IRQ 0x21
+#define PIN_CMD_ENABLE_IRQ 0x22
+
 /* pin device and operations */
 struct pin_device {
     struct rt_device parent;
@@ -45,14 +58,25 @@ struct device_pin_status {
     uint16_t pin;
     uint16_t status;
 };
+struct device_pin_irq {
+    uint16_t pin;
+    uint16_t mode;
+    void (*hdr)(void* args);
+    void* args;
+};
+struct device_pin_irq_enable {
+    uint16_t pin;
+    uint16_t enable;
+};
 
 /* gpio driver opeations */
 struct pin_ops {
     void (*pin_mode)(struct rt_device* device, rt_base_t pin, rt_base_t mode, rt_base_t otype);
     void (*pin_write)(struct rt_device* device, rt_base_t pin, rt_base_t value);
     int (*pin_read)(struct rt_device* device, rt_base_t pin);
-
-    /* TODO: add GPIO interrupt */
+    rt_err_t (*pin_attach_irq)(struct rt_device* device, rt_base_t pin, rt_base_t mode, void (*hdr)(void* args), void* args);
+    rt_err_t (*pin_detach_irq)(struct rt_device* device, rt_base_t pin);
+    rt_err_t (*pin_irq_enable)(struct rt_device* device, rt_base_t pin, rt_base_t enabled);
 };
 
 rt_err_t hal_pin_register(pin_dev_t pin, const char* name, rt_uint32_t flag, void* data);
@@ -80,6 +80,10 @@
 #define SERIAL_ERR_FRAMING 0x02
 #define SERIAL_ERR_PARITY 0x03
 
+/* zero-copy access to dma rx fifo */
+#define SERIAL_CTRL_RX_PEEK 0x30 /* arg: struct serial_rx_span* */
+#define SERIAL_CTRL_RX_CONSUME 0x31 /* arg: (void*)length */
+
 /* Default config for serial_configure structure */
 #define SERIAL_CONFIG_DEFAULT                   \
     {                                           \
@@ -146,6 +150,12 @@ struct serial_tx_fifo {
     struct rt_completion completion;
 };
 
+/* contiguous span of received data inside the dma rx fifo */
+struct serial_rx_span {
+    rt_uint8_t* data;
+    rt_size_t len;
+};
+
 /*
  * Serial DMA mode
  */
@@ -181,6 +191,8 @@ struct usart_ops {
 };
 
 void hal_serial_isr(struct serial_device* serial, int event);
+rt_size_t hal_serial_rx_peek(struct serial_device* serial, rt_uint8_t** data);
+rt_size_t hal_serial_rx_consume(struct serial_device* serial, rt_size_t len);
 rt_err_t hal_serial_register(struct serial_device* serial, const char* name, rt_uint32_t flag, void* data);
 
 #endif
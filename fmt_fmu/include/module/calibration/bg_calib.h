@@ -0,0 +1,59 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef __BG_CALIB_H__
+#define __BG_CALIB_H__
+
+#include <firmament.h>
+
+#include "module/calibration/ellipsoid_fit.h"
+
+/*
+ * Background calibration. It is enabled by the BG_CALIB parameter (bit0 gyro,
+ * bit1 mag) and stepped from a low priority thread.
+ *
+ * Each step takes at most one imu and one mag sample, so its cost is fixed.
+ * Gyro bias is averaged over stationary windows. Mag samples are only
+ * accepted into the ellipsoid fit when their direction bin is not full, so
+ * one dominant attitude can not bias the fit. New CALIB parameters are
+ * written only when the estimate is confident, and only while disarmed.
+ */
+
+/* direction bins, sign pattern of the 3 axes without (0,0,0) */
+#define BG_MAG_BIN_NUM          26
+
+typedef struct {
+	/* gyro */
+	uint32_t gyr_windows;           /* stationary windows averaged */
+	float gyr_bias[3];
+	uint8_t gyr_ready;
+	/* mag */
+	uint8_t mag_bin[BG_MAG_BIN_NUM];
+	uint8_t mag_bin_filled;
+	uint32_t mag_samples;
+	EllipsoidResult mag_result;
+	uint8_t mag_ready;
+	/* number of parameter updates written */
+	uint32_t gyr_commit;
+	uint32_t mag_commit;
+} BgCalibStatus;
+
+fmt_err bg_calib_init(void);
+void bg_calib_step(void);
+void bg_calib_reset(void);
+void bg_calib_get_status(BgCalibStatus* status);
+
+#endif
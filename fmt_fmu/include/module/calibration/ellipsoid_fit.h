@@ -0,0 +1,53 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef __ELLIPSOID_FIT_H__
+#define __ELLIPSOID_FIT_H__
+
+#include <firmament.h>
+
+/*
+ * Incremental ellipsoid fit for accelerometer and magnetometer calibration.
+ *
+ * Samples are fitted to A*x^2 + B*y^2 + C*z^2 + 2D*xy + 2E*xz + 2F*yz
+ * + 2G*x + 2H*y + 2I*z = 1 by recursive least squares. Everything is single
+ * precision. Samples are divided by a scale taken from the first sample so
+ * the parameters stay close to 1, and the covariance is kept as a packed
+ * upper triangle since it is symmetric.
+ */
+
+#define ELLIPSOID_PARAM_NUM     9
+#define ELLIPSOID_COV_NUM       (ELLIPSOID_PARAM_NUM * (ELLIPSOID_PARAM_NUM + 1) / 2)
+
+typedef struct {
+	float v[ELLIPSOID_PARAM_NUM];   /* parameters A..I of normalized samples */
+	float P[ELLIPSOID_COV_NUM];     /* covariance, packed upper triangle by row */
+	float R;                        /* measurement noise */
+	float scale;                    /* sample normalization, 0 until first sample */
+	uint32_t cnt;
+} EllipsoidFit;
+
+typedef struct {
+	float bias[3];                  /* ellipsoid center */
+	float mat[9];                   /* row-major correction matrix, largest gain is 1 */
+	float radii[3];                 /* semi axes, in order of the eigenvectors */
+} EllipsoidResult;
+
+void ellipsoid_fit_init(EllipsoidFit* fit, const float p_diag[ELLIPSOID_PARAM_NUM], float R);
+void ellipsoid_fit_update(EllipsoidFit* fit, float x, float y, float z);
+fmt_err ellipsoid_fit_result(const EllipsoidFit* fit, EllipsoidResult* result);
+
+#endif
@@ -18,8 +18,14 @@
 #define __CONTROLLER_MODEL_H__
 
 #include <Controller.h>
+#include <firmament.h>
 
-void controller_model_init(void);
+#include "module/system/model_inst.h"
+
+/* further instances are created with this class and stepped in the model thread */
+MODEL_CLASS_DECLARE(Controller);
+
+fmt_err controller_model_init(void);
 void controller_model_step(void);
 
 #endif
\ No newline at end of file
@@ -18,8 +18,14 @@
 #define __FMS_MODEL_H__
 
 #include <FMS.h>
+#include <firmament.h>
 
-void fms_model_init(void);
+#include "module/system/model_inst.h"
+
+/* further instances are created with this class and stepped in the model thread */
+MODEL_CLASS_DECLARE(FMS);
+
+fmt_err fms_model_init(void);
 void fms_model_step(void);
 
 #endif
\ No newline at end of file
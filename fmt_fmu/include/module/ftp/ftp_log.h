@@ -0,0 +1,61 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef __FTP_LOG_H__
+#define __FTP_LOG_H__
+
+#include <firmament.h>
+
+#include "module/ftp/ftp_manager.h"
+
+/*
+ * Log download service on mavlink ftp.
+ *
+ * kCmdLogReadChunk/kCmdLogBurstChunk work like kCmdReadFile/kCmdBurstReadFile
+ * on a session opened by kCmdOpenFileRO, but every packet carries one chunk:
+ *
+ * | raw_len(2) | crc32(4) | method(1) | chunk data |
+ *
+ * PayloadHeader.offset is the file offset of the chunk, raw_len is the number
+ * of file bytes in it and crc32 is computed over these file bytes. chunks are
+ * compressed independently (see lz.h), so a lost chunk or a new connection can
+ * resume at any offset.
+ *
+ * kCmdLogListSessions lists "<session>\t<total bytes>\t<file num>" for each
+ * session folder, kCmdLogListBus lists "<msg_id>\t<bus name>\t<elem num>" for
+ * each bus in the blog header. both start at entry PayloadHeader.offset.
+ */
+
+/* file bytes read for one chunk, the compressor takes as much as fits */
+#define FTP_LOG_CHUNK_RAW_MAX   2048
+
+enum {
+	kLogChunkRaw = 0,
+	kLogChunkLz,
+};
+
+__PACKED__(
+typedef struct {
+	uint16_t	raw_len;
+	uint32_t	crc32;
+	uint8_t		method;
+})FTP_Log_Chunk_Header;
+
+uint8_t ftp_log_list_sessions(FTP_Msg_Payload* payload);
+uint8_t ftp_log_list_bus(FTP_Msg_Payload* payload);
+uint8_t ftp_log_pack_chunk(const uint8_t* raw, uint32_t raw_len, FTP_Msg_Payload* payload, uint32_t* chunk_raw_len);
+
+#endif
@@ -52,6 +52,12 @@ enum Opcode {
 	kCmdCalcFileCRC32,	    ///< Calculate CRC32 for file at <path>
 	kCmdBurstReadFile,	    ///< Burst download session file
 
+	/* log download service, see ftp_log.h */
+	kCmdLogListSessions = 64,	///< List log sessions from <offset>
+	kCmdLogListBus,		    ///< List buses of blog file at <path> from <offset>
+	kCmdLogReadChunk,	    ///< Reads one compressed chunk from <offset> in <session>
+	kCmdLogBurstChunk,	    ///< Burst download session file in compressed chunks
+
 	kRspAck = 128,		    ///< Ack response
 	kRspNak			        ///< Nak response
 };
@@ -69,17 +75,46 @@ enum ErrorCode {
 	kErrFailFileProtected		///< File is write protected
 };
 
+#define FTP_MAX_SESSION_NUM     2
+/* file is read sequentially in blocks of this size, burst chunks are served from it */
+#define FTP_READ_AHEAD_SIZE     4096
+/* max time the burst engine can hold mavproxy thread in one tick */
+#define FTP_BURST_SLICE_MS      5
+/* an idle session can be taken over after this time, e.g. client is reconnected */
+#define FTP_SESSION_TIMEOUT_MS  5000
+
+typedef struct {
+	uint32_t    bytes;          ///< file bytes sent by burst
+	uint32_t    wire_bytes;     ///< payload bytes sent by burst, less than bytes if compressed
+	uint32_t    chunks;         ///< burst packets sent
+	uint32_t    send_fail;      ///< burst packets failed to send
+	uint32_t    reads;          ///< file read calls
+	uint32_t    seeks;          ///< file seek calls
+	uint32_t    start_ms;       ///< time burst started
+	uint32_t    time_ms;        ///< burst duration
+} StreamStat;
+
 typedef struct {
 	int         fd;
 	uint32_t    file_size;
+	uint32_t    file_pos;       ///< current position of fd
+	uint8_t*    ra_buf;         ///< read-ahead buffer, only for read session
+	uint32_t    ra_offset;      ///< file offset of ra_buf[0]
+	uint32_t    ra_len;         ///< valid bytes in ra_buf
 	uint32_t    stream_offset;
 	uint16_t    stream_seq_number;
 	uint8_t     stream_target_system_id;
 	uint8_t     stream_target_component_id;
-	uint8_t     complete;
+	uint8_t     streaming;      ///< burst in progress
+	uint8_t     compress;       ///< burst sends compressed chunks
+	uint8_t     complete;       ///< burst reached end of file
+	uint32_t    last_active_ms;
+	StreamStat  stat;
 } StreamSession;
 
+fmt_err ftp_manager_init(void);
 fmt_err ftp_process_request(uint8_t* payload, uint8_t target_system, uint8_t target_component);
-fmt_err ftp_stream_send(StreamSession* stream_session);
+fmt_err ftp_stream_process(void);
+fmt_err ftp_get_session(uint8_t session, StreamSession* stream_session);
 
 #endif
\ No newline at end of file
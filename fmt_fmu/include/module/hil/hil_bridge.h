@@ -0,0 +1,51 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef __HIL_BRIDGE_H__
+#define __HIL_BRIDGE_H__
+
+#include <firmament.h>
+
+/*
+ * Bridge to an external simulator over HIL_BRIDGE_DEVICE_NAME, see
+ * hil_frame.h for the frames.
+ *
+ * Each SENSOR frame is published to the sensor topics and answered with the
+ * latest control_output. In lockstep every imu sample of the frame is
+ * published and steps the vehicle loop on its own time, so a batch of N
+ * samples runs the loop N times as the board would. The bridge thread has
+ * lower priority than the vehicle and model threads, so when it gets back
+ * from a step every model released by it has finished and the answer
+ * carries the controller output of the last sample. Free running the loop
+ * runs on its timer and would only see the latest sample, frames of more
+ * than one imu sample are dropped.
+ */
+
+typedef struct {
+	uint32_t frame;			/* SENSOR frames received */
+	uint32_t lost;			/* SENSOR frames missing in sequence */
+	uint32_t crc_err;
+	uint32_t tx_err;		/* frames not fully written to device */
+	uint32_t batch_err;		/* free running SENSOR frames of more than one imu sample, dropped */
+	uint8_t lockstep;
+} hil_bridge_status_t;
+
+fmt_err hil_bridge_init(void (*step)(void));
+uint8_t hil_bridge_lockstep(void);
+uint32_t hil_bridge_time_ms(void);
+hil_bridge_status_t hil_bridge_get_status(void);
+
+#endif
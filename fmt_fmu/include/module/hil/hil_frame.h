@@ -0,0 +1,152 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef __HIL_FRAME_H__
+#define __HIL_FRAME_H__
+
+#include <stdint.h>
+
+/*
+ * Frames exchanged by the hil bridge and an external simulator. The host
+ * simulator in target/hil_bridge builds the same codec, so only stdint is
+ * used here.
+ *
+ * A frame is 0xA5 0x5A, type, payload length, payload, crc16 of type, length
+ * and payload. Fields are little endian and the payload structs are packed.
+ *
+ * simulator -> fmu
+ *   HELLO     start a session, free running or lockstep
+ *   SENSOR    all samples taken since the previous frame, timed relative to
+ *             the frame time, a single imu sample when free running
+ * fmu -> simulator
+ *   HELLO     the accepted session
+ *   ACTUATOR  latest Control_Out, acknowledges a SENSOR frame
+ *
+ * In lockstep the simulator does not simulate past SENSOR frame k before the
+ * ACTUATOR acknowledging k arrives, and the fmu steps its vehicle loop once
+ * per imu sample of the frame on the simulated time of the sample.
+ */
+
+#define HIL_FRAME_VERSION			1
+
+#define HIL_FRAME_SYNC0				0xA5
+#define HIL_FRAME_SYNC1				0x5A
+/* sync, type, length and crc */
+#define HIL_FRAME_OVERHEAD			6
+#define HIL_FRAME_MAX_PAYLOAD		255
+#define HIL_FRAME_MAX_LEN			(HIL_FRAME_MAX_PAYLOAD + HIL_FRAME_OVERHEAD)
+
+/* imu samples a SENSOR frame can carry */
+#define HIL_SENSOR_MAX_IMU			4
+
+enum {
+	HIL_FRAME_HELLO = 1,
+	HIL_FRAME_SENSOR,
+	HIL_FRAME_ACTUATOR,
+};
+
+/* hello flag */
+#define HIL_FLAG_LOCKSTEP			(1 << 0)
+
+/* samples in a SENSOR frame besides imu */
+#define HIL_SENSOR_MAG				(1 << 0)
+#define HIL_SENSOR_BARO				(1 << 1)
+#define HIL_SENSOR_GPS				(1 << 2)
+
+#define HIL_PACKED					__attribute__((packed))
+
+typedef struct HIL_PACKED {
+	uint8_t version;
+	uint8_t flag;
+	uint16_t period_us;		/* period of SENSOR frame */
+} hil_hello_t;
+
+typedef struct HIL_PACKED {
+	int32_t dt_us;			/* sample time relative to frame time */
+	float gyr[3];			/* rad/s */
+	float acc[3];			/* m/s^2 */
+} hil_imu_t;
+
+typedef struct HIL_PACKED {
+	int32_t dt_us;
+	float mag[3];			/* gauss */
+} hil_mag_t;
+
+typedef struct HIL_PACKED {
+	int32_t dt_us;
+	float pressure;			/* Pa */
+	float temperature;		/* deg */
+} hil_baro_t;
+
+typedef struct HIL_PACKED {
+	int32_t dt_us;
+	int32_t lat;			/* 1e-7 deg */
+	int32_t lon;			/* 1e-7 deg */
+	int32_t height;			/* mm */
+	float velN;				/* m/s */
+	float velE;
+	float velD;
+	float hAcc;				/* m */
+	float vAcc;
+	float sAcc;				/* m/s */
+	uint8_t fixType;
+	uint8_t numSV;
+} hil_gps_t;
+
+/* decoded SENSOR frame, the wire carries imu_num imu and the samples in mask */
+typedef struct {
+	uint32_t seq;
+	uint64_t time_us;		/* simulated time of frame */
+	uint8_t imu_num;
+	uint8_t mask;
+	hil_imu_t imu[HIL_SENSOR_MAX_IMU];
+	hil_mag_t mag;
+	hil_baro_t baro;
+	hil_gps_t gps;
+} hil_sensor_t;
+
+typedef struct HIL_PACKED {
+	uint32_t seq;			/* SENSOR frame acknowledged */
+	uint64_t time_us;		/* its simulated time */
+	uint32_t timestamp;		/* Control_Out timestamp */
+	uint16_t actuator_cmd[16];
+} hil_actuator_t;
+
+/*
+ * Bytes are kept from a frame start until the frame is complete. If its crc
+ * fails the start was false or the frame is corrupted, and the kept bytes
+ * are scanned again from the byte after the sync. This can find several
+ * frames in the bytes already fed, so hil_frame_parse_next() is called
+ * after each frame until it returns 0.
+ */
+typedef struct {
+	uint8_t type;
+	uint8_t len;
+	uint8_t payload[HIL_FRAME_MAX_PAYLOAD];
+	uint32_t crc_err;
+	uint8_t buf[HIL_FRAME_MAX_LEN];
+	uint16_t head;
+	uint16_t tail;
+} hil_parser_t;
+
+/******************* API *******************/
+uint16_t hil_frame_pack(uint8_t* buf, uint8_t type, const void* payload, uint8_t len);
+int hil_frame_parse(hil_parser_t* parser, uint8_t c);
+int hil_frame_parse_next(hil_parser_t* parser);
+uint8_t hil_sensor_encode(uint8_t* payload, const hil_sensor_t* sensor);
+int hil_sensor_decode(const uint8_t* payload, uint8_t len, hil_sensor_t* sensor);
+
+#endif
@@ -18,6 +18,16 @@
 #define __INS_MODEL_H__
 
 #include <INS.h>
+#include <firmament.h>
+
+#include "module/system/model_inst.h"
+
+/* the main INS runs on imu 0, a second one can run on imu 1 */
+#if defined(FMT_INS_INSTANCE_NUM) && FMT_INS_INSTANCE_NUM > 1
+	#define INS_INSTANCE_NUM	2
+#else
+	#define INS_INSTANCE_NUM	1
+#endif
 
 typedef struct {
 	union {
@@ -54,7 +64,9 @@ typedef struct {
 } INS_Flag;
 
 
-void ins_model_init(void);
+MODEL_CLASS_DECLARE(INS);
+
+fmt_err ins_model_init(void);
 void ins_model_step(void);
 
 
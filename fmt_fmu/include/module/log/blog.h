@@ -32,6 +32,7 @@
 #define BLOG_BEGIN_MSG2 0x05
 #define BLOG_END_MSG    0x26
 
+/* bus and element names are stored with their quotes and a NUL, 17 characters at most */
 #define BLOG_MAX_NAME_LEN     20
 #define BLOG_DESCRIPTION_SIZE 50
 
@@ -53,6 +54,11 @@ enum {
     BLOG_INS_OUT_ID,
     BLOG_FMS_OUT_ID,
     BLOG_CONTROL_OUT_ID,
+    BLOG_PERF_ID,
+    BLOG_MEM_STAT_ID,
+    BLOG_IO_LATENCY_ID,
+    BLOG_ESC_RPM_ID,
+    BLOG_MODEL_SCHED_ID,
 #if defined(FMT_USING_SIH)
     BLOG_PLANT_STATE_ID,
 #endif
@@ -68,6 +74,8 @@ enum {
     BLOG_FLOAT,
     BLOG_DOUBLE,
     BLOG_BOOLEAN,
+    BLOG_INT64,
+    BLOG_UINT64,
 };
 
 enum {
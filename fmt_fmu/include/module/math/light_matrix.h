@@ -38,6 +38,11 @@ Mat* MatAdd(Mat* src1, Mat* src2, Mat* dst);
 Mat* MatSub(Mat* src1, Mat* src2, Mat* dst);
 Mat* MatMul(Mat* src1, Mat* src2, Mat* dst);
 Mat* MatTrans(Mat* src, Mat* dst);
+/* MatDet and MatInv run on the fixed size LU kernels of matrix.c, so they take
+ * square matrices of at most MATRIX_MAX_DIM (9) rows. A larger or non square
+ * one is refused with a message: MatDet returns NAN, MatInv returns NULL and
+ * MatAdj, which takes the determinants of the minors, fills NAN above
+ * MATRIX_MAX_DIM + 1 rows */
 LIGHT_MATRIX_TYPE MatDet(Mat* mat);
 Mat* MatAdj(Mat* src, Mat* dst);
 Mat* MatInv(Mat* src, Mat* dst);
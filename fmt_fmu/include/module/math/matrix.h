@@ -0,0 +1,123 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef __MATRIX_H__
+#define __MATRIX_H__
+
+#include <firmament.h>
+
+#include "module/math/quaternion.h"
+
+/*
+ * Fixed size matrix library. Matrices are plain row-major float arrays
+ * wrapped in a struct, so they live on the stack or in static memory and
+ * nothing is allocated. The MAT_xxx macros take the dimensions from the
+ * types at compile time and call the generic kernels below, e.g.
+ *
+ *   MATRIX_DEFINE(Mat6x3f, 6, 3);
+ *   Mat6f P;
+ *   Mat6x3f H, PH;
+ *   MAT_MUL(&P, &H, &PH);
+ *
+ * 3x3 rotation kernels and quaternion helpers are unrolled inline functions.
+ */
+
+/* bound of the stack workspace used by solvers. matrix_solve, matrix_inv and
+ * matrix_eig_sym return FMT_EINVAL and matrix_det returns NAN for a larger n,
+ * matrix_lu_solve must not be called with one */
+#define MATRIX_MAX_DIM          9
+
+#define MATRIX_DEFINE(name, row, col) \
+	typedef struct { float e[row][col]; } name
+
+MATRIX_DEFINE(Mat3f, 3, 3);
+MATRIX_DEFINE(Mat4f, 4, 4);
+MATRIX_DEFINE(Mat6f, 6, 6);
+MATRIX_DEFINE(Mat9f, 9, 9);
+
+#define MAT_ROW(m)              ((uint8_t)(sizeof((m)->e) / sizeof((m)->e[0])))
+#define MAT_COL(m)              ((uint8_t)(sizeof((m)->e[0]) / sizeof(float)))
+#define MAT_PTR(m)              (&(m)->e[0][0])
+
+#define MAT_ZEROS(m)            matrix_zeros(MAT_PTR(m), MAT_ROW(m), MAT_COL(m))
+#define MAT_EYE(m)              matrix_eye(MAT_PTR(m), MAT_ROW(m))
+#define MAT_ADD(a, b, c)        matrix_add(MAT_PTR(a), MAT_PTR(b), MAT_PTR(c), MAT_ROW(a), MAT_COL(a))
+#define MAT_SUB(a, b, c)        matrix_sub(MAT_PTR(a), MAT_PTR(b), MAT_PTR(c), MAT_ROW(a), MAT_COL(a))
+#define MAT_MUL(a, b, c)        matrix_mul(MAT_PTR(a), MAT_PTR(b), MAT_PTR(c), MAT_ROW(a), MAT_COL(a), MAT_COL(b))
+#define MAT_TRANS(a, b)         matrix_trans(MAT_PTR(a), MAT_PTR(b), MAT_ROW(a), MAT_COL(a))
+#define MAT_MUL_VEC(a, x, y)    matrix_mul_vec(MAT_PTR(a), x, y, MAT_ROW(a), MAT_COL(a))
+#define MAT_DET(a)              matrix_det(MAT_PTR(a), MAT_ROW(a))
+#define MAT_INV(a, b)           matrix_inv(MAT_PTR(a), MAT_PTR(b), MAT_ROW(a))
+#define MAT_CHOL(a, l)          matrix_cholesky(MAT_PTR(a), MAT_PTR(l), MAT_ROW(a))
+
+void matrix_zeros(float* a, uint8_t row, uint8_t col);
+void matrix_eye(float* a, uint8_t n);
+void matrix_add(const float* a, const float* b, float* c, uint8_t row, uint8_t col);
+void matrix_sub(const float* a, const float* b, float* c, uint8_t row, uint8_t col);
+void matrix_mul(const float* a, const float* b, float* c, uint8_t row, uint8_t n, uint8_t col);
+void matrix_trans(const float* a, float* b, uint8_t row, uint8_t col);
+void matrix_mul_vec(const float* a, const float* x, float* y, uint8_t row, uint8_t col);
+
+fmt_err matrix_lu(float* a, uint8_t* pivot, uint8_t n, int8_t* sign);
+void matrix_lu_solve(const float* lu, const uint8_t* pivot, const float* b, float* x, uint8_t n);
+fmt_err matrix_cholesky(const float* a, float* l, uint8_t n);
+void matrix_cholesky_solve(const float* l, const float* b, float* x, uint8_t n);
+fmt_err matrix_solve(const float* a, const float* b, float* x, uint8_t n);
+float matrix_det(const float* a, uint8_t n);
+fmt_err matrix_inv(const float* a, float* inv, uint8_t n);
+fmt_err matrix_eig_sym(const float* a, float* eig_val, float* eig_vec, uint8_t n);
+
+void mat3_from_quaternion(Mat3f* dcm, const quaternion* q);
+void mat3_to_quaternion(const Mat3f* dcm, quaternion* q);
+void quaternion_rotate_vectors(const quaternion* q, const float (*from)[3], float (*to)[3], uint32_t num);
+
+static inline void mat3_mul_vec(const Mat3f* a, const float x[3], float y[3])
+{
+	y[0] = a->e[0][0] * x[0] + a->e[0][1] * x[1] + a->e[0][2] * x[2];
+	y[1] = a->e[1][0] * x[0] + a->e[1][1] * x[1] + a->e[1][2] * x[2];
+	y[2] = a->e[2][0] * x[0] + a->e[2][1] * x[1] + a->e[2][2] * x[2];
+}
+
+/* y = A' * x, without forming the transpose */
+static inline void mat3_trans_mul_vec(const Mat3f* a, const float x[3], float y[3])
+{
+	y[0] = a->e[0][0] * x[0] + a->e[1][0] * x[1] + a->e[2][0] * x[2];
+	y[1] = a->e[0][1] * x[0] + a->e[1][1] * x[1] + a->e[2][1] * x[2];
+	y[2] = a->e[0][2] * x[0] + a->e[1][2] * x[1] + a->e[2][2] * x[2];
+}
+
+static inline void mat3_mul(const Mat3f* a, const Mat3f* b, Mat3f* c)
+{
+	for(uint8_t i = 0; i < 3; i++) {
+		c->e[i][0] = a->e[i][0] * b->e[0][0] + a->e[i][1] * b->e[1][0] + a->e[i][2] * b->e[2][0];
+		c->e[i][1] = a->e[i][0] * b->e[0][1] + a->e[i][1] * b->e[1][1] + a->e[i][2] * b->e[2][1];
+		c->e[i][2] = a->e[i][0] * b->e[0][2] + a->e[i][1] * b->e[1][2] + a->e[i][2] * b->e[2][2];
+	}
+}
+
+/* rotate one vector with unit quaternion, v' = v + w * t + q x t, t = 2 * q x v */
+static inline void quaternion_rotate_fast(const quaternion* q, const float from[3], float to[3])
+{
+	float tx = 2.0f * (q->y * from[2] - q->z * from[1]);
+	float ty = 2.0f * (q->z * from[0] - q->x * from[2]);
+	float tz = 2.0f * (q->x * from[1] - q->y * from[0]);
+
+	to[0] = from[0] + q->w * tx + q->y * tz - q->z * ty;
+	to[1] = from[1] + q->w * ty + q->z * tx - q->x * tz;
+	to[2] = from[2] + q->w * tz + q->x * ty - q->y * tx;
+}
+
+#endif
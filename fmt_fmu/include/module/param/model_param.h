@@ -0,0 +1,37 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef __MODEL_PARAM_H__
+#define __MODEL_PARAM_H__
+
+#include <firmament.h>
+
+/*
+ * Bridge between the parameter structs of codegen models and param groups.
+ *
+ * Each struct (CONTROL_PARAM, FMS_PARAM) is mirrored by a param group with
+ * the float members in the same order. When a parameter of the group is set,
+ * the whole table is published to its uMCN topic (control_param, fms_param).
+ * The model wrapper copies the topic into the model struct before its step,
+ * so a step always runs on one consistent table and the step path takes no
+ * lock, the topic is the second buffer of the struct.
+ */
+
+/******************* API *******************/
+fmt_err model_param_init(void);
+void model_param_notify(const param_t* param);
+
+#endif
@@ -144,6 +144,12 @@ typedef struct {
 /******************** Step 3: Declare Parameters In Group ********************/
 typedef struct {
 	PARAM_DECLARE(BLOG_MODE);
+	PARAM_DECLARE(IMU_SYNC);
+	PARAM_DECLARE(GPS_RATE);
+	PARAM_DECLARE(MOTOR_PROTOCOL);
+	PARAM_DECLARE(MOTOR_BIDIR);
+	PARAM_DECLARE(MOTOR_POLES);
+	PARAM_DECLARE(BG_CALIB);
 } PARAM_GROUP(SYSTEM);
 
 typedef struct {
@@ -191,10 +197,60 @@ typedef struct {
 	PARAM_DECLARE(MAG1_YZSCALE);
 } PARAM_GROUP(CALIB);
 
+/* same order as CONTROL_PARAM of Controller codegen, see model_param.h */
+typedef struct {
+	PARAM_DECLARE(VEL_XY_P);
+	PARAM_DECLARE(VEL_XY_I);
+	PARAM_DECLARE(VEL_XY_D);
+	PARAM_DECLARE(VEL_Z_P);
+	PARAM_DECLARE(VEL_Z_I);
+	PARAM_DECLARE(VEL_Z_D);
+	PARAM_DECLARE(VEL_XY_I_MIN);
+	PARAM_DECLARE(VEL_XY_I_MAX);
+	PARAM_DECLARE(VEL_XY_D_MIN);
+	PARAM_DECLARE(VEL_XY_D_MAX);
+	PARAM_DECLARE(VEL_Z_I_MIN);
+	PARAM_DECLARE(VEL_Z_I_MAX);
+	PARAM_DECLARE(VEL_Z_D_MIN);
+	PARAM_DECLARE(VEL_Z_D_MAX);
+	PARAM_DECLARE(RP_CMD_LIM);
+	PARAM_DECLARE(RP_RATE_CMD_LIM);
+	PARAM_DECLARE(YAW_RATE_CMD_LIM);
+	PARAM_DECLARE(ROLL_P);
+	PARAM_DECLARE(PITCH_P);
+	PARAM_DECLARE(ROLL_RATE_P);
+	PARAM_DECLARE(PITCH_RATE_P);
+	PARAM_DECLARE(YAW_RATE_P);
+	PARAM_DECLARE(ROLL_RATE_I);
+	PARAM_DECLARE(PITCH_RATE_I);
+	PARAM_DECLARE(YAW_RATE_I);
+	PARAM_DECLARE(ROLL_RATE_D);
+	PARAM_DECLARE(PITCH_RATE_D);
+	PARAM_DECLARE(YAW_RATE_D);
+	PARAM_DECLARE(RATE_I_MIN);
+	PARAM_DECLARE(RATE_I_MAX);
+	PARAM_DECLARE(RATE_D_MIN);
+	PARAM_DECLARE(RATE_D_MAX);
+} PARAM_GROUP(CONTROL);
+
+/* same order as FMS_PARAM of FMS codegen, see model_param.h */
+typedef struct {
+	PARAM_DECLARE(STICK_DEADZONE);
+	PARAM_DECLARE(XY_P);
+	PARAM_DECLARE(Z_P);
+	PARAM_DECLARE(VEL_XY_LIM);
+	PARAM_DECLARE(VEL_Z_LIM);
+	PARAM_DECLARE(YAW_P);
+	PARAM_DECLARE(YAW_RATE_LIM);
+	PARAM_DECLARE(ROLL_PITCH_LIM);
+} PARAM_GROUP(FMS);
+
 /******************** Step 1: Declare Group ********************/
 typedef struct {
 	param_group_t	PARAM_GROUP(SYSTEM);
 	param_group_t	PARAM_GROUP(CALIB);
+	param_group_t	PARAM_GROUP(CONTROL);
+	param_group_t	PARAM_GROUP(FMS);
 } param_list_t;
 
 /********************** Helper Macro **********************/
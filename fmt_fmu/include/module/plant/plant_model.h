@@ -18,8 +18,18 @@
 #define __PLANT_MODEL_H__
 
 #include <Plant.h>
+#include <firmament.h>
 
-void plant_model_init(void);
-void plant_model_step(void);
+/*
+ * With FMT_USING_SIH the plant runs in the sih thread, above the vehicle and
+ * model threads. The thread wakes every FMT_SIH_PERIOD ms and steps the plant
+ * until it has caught up with real time, so a plant generated with a step
+ * shorter than the wakeup period runs in sub-steps. Each sensor topic is
+ * published when the plant samples it and control_output is read at every
+ * sub-step, independent of the controller rate.
+ */
+
+fmt_err plant_model_init(void);
+uint32_t plant_model_get_slip(void);
 
 #endif
\ No newline at end of file
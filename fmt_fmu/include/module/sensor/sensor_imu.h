@@ -27,5 +27,8 @@ fmt_err sensor_gyr_raw_measure(int16_t gyr[3], uint8_t imu_id);
 fmt_err sensor_gyr_measure(float gyr[3], uint8_t imu_id);
 fmt_err sensor_acc_raw_measure(int16_t acc[3], uint8_t imu_id);
 fmt_err sensor_acc_measure(float acc[3], uint8_t imu_id);
+bool sensor_imu_available(uint8_t imu_id);
+fmt_err sensor_imu_get_timestamp(uint64_t* timestamp_us, uint8_t imu_id);
+fmt_err sensor_imu_set_drdy_indicate(uint8_t imu_id, rt_err_t (*drdy_ind)(rt_device_t dev, rt_size_t size));
 
 #endif
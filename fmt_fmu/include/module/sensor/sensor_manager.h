@@ -46,11 +46,13 @@ typedef struct {
 	uint32_t timestamp_ms;
 	float gyr_B_radDs[3];
 	float acc_B_mDs2[3];
+	uint64_t timestamp_us;	/* sample time in us, 0 if not available */
 } IMU_Report;
 
 typedef struct {
 	uint32_t timestamp_ms;
 	float mag_B_gauss[3];
+	uint64_t timestamp_us;	/* sample time in us, 0 if not available */
 } Mag_Report;
 
 typedef struct {
@@ -58,6 +60,7 @@ typedef struct {
 	float temperature_deg;
 	int32_t pressure_pa;
 	float altitude_m;
+	uint64_t timestamp_us;	/* sample time in us, 0 if not available */
 } Baro_Report;
 
 typedef struct {
@@ -73,10 +76,17 @@ typedef struct {
 	float sAcc;
 	uint8_t fixType;
 	uint8_t numSV;
-	uint16_t reserved;
+	uint8_t carrSoln;		/* carrier phase solution: 0 none, 1 float, 2 fixed */
+	uint8_t headingValid;
+	uint64_t timestamp_us;	/* sample time in us, 0 if not available */
+	uint32_t iTOW;			/* gps time of week in ms */
+	float heading;			/* moving baseline heading in rad */
+	float headingAcc;
 } GPS_Report;
 
 rt_err_t sensor_manager_init(void);
 void sensor_collect(void);
+fmt_err sensor_imu_drdy_sync(void (*drdy_cb)(void));
+uint8_t sensor_manager_imu_num(void);
 
 #endif
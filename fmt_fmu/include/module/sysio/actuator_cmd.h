@@ -19,6 +19,14 @@
 
 #include <firmament.h>
 
+#include "hal/motor.h"
+
+typedef struct {
+    uint32_t timestamp_ms;
+    uint32_t valid_mask; /* channels with valid telemetry */
+    float rpm[MAX_MOTOR_CHANNEL_NUM];
+} ESC_RPM_Report;
+
 fmt_err send_actuator_cmd(void);
 fmt_err actuator_init(const char* device_name);
 fmt_err actuator_deinit(void);
@@ -0,0 +1,57 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef __MEMSTAT_H__
+#define __MEMSTAT_H__
+
+#include <firmament.h>
+
+#define MEMSTAT_MAX_THREAD		16
+#define MEMSTAT_MAX_ALLOC_SITE	32
+
+typedef struct {
+	char name[RT_NAME_MAX];
+	uint32_t stack_size;
+	uint32_t stack_max_used;	/* stack high-water mark */
+} Stack_Stat;
+
+typedef struct {
+	uint32_t timestamp_ms;
+	uint32_t heap_total;
+	uint32_t heap_used;
+	uint32_t heap_max_used;
+	uint32_t heap_max_free_block;
+	uint32_t heap_free_blocks;
+	float heap_fragmentation;	/* 1 - largest free block / total free, in percent */
+	uint16_t thread_num;
+	uint16_t reserved;
+	Stack_Stat stack[MEMSTAT_MAX_THREAD];
+} Mem_Stat_Report;
+
+typedef struct {
+	void* caller;				/* return address of the allocation */
+	uint32_t alloc_cnt;
+	uint32_t alloc_bytes;
+	uint32_t fail_cnt;
+} Alloc_Site;
+
+void memstat_init(void);
+void memstat_update(void);
+void memstat_log(void);
+fmt_err memstat_get_report(Mem_Stat_Report* report);
+uint16_t memstat_get_alloc_sites(Alloc_Site* sites, uint16_t max_num);
+
+#endif
@@ -0,0 +1,89 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef __MODEL_INST_H__
+#define __MODEL_INST_H__
+
+#include <firmament.h>
+
+#include "module/system/perf.h"
+
+/*
+ * Multiple instances of a generated model.
+ *
+ * The codegen keeps the state of a model in globals (*_U, *_Y, *_DW, *_B ...),
+ * the model class lists them. One instance at a time is resident, its state
+ * lives in the globals and the model step works on it as usual. The state of
+ * the other instances is kept in context buffers. model_inst_switch() makes
+ * an instance resident by exchanging the globals with its buffer, the buffer
+ * then holds the instance switched out. So N instances need N - 1 buffers, a
+ * model with a single instance needs none and its switch costs nothing.
+ *
+ * Parameters (*_P, *_PARAM) are not instance state, all instances share them.
+ * All instances of a model must be switched and stepped in the same thread.
+ */
+
+typedef struct {
+	void* addr;
+	uint32_t size;
+} model_state_t;
+
+typedef struct model_inst model_inst_t;
+
+typedef struct {
+	const char* name;
+	const model_state_t* state;		/* globals holding the state of model */
+	uint8_t state_num;
+	void (*init)(void);
+	model_inst_t* resident;			/* instance whose state is in globals */
+	uint8_t inst_num;
+	perf_counter_t swap;			/* cost of switching instance */
+} model_class_t;
+
+struct model_inst {
+	model_class_t* cls;
+	void* ctx;						/* state of instance if not resident */
+	uint8_t id;
+};
+
+/******************* Helper Macro *******************/
+#define MODEL_STATE(_var)				{ (void*)&(_var), sizeof(_var) }
+
+#define MODEL_CLASS_ID(_name)			(&__model_class_##_name)
+
+#define MODEL_CLASS_DECLARE(_name)		extern model_class_t __model_class_##_name
+
+#define MODEL_CLASS_DEFINE(_name, _init, ...)									\
+	static const model_state_t __model_state_##_name[] = { __VA_ARGS__ };		\
+	model_class_t __model_class_##_name = {										\
+		.name = #_name,															\
+		.state = __model_state_##_name,											\
+		.state_num = sizeof(__model_state_##_name) / sizeof(model_state_t),		\
+		.init = _init,															\
+		.resident = NULL,														\
+		.inst_num = 0,															\
+		.swap = {																\
+			.name = #_name "_switch",											\
+			.min = 0xFFFFFFFF,													\
+		},																		\
+	}
+
+/******************* API *******************/
+fmt_err model_inst_create(model_inst_t* inst, model_class_t* cls);
+void model_inst_switch(model_inst_t* inst);
+uint32_t model_inst_ctx_size(const model_class_t* cls);
+
+#endif
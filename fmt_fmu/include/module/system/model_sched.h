@@ -0,0 +1,98 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef __MODEL_SCHED_H__
+#define __MODEL_SCHED_H__
+
+#include <firmament.h>
+
+#include "module/system/perf.h"
+
+/*
+ * Rate-monotonic scheduler of the generated models.
+ *
+ * Each model runs its step function in its own thread. The vehicle task calls
+ * model_sched_tick() every millisecond, which releases the models whose period
+ * is due. Thread priority is assigned by period, so a faster model preempts a
+ * slower one; models of the same period keep their registration order.
+ *
+ * The deadline of a model is its next release. A release that finds the
+ * previous step still running is counted as deadline miss and dropped, the
+ * overrun step is never queued.
+ *
+ * Rate transition: models exchange data only through uMCN topics, which hold
+ * the latest sample and are copied atomically. A model reads its inputs at the
+ * beginning of the step, so
+ *  - fast to slow: the slow model sees the output of the faster models released
+ *    on the same tick, since they run first at higher priority.
+ *  - slow to fast: the fast model holds the last complete output of the slow
+ *    model until the next one is published (sample and hold).
+ *  - slow to fast on a shared tick: the fast model runs first and still reads
+ *    the output of the previous slow step. The Controller (4 ms) runs before
+ *    the FMS (8 ms), so it follows an FMS command one FMS period later than
+ *    the former sequential INS, FMS, Controller loop did. Registration order
+ *    does not change this, it only orders models of the same period.
+ */
+
+/* models get priority from MODEL_THREAD_PRIORITY to MODEL_THREAD_PRIORITY_MAX */
+#define MODEL_SCHED_MAX_NUM		(MODEL_THREAD_PRIORITY_MAX - MODEL_THREAD_PRIORITY + 1)
+
+typedef struct model_task model_task_t;
+struct model_task {
+	const char* name;
+	void (*step)(void);
+	uint32_t period;			/* ms */
+	uint8_t priority;
+	void* stack;
+	uint32_t stack_size;
+	struct rt_thread thread;
+	struct rt_semaphore sem;
+	uint32_t next_release;		/* ms */
+	volatile uint32_t release_cycle;
+	volatile uint8_t busy;
+	volatile uint32_t release;	/* number of release */
+	volatile uint32_t miss;		/* number of deadline miss */
+	volatile uint32_t resp_max;	/* max cycles from release to step finish */
+	perf_counter_t exec;		/* execution time of step */
+	model_task_t* next;
+};
+
+/******************* Helper Macro *******************/
+#define MODEL_TASK_ID(_name)	(&__model_task_##_name)
+
+#define MODEL_TASK_DEFINE(_name, _step, _stack_size)					\
+	static uint8_t __model_stack_##_name[_stack_size] __attribute__((aligned(8)));	\
+	model_task_t __model_task_##_name = {								\
+		.name = #_name,													\
+		.step = _step,													\
+		.stack = __model_stack_##_name,									\
+		.stack_size = _stack_size,										\
+		.exec = {														\
+			.name = #_name "_step",										\
+			.min = 0xFFFFFFFF,											\
+		},																\
+		.next = NULL													\
+	}
+
+/******************* API *******************/
+fmt_err model_sched_register(model_task_t* task, uint32_t period);
+fmt_err model_sched_start(void);
+void model_sched_tick(uint32_t time_now);
+void model_sched_reset(void);
+model_task_t* model_sched_get_list(void);
+void model_sched_log(void);
+
+#endif
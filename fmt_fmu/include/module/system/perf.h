@@ -0,0 +1,98 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef __PERF_H__
+#define __PERF_H__
+
+#include <firmament.h>
+
+#if !defined(__arm__)
+#include <time.h>
+#endif
+
+/* log2 histogram of scope duration in us: [0,1) [1,2) [2,4) ... [1024,inf) */
+#define PERF_HIST_BINS 12
+/* scope name in the log, longer names are cut */
+#define PERF_NAME_LEN 20
+
+typedef struct perf_counter perf_counter_t;
+struct perf_counter {
+	const char* name;
+	volatile uint32_t start;	/* cycle stamp of scope begin */
+	volatile uint8_t reset;		/* reset request, handled by perf_end() */
+	uint32_t count;
+	uint32_t min;				/* cycles */
+	uint32_t max;				/* cycles */
+	uint64_t total;				/* cycles */
+	uint32_t hist[PERF_HIST_BINS];
+	perf_counter_t* next;
+};
+
+/******************* Helper Macro *******************/
+#define PERF_ID(_name)			(&__perf_##_name)
+
+#define PERF_DECLARE(_name)		extern perf_counter_t __perf_##_name
+
+#define PERF_DEFINE(_name)				\
+	perf_counter_t __perf_##_name = {	\
+		.name = #_name,					\
+		.start = 0,						\
+		.reset = 0,						\
+		.count = 0,						\
+		.min = 0xFFFFFFFF,				\
+		.max = 0,						\
+		.total = 0,						\
+		.next = NULL					\
+	}
+
+#ifdef FMT_USING_PERF
+#define PERF_BEGIN(_name)		perf_begin(PERF_ID(_name))
+#define PERF_END(_name)			perf_end(PERF_ID(_name))
+#else
+#define PERF_BEGIN(_name)
+#define PERF_END(_name)
+#endif
+
+/* free running cycle counter, wrap around is handled by unsigned subtraction */
+static inline uint32_t perf_cycle_now(void)
+{
+#if defined(__arm__)
+	return DWT->CYCCNT;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#endif
+}
+
+/* can be called from interrupt, the scope may end in another context */
+static inline void perf_begin(perf_counter_t* pc)
+{
+	pc->start = perf_cycle_now();
+}
+
+/******************* API *******************/
+void perf_end(perf_counter_t* pc);
+void perf_reset(perf_counter_t* pc);
+fmt_err perf_register(perf_counter_t* pc);
+perf_counter_t* perf_get_list(void);
+float perf_cycle_to_us(uint64_t cycle);
+void perf_log(void);
+void perf_init(void);
+
+#endif
@@ -19,7 +19,35 @@
 
 #include <firmament.h>
 
+#define SYS_STAT_MAX_THREAD	16
+#define SYS_STAT_MAX_IRQ	16	/* number of the busiest interrupts to report */
+
+typedef struct {
+	char name[RT_NAME_MAX];
+	float usage;			/* percentage of cpu time */
+	uint32_t switch_cnt;	/* times switched in per second */
+	float max_run_us;		/* longest run before being switched out */
+} Thread_Stat;
+
+typedef struct {
+	int16_t irqn;			/* IRQn_Type, e.g, -1 is SysTick */
+	uint16_t reserved;
+	float usage;			/* percentage of cpu time */
+	uint32_t count;			/* times per second */
+} Irq_Stat;
+
+typedef struct {
+	uint32_t timestamp_ms;
+	float cpu_usage;		/* percentage of cpu time not used by idle thread */
+	float irq_usage;		/* percentage of cpu time used by interrupts */
+	uint16_t thread_num;
+	uint16_t irq_num;
+	Thread_Stat thread[SYS_STAT_MAX_THREAD];
+	Irq_Stat irq[SYS_STAT_MAX_IRQ];
+} Sys_Stat_Report;
+
 void sys_stat_init(void);
 float sysstat_get_cpu_usage(void);
+fmt_err sysstat_get_report(Sys_Stat_Report* report);
 
 #endif
@@ -0,0 +1,45 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef __LZ_H__
+#define __LZ_H__
+
+#include <stdint.h>
+
+/*
+ * Small LZ77 compressor with output size bound, for sending data over
+ * packet links. Output is a series of sequences in LZ4 block style:
+ *
+ * | token | [literal len ext] | literals | offset(2, le) | [match len ext] |
+ *
+ * token high nibble is literal length, low nibble is match length - 4. a
+ * nibble of 15 is followed by bytes added to it, until a byte < 255. the
+ * last sequence may end after its literals (no match). match offset is
+ * counted back from current output position and never exceeds the block,
+ * so every block can be decoded on its own.
+ */
+
+#define LZ_MIN_MATCH        4
+#define LZ_HASH_BITS        10
+#define LZ_HASH_SIZE        (1 << LZ_HASH_BITS)
+/* matches are referenced by 16-bit position */
+#define LZ_MAX_INPUT        65535
+
+uint32_t lz_compress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_cap, uint32_t* consumed,
+                     uint16_t hash_table[LZ_HASH_SIZE]);
+int32_t lz_decompress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_cap);
+
+#endif
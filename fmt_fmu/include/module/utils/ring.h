@@ -0,0 +1,314 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef __RING_H__
+#define __RING_H__
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Lock-free ring buffers, header only.
+ *
+ * ring_spsc: one producer and one consumer, each can be a thread or an isr.
+ * head is only written by producer and tail only by consumer. indexes run
+ * freely and are masked on access, so the capacity must be power of 2 and
+ * all slots can be used. besides copy in/out, the producer can reserve a
+ * contiguous span to fill in place (e.g. as dma target) and the consumer can
+ * peek a contiguous span to process in place.
+ *
+ * ring_mpsc: any number of producers and one consumer, one element per
+ * operation. each slot carries a sequence number, a producer claims a slot by
+ * cas on head and publishes it by updating the sequence. producers never wait
+ * for each other, but the consumer reads slots in order: a producer preempted
+ * between claim and publish holds back every slot claimed after its own, peek
+ * returns NULL until it resumes. so a low priority producer can delay the
+ * elements of higher priority ones by as long as it is preempted.
+ */
+
+#if defined(__GNUC__) && !defined(__CC_ARM)
+	#define RING_LOAD_ACQUIRE(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+	#define RING_STORE_RELEASE(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+	#define RING_CAS(p, e, d)			__atomic_compare_exchange_n((p), (e), (d), 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)
+#else
+	/* armcc/iar on cortex-m, cmsis core header should be included before */
+	static inline uint32_t _ring_load_acquire(volatile uint32_t* p)
+	{
+		uint32_t v = *p;
+		__DMB();
+		return v;
+	}
+
+	static inline void _ring_store_release(volatile uint32_t* p, uint32_t v)
+	{
+		__DMB();
+		*p = v;
+	}
+
+	static inline int _ring_cas(volatile uint32_t* p, uint32_t* e, uint32_t d)
+	{
+		uint32_t v;
+
+		do {
+			v = __LDREXW(p);
+
+			if(v != *e) {
+				__CLREX();
+				*e = v;
+				return 0;
+			}
+		} while(__STREXW(d, p));
+
+		__DMB();
+		return 1;
+	}
+
+	#define RING_LOAD_ACQUIRE(p)		_ring_load_acquire(p)
+	#define RING_STORE_RELEASE(p, v)	_ring_store_release(p, v)
+	#define RING_CAS(p, e, d)			_ring_cas(p, e, d)
+#endif
+
+#define RING_IS_POW2(n)		((n) != 0 && ((n) & ((n) - 1)) == 0)
+
+typedef struct {
+	volatile uint32_t head;		/* next slot to write, updated by producer */
+	volatile uint32_t tail;		/* next slot to read, updated by consumer */
+	uint32_t mask;				/* capacity - 1 */
+	uint32_t esize;				/* element size in byte */
+	uint8_t* buff;
+} ring_spsc;
+
+typedef struct {
+	volatile uint32_t head;		/* next slot to claim, shared by producers */
+	uint32_t tail;				/* next slot to read, consumer only */
+	uint32_t mask;
+	uint32_t esize;
+	volatile uint32_t* seq;		/* per slot sequence, capacity entries */
+	uint8_t* buff;
+} ring_mpsc;
+
+/************************* ring_spsc *************************/
+
+/* num: capacity in element, must be power of 2. return 0 if success */
+static inline uint8_t ring_spsc_init(ring_spsc* r, void* buff, uint32_t num, uint32_t esize)
+{
+	if(!RING_IS_POW2(num) || esize == 0) {
+		return 1;
+	}
+
+	r->head = 0;
+	r->tail = 0;
+	r->mask = num - 1;
+	r->esize = esize;
+	r->buff = (uint8_t*)buff;
+
+	return 0;
+}
+
+static inline uint32_t ring_spsc_capacity(const ring_spsc* r)
+{
+	return r->mask + 1;
+}
+
+/* number of elements can be read */
+static inline uint32_t ring_spsc_count(ring_spsc* r)
+{
+	return RING_LOAD_ACQUIRE(&r->head) - r->tail;
+}
+
+/* number of elements can be written */
+static inline uint32_t ring_spsc_space(ring_spsc* r)
+{
+	return r->mask + 1 - (r->head - RING_LOAD_ACQUIRE(&r->tail));
+}
+
+/* producer: get contiguous free span at head, return its length in element */
+static inline uint32_t ring_spsc_reserve(ring_spsc* r, void** ptr)
+{
+	uint32_t head = r->head;
+	uint32_t idx = head & r->mask;
+	uint32_t space = r->mask + 1 - (head - RING_LOAD_ACQUIRE(&r->tail));
+	uint32_t to_end = r->mask + 1 - idx;
+
+	*ptr = &r->buff[idx * r->esize];
+
+	return space < to_end ? space : to_end;
+}
+
+/* producer: publish n elements written to the reserved span */
+static inline void ring_spsc_commit(ring_spsc* r, uint32_t n)
+{
+	RING_STORE_RELEASE(&r->head, r->head + n);
+}
+
+/* consumer: get contiguous filled span at tail, return its length in element */
+static inline uint32_t ring_spsc_peek(ring_spsc* r, void** ptr)
+{
+	uint32_t tail = r->tail;
+	uint32_t idx = tail & r->mask;
+	uint32_t count = RING_LOAD_ACQUIRE(&r->head) - tail;
+	uint32_t to_end = r->mask + 1 - idx;
+
+	*ptr = &r->buff[idx * r->esize];
+
+	return count < to_end ? count : to_end;
+}
+
+/* consumer: release n elements returned by peek */
+static inline void ring_spsc_consume(ring_spsc* r, uint32_t n)
+{
+	RING_STORE_RELEASE(&r->tail, r->tail + n);
+}
+
+/* producer: copy in up to num elements, return number of elements written */
+static inline uint32_t ring_spsc_put(ring_spsc* r, const void* data, uint32_t num)
+{
+	uint32_t space = ring_spsc_space(r);
+	uint32_t idx = r->head & r->mask;
+	uint32_t to_end = r->mask + 1 - idx;
+	uint32_t n;
+
+	if(num > space) {
+		num = space;
+	}
+
+	n = num < to_end ? num : to_end;
+	memcpy(&r->buff[idx * r->esize], data, n * r->esize);
+	memcpy(r->buff, (const uint8_t*)data + n * r->esize, (num - n) * r->esize);
+
+	ring_spsc_commit(r, num);
+
+	return num;
+}
+
+/* consumer: copy out up to num elements, return number of elements read */
+static inline uint32_t ring_spsc_get(ring_spsc* r, void* data, uint32_t num)
+{
+	uint32_t count = ring_spsc_count(r);
+	uint32_t idx = r->tail & r->mask;
+	uint32_t to_end = r->mask + 1 - idx;
+	uint32_t n;
+
+	if(num > count) {
+		num = count;
+	}
+
+	n = num < to_end ? num : to_end;
+	memcpy(data, &r->buff[idx * r->esize], n * r->esize);
+	memcpy((uint8_t*)data + n * r->esize, r->buff, (num - n) * r->esize);
+
+	ring_spsc_consume(r, num);
+
+	return num;
+}
+
+/* consumer: drop all readable elements */
+static inline void ring_spsc_flush(ring_spsc* r)
+{
+	RING_STORE_RELEASE(&r->tail, RING_LOAD_ACQUIRE(&r->head));
+}
+
+/************************* ring_mpsc *************************/
+
+/* seq: array of num entries. num must be power of 2. return 0 if success */
+static inline uint8_t ring_mpsc_init(ring_mpsc* r, void* buff, uint32_t* seq, uint32_t num, uint32_t esize)
+{
+	if(!RING_IS_POW2(num) || esize == 0) {
+		return 1;
+	}
+
+	for(uint32_t i = 0; i < num; i++) {
+		seq[i] = i;
+	}
+
+	r->head = 0;
+	r->tail = 0;
+	r->mask = num - 1;
+	r->esize = esize;
+	r->seq = seq;
+	r->buff = (uint8_t*)buff;
+
+	return 0;
+}
+
+/* producer: copy in one element, return 0 if success, 1 if full */
+static inline uint8_t ring_mpsc_push(ring_mpsc* r, const void* elem)
+{
+	uint32_t pos = RING_LOAD_ACQUIRE(&r->head);
+	uint32_t seq;
+	int32_t diff;
+
+	for(;;) {
+		seq = RING_LOAD_ACQUIRE(&r->seq[pos & r->mask]);
+		diff = (int32_t)(seq - pos);
+
+		if(diff == 0) {
+			/* slot is free, try to claim it. pos is reloaded on failure */
+			if(RING_CAS(&r->head, &pos, pos + 1)) {
+				break;
+			}
+		} else if(diff < 0) {
+			/* slot still holds an element one lap behind */
+			return 1;
+		} else {
+			/* another producer claimed it */
+			pos = RING_LOAD_ACQUIRE(&r->head);
+		}
+	}
+
+	memcpy(&r->buff[(pos & r->mask) * r->esize], elem, r->esize);
+	RING_STORE_RELEASE(&r->seq[pos & r->mask], pos + 1);
+
+	return 0;
+}
+
+/* consumer: get oldest element in place, NULL if empty or not published yet */
+static inline void* ring_mpsc_peek(ring_mpsc* r)
+{
+	uint32_t pos = r->tail;
+
+	if(RING_LOAD_ACQUIRE(&r->seq[pos & r->mask]) != pos + 1) {
+		return NULL;
+	}
+
+	return &r->buff[(pos & r->mask) * r->esize];
+}
+
+/* consumer: release element returned by peek */
+static inline void ring_mpsc_consume(ring_mpsc* r)
+{
+	uint32_t pos = r->tail;
+
+	r->tail = pos + 1;
+	RING_STORE_RELEASE(&r->seq[pos & r->mask], pos + r->mask + 1);
+}
+
+/* consumer: copy out one element, return 0 if success, 1 if empty */
+static inline uint8_t ring_mpsc_pop(ring_mpsc* r, void* elem)
+{
+	void* p = ring_mpsc_peek(r);
+
+	if(p == NULL) {
+		return 1;
+	}
+
+	memcpy(elem, p, r->esize);
+	ring_mpsc_consume(r);
+
+	return 0;
+}
+
+#endif
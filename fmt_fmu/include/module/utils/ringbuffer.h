@@ -19,12 +19,13 @@
 
 #include <stdint.h>
 
+#include "module/utils/ring.h"
+
+/* byte ring on top of ring_spsc. any thread can write or read it, each call
+ * holds the scheduler lock. size must be power of 2 */
 typedef struct {
 	uint8_t	static_flag;
-	unsigned head;
-	unsigned tail;
-	unsigned size;
-	uint8_t* buff;
+	ring_spsc ring;
 } ringbuffer;
 
 ringbuffer* ringbuffer_create(uint32_t size);
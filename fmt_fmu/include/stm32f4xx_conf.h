@@ -33,7 +33,7 @@
 //#include "stm32f4xx_dbgmcu.h"
 //#include "stm32f4xx_dcmi.h"
 #include "stm32f4xx_dma.h"
-//#include "stm32f4xx_exti.h"
+#include "stm32f4xx_exti.h"
 //#include "stm32f4xx_flash.h"
 //#include "stm32f4xx_fsmc.h"
 //#include "stm32f4xx_hash.h"
@@ -46,7 +46,7 @@
 #include "stm32f4xx_rtc.h"
 #include "stm32f4xx_sdio.h"
 #include "stm32f4xx_spi.h"
-//#include "stm32f4xx_syscfg.h"
+#include "stm32f4xx_syscfg.h"
 #include "stm32f4xx_tim.h"
 #include "stm32f4xx_usart.h"
 //#include "stm32f4xx_wwdg.h"
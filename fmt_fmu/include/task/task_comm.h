@@ -21,10 +21,11 @@
 #include <mavlink.h>
 
 #include "module/mavproxy/mavlink_status.h"
+#include "module/utils/ring.h"
 #include "module/utils/ringbuffer.h"
 
 #define MAX_PERIOD_MSG_QUEUE_SIZE    20
-#define MAX_IMMEDIATE_MSG_QUEUE_SIZE 10
+#define MAX_IMMEDIATE_MSG_QUEUE_SIZE 16 // must be power of 2
 
 #define EVENT_MAVPROXY_UPDATE    (1 << 0)
 #define EVENT_MAVCONSOLE_TIMEOUT (1 << 1)
@@ -46,8 +47,8 @@ typedef struct {
 
 typedef struct {
     mavlink_message_t queue[MAX_IMMEDIATE_MSG_QUEUE_SIZE];
-    uint16_t head;
-    uint16_t tail;
+    uint32_t seq[MAX_IMMEDIATE_MSG_QUEUE_SIZE];
+    ring_mpsc ring;
 } MAV_ImmediateMsg_Queue;
 
 extern ringbuffer* _mav_serial_rb;
@@ -20,20 +20,29 @@
 #include <firmament.h>
 #include "module/fmtio/fmtio_protocol.h"
 
-#define FMT_IO_BUFFER_SIZE				10
-#define	FMT_IO_PKG_DATA_SIZE			256
+#define FMT_IO_FRAME_POOL_SIZE			4		// must be power of 2
+/* one frame in transmission, one pending and one being filled */
+#define FMT_IO_MOTOR_FRAME_NUM			3
 
 #define FMTIO_MOTOR_CHANNEL_NUM     8
 #define FMTIO_RC_CHANNEL_NUM        8
 
+typedef struct {
+    uint32_t timestamp_ms;
+    uint32_t cmd_timestamp_us; /* fmu time when the motor command is serialized */
+    uint32_t rtt_us;           /* command sent to ack received */
+    uint32_t link_us;          /* estimated one-way transfer time to io */
+    uint16_t io_proc_us;       /* io frame received to pwm updated */
+    uint16_t io_hold_us;       /* io frame received to ack sent */
+    uint32_t latency_us;       /* command serialized to pwm updated */
+} FMTIO_Latency_Report;
+
 fmt_err task_fmtio_init(void);
 void task_fmtio_entry(void* parameter);
-fmt_err fmtio_init_pkg(uint16_t cmd, void* buffer, PackageStruct* pkg);
-fmt_err fmtio_create_pkg(uint16_t cmd, uint16_t buff_len, PackageStruct* pkg);
-fmt_err fmtio_send_pkg(const void* data, uint16_t len, PackageStruct* pkg);
 fmt_err fmtio_send_message(uint16_t cmd, const void* data, uint16_t len);
 void fmtio_suspend_comm(uint8_t suspend);
 rt_device_t fmtio_get_device(void);
 fmt_err fmtio_config(uint32_t baud_rate, uint16_t rc_chan_num, uint16_t pwm_freq);
+void fmtio_get_link_stat(LinkStatStruct* stat);
 
 #endif
\ No newline at end of file
@@ -19,6 +19,8 @@
 
 #include <firmament.h>
 
+#define LOG_SESSION_FOLDER              "/log"
+
 #define EVENT_BLOG_UPDATE				(1<<0)
 #define EVENT_ULOG_UPDATE		        (1<<1)
 
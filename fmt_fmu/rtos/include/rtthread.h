@@ -261,6 +261,8 @@ void rt_free_align(void* ptr);
 void rt_memory_info(rt_uint32_t* total,
                     rt_uint32_t* used,
                     rt_uint32_t* max_used);
+void rt_memory_free_info(rt_uint32_t* max_free,
+                         rt_uint32_t* free_blocks);
 
 #ifdef RT_USING_SLAB
 void* rt_page_alloc(rt_size_t npages);
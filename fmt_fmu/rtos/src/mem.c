@@ -618,6 +618,38 @@ void rt_memory_info(rt_uint32_t* total,
 		*max_used = max_mem;
 }
 
+/**
+ * This function walks the heap to get the size of the largest free block and
+ * the number of free blocks, which indicates the fragmentation of heap.
+ */
+void rt_memory_free_info(rt_uint32_t* max_free,
+                         rt_uint32_t* free_blocks)
+{
+	struct heap_mem* mem;
+	rt_uint32_t size, max = 0, num = 0;
+
+	rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+
+	for(mem = lfree; mem != heap_end; mem = (struct heap_mem*)&heap_ptr[mem->next]) {
+		if(!mem->used) {
+			size = mem->next - ((rt_uint8_t*)mem - heap_ptr) - SIZEOF_STRUCT_MEM;
+
+			if(size > max)
+				max = size;
+
+			num ++;
+		}
+	}
+
+	rt_sem_release(&heap_sem);
+
+	if(max_free != RT_NULL)
+		*max_free = max;
+
+	if(free_blocks != RT_NULL)
+		*free_blocks = num;
+}
+
 #ifdef RT_USING_FINSH
 #include <finsh.h>
 
@@ -26,6 +26,8 @@
 #include "module/sensor/sensor_manager.h"
 #include "module/sysio/actuator_cmd.h"
 #include "module/sysio/pilot_cmd.h"
+#include "module/system/memstat.h"
+#include "module/system/perf.h"
 #include "module/system/statistic.h"
 #include "module/system/systime.h"
 
@@ -93,6 +95,9 @@ void board_early_init(void)
     /* system time module init */
     systime_init();
 
+    /* enable cycle counter for perf scopes */
+    perf_init();
+
     /* init console to enable console output */
     console_init(CONSOLE_DEVICE_NAME);
 
@@ -142,6 +147,8 @@ void board_init(void)
 
     sys_stat_init();
 
+    memstat_init();
+
 #ifdef FMT_USING_CM_BACKTRACE
     // cortex-m backtrace
     cm_backtrace_init("fmt_fmu", BOARD_NAME, "V0.1");
@@ -120,6 +120,28 @@ static const struct pin_index pins[] = {
 
 #define ITEM_NUM(items)     sizeof(items)/sizeof(items[0])
 
+/* each exti line can only be attached to one pin */
+struct pin_irq_hdr {
+	int16_t pin;
+	uint16_t mode;
+	void (*hdr)(void* args);
+	void* args;
+};
+
+static const IRQn_Type pin_irq_map[16] = {
+	EXTI0_IRQn, EXTI1_IRQn, EXTI2_IRQn, EXTI3_IRQn,
+	EXTI4_IRQn, EXTI9_5_IRQn, EXTI9_5_IRQn, EXTI9_5_IRQn,
+	EXTI9_5_IRQn, EXTI9_5_IRQn, EXTI15_10_IRQn, EXTI15_10_IRQn,
+	EXTI15_10_IRQn, EXTI15_10_IRQn, EXTI15_10_IRQn, EXTI15_10_IRQn,
+};
+
+static struct pin_irq_hdr pin_irq_hdr_tab[16] = {
+	{-1, 0, RT_NULL, RT_NULL}, {-1, 0, RT_NULL, RT_NULL}, {-1, 0, RT_NULL, RT_NULL}, {-1, 0, RT_NULL, RT_NULL},
+	{-1, 0, RT_NULL, RT_NULL}, {-1, 0, RT_NULL, RT_NULL}, {-1, 0, RT_NULL, RT_NULL}, {-1, 0, RT_NULL, RT_NULL},
+	{-1, 0, RT_NULL, RT_NULL}, {-1, 0, RT_NULL, RT_NULL}, {-1, 0, RT_NULL, RT_NULL}, {-1, 0, RT_NULL, RT_NULL},
+	{-1, 0, RT_NULL, RT_NULL}, {-1, 0, RT_NULL, RT_NULL}, {-1, 0, RT_NULL, RT_NULL}, {-1, 0, RT_NULL, RT_NULL},
+};
+
 static struct pin_device pin_device;
 
 // TODO, optimize get_pin speed
@@ -219,10 +241,226 @@ void gpio_pin_mode(rt_device_t dev, rt_base_t pin, rt_base_t mode, rt_base_t oty
 	GPIO_Init(index->gpio, &GPIO_InitStructure);
 }
 
+static uint8_t _get_pin_source(uint32_t pin)
+{
+	uint8_t source = 0;
+
+	while(source < 16 && !(pin & (1 << source))) {
+		source++;
+	}
+
+	return source;
+}
+
+static uint8_t _get_port_source(GPIO_TypeDef* gpio)
+{
+	return ((uint32_t)gpio - (uint32_t)GPIOA) / ((uint32_t)GPIOB - (uint32_t)GPIOA);
+}
+
+rt_err_t gpio_pin_attach_irq(rt_device_t dev, rt_base_t pin, rt_base_t mode, void (*hdr)(void* args), void* args)
+{
+	const struct pin_index* index;
+	rt_base_t level;
+	uint8_t line;
+
+	index = _get_pin(pin);
+
+	if(index == RT_NULL) {
+		return -RT_ENOSYS;
+	}
+
+	line = _get_pin_source(index->pin);
+
+	level = rt_hw_interrupt_disable();
+
+	if(pin_irq_hdr_tab[line].pin == pin
+	        && pin_irq_hdr_tab[line].hdr == hdr
+	        && pin_irq_hdr_tab[line].mode == mode
+	        && pin_irq_hdr_tab[line].args == args) {
+		rt_hw_interrupt_enable(level);
+		return RT_EOK;
+	}
+
+	if(pin_irq_hdr_tab[line].pin != -1) {
+		/* exti line is already occupied by other pin */
+		rt_hw_interrupt_enable(level);
+		return -RT_EBUSY;
+	}
+
+	pin_irq_hdr_tab[line].pin = pin;
+	pin_irq_hdr_tab[line].hdr = hdr;
+	pin_irq_hdr_tab[line].mode = mode;
+	pin_irq_hdr_tab[line].args = args;
+
+	rt_hw_interrupt_enable(level);
+
+	return RT_EOK;
+}
+
+rt_err_t gpio_pin_detach_irq(rt_device_t dev, rt_base_t pin)
+{
+	const struct pin_index* index;
+	rt_base_t level;
+	uint8_t line;
+
+	index = _get_pin(pin);
+
+	if(index == RT_NULL) {
+		return -RT_ENOSYS;
+	}
+
+	line = _get_pin_source(index->pin);
+
+	level = rt_hw_interrupt_disable();
+
+	if(pin_irq_hdr_tab[line].pin == pin) {
+		pin_irq_hdr_tab[line].pin = -1;
+		pin_irq_hdr_tab[line].hdr = RT_NULL;
+		pin_irq_hdr_tab[line].mode = 0;
+		pin_irq_hdr_tab[line].args = RT_NULL;
+	}
+
+	rt_hw_interrupt_enable(level);
+
+	return RT_EOK;
+}
+
+rt_err_t gpio_pin_irq_enable(rt_device_t dev, rt_base_t pin, rt_base_t enabled)
+{
+	const struct pin_index* index;
+	EXTI_InitTypeDef EXTI_InitStructure;
+	NVIC_InitTypeDef NVIC_InitStructure;
+	rt_base_t level;
+	uint8_t line;
+
+	index = _get_pin(pin);
+
+	if(index == RT_NULL) {
+		return -RT_ENOSYS;
+	}
+
+	line = _get_pin_source(index->pin);
+
+	if(pin_irq_hdr_tab[line].pin != pin) {
+		/* irq is not attached */
+		return -RT_ENOSYS;
+	}
+
+	EXTI_InitStructure.EXTI_Line = index->pin;	/* EXTI_Linex has the same bit as GPIO_Pin_x */
+	EXTI_InitStructure.EXTI_Mode = EXTI_Mode_Interrupt;
+
+	if(pin_irq_hdr_tab[line].mode == PIN_IRQ_MODE_FALLING) {
+		EXTI_InitStructure.EXTI_Trigger = EXTI_Trigger_Falling;
+	} else if(pin_irq_hdr_tab[line].mode == PIN_IRQ_MODE_RISING_FALLING) {
+		EXTI_InitStructure.EXTI_Trigger = EXTI_Trigger_Rising_Falling;
+	} else {
+		EXTI_InitStructure.EXTI_Trigger = EXTI_Trigger_Rising;
+	}
+
+	level = rt_hw_interrupt_disable();
+
+	if(enabled == PIN_IRQ_ENABLE) {
+		RCC_APB2PeriphClockCmd(RCC_APB2Periph_SYSCFG, ENABLE);
+		SYSCFG_EXTILineConfig(_get_port_source(index->gpio), line);
+
+		EXTI_InitStructure.EXTI_LineCmd = ENABLE;
+		EXTI_ClearITPendingBit(index->pin);
+		EXTI_Init(&EXTI_InitStructure);
+
+		/* sensor data-ready interrupts should be served with high priority */
+		NVIC_InitStructure.NVIC_IRQChannel = pin_irq_map[line];
+		NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
+		NVIC_InitStructure.NVIC_IRQChannelSubPriority = 1;
+		NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+		NVIC_Init(&NVIC_InitStructure);
+	} else {
+		/* only disable the exti line, the nvic channel may be shared */
+		EXTI_InitStructure.EXTI_LineCmd = DISABLE;
+		EXTI_Init(&EXTI_InitStructure);
+	}
+
+	rt_hw_interrupt_enable(level);
+
+	return RT_EOK;
+}
+
+static void _pin_irq_handler(uint8_t line)
+{
+	uint32_t exti_line = 1 << line;
+
+	if(EXTI_GetITStatus(exti_line) != RESET) {
+		EXTI_ClearITPendingBit(exti_line);
+
+		if(pin_irq_hdr_tab[line].hdr) {
+			pin_irq_hdr_tab[line].hdr(pin_irq_hdr_tab[line].args);
+		}
+	}
+}
+
+void EXTI0_IRQHandler(void)
+{
+	rt_interrupt_enter();
+	_pin_irq_handler(0);
+	rt_interrupt_leave();
+}
+
+void EXTI1_IRQHandler(void)
+{
+	rt_interrupt_enter();
+	_pin_irq_handler(1);
+	rt_interrupt_leave();
+}
+
+void EXTI2_IRQHandler(void)
+{
+	rt_interrupt_enter();
+	_pin_irq_handler(2);
+	rt_interrupt_leave();
+}
+
+void EXTI3_IRQHandler(void)
+{
+	rt_interrupt_enter();
+	_pin_irq_handler(3);
+	rt_interrupt_leave();
+}
+
+void EXTI4_IRQHandler(void)
+{
+	rt_interrupt_enter();
+	_pin_irq_handler(4);
+	rt_interrupt_leave();
+}
+
+void EXTI9_5_IRQHandler(void)
+{
+	rt_interrupt_enter();
+
+	for(uint8_t line = 5 ; line <= 9 ; line++) {
+		_pin_irq_handler(line);
+	}
+
+	rt_interrupt_leave();
+}
+
+void EXTI15_10_IRQHandler(void)
+{
+	rt_interrupt_enter();
+
+	for(uint8_t line = 10 ; line <= 15 ; line++) {
+		_pin_irq_handler(line);
+	}
+
+	rt_interrupt_leave();
+}
+
 const static struct pin_ops _gpio_pin_ops = {
 	gpio_pin_mode,
 	gpio_pin_write,
 	gpio_pin_read,
+	gpio_pin_attach_irq,
+	gpio_pin_detach_irq,
+	gpio_pin_irq_enable,
 };
 
 rt_err_t gpio_drv_init(void)
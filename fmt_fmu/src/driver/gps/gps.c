@@ -24,11 +24,44 @@
 #define FNV1_32_PRIME	((uint32_t)0x01000193)	// magic prime for FNV1 hash algorithm
 #define M_DEG_TO_RAD_F 		0.01745329251994f
 #define M_RAD_TO_DEG_F 		57.2957795130823f
+#define M_PI_F				3.14159265358979f
 #define MIN(x,y) (x < y ? x : y)
+#define MAX(x,y) (x > y ? x : y)
+
+#define GPS_THREAD_STACK_SIZE	1024
+
+#define GPS_WEEK_MS				604800000ULL	// milliseconds of one gps week
+#define GPS_EPOCH_RESYNC_US		500000			// resync epoch alignment if offset jumps more than this
+#define GPS_CLOCK_DRIFT_PPM		100				// max drift between local clock and gps time
+#define GPS_RELPOSNED_MISS_MAX	5				// epochs without RELPOSNED before it's dropped
 
 static rt_device_t serial_device;
 static struct rt_device gps_device;
 
+static struct rt_thread _gps_thread;
+ALIGN(RT_ALIGN_SIZE)
+static rt_uint8_t _gps_thread_stack[GPS_THREAD_STACK_SIZE];
+static struct rt_semaphore _gps_rx_sem;
+static volatile uint64_t _gps_rx_stamp_us;
+static uint32_t _byte_time_us;
+static uint64_t _rx_timestamp_us;
+
+/* offset between local clock and gps time of week */
+static int64_t _epoch_offset_us;
+static uint64_t _epoch_update_us;
+static rt_bool_t _epoch_offset_valid;
+
+/* parsed reports are double-buffered, the parser fills the back buffer and
+ * flips the index, readers retry if a flip happens during their copy */
+static struct vehicle_gps_position_s _gps_report[2];
+static volatile uint8_t _gps_report_front;
+static volatile uint32_t _gps_report_seq;
+static uint32_t _gps_report_read_seq;
+
+/* the report is a plain struct, keep the compiler from moving its copy across
+ * the index and seq updates. a single core needs no hardware barrier */
+#define GPS_REPORT_BARRIER() __asm volatile("" ::: "memory")
+
 ubx_decode_state_t _decode_state;
 uint16_t _rx_payload_length;
 uint16_t _rx_payload_index;
@@ -37,17 +70,15 @@ uint8_t _rx_ck_b;
 uint16_t _rx_msg;
 ubx_rxmsg_state_t _rx_state;
 rt_bool_t _configured;
-rt_bool_t _use_nav_pvt;
+rt_bool_t _use_relposned;
+rt_bool_t _pvt_pending;
+uint8_t _relposned_miss;
 ubx_buf_t _buf;
 ubx_ack_state_t _ack_state;
 uint16_t _ack_waiting_msg;
 uint32_t _ubx_version;
-struct vehicle_gps_position_s _gps_position;
+static struct vehicle_gps_position_s _gps_position;
 struct satellite_info_s _satellite_info;
-uint8_t _rate_count_lat_lon;
-uint8_t _rate_count_vel;
-rt_bool_t _got_posllh;
-rt_bool_t _got_velned;
 rt_bool_t _got_svinfo;
 
 void _decode_init(void)
@@ -77,9 +108,64 @@ rt_err_t _set_baudrate(rt_device_t dev, uint32_t baudrate)
 
 	err = rt_device_control(dev, RT_DEVICE_CTRL_CONFIG, &serial_dev->config);
 
+	/* 8N1, 10 bits per byte */
+	_byte_time_us = 10000000 / baudrate;
+
 	return err;
 }
 
+static uint64_t _align_epoch(uint32_t iTOW, uint64_t rx_us)
+{
+	/* The receiver computes the solution at the gps epoch and sends it after a
+	 * roughly constant processing delay, plus a variable queuing delay. The
+	 * smallest observed offset between local time and gps time of week
+	 * is the one without queuing delay, so track the minimum (allowing for
+	 * the local clock drift) and stamp reports on the epoch grid with it. */
+	int64_t offset = (int64_t)rx_us - (int64_t)iTOW * 1000;
+
+	if(!_epoch_offset_valid || offset < _epoch_offset_us || offset - _epoch_offset_us > GPS_EPOCH_RESYNC_US) {
+		/* first epoch, smaller delay or week rollover */
+		_epoch_offset_us = offset;
+		_epoch_offset_valid = RT_TRUE;
+	} else {
+		_epoch_offset_us += (int64_t)(rx_us - _epoch_update_us) * GPS_CLOCK_DRIFT_PPM / 1000000;
+
+		if(_epoch_offset_us > offset) {
+			_epoch_offset_us = offset;
+		}
+	}
+
+	_epoch_update_us = rx_us;
+
+	return (uint64_t)((int64_t)iTOW * 1000 + _epoch_offset_us);
+}
+
+static void _publish_report(void)
+{
+	uint8_t back = _gps_report_front ^ 1;
+
+	_gps_report[back] = _gps_position;
+	GPS_REPORT_BARRIER();
+	_gps_report_front = back;
+	_gps_report_seq++;
+
+	_pvt_pending = RT_FALSE;
+}
+
+static uint32_t _copy_report(struct vehicle_gps_position_s* report)
+{
+	uint32_t seq;
+
+	do {
+		seq = _gps_report_seq;
+		GPS_REPORT_BARRIER();
+		*report = _gps_report[_gps_report_front];
+		GPS_REPORT_BARRIER();
+	} while(seq != _gps_report_seq);
+
+	return seq;
+}
+
 uint32_t fnv1_32_str(uint8_t* str, uint32_t hval)
 {
 	uint8_t* s = str;
@@ -207,10 +293,17 @@ payload_rx_done(void)
 	// handle message
 	switch(_rx_msg) {
 		case UBX_MSG_NAV_PVT: {
-			// struct gps_tm timeinfo;
+			/* the previous epoch never got its RELPOSNED, publish it as it is */
+			if(_pvt_pending) {
+				_publish_report();
 
+				/* module acked the config but doesn't output it, stop waiting */
+				if(++_relposned_miss >= GPS_RELPOSNED_MISS_MAX) {
+					_use_relposned = RT_FALSE;
+				}
+			}
 
-			if((_buf.payload_rx_nav_pvt.flags & UBX_RX_NAV_PVT_FLAGS_GNSSFIXOK) == 1) {
+			if(_buf.payload_rx_nav_pvt.flags & UBX_RX_NAV_PVT_FLAGS_GNSSFIXOK) {
 				_gps_position.fix_type		 = _buf.payload_rx_nav_pvt.fixType;
 				_gps_position.vel_ned_valid = 1;
 
@@ -219,11 +312,13 @@ payload_rx_done(void)
 				_gps_position.vel_ned_valid = 0;
 			}
 
+			_gps_position.carr_soln		= (_buf.payload_rx_nav_pvt.flags & UBX_RX_NAV_PVT_FLAGS_CARRSOLN) >> 6;
 			_gps_position.satellites_used	= _buf.payload_rx_nav_pvt.numSV;
 
 			_gps_position.lat		= _buf.payload_rx_nav_pvt.lat;
 			_gps_position.lon		= _buf.payload_rx_nav_pvt.lon;
 			_gps_position.alt		= _buf.payload_rx_nav_pvt.hMSL;
+			_gps_position.alt_ellipsoid	= _buf.payload_rx_nav_pvt.height;
 
 			_gps_position.eph		= (float)_buf.payload_rx_nav_pvt.hAcc * 1e-3f;
 			_gps_position.epv		= (float)_buf.payload_rx_nav_pvt.vAcc * 1e-3f;
@@ -238,65 +333,54 @@ payload_rx_done(void)
 			_gps_position.cog_rad		= (float)_buf.payload_rx_nav_pvt.headMot * M_DEG_TO_RAD_F * 1e-5f;
 			_gps_position.c_variance_rad	= (float)_buf.payload_rx_nav_pvt.headAcc * M_DEG_TO_RAD_F * 1e-5f;
 
-			//Check if time and date fix flags are good
-			if((_buf.payload_rx_nav_pvt.valid & UBX_RX_NAV_PVT_VALID_VALIDDATE)
-			        && (_buf.payload_rx_nav_pvt.valid & UBX_RX_NAV_PVT_VALID_VALIDTIME)
-			        && (_buf.payload_rx_nav_pvt.valid & UBX_RX_NAV_PVT_VALID_FULLYRESOLVED)) {
-				/* convert to unix timestamp */
-				// timeinfo.tm_year	= _buf.payload_rx_nav_pvt.year - 1900;
-				// timeinfo.tm_mon		= _buf.payload_rx_nav_pvt.month - 1;
-				// timeinfo.tm_mday	= _buf.payload_rx_nav_pvt.day;
-				// timeinfo.tm_hour	= _buf.payload_rx_nav_pvt.hour;
-				// timeinfo.tm_min		= _buf.payload_rx_nav_pvt.min;
-				// timeinfo.tm_sec		= _buf.payload_rx_nav_pvt.sec;
-
-				//_gps_position.time_utc_usec = 0;
+			_gps_position.iTOW				= _buf.payload_rx_nav_pvt.iTOW;
+			_gps_position.rx_timestamp_us	= _rx_timestamp_us;
+			_gps_position.timestamp_us		= _align_epoch(_buf.payload_rx_nav_pvt.iTOW, _rx_timestamp_us);
+			_gps_position.timestamp_time		= (uint32_t)(_gps_position.timestamp_us / 1000);
+			_gps_position.timestamp_velocity 	= _gps_position.timestamp_time;
+			_gps_position.timestamp_variance 	= _gps_position.timestamp_time;
+			_gps_position.timestamp_position	= _gps_position.timestamp_time;
+
+			if(_use_relposned) {
+				/* wait for RELPOSNED of the same epoch, it is sent right after NAV-PVT */
+				_pvt_pending = RT_TRUE;
+			} else {
+				_publish_report();
 			}
 
-			_gps_position.timestamp_time		= systime_now_ms();
-			_gps_position.timestamp_velocity 	= systime_now_ms();
-			_gps_position.timestamp_variance 	= systime_now_ms();
-			_gps_position.timestamp_position	= systime_now_ms();
-
-			_rate_count_vel++;
-			_rate_count_lat_lon++;
-
-			_got_posllh = RT_TRUE;
-			_got_velned = RT_TRUE;
-
 			ret = 1;
 		}
 		break;
 
-		case UBX_MSG_NAV_POSLLH: {
-			//console_printf("Rx NAV-POSLLH\r\n");
+		case UBX_MSG_NAV_RELPOSNED: {
+			uint32_t flags = _buf.payload_rx_nav_relposned.flags;
 
-			_gps_position.lat	= _buf.payload_rx_nav_posllh.lat;
-			_gps_position.lon	= _buf.payload_rx_nav_posllh.lon;
-			_gps_position.alt	= _buf.payload_rx_nav_posllh.hMSL;
-			_gps_position.eph	= (float)_buf.payload_rx_nav_posllh.hAcc * 1e-3f; // from mm to m
-			_gps_position.epv	= (float)_buf.payload_rx_nav_posllh.vAcc * 1e-3f; // from mm to m
-			_gps_position.alt_ellipsoid = _buf.payload_rx_nav_posllh.height;
+			_gps_position.rel_pos_valid = (flags & UBX_RX_NAV_RELPOSNED_FLAGS_RELPOSVALID) ? 1 : 0;
+			_gps_position.heading_valid = ((flags & UBX_RX_NAV_RELPOSNED_FLAGS_HEADINGVALID)
+			                               && (flags & UBX_RX_NAV_RELPOSNED_FLAGS_ISMOVING)) ? 1 : 0;
 
-			_gps_position.timestamp_position = systime_now_ms();
+			_gps_position.rel_pos_n_m = (float)_buf.payload_rx_nav_relposned.relPosN * 1e-2f
+			                            + (float)_buf.payload_rx_nav_relposned.relPosHPN * 1e-4f;
+			_gps_position.rel_pos_e_m = (float)_buf.payload_rx_nav_relposned.relPosE * 1e-2f
+			                            + (float)_buf.payload_rx_nav_relposned.relPosHPE * 1e-4f;
+			_gps_position.rel_pos_d_m = (float)_buf.payload_rx_nav_relposned.relPosD * 1e-2f
+			                            + (float)_buf.payload_rx_nav_relposned.relPosHPD * 1e-4f;
 
-			_rate_count_lat_lon++;
-			_got_posllh = RT_TRUE;
+			_gps_position.heading_rad = (float)_buf.payload_rx_nav_relposned.relPosHeading * M_DEG_TO_RAD_F * 1e-5f;
 
-			//console_printf("alt:%d lat:%d lon:%d\r\n" , _gps_position.alt, _gps_position.lat,_gps_position.lon);
+			if(_gps_position.heading_rad > M_PI_F) {
+				_gps_position.heading_rad -= 2.0f * M_PI_F;
+			}
 
-			ret = 1;
-		}
-		break;
+			_gps_position.heading_acc_rad = (float)_buf.payload_rx_nav_relposned.accHeading * M_DEG_TO_RAD_F * 1e-5f;
 
-		case UBX_MSG_NAV_SOL: {
-			//console_printf("Rx NAV-SOL\r\n");
+			_relposned_miss = 0;
 
-			_gps_position.fix_type		= _buf.payload_rx_nav_sol.gpsFix;
-			_gps_position.s_variance_m_s	= (float)_buf.payload_rx_nav_sol.sAcc * 1e-2f;	// from cm to m
-			_gps_position.satellites_used	= _buf.payload_rx_nav_sol.numSV;
+			if(_pvt_pending && _buf.payload_rx_nav_relposned.iTOW == _gps_position.iTOW) {
+				_publish_report();
+			}
 
-			_gps_position.timestamp_variance = systime_now_ms();
+			ret = 1;
 		}
 		break;
 
@@ -309,31 +393,6 @@ payload_rx_done(void)
 			_gps_position.ndop		= _buf.payload_rx_nav_dop.nDOP * 0.01f;	// from cm to m
 			_gps_position.edop		= _buf.payload_rx_nav_dop.eDOP * 0.01f;	// from cm to m
 
-			_gps_position.timestamp_variance = systime_now_ms();
-
-			ret = 1;
-		}
-		break;
-
-		case UBX_MSG_NAV_TIMEUTC: {
-			//console_printf("Rx NAV-TIMEUTC\r\n");
-
-			if(_buf.payload_rx_nav_timeutc.valid & UBX_RX_NAV_TIMEUTC_VALID_VALIDUTC) {
-				// convert to unix timestamp
-				// struct gps_tm timeinfo;
-				// timeinfo.tm_year	= _buf.payload_rx_nav_timeutc.year - 1900;
-				// timeinfo.tm_mon		= _buf.payload_rx_nav_timeutc.month - 1;
-				// timeinfo.tm_mday	= _buf.payload_rx_nav_timeutc.day;
-				// timeinfo.tm_hour	= _buf.payload_rx_nav_timeutc.hour;
-				// timeinfo.tm_min		= _buf.payload_rx_nav_timeutc.min;
-				// timeinfo.tm_sec		= _buf.payload_rx_nav_timeutc.sec;
-
-				//_gps_position.time_utc_usec = 0;
-				//console_printf("%d-%d-%d %d:%d:%d\r\n" , timeinfo.tm_year,timeinfo.tm_mon,timeinfo.tm_mday,timeinfo.tm_hour,timeinfo.tm_min,timeinfo.tm_sec);
-			}
-
-			_gps_position.timestamp_time = systime_now_ms();
-
 			ret = 1;
 		}
 		break;
@@ -349,28 +408,6 @@ payload_rx_done(void)
 		}
 		break;
 
-		case UBX_MSG_NAV_VELNED: {
-			//console_printf("Rx NAV-VELNED\r\n");
-
-			_gps_position.vel_m_s		= (float)_buf.payload_rx_nav_velned.speed * 1e-2f;
-			_gps_position.vel_n_m_s	= (float)_buf.payload_rx_nav_velned.velN * 1e-2f; /* NED NORTH velocity */
-			_gps_position.vel_e_m_s	= (float)_buf.payload_rx_nav_velned.velE * 1e-2f; /* NED EAST velocity */
-			_gps_position.vel_d_m_s	= (float)_buf.payload_rx_nav_velned.velD * 1e-2f; /* NED DOWN velocity */
-			_gps_position.cog_rad		= (float)_buf.payload_rx_nav_velned.heading * M_DEG_TO_RAD_F * 1e-5f;
-			_gps_position.c_variance_rad	= (float)_buf.payload_rx_nav_velned.cAcc * M_DEG_TO_RAD_F * 1e-5f;
-			_gps_position.vel_ned_valid	= 1;
-
-			_gps_position.timestamp_velocity = systime_now_ms();
-
-			_rate_count_vel++;
-			_got_velned = RT_TRUE;
-
-			//console_printf("nV:%.2f eV:%.2f dV:%.2f" , _gps_position.vel_n_m_s,_gps_position.vel_e_m_s,_gps_position.vel_d_m_s);
-
-			ret = 1;
-		}
-		break;
-
 		case UBX_MSG_MON_VER: {
 			//console_printf("Rx MON-VER\r\n");
 		} break;
@@ -444,35 +481,19 @@ _payload_rx_init()
 
 			} else if(!_configured) {
 				_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
-
-			} else if(!_use_nav_pvt) {
-				_rx_state = UBX_RXMSG_DISABLE;        // disable if not using NAV-PVT
-			}
-
-			break;
-
-		case UBX_MSG_NAV_POSLLH:
-			if(_rx_payload_length != sizeof(ubx_payload_rx_nav_posllh_t)) {
-				_rx_state = UBX_RXMSG_ERROR_LENGTH;
-
-			} else if(!_configured) {
-				_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
-
-			} else if(_use_nav_pvt) {
-				_rx_state = UBX_RXMSG_DISABLE;        // disable if using NAV-PVT instead
 			}
 
 			break;
 
-		case UBX_MSG_NAV_SOL:
-			if(_rx_payload_length != sizeof(ubx_payload_rx_nav_sol_t)) {
+		case UBX_MSG_NAV_RELPOSNED:
+			if(_rx_payload_length != sizeof(ubx_payload_rx_nav_relposned_t)) {
 				_rx_state = UBX_RXMSG_ERROR_LENGTH;
 
 			} else if(!_configured) {
 				_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
 
-			} else if(_use_nav_pvt) {
-				_rx_state = UBX_RXMSG_DISABLE;        // disable if using NAV-PVT instead
+			} else if(!_use_relposned) {
+				_rx_state = UBX_RXMSG_DISABLE;        // disable if not supported
 			}
 
 			break;
@@ -488,19 +509,6 @@ _payload_rx_init()
 
 			break;
 
-		case UBX_MSG_NAV_TIMEUTC:
-			if(_rx_payload_length != sizeof(ubx_payload_rx_nav_timeutc_t)) {
-				_rx_state = UBX_RXMSG_ERROR_LENGTH;
-
-			} else if(!_configured) {
-				_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
-
-			} else if(_use_nav_pvt) {
-				_rx_state = UBX_RXMSG_DISABLE;        // disable if using NAV-PVT instead
-			}
-
-			break;
-
 		case UBX_MSG_NAV_SVINFO:
 			if(!_configured) {
 				_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
@@ -511,19 +519,6 @@ _payload_rx_init()
 
 			break;
 
-		case UBX_MSG_NAV_VELNED:
-			if(_rx_payload_length != sizeof(ubx_payload_rx_nav_velned_t)) {
-				_rx_state = UBX_RXMSG_ERROR_LENGTH;
-
-			} else if(!_configured) {
-				_rx_state = UBX_RXMSG_IGNORE;        // ignore if not _configured
-
-			} else if(_use_nav_pvt) {
-				_rx_state = UBX_RXMSG_DISABLE;        // disable if using NAV-PVT instead
-			}
-
-			break;
-
 		case UBX_MSG_MON_VER:
 			break;		// unconditionally handle this message
 
@@ -619,7 +614,10 @@ _wait_for_ack(const uint16_t msg, const uint32_t timeout)
 
 	uint32_t time_started = systime_now_ms();
 
-	while((_ack_state == UBX_ACK_WAITING) && (systime_now_ms() < time_started + timeout)) {;}
+	while((_ack_state == UBX_ACK_WAITING) && (systime_now_ms() < time_started + timeout)) {
+		/* ack is decoded by gps thread */
+		rt_thread_delay(1);
+	}
 
 	if(_ack_state == UBX_ACK_GOT_ACK) {
 		ret = 0;	// ACK received ok
@@ -804,12 +802,19 @@ void _configure_message_rate(const uint16_t msg, const uint8_t rate)
 
 int _configure_by_ubx(void)
 {
+	int32_t rate_hz = PARAM_GET_INT32(SYSTEM, GPS_RATE);
 	uint32_t baudrates[] = {9600, 19200, 38400, 57600, 115200};
 	uint32_t baudrate;
 	uint8_t i;
 
 	_configured = RT_FALSE;
 
+	if(rate_hz < UBX_TX_CFG_RATE_MIN_HZ) {
+		rate_hz = UBX_TX_CFG_RATE_MIN_HZ;
+	} else if(rate_hz > UBX_TX_CFG_RATE_MAX_HZ) {
+		rate_hz = UBX_TX_CFG_RATE_MAX_HZ;
+	}
+
 	for(i = 0 ; i < sizeof(baudrates) / sizeof(baudrates[0]) ; i++) {
 		baudrate = baudrates[i];
 		_set_baudrate(serial_device, baudrate);
@@ -864,7 +869,7 @@ int _configure_by_ubx(void)
 
 	/* Send a CFG-RATE message to define update rate */
 	memset(&_buf.payload_tx_cfg_rate, 0, sizeof(_buf.payload_tx_cfg_rate));
-	_buf.payload_tx_cfg_rate.measRate	= UBX_TX_CFG_RATE_MEASINTERVAL;
+	_buf.payload_tx_cfg_rate.measRate	= 1000 / rate_hz;
 	_buf.payload_tx_cfg_rate.navRate	= UBX_TX_CFG_RATE_NAVRATE;
 	_buf.payload_tx_cfg_rate.timeRef	= UBX_TX_CFG_RATE_TIMEREF;
 
@@ -887,65 +892,44 @@ int _configure_by_ubx(void)
 	}
 
 	/* configure message rates */
-	/* the last argument is divisor for measurement rate (set by CFG RATE), i.e. 1 means 10Hz */
+	/* the last argument is divisor for measurement rate (set by CFG RATE), i.e. 1 means every epoch */
 
-	/* try to set rate for NAV-PVT */
-	/* (implemented for ubx7+ modules only, use NAV-SOL, NAV-POSLLH, NAV-VELNED and NAV-TIMEUTC for ubx6) */
+	/* NAV-PVT carries the complete navigation solution (ubx7+) */
 	_configure_message_rate(UBX_MSG_NAV_PVT, 1);
 
 	if(_wait_for_ack(UBX_MSG_CFG_MSG, UBX_CONFIG_TIMEOUT) < 0) {
-		_use_nav_pvt = RT_FALSE;
-
-	} else {
-		_use_nav_pvt = RT_TRUE;
+		console_printf("UBX_MSG_NAV_PVT configure fail!\n");
+		return 1;
 	}
 
-	if(!_use_nav_pvt) {
-		_configure_message_rate(UBX_MSG_NAV_TIMEUTC, 5);
-
-		if(_wait_for_ack(UBX_MSG_CFG_MSG, UBX_CONFIG_TIMEOUT) < 0) {
-			console_printf("UBX_MSG_NAV_TIMEUTC configure fail!\n");
-			return 1;
-		}
-
-		_configure_message_rate(UBX_MSG_NAV_POSLLH, 1);
+	/* NAV-RELPOSNED version 1 is only output by RTK capable F9 modules (F9P) */
+	_configure_message_rate(UBX_MSG_NAV_RELPOSNED, 1);
 
-		if(_wait_for_ack(UBX_MSG_CFG_MSG, UBX_CONFIG_TIMEOUT) < 0) {
-			console_printf("UBX_MSG_CFG_MSG configure fail!\n");
-			return 1;
-		}
-
-		_configure_message_rate(UBX_MSG_NAV_SOL, 1);
-
-		if(_wait_for_ack(UBX_MSG_CFG_MSG, UBX_CONFIG_TIMEOUT) < 0) {
-			console_printf("UBX_MSG_NAV_SOL configure fail!\n");
-			return 1;
-		}
-
-		_configure_message_rate(UBX_MSG_NAV_VELNED, 1);
-
-		if(_wait_for_ack(UBX_MSG_CFG_MSG, UBX_CONFIG_TIMEOUT) < 0) {
-			console_printf("UBX_MSG_NAV_VELNED configure fail!\n");
-			return 1;
-		}
+	if(_wait_for_ack(UBX_MSG_CFG_MSG, UBX_CONFIG_TIMEOUT) < 0) {
+		_use_relposned = RT_FALSE;
+	} else {
+		_use_relposned = RT_TRUE;
 	}
 
-	_configure_message_rate(UBX_MSG_NAV_DOP, 1);
+	/* auxiliary messages are kept around 5Hz/1Hz regardless of navigation rate */
+	_configure_message_rate(UBX_MSG_NAV_DOP, MAX(rate_hz / 5, 1));
 
 	if(_wait_for_ack(UBX_MSG_CFG_MSG, UBX_CONFIG_TIMEOUT) < 0) {
 		return 1;
 	}
 
-	_configure_message_rate(UBX_MSG_NAV_SVINFO, 5);
+	/* NAV-SVINFO and MON-HW are gone on F9 (protocol 27+), which NAK them,
+	 * they only feed satellite and jamming info so a NAK is not fatal */
+	_configure_message_rate(UBX_MSG_NAV_SVINFO, rate_hz);
 
 	if(_wait_for_ack(UBX_MSG_CFG_MSG, UBX_CONFIG_TIMEOUT) < 0) {
-		return 1;
+		console_printf("UBX_MSG_NAV_SVINFO not supported\n");
 	}
 
-	_configure_message_rate(UBX_MSG_MON_HW, 1);
+	_configure_message_rate(UBX_MSG_MON_HW, rate_hz);
 
 	if(_wait_for_ack(UBX_MSG_CFG_MSG, UBX_CONFIG_TIMEOUT) < 0) {
-		return 1;
+		console_printf("UBX_MSG_MON_HW not supported\n");
 	}
 
 	/* request module version information by sending an empty MON-VER message */
@@ -958,35 +942,83 @@ int _configure_by_ubx(void)
 
 static rt_err_t gps_serial_rx_ind(rt_device_t dev, rt_size_t size)
 {
+	/* idle line or dma half/full, the last byte of the burst arrives now */
+	_gps_rx_stamp_us = systime_now_us();
+	/* only wake up gps thread, parsing is done in thread context */
+	rt_sem_release(&_gps_rx_sem);
+
+	return RT_EOK;
+}
+
+static void gps_thread_entry(void* parameter)
+{
+	rt_uint8_t* data;
 	rt_size_t bytes;
-	uint8_t ch[SERIAL_RB_BUFSZ];
+	uint64_t stamp_us;
 
-	bytes = rt_device_read(serial_device, 0, ch, size);
+	while(1) {
+		if(rt_sem_take(&_gps_rx_sem, RT_WAITING_FOREVER) != RT_EOK) {
+			continue;
+		}
+
+		stamp_us = _gps_rx_stamp_us;
+
+		/* drain everything the dma has received so far, parsing in place */
+		while((bytes = hal_serial_rx_peek((serial_dev_t)serial_device, &data)) > 0) {
+			for(uint32_t i = 0 ; i < bytes ; i++) {
+				/* back-date each byte from the end of the burst by its transfer time */
+				_rx_timestamp_us = stamp_us - (uint64_t)(bytes - 1 - i) * _byte_time_us;
+				_parse_ubx_char(data[i]);
+			}
+
+			hal_serial_rx_consume((serial_dev_t)serial_device, bytes);
 
-	if(bytes) {
-		for(uint32_t j = 0 ; j < bytes ; j++) {
-			//console_printf("%x," , ch[j]);
-			_parse_ubx_char(ch[j]);
+			/* anything read after this arrived later than the burst stamp */
+			stamp_us = systime_now_us();
 		}
-	} else {
-		console_printf("ubx listen err:%ld\r\n", bytes);
 	}
-
-	return RT_EOK;
 }
 
 rt_err_t gps_init(rt_device_t dev)
 {
+	rt_err_t res;
+
 	_configured = RT_FALSE;
-	_use_nav_pvt = RT_FALSE;
+	_use_relposned = RT_FALSE;
+	_pvt_pending = RT_FALSE;
+	_relposned_miss = 0;
 	_ack_state = UBX_ACK_IDLE;
 	_ack_waiting_msg = 0;
-	_got_posllh = RT_FALSE;
-	_got_velned = RT_FALSE;
 	_got_svinfo = RT_FALSE;
+	_epoch_offset_valid = RT_FALSE;
+	_gps_report_front = 0;
+	_gps_report_seq = 0;
+	_gps_report_read_seq = 0;
+
+	rt_sem_init(&_gps_rx_sem, "gps_rx", 0, RT_IPC_FLAG_FIFO);
+
+	res = rt_thread_init(&_gps_thread,
+	                     "gps",
+	                     gps_thread_entry,
+	                     RT_NULL,
+	                     &_gps_thread_stack[0],
+	                     sizeof(_gps_thread_stack),
+	                     GPS_THREAD_PRIORITY,
+	                     5);
+
+	if(res != RT_EOK) {
+		return res;
+	}
+
+	/* parser must be running before configuration, since it waits for ack */
+	rt_thread_startup(&_gps_thread);
 
 	rt_device_set_rx_indicate(serial_device, gps_serial_rx_ind);
-	rt_device_open(serial_device, RT_DEVICE_OFLAG_RDWR | RT_DEVICE_FLAG_INT_RX);
+	res = rt_device_open(serial_device, RT_DEVICE_OFLAG_RDWR | RT_DEVICE_FLAG_DMA_RX);
+
+	if(res != RT_EOK) {
+		return res;
+	}
 
 	for(uint8_t i = 0 ; i < CONFIGURE_RETRY_MAX ; i++) {
 		if(_configure_by_ubx() == 0) {
@@ -1003,46 +1035,33 @@ rt_err_t gps_init(rt_device_t dev)
 
 rt_size_t gps_read(rt_device_t dev, rt_off_t pos, void* buffer, rt_size_t size)
 {
-	if(pos == RD_ONLY_POSLLH) {
-		if(_got_posllh == RT_FALSE)
-			return 0;
-
-		if(buffer != NULL)
-			*(struct vehicle_gps_position_s*)buffer = _gps_position;
-
-		_got_posllh = RT_FALSE;
-	} else if(pos == RD_ONLY_VELNED) {
-		if(_got_velned == RT_FALSE)
-			return 0;
-
-		if(buffer != NULL)
-			*(struct vehicle_gps_position_s*)buffer = _gps_position;
-
-		_got_velned = RT_FALSE;
-	} else if(pos == RD_COMPLETED_REPORT) {
-		if(_got_posllh == RT_FALSE || _got_velned == RT_FALSE)
+	if(pos == RD_COMPLETED_REPORT) {
+		/* a report is published per NAV-PVT epoch (with RELPOSNED if enabled) */
+		if(_gps_report_seq == _gps_report_read_seq)
 			return 0;
 
-		if(buffer != NULL)
-			*(struct vehicle_gps_position_s*)buffer = _gps_position;
-
-		_got_posllh = RT_FALSE;
-		_got_velned = RT_FALSE;
+		if(buffer != NULL) {
+			_gps_report_read_seq = _copy_report((struct vehicle_gps_position_s*)buffer);
+		} else {
+			_gps_report_read_seq = _gps_report_seq;
+		}
 	} else if(pos == RD_SVINFO) {
 		if(_got_svinfo == RT_FALSE)
 			return 0;
 
-		if(buffer != NULL)
+		if(buffer != NULL) {
+			OS_ENTER_CRITICAL;
 			*(struct satellite_info_s*)buffer = _satellite_info;
+			OS_EXIT_CRITICAL;
+		}
 
 		_got_svinfo = RT_FALSE;
 	} else if(pos == GPS_REPORT_READY) {
-		*(uint8_t*)buffer = (_got_posllh && _got_posllh) ? 1 : 0;
+		*(uint8_t*)buffer = (_gps_report_seq != _gps_report_read_seq) ? 1 : 0;
 	} else {
 		return 0;
 	}
 
-
 	return size;
 }
 
@@ -18,6 +18,7 @@
 #include "driver/mpu6000.h"
 #include "hal/accel.h"
 #include "hal/gyro.h"
+#include "hal/pin.h"
 #include "hal/spi.h"
 #include "module/math/conversion.h"
 
@@ -147,6 +148,10 @@ static float _gyro_range_rad_s;
 static float _accel_range_scale;
 static float _accel_range_m_s2;
 static rt_device_t spi_device;
+static uint64_t _gyr_timestamp_us;
+static uint64_t _acc_timestamp_us;
+static volatile uint64_t _drdy_timestamp_us;
+static uint8_t _drdy_enabled;
 
 static rt_err_t _write_reg(rt_uint8_t reg, rt_uint8_t val)
 {
@@ -439,6 +444,8 @@ static rt_err_t mpu6000_gyr_read_raw(int16_t gyr[3])
 {
     rt_err_t res;
     uint16_t raw[3];
+    /* in data-ready mode the sample was latched at the drdy edge */
+    _gyr_timestamp_us = _drdy_enabled ? _drdy_timestamp_us : systime_now_us();
     res = read_multi_reg(MPUREG_GYRO_XOUT_H, (uint8_t*)raw, 6);
     // big-endian to little-endian
     gyr[0] = int16_t_from_bytes((uint8_t*)&raw[0]);
@@ -467,6 +474,7 @@ static rt_err_t mpu6000_acc_read_raw(int16_t acc[3])
 {
     int16_t raw[3];
     rt_err_t res;
+    _acc_timestamp_us = _drdy_enabled ? _drdy_timestamp_us : systime_now_us();
     res = read_multi_reg(MPUREG_ACCEL_XOUT_H, (rt_uint8_t*)raw, 6);
     // big-endian to little-endian
     acc[0] = int16_t_from_bytes((uint8_t*)&raw[0]);
@@ -510,8 +518,70 @@ static rt_err_t gyro_config(gyro_dev_t gyro, const struct gyro_configure* cfg)
     return ret;
 }
 
+static void _drdy_isr(void* args)
+{
+    gyro_dev_t gyro = (gyro_dev_t)args;
+
+    _drdy_timestamp_us = systime_now_us();
+
+    if (gyro->parent.rx_indicate) {
+        gyro->parent.rx_indicate(&gyro->parent, 1);
+    }
+}
+
+static rt_err_t _enable_drdy(gyro_dev_t gyro, uint8_t enable)
+{
+    rt_err_t ret;
+    rt_device_t pin_dev;
+    struct device_pin_mode mode = { MPU6000_DRDY_PIN, PIN_MODE_INPUT, PIN_OUT_TYPE_PP };
+    struct device_pin_irq irq = { MPU6000_DRDY_PIN, PIN_IRQ_MODE_RISING, _drdy_isr, gyro };
+    struct device_pin_irq_enable irq_enable = { MPU6000_DRDY_PIN, PIN_IRQ_DISABLE };
+
+    pin_dev = rt_device_find("pin");
+
+    if (pin_dev == RT_NULL) {
+        return RT_EEMPTY;
+    }
+
+    if (!enable) {
+        _drdy_enabled = 0;
+        rt_device_control(pin_dev, PIN_CMD_ENABLE_IRQ, &irq_enable);
+        return rt_device_control(pin_dev, PIN_CMD_DETACH_IRQ, &irq);
+    }
+
+    rt_device_control(pin_dev, PIN_CMD_SET_MODE, &mode);
+
+    ret = rt_device_control(pin_dev, PIN_CMD_ATTACH_IRQ, &irq);
+
+    if (ret != RT_EOK) {
+        return ret;
+    }
+
+    _drdy_timestamp_us = systime_now_us();
+    _drdy_enabled = 1;
+
+    irq_enable.enable = PIN_IRQ_ENABLE;
+    ret = rt_device_control(pin_dev, PIN_CMD_ENABLE_IRQ, &irq_enable);
+
+    if (ret != RT_EOK) {
+        _drdy_enabled = 0;
+        rt_device_control(pin_dev, PIN_CMD_DETACH_IRQ, &irq);
+    }
+
+    return ret;
+}
+
 static rt_err_t gyro_control(gyro_dev_t gyro, int cmd, void* arg)
 {
+    switch (cmd) {
+    case GYRO_CMD_ENABLE_DRDY:
+        return _enable_drdy(gyro, 1);
+    case GYRO_CMD_DISABLE_DRDY:
+        return _enable_drdy(gyro, 0);
+    default:
+        break;
+    }
+
     return RT_EOK;
 }
 
@@ -529,6 +599,8 @@ static rt_size_t gyro_read(gyro_dev_t gyro, rt_off_t pos, void* data, rt_size_t
         if (mpu6000_gyr_read_rad(((float*)data)) != RT_EOK) {
             return 0;
         }
+    } else if (pos == GYRO_RD_TIMESTAMP) {
+        *(uint64_t*)data = _gyr_timestamp_us;
     } else {
         DRV_DBG("gyro unknow read pos:%d\n", pos);
         return 0;
@@ -581,6 +653,8 @@ static rt_size_t accel_read(accel_dev_t accel, rt_off_t pos, void* data, rt_size
         if (mpu6000_acc_read_m_s2(((float*)data)) != RT_EOK) {
             return 0;
         }
+    } else if (pos == ACCEL_RD_TIMESTAMP) {
+        *(uint64_t*)data = _acc_timestamp_us;
     } else {
         DRV_DBG("accel unknow read pos:%d\n", pos);
         return 0;
@@ -85,6 +85,7 @@ enum {
 
 static rt_device_t spi_device;
 uint32_t _raw_temperature, _raw_pressure;
+static uint64_t _pressure_timestamp_us;
 static ms5611_prom_t _prom;
 static struct rt_timer _timer_ms5611;
 static uint8_t _ms5611_state;
@@ -244,7 +245,8 @@ static rt_err_t _collect_report(baro_report_t* report)
 	//report->altitude = (((exp((-(a * R) / g) * log((p / p1)))) * T1) - T1) / a;
 	report->altitude_m = (((pow((p / p1), (-(a * R) / g))) * T1) - T1) / a;
 
-	report->timestamp_ms = systime_now_ms();
+	report->timestamp_us = _pressure_timestamp_us;
+	report->timestamp_ms = (uint32_t)(_pressure_timestamp_us / 1000);
 
 	return RT_EOK;
 }
@@ -286,7 +288,9 @@ static void _ms5611_StateMchine(void* parameter)
 		case S_CONV_2: {
 			_ms5611_state = S_CONV_1;
 
-			/* read raw pressure */
+			/* read raw pressure, the pressure sample is stamped at its conversion end */
+			_pressure_timestamp_us = systime_now_us();
+
 			if(_read_adc(&_raw_pressure) == RT_EOK) {
 				/* trigger D2 conversion immediately */
 				if(_write_cmd(CMD_CONVERT_D2_ADDR[osr]) == RT_EOK) {
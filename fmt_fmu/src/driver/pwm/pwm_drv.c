@@ -15,6 +15,7 @@
  *****************************************************************************/
 #include "driver/pwm_drv.h"
 #include "hal/motor.h"
+#include "module/dshot/dshot.h"
 #include <firmament.h>
 
 #define DRV_DBG(...) console_printf(__VA_ARGS__)
@@ -27,9 +28,50 @@
 #define PWM_ARR(freq) (TIMER_FREQUENCY / freq) // CCR reload value, Timer frequency = 3M/60K = 50 Hz
 #define PWM_TIMER(id) (id < 4 ? TIM1 : TIM4)
 
+/* dshot frames are streamed into CCR registers by timer dma burst, which is
+ * requested on update event (CCDS) through a compare channel: TIM1 CH4 (DMA2
+ * Stream4 Channel6) and TIM4 CH1 (DMA1 Stream0 Channel2).
+ * bidirectional telemetry is sampled from GPIOE input data register by TIM8 CH1
+ * request (DMA2 Stream2 Channel7). Only dma2 reaches the gpio and its other
+ * streams are taken: Stream0/3 by SPI1, Stream3 also by SDIO, Stream1/6 by
+ * USART6 and Stream5/7 by USART1. So telemetry is decoded for the TIM1 channels
+ * (FMU_CH1 ~ FMU_CH4) only, TIM4 channels are released to input for the reply
+ * but not sampled */
+#define TIM1_BURST_NUM 4 /* CCR1 ~ CCR4 */
+#define TIM4_BURST_NUM 2 /* CCR2 ~ CCR3 */
+#define TIM1_PIN_MASK  (GPIO_Pin_9 | GPIO_Pin_11 | GPIO_Pin_13 | GPIO_Pin_14)
+#define TIM4_PIN_MASK  (GPIO_Pin_13 | GPIO_Pin_14)
+
 static int _pwm_freq = PWM_DEFAULT_FREQUENCY;
 static float _pwm_fmu_duty_cyc[MAX_PWM_OUT_CHAN] = { 0.00, 0.00, 0.00, 0.00, 0.00, 0.00 };
 
+static uint8_t _protocol = MOTOR_PROTOCOL_PWM;
+static uint8_t _bidir = 0;
+static uint16_t _dshot_throttle[MAX_PWM_OUT_CHAN];
+static uint16_t _tim1_burst[DSHOT_FRAME_SLOTS][TIM1_BURST_NUM];
+static uint16_t _tim4_burst[DSHOT_FRAME_SLOTS][TIM4_BURST_NUM];
+static uint16_t _samples_e[DSHOT_TELEM_SAMPLES];
+static volatile uint8_t _dshot_busy = 0;
+static volatile uint8_t _dma_pending = 0;
+static struct motor_erpm _erpm;
+
+/* position of each channel in burst buffer and its gpio, samples is NULL
+ * for the channels without telemetry */
+static const struct {
+    uint16_t* burst;
+    uint8_t stride;
+    GPIO_TypeDef* port;
+    uint16_t pin;
+    uint16_t* samples;
+} _dshot_chan[MAX_PWM_OUT_CHAN] = {
+    { &_tim1_burst[0][3], TIM1_BURST_NUM, GPIOE, GPIO_Pin_14, _samples_e },
+    { &_tim1_burst[0][2], TIM1_BURST_NUM, GPIOE, GPIO_Pin_13, _samples_e },
+    { &_tim1_burst[0][1], TIM1_BURST_NUM, GPIOE, GPIO_Pin_11, _samples_e },
+    { &_tim1_burst[0][0], TIM1_BURST_NUM, GPIOE, GPIO_Pin_9, _samples_e },
+    { &_tim4_burst[0][0], TIM4_BURST_NUM, GPIOD, GPIO_Pin_13, NULL },
+    { &_tim4_burst[0][1], TIM4_BURST_NUM, GPIOD, GPIO_Pin_14, NULL },
+};
+
 typedef void (*timer_func)(TIM_TypeDef*, uint32_t);
 timer_func _timer_set_compare[MAX_PWM_OUT_CHAN] = {
     TIM_SetCompare4,
@@ -146,9 +188,293 @@ static void _pwm_timer_init(void)
     //TIM_Cmd(TIM4, ENABLE);
 }
 
+static uint32_t _dshot_bitrate(void)
+{
+    switch (_protocol) {
+    case MOTOR_PROTOCOL_DSHOT150:
+        return 150000;
+    case MOTOR_PROTOCOL_DSHOT300:
+        return 300000;
+    case MOTOR_PROTOCOL_DSHOT600:
+        return 600000;
+    default:
+        return 0;
+    }
+}
+
+/* switch pins between alternate function (output) and input with pull-up */
+rt_inline void _pin_set_input(GPIO_TypeDef* port, uint16_t pin_mask, uint8_t input)
+{
+    uint32_t moder = port->MODER;
+
+    for (uint8_t i = 0; i < 16; i++) {
+        if (pin_mask & (1 << i)) {
+            moder &= ~(GPIO_MODER_MODER0 << (i * 2));
+            moder |= input ? 0 : ((uint32_t)GPIO_Mode_AF << (i * 2));
+        }
+    }
+
+    port->MODER = moder;
+}
+
+static void _dma_config(DMA_Stream_TypeDef* stream, uint32_t channel, uint32_t periph, void* buf, uint16_t num, uint32_t dir)
+{
+    DMA_InitTypeDef DMA_InitStructure;
+
+    DMA_DeInit(stream);
+
+    DMA_InitStructure.DMA_Channel = channel;
+    DMA_InitStructure.DMA_PeripheralBaseAddr = periph;
+    DMA_InitStructure.DMA_Memory0BaseAddr = (uint32_t)buf;
+    DMA_InitStructure.DMA_DIR = dir;
+    DMA_InitStructure.DMA_BufferSize = num;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;
+    DMA_InitStructure.DMA_FIFOMode = DMA_FIFOMode_Disable;
+    DMA_InitStructure.DMA_FIFOThreshold = DMA_FIFOThreshold_Full;
+    DMA_InitStructure.DMA_MemoryBurst = DMA_MemoryBurst_Single;
+    DMA_InitStructure.DMA_PeripheralBurst = DMA_PeripheralBurst_Single;
+    DMA_Init(stream, &DMA_InitStructure);
+
+    DMA_ITConfig(stream, DMA_IT_TC, ENABLE);
+}
+
+static void _dma_irq_config(uint8_t irq)
+{
+    NVIC_InitTypeDef NVIC_InitStructure;
+
+    NVIC_InitStructure.NVIC_IRQChannel = irq;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+}
+
+static void _dshot_timer_init(void)
+{
+    TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+    TIM_OCInitTypeDef TIM_OCInitStructure;
+    RCC_ClocksTypeDef rcc_clocks;
+    uint32_t bitrate = _dshot_bitrate();
+
+    RCC_GetClocksFreq(&rcc_clocks);
+
+    TIM_TimeBaseStructure.TIM_Prescaler = 0;
+    TIM_TimeBaseStructure.TIM_ClockDivision = TIM_CKD_DIV1;
+    TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+    TIM_TimeBaseStructure.TIM_RepetitionCounter = 0;
+
+    TIM_OCInitStructure.TIM_OCMode = TIM_OCMode_PWM1;
+    TIM_OCInitStructure.TIM_OutputState = TIM_OutputState_Enable;
+    TIM_OCInitStructure.TIM_Pulse = 0;
+    /* bidirectional dshot is inverted, line idles high */
+    TIM_OCInitStructure.TIM_OCPolarity = _bidir ? TIM_OCPolarity_Low : TIM_OCPolarity_High;
+    TIM_OCInitStructure.TIM_OutputNState = TIM_OutputNState_Disable;
+    TIM_OCInitStructure.TIM_OCNPolarity = TIM_OCNPolarity_High;
+    TIM_OCInitStructure.TIM_OCIdleState = TIM_OCIdleState_Reset;
+    TIM_OCInitStructure.TIM_OCNIdleState = TIM_OCIdleState_Reset;
+
+    /* TIM1CLK = 2 * PCLK2, one bit per timer period */
+    TIM_TimeBaseStructure.TIM_Period = rcc_clocks.PCLK2_Frequency * 2 / bitrate - 1;
+    TIM_TimeBaseInit(TIM1, &TIM_TimeBaseStructure);
+
+    TIM_OC1Init(TIM1, &TIM_OCInitStructure);
+    TIM_OC1PreloadConfig(TIM1, TIM_OCPreload_Enable);
+    TIM_OC2Init(TIM1, &TIM_OCInitStructure);
+    TIM_OC2PreloadConfig(TIM1, TIM_OCPreload_Enable);
+    TIM_OC3Init(TIM1, &TIM_OCInitStructure);
+    TIM_OC3PreloadConfig(TIM1, TIM_OCPreload_Enable);
+    TIM_OC4Init(TIM1, &TIM_OCInitStructure);
+    TIM_OC4PreloadConfig(TIM1, TIM_OCPreload_Enable);
+    TIM_ARRPreloadConfig(TIM1, ENABLE);
+
+    TIM_DMAConfig(TIM1, TIM_DMABase_CCR1, TIM_DMABurstLength_4Transfers);
+    TIM_SelectCCDMA(TIM1, ENABLE);
+    TIM_DMACmd(TIM1, TIM_DMA_CC4, ENABLE);
+
+    /* TIM4CLK = 2 * PCLK1 */
+    TIM_TimeBaseStructure.TIM_Period = rcc_clocks.PCLK1_Frequency * 2 / bitrate - 1;
+    TIM_TimeBaseInit(TIM4, &TIM_TimeBaseStructure);
+
+    TIM_OC2Init(TIM4, &TIM_OCInitStructure);
+    TIM_OC2PreloadConfig(TIM4, TIM_OCPreload_Enable);
+    TIM_OC3Init(TIM4, &TIM_OCInitStructure);
+    TIM_OC3PreloadConfig(TIM4, TIM_OCPreload_Enable);
+    TIM_ARRPreloadConfig(TIM4, ENABLE);
+
+    TIM_DMAConfig(TIM4, TIM_DMABase_CCR2, TIM_DMABurstLength_2Transfers);
+    TIM_SelectCCDMA(TIM4, ENABLE);
+    TIM_DMACmd(TIM4, TIM_DMA_CC1, ENABLE);
+
+    if (_bidir) {
+        /* TIM8 paces telemetry sampling, TIM8CLK = 2 * PCLK2 */
+        RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM8, ENABLE);
+
+        TIM_TimeBaseStructure.TIM_Period = rcc_clocks.PCLK2_Frequency * 2 / (bitrate * 5 / 4 * DSHOT_TELEM_OVERSAMPLE) - 1;
+        TIM_TimeBaseInit(TIM8, &TIM_TimeBaseStructure);
+
+        TIM_SelectCCDMA(TIM8, ENABLE);
+        TIM_DMACmd(TIM8, TIM_DMA_CC1, ENABLE);
+
+        _dma_irq_config(DMA2_Stream2_IRQn);
+    }
+
+    _dma_irq_config(DMA2_Stream4_IRQn);
+    _dma_irq_config(DMA1_Stream0_IRQn);
+}
+
+/* disable dshot dma requests, used when switching back to pwm */
+static void _dshot_timer_deinit(void)
+{
+    TIM_DMACmd(TIM1, TIM_DMA_CC4, DISABLE);
+    TIM_SelectCCDMA(TIM1, DISABLE);
+    TIM_DMACmd(TIM4, TIM_DMA_CC1, DISABLE);
+    TIM_SelectCCDMA(TIM4, DISABLE);
+    TIM_Cmd(TIM8, DISABLE);
+
+    DMA_Cmd(DMA2_Stream4, DISABLE);
+    DMA_Cmd(DMA1_Stream0, DISABLE);
+    DMA_Cmd(DMA2_Stream2, DISABLE);
+
+    _pin_set_input(GPIOE, TIM1_PIN_MASK, 0);
+    _pin_set_input(GPIOD, TIM4_PIN_MASK, 0);
+
+    _dshot_busy = 0;
+}
+
+static void _dshot_send(void)
+{
+    uint32_t period;
+    uint16_t t0h, t1h;
+    uint16_t frame;
+
+    if (_dshot_busy) {
+        /* previous frame or telemetry is not finished, send next time */
+        return;
+    }
+
+    for (uint8_t i = 0; i < MAX_PWM_OUT_CHAN; i++) {
+        /* TIM4 runs at half the clock of TIM1 */
+        period = (i < 4 ? TIM1->ARR : TIM4->ARR) + 1;
+        /* bit 0 is high for 3/8 of period, bit 1 for 3/4 */
+        t0h = period * 3 / 8;
+        t1h = period * 3 / 4;
+        /* telemetry request bit is for esc serial telemetry, which is not used */
+        frame = dshot_pack(_dshot_throttle[i], 0, _bidir);
+
+        dshot_fill_slots(frame, _dshot_chan[i].burst, _dshot_chan[i].stride, t0h, t1h);
+    }
+
+    _dshot_busy = 1;
+    _dma_pending = 2;
+
+    _dma_config(DMA2_Stream4, DMA_Channel_6, (uint32_t)&TIM1->DMAR, _tim1_burst, sizeof(_tim1_burst) / 2, DMA_DIR_MemoryToPeripheral);
+    _dma_config(DMA1_Stream0, DMA_Channel_2, (uint32_t)&TIM4->DMAR, _tim4_burst, sizeof(_tim4_burst) / 2, DMA_DIR_MemoryToPeripheral);
+
+    DMA_Cmd(DMA2_Stream4, ENABLE);
+    DMA_Cmd(DMA1_Stream0, ENABLE);
+}
+
+static void _dshot_telem_start(void)
+{
+    _pin_set_input(GPIOE, TIM1_PIN_MASK, 1);
+    _pin_set_input(GPIOD, TIM4_PIN_MASK, 1);
+
+    _dma_config(DMA2_Stream2, DMA_Channel_7, (uint32_t)&GPIOE->IDR, _samples_e, DSHOT_TELEM_SAMPLES, DMA_DIR_PeripheralToMemory);
+
+    DMA_Cmd(DMA2_Stream2, ENABLE);
+
+    TIM_SetCounter(TIM8, 0);
+    TIM_Cmd(TIM8, ENABLE);
+}
+
+static void _dshot_telem_done(void)
+{
+    uint32_t erpm;
+
+    TIM_Cmd(TIM8, DISABLE);
+
+    _pin_set_input(GPIOE, TIM1_PIN_MASK, 0);
+    _pin_set_input(GPIOD, TIM4_PIN_MASK, 0);
+
+    _erpm.valid_mask = 0;
+
+    for (uint8_t i = 0; i < MAX_PWM_OUT_CHAN; i++) {
+        if (_dshot_chan[i].samples == NULL) {
+            continue;
+        }
+
+        if (dshot_decode_telem(_dshot_chan[i].samples, DSHOT_TELEM_SAMPLES, _dshot_chan[i].pin, &erpm) == FMT_EOK) {
+            _erpm.erpm[i] = erpm;
+            _erpm.valid_mask |= 1 << i;
+        }
+    }
+
+    _erpm.timestamp_ms = systime_now_ms();
+}
+
+/* frame dma of TIM1 and TIM4 completes at nearly the same time */
+static void _dshot_frame_done(void)
+{
+    if (--_dma_pending) {
+        return;
+    }
+
+    if (_bidir) {
+        /* esc replies 30us after the frame */
+        _dshot_telem_start();
+    } else {
+        _dshot_busy = 0;
+    }
+}
+
+void DMA2_Stream4_IRQHandler(void)
+{
+    rt_interrupt_enter();
+
+    if (DMA_GetITStatus(DMA2_Stream4, DMA_IT_TCIF4) != RESET) {
+        DMA_ClearITPendingBit(DMA2_Stream4, DMA_IT_TCIF4);
+        _dshot_frame_done();
+    }
+
+    rt_interrupt_leave();
+}
+
+void DMA1_Stream0_IRQHandler(void)
+{
+    rt_interrupt_enter();
+
+    if (DMA_GetITStatus(DMA1_Stream0, DMA_IT_TCIF0) != RESET) {
+        DMA_ClearITPendingBit(DMA1_Stream0, DMA_IT_TCIF0);
+        _dshot_frame_done();
+    }
+
+    rt_interrupt_leave();
+}
+
+void DMA2_Stream2_IRQHandler(void)
+{
+    rt_interrupt_enter();
+
+    if (DMA_GetITStatus(DMA2_Stream2, DMA_IT_TCIF2) != RESET) {
+        DMA_ClearITPendingBit(DMA2_Stream2, DMA_IT_TCIF2);
+        _dshot_telem_done();
+        _dshot_busy = 0;
+    }
+
+    rt_interrupt_leave();
+}
+
 rt_inline void _pwm_write(uint8_t chan_id, float duty_cyc)
 {
-    _timer_set_compare[chan_id](PWM_TIMER(chan_id), PWM_ARR(_pwm_freq) * duty_cyc);
+    /* in dshot mode compare registers are written by dma */
+    if (_protocol == MOTOR_PROTOCOL_PWM) {
+        _timer_set_compare[chan_id](PWM_TIMER(chan_id), PWM_ARR(_pwm_freq) * duty_cyc);
+    }
 
     _pwm_fmu_duty_cyc[chan_id] = duty_cyc;
 }
@@ -176,6 +502,7 @@ static rt_err_t motor_control(motor_dev_t motor, int cmd, void* arg)
         /* set to lowest pwm before open */
         for (uint8_t i = 0; i < MAX_PWM_OUT_CHAN; i++) {
             _pwm_write(i, 0.05);
+            _dshot_throttle[i] = DSHOT_CMD_MOTOR_STOP;
         }
 
         TIM_Cmd(TIM1, ENABLE);
@@ -196,16 +523,53 @@ static rt_err_t motor_control(motor_dev_t motor, int cmd, void* arg)
     case MOTOR_CMD_SET_FREQUENCY: {
         _pwm_freq = (int)arg;
 
-        _pwm_timer_init();
+        /* dshot frame rate follows motor write, frequency only applies to pwm */
+        if (_protocol == MOTOR_PROTOCOL_PWM) {
+            _pwm_timer_init();
 
-        /* the timer compare value should be re-configured */
-        for (uint8_t i = 0; i < MAX_PWM_OUT_CHAN; i++) {
-            _pwm_write(i, _pwm_fmu_duty_cyc[i]);
+            /* the timer compare value should be re-configured */
+            for (uint8_t i = 0; i < MAX_PWM_OUT_CHAN; i++) {
+                _pwm_write(i, _pwm_fmu_duty_cyc[i]);
+            }
         }
 
         DRV_DBG("aux motor set frequency to %d Hz\n", _pwm_freq);
     } break;
 
+    case MOTOR_CMD_SET_PROTOCOL: {
+        uint8_t protocol = (uint32_t)arg & ~MOTOR_PROTOCOL_BIDIR;
+
+        if (protocol > MOTOR_PROTOCOL_DSHOT600) {
+            return RT_EINVAL;
+        }
+
+        if (_protocol != MOTOR_PROTOCOL_PWM) {
+            _dshot_timer_deinit();
+        }
+
+        _protocol = protocol;
+        _bidir = protocol != MOTOR_PROTOCOL_PWM && ((uint32_t)arg & MOTOR_PROTOCOL_BIDIR);
+        _erpm.valid_mask = 0;
+
+        if (_protocol == MOTOR_PROTOCOL_PWM) {
+            _pwm_timer_init();
+
+            for (uint8_t i = 0; i < MAX_PWM_OUT_CHAN; i++) {
+                _pwm_write(i, _pwm_fmu_duty_cyc[i]);
+            }
+        } else {
+            _dshot_timer_init();
+        }
+
+        DRV_DBG("aux motor set protocol to %d%s\n", _protocol, _bidir ? " (bidirectional)" : "");
+    } break;
+
+    case MOTOR_CMD_GET_ERPM: {
+        rt_base_t level = rt_hw_interrupt_disable();
+        *(struct motor_erpm*)arg = _erpm;
+        rt_hw_interrupt_enable(level);
+    } break;
+
     default:
         break;
     }
@@ -244,6 +608,7 @@ static rt_size_t motor_write(motor_dev_t motor, rt_uint16_t chan_mask, const rt_
             dc = PWM_DC_SCALE * val;
             /* update pwm signal */
             _pwm_write(i, dc);
+            _dshot_throttle[i] = dshot_throttle(val, motor->config.motor_min_value, motor->config.motor_max_value);
 
             DRV_DBG("chan[%d]=%d %.2f ", i + 1, *index, dc);
             index++;
@@ -251,6 +616,10 @@ static rt_size_t motor_write(motor_dev_t motor, rt_uint16_t chan_mask, const rt_
     }
     DRV_DBG("\n");
 
+    if (_protocol != MOTOR_PROTOCOL_PWM) {
+        _dshot_send();
+    }
+
     return size;
 }
 
@@ -75,6 +75,8 @@ struct stm32_uart {
 		uint32_t rx_flag;
 		/* dma irq channel */
 		uint8_t rx_irq_ch;
+		/* dma half transfer flag */
+		uint32_t rx_ht_flag;
 		/* setting receive len */
 		rt_size_t setting_recv_len;
 		/* last receive index */
@@ -103,56 +105,75 @@ static struct serial_device serial4;    // fmtio
 static struct serial_device serial5;
 
 /**
- * Serial port receive idle process. This need add to uart idle ISR.
+ * Report data received by circular dma since last call. The write position is
+ * taken from dma counter, so it is the same whichever of idle line, half
+ * transfer or transfer complete interrupt calls it first.
  *
  * @param serial serial device
  */
-static void dma_uart_rx_idle_isr(struct serial_device* serial)
+static void dma_rx_update(struct serial_device* serial)
 {
 	struct stm32_uart* uart = (struct stm32_uart*) serial->parent.user_data;
-	rt_size_t recv_total_index, recv_len;
+	rt_size_t recv_index, recv_len;
 	rt_base_t level;
 
 	/* disable interrupt */
 	level = rt_hw_interrupt_disable();
 
-	recv_total_index = uart->dma.setting_recv_len - DMA_GetCurrDataCounter(uart->dma.rx_stream);
-	recv_len = recv_total_index - uart->dma.last_recv_index;
-	uart->dma.last_recv_index = recv_total_index;
+	recv_index = uart->dma.setting_recv_len - DMA_GetCurrDataCounter(uart->dma.rx_stream);
+
+	if(recv_index >= uart->dma.last_recv_index) {
+		recv_len = recv_index - uart->dma.last_recv_index;
+	} else {
+		/* dma wrapped around */
+		recv_len = uart->dma.setting_recv_len - uart->dma.last_recv_index + recv_index;
+	}
+
+	uart->dma.last_recv_index = recv_index == uart->dma.setting_recv_len ? 0 : recv_index;
 	/* enable interrupt */
 	rt_hw_interrupt_enable(level);
 
 	if(recv_len) hal_serial_isr(serial, SERIAL_EVENT_RX_DMADONE | (recv_len << 8));
+}
+
+/**
+ * Serial port receive idle process. This need add to uart idle ISR.
+ *
+ * @param serial serial device
+ */
+static void dma_uart_rx_idle_isr(struct serial_device* serial)
+{
+	struct stm32_uart* uart = (struct stm32_uart*) serial->parent.user_data;
+
+	dma_rx_update(serial);
 
 	/* read a data for clear receive idle interrupt flag */
 	USART_ReceiveData(uart->uart_device);
 }
 
 /**
- * DMA receive done process. This need add to DMA receive done ISR.
+ * DMA receive half/done process. This need add to DMA receive ISR.
+ * Half transfer interrupt makes sure a continuous stream without idle line is
+ * reported at least twice per fifo round, before it can be overwritten.
  *
  * @param serial serial device
  */
 static void dma_rx_done_isr(struct serial_device* serial)
 {
 	struct stm32_uart* uart = (struct stm32_uart*) serial->parent.user_data;
-	rt_size_t recv_len;
-	rt_base_t level;
-
-	if(DMA_GetFlagStatus(uart->dma.rx_stream, uart->dma.rx_flag) != RESET) {
-		/* disable interrupt */
-		level = rt_hw_interrupt_disable();
+	uint32_t flags = 0;
 
-		recv_len = uart->dma.setting_recv_len - uart->dma.last_recv_index;
-		/* reset last recv index */
-		uart->dma.last_recv_index = 0;
-		/* enable interrupt */
-		rt_hw_interrupt_enable(level);
+	if(DMA_GetFlagStatus(uart->dma.rx_stream, uart->dma.rx_ht_flag) != RESET) {
+		flags |= uart->dma.rx_ht_flag;
+	}
 
-		if(recv_len) hal_serial_isr(serial, SERIAL_EVENT_RX_DMADONE | (recv_len << 8));
+	if(DMA_GetFlagStatus(uart->dma.rx_stream, uart->dma.rx_flag) != RESET) {
+		flags |= uart->dma.rx_flag;
+	}
 
-		/* start receive data */
-		DMA_ClearFlag(uart->dma.rx_stream, uart->dma.rx_flag);
+	if(flags) {
+		DMA_ClearFlag(uart->dma.rx_stream, flags);
+		dma_rx_update(serial);
 	}
 }
 
@@ -215,6 +236,7 @@ struct stm32_uart uart1 = {
 		DMA_Channel_4,
 		DMA_FLAG_TCIF5,
 		DMA2_Stream5_IRQn,
+		DMA_FLAG_HTIF5,
 		0,
 		0,
 		DMA2_Stream7,
@@ -270,6 +292,7 @@ struct stm32_uart uart2 = {
 		DMA_Channel_4,
 		DMA_FLAG_TCIF5,
 		DMA1_Stream5_IRQn,
+		DMA_FLAG_HTIF5,
 		0,
 		0,
 		DMA1_Stream6,
@@ -324,6 +347,7 @@ struct stm32_uart uart3 = {
 		DMA_Channel_4,
 		DMA_FLAG_TCIF1,
 		DMA1_Stream1_IRQn,
+		DMA_FLAG_HTIF1,
 		0,
 		0,
 		DMA1_Stream3,
@@ -378,6 +402,7 @@ struct stm32_uart uart4 = {
 		DMA_Channel_4,
 		DMA_FLAG_TCIF2,
 		DMA1_Stream2_IRQn,
+		DMA_FLAG_HTIF2,
 		0,
 		0,
 		DMA1_Stream4,
@@ -432,6 +457,7 @@ struct stm32_uart uart6 = {
 		DMA_Channel_5,
 		DMA_FLAG_TCIF1,
 		DMA2_Stream1_IRQn,
+		DMA_FLAG_HTIF1,
 		0,
 		0,
 		DMA2_Stream6,
@@ -627,10 +653,12 @@ static void _dma_rx_config(struct serial_device* serial, rt_uint8_t* buf, rt_siz
 
 	DMA_Init(uart->dma.rx_stream, &DMA_InitStructure);
 
-	DMA_ClearFlag(uart->dma.rx_stream, uart->dma.rx_flag);
+	DMA_ClearFlag(uart->dma.rx_stream, uart->dma.rx_flag | uart->dma.rx_ht_flag);
+
+	/* DMA IT Interrupt will be trigger if half or all of DMA_InitStructure.DMA_BufferSize bytes has been received */
+	DMA_ITConfig(uart->dma.rx_stream, DMA_IT_TC | DMA_IT_HT, ENABLE);
 
-	/* DMA IT Interrupt will be trigger if DMA_InitStructure.DMA_BufferSize bytes has been received */
-	DMA_ITConfig(uart->dma.rx_stream, DMA_IT_TC, ENABLE);
+	uart->dma.last_recv_index = 0;
 
 	/* We will also reveice data in usart idle irq */
 	USART_ITConfig(uart->uart_device, USART_IT_IDLE, ENABLE);
@@ -701,8 +729,8 @@ static void _close_usart(struct serial_device* serial)
 	}
 
 	if(serial->parent.open_flag & RT_DEVICE_FLAG_DMA_RX) {
-		DMA_ClearFlag(uart->dma.rx_stream, uart->dma.rx_flag);
-		DMA_ITConfig(uart->dma.rx_stream, DMA_IT_TC, DISABLE);
+		DMA_ClearFlag(uart->dma.rx_stream, uart->dma.rx_flag | uart->dma.rx_ht_flag);
+		DMA_ITConfig(uart->dma.rx_stream, DMA_IT_TC | DMA_IT_HT, DISABLE);
 		USART_ITConfig(uart->uart_device, USART_IT_IDLE, DISABLE);
 		USART_DMACmd(uart->uart_device, USART_DMAReq_Rx, DISABLE);
 		DMA_Cmd(uart->dma.rx_stream, DISABLE);
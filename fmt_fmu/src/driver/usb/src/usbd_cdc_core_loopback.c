@@ -137,6 +137,7 @@ static uint8_t*  USBD_cdc_GetCfgDesc(uint8_t speed, uint16_t* length);
   * @{
   */
 extern CDC_IF_Prop_TypeDef  APP_FOPS;
+extern void cdc_rx_start(void);
 extern uint8_t USBD_DeviceDesc   [USB_SIZ_DEVICE_DESC];
 
 #ifdef USB_OTG_HS_INTERNAL_DMA_ENABLED
@@ -429,6 +430,9 @@ uint8_t  usbd_cdc_Init(void*  pdev,
 	pbuf[4] = DEVICE_CLASS_CDC;
 	pbuf[5] = DEVICE_SUBCLASS_CDC;
 
+	/* Prepare Out endpoint to receive next packet */
+	cdc_rx_start();
+
 	return USBD_OK;
 }
 
@@ -24,12 +24,17 @@ static rt_device_t _fmtio_dev_t;
 static rt_device_t _io_dev;
 static rt_sem_t _io_rx_sem_t;
 static rt_sem_t _io_tx_sem_t;
+/* set by synchronous write which waits for tx done */
+static volatile uint8_t _io_tx_wait;
 
 static rt_err_t fmtio_dev_tx_done(rt_device_t dev, void* buffer)
 {
-	rt_err_t ret;
+	rt_err_t ret = RT_EOK;
 
-	ret = rt_sem_release(_io_tx_sem_t);
+	if(_io_tx_wait) {
+		_io_tx_wait = 0;
+		ret = rt_sem_release(_io_tx_sem_t);
+	}
 
 	/* invoke tx indicator if set */
 	if(_fmtio_dev_t->tx_complete) {
@@ -85,6 +90,8 @@ static rt_size_t fmtio_dev_read(rt_device_t dev, rt_off_t pos, void* buffer, rt_
 	return cnt;
 }
 
+/* pos is the timeout to wait for write complete, if pos is 0 the write is
+ * asynchronous and completion is reported by tx_complete indicator only */
 static rt_size_t fmtio_dev_write(rt_device_t dev, rt_off_t pos, const void* buffer, rt_size_t size)
 {
 	rt_size_t wb;
@@ -93,11 +100,17 @@ static rt_size_t fmtio_dev_write(rt_device_t dev, rt_off_t pos, const void* buff
 		return 0;
 	}
 
+	if(pos == 0) {
+		return rt_device_write(_io_dev, 0, buffer, size);
+	}
+
 	/* write data to device */
+	_io_tx_wait = 1;
 	wb = rt_device_write(_io_dev, 0, buffer, size);
 
 	/* wait write complete up to timeout ms */
 	if(rt_sem_take(_io_tx_sem_t, (rt_int32_t)pos) != RT_EOK) {
+		_io_tx_wait = 0;
 		return 0;
 	}
 
@@ -128,6 +141,13 @@ rt_err_t fmtio_dev_control(rt_device_t dev, int cmd, void* args)
 		}
 		break;
 
+		/* zero-copy rx, parse directly on serial dma fifo */
+		case SERIAL_CTRL_RX_PEEK:
+		case SERIAL_CTRL_RX_CONSUME: {
+			ret = rt_device_control(_io_dev, cmd, args);
+		}
+		break;
+
 		default: {
 
 		} break;
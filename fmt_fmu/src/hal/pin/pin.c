@@ -52,17 +52,45 @@ static rt_size_t hal_pin_write(rt_device_t dev, rt_off_t pos, const void* buffer
 
 static rt_err_t  hal_pin_control(rt_device_t dev, int cmd, void* args)
 {
-	struct device_pin_mode* mode;
 	struct pin_device* pin = (struct pin_device*)dev;
 
 	/* check parameters */
 	RT_ASSERT(pin != RT_NULL);
 
-	mode = (struct device_pin_mode*) args;
+	if(args == RT_NULL) return -RT_ERROR;
 
-	if(mode == RT_NULL) return -RT_ERROR;
+	switch(cmd) {
+		case PIN_CMD_ATTACH_IRQ: {
+			struct device_pin_irq* irq = (struct device_pin_irq*) args;
 
-	pin->ops->pin_mode(dev, (rt_base_t)mode->pin, (rt_base_t)mode->mode, (rt_base_t)mode->otype);
+			if(pin->ops->pin_attach_irq == RT_NULL) return -RT_ENOSYS;
+
+			return pin->ops->pin_attach_irq(dev, (rt_base_t)irq->pin, (rt_base_t)irq->mode, irq->hdr, irq->args);
+		}
+
+		case PIN_CMD_DETACH_IRQ: {
+			struct device_pin_irq* irq = (struct device_pin_irq*) args;
+
+			if(pin->ops->pin_detach_irq == RT_NULL) return -RT_ENOSYS;
+
+			return pin->ops->pin_detach_irq(dev, (rt_base_t)irq->pin);
+		}
+
+		case PIN_CMD_ENABLE_IRQ: {
+			struct device_pin_irq_enable* irq_enable = (struct device_pin_irq_enable*) args;
+
+			if(pin->ops->pin_irq_enable == RT_NULL) return -RT_ENOSYS;
+
+			return pin->ops->pin_irq_enable(dev, (rt_base_t)irq_enable->pin, (rt_base_t)irq_enable->enable);
+		}
+
+		default: {
+			struct device_pin_mode* mode = (struct device_pin_mode*) args;
+
+			pin->ops->pin_mode(dev, (rt_base_t)mode->pin, (rt_base_t)mode->mode, (rt_base_t)mode->otype);
+		}
+		break;
+	}
 
 	return RT_EOK;
 }
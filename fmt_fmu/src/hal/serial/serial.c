@@ -299,6 +299,78 @@ rt_inline int _serial_dma_rx(struct serial_device* serial, rt_uint8_t* data, int
     return recv_len;
 }
 
+/**
+ * Get the contiguous span of received data in dma rx fifo without copying it.
+ * The data is only valid until it's consumed, and can be overwritten by dma if
+ * the fifo overruns, so the caller should consume it in time.
+ *
+ * @param serial serial device
+ * @param data return the start of the span
+ *
+ * @return length of the span
+ */
+rt_size_t hal_serial_rx_peek(struct serial_device* serial, rt_uint8_t** data)
+{
+    struct serial_rx_fifo* rx_fifo;
+    rt_size_t len;
+    rt_base_t level;
+
+    RT_ASSERT((serial != RT_NULL) && (data != RT_NULL));
+
+    if (!(serial->parent.open_flag & RT_DEVICE_FLAG_DMA_RX)) {
+        return 0;
+    }
+
+    level = rt_hw_interrupt_disable();
+
+    rx_fifo = (struct serial_rx_fifo*)serial->serial_rx;
+    RT_ASSERT(rx_fifo != RT_NULL);
+
+    len = _dma_calc_recved_len(serial);
+    /* stop at the end of fifo, the wrapped part is returned by next peek */
+    if (rx_fifo->get_index + len > serial->config.bufsz) {
+        len = serial->config.bufsz - rx_fifo->get_index;
+    }
+    *data = rx_fifo->buffer + rx_fifo->get_index;
+
+    rt_hw_interrupt_enable(level);
+
+    return len;
+}
+
+/**
+ * Release data returned by hal_serial_rx_peek().
+ *
+ * @param serial serial device
+ * @param len length to release
+ *
+ * @return length released
+ */
+rt_size_t hal_serial_rx_consume(struct serial_device* serial, rt_size_t len)
+{
+    rt_size_t recved_len;
+    rt_base_t level;
+
+    RT_ASSERT(serial != RT_NULL);
+
+    if (!(serial->parent.open_flag & RT_DEVICE_FLAG_DMA_RX)) {
+        return 0;
+    }
+
+    level = rt_hw_interrupt_disable();
+
+    /* fifo may have been overrun since peek */
+    recved_len = _dma_calc_recved_len(serial);
+    if (len > recved_len) {
+        len = recved_len;
+    }
+    _dma_recv_update_get_index(serial, len);
+
+    rt_hw_interrupt_enable(level);
+
+    return len;
+}
+
 rt_inline int _serial_dma_tx(struct serial_device* serial, const rt_uint8_t* data, int length)
 {
     /* make a DMA transfer */
@@ -624,6 +696,24 @@ static rt_err_t hal_serial_control(struct rt_device* dev,
 
         break;
 
+    case SERIAL_CTRL_RX_PEEK: {
+        struct serial_rx_span* span = (struct serial_rx_span*)args;
+
+        if (!(dev->open_flag & RT_DEVICE_FLAG_DMA_RX)) {
+            return RT_ENOSYS;
+        }
+
+        span->len = hal_serial_rx_peek(serial, &span->data);
+    } break;
+
+    case SERIAL_CTRL_RX_CONSUME:
+        if (!(dev->open_flag & RT_DEVICE_FLAG_DMA_RX)) {
+            return RT_ENOSYS;
+        }
+
+        hal_serial_rx_consume(serial, (rt_size_t)args);
+        break;
+
     default:
         /* control device */
         ret = serial->ops->control(serial, cmd, args);
@@ -16,17 +16,21 @@
 
 #include <firmament.h>
 
-#include "module/utils/ringbuffer.h"
 #include "hal/cdcacm.h"
+#include "hal/serial.h"
+#include "module/utils/ring.h"
 
 MCN_DEFINE(usb_status, sizeof(USB_Status));
 
-#ifdef USB_OTG_HS_CORE
-	#define RECEIVE_RINGBUFF_SIZE		10*RX_FIFO_HS_SIZE
-#else
-	#define RECEIVE_RINGBUFF_SIZE		10*RX_FIFO_FS_SIZE
-#endif
-#define USB_SEND_TIMEOUT				100		// 100ms
+/* out packets are received by usb core directly into a spsc ring of packet
+ * slots, the usb isr is producer and reader thread is consumer. when all slots
+ * are full the endpoint is not re-armed and the host is NAKed until the reader
+ * frees a slot */
+#define CDC_RX_PKT_SIZE				CDC_DATA_OUT_PACKET_SIZE
+#define CDC_RX_PKT_NUM				16		// must be power of 2
+/* in transfers are double buffered, writes are appended to the buffer being
+ * filled while the other one is sent, then they are swapped on tx done */
+#define CDC_TX_BUF_SIZE				1024
 
 __ALIGN_BEGIN USB_OTG_CORE_HANDLE    USB_OTG_dev __ALIGN_END ;
 
@@ -35,16 +39,25 @@ static uint16_t cdc_data_rx(uint32_t Len);
 
 /* add volatile, otherwise the compiler will optimize these value and the value can't be read correctly */
 static volatile uint8_t data_sent, data_receive;
-#ifdef USB_OTG_HS_CORE
-	static uint8_t receiv_pack[RX_FIFO_HS_SIZE];
-#else
-	static uint8_t receiv_pack[RX_FIFO_FS_SIZE];
-#endif
+
+typedef struct {
+	uint8_t data[CDC_RX_PKT_SIZE];
+	uint32_t len;
+} cdc_rx_pkt;
+
+static cdc_rx_pkt _rx_pkt[CDC_RX_PKT_NUM];
+static ring_spsc _rx_ring;
+static uint16_t _rx_offset;				// read offset in oldest packet
+static volatile uint8_t _rx_stalled;
+
+static uint8_t _tx_buf[2][CDC_TX_BUF_SIZE];
+static uint16_t _tx_len[2];
+static uint8_t _tx_fill;
+static volatile uint8_t _tx_busy;
+static volatile uint8_t _tx_wait;
 
 static uint8_t _cdc_connected = 0;
 USB_Status usb_status;
-uint8_t rb_buffer[RECEIVE_RINGBUFF_SIZE];
-static ringbuffer* rb;
 
 static struct rt_device usb_device;
 
@@ -64,10 +77,52 @@ static int USB_STATUS_echo(void* param)
 	return 0;
 }
 
+/* arm out endpoint with next free slot, called from usb isr or with irq disabled */
+static void _rx_prepare(void)
+{
+	cdc_rx_pkt* pkt;
+
+	if(ring_spsc_reserve(&_rx_ring, (void**)&pkt) == 0) {
+		_rx_stalled = 1;
+		return;
+	}
+
+	_rx_stalled = 0;
+	DCD_EP_PrepareRx(&USB_OTG_dev, CDC_OUT_EP, pkt->data, CDC_RX_PKT_SIZE);
+}
+
+/* start transfer of the buffer being filled, called from usb isr or with irq disabled */
+static void _tx_kick(void)
+{
+	if(_tx_len[_tx_fill] == 0) {
+		_tx_busy = 0;
+		data_sent = 1;
+		return;
+	}
+
+	_tx_busy = 1;
+	data_sent = 0;
+	DCD_EP_Tx(&USB_OTG_dev, CDC_IN_EP, _tx_buf[_tx_fill], _tx_len[_tx_fill]);
+
+	_tx_fill ^= 1;
+	_tx_len[_tx_fill] = 0;
+}
+
 void cdc_connected_status_change(uint8_t connected)
 {
+	rt_base_t level;
+
 	_cdc_connected = connected;
 
+	if(!connected) {
+		/* drop pending tx data, the in endpoint is reset */
+		level = rt_hw_interrupt_disable();
+		_tx_len[0] = _tx_len[1] = 0;
+		_tx_busy = 0;
+		data_sent = 1;
+		rt_hw_interrupt_enable(level);
+	}
+
 	usb_status.connected = connected;
 	mcn_publish(MCN_ID(usb_status), &usb_status);
 }
@@ -77,14 +132,25 @@ uint8_t cdc_is_connected(void)
 	return _cdc_connected;
 }
 
+/* called by usb core after endpoints are opened, queued packets are kept */
+void cdc_rx_start(void)
+{
+	_rx_prepare();
+}
+
 /* This callback is called when the send status is finished */
 static uint16_t cdc_data_tx(void)
 {
-	data_sent = 1;
+	/* chain the next buffer right away */
+	_tx_kick();
 
-	/* invoke callback */
-	if(usb_device.tx_complete != RT_NULL) {
-		usb_device.tx_complete(&usb_device, RT_NULL);
+	/* invoke callback if a writer is waiting for room */
+	if(_tx_wait) {
+		_tx_wait = 0;
+
+		if(usb_device.tx_complete != RT_NULL) {
+			usb_device.tx_complete(&usb_device, RT_NULL);
+		}
 	}
 
 	return USBD_OK;
@@ -93,24 +159,22 @@ static uint16_t cdc_data_tx(void)
 /* This callback is called when the receive status is finished */
 static uint16_t cdc_data_rx(uint32_t Len)
 {
-	data_receive = 1;
-
-	/* we need to receive data here, otherwise, the send will be suspended */
-	DCD_EP_PrepareRx(&USB_OTG_dev, CDC_OUT_EP, receiv_pack, Len);
-
-	/* push data to ring buffer */
-	for(int i = 0 ; i < Len ; i++) {
-		ringbuffer_putc(rb, receiv_pack[i]);
+	cdc_rx_pkt* pkt;
+
+	if(Len) {
+		/* publish the armed slot to reader */
+		ring_spsc_reserve(&_rx_ring, (void**)&pkt);
+		pkt->len = Len;
+		ring_spsc_commit(&_rx_ring, 1);
+		data_receive = 1;
 	}
 
-	/* invoke callback */
-	if(usb_device.rx_indicate != RT_NULL) {
-		rt_size_t rx_length;
-
-		/* get rx length */
-		rx_length = ringbuffer_getlen(rb);
+	/* re-arm endpoint, otherwise the host is NAKed */
+	_rx_prepare();
 
-		usb_device.rx_indicate(&usb_device, rx_length);
+	/* invoke callback */
+	if(Len && usb_device.rx_indicate != RT_NULL) {
+		usb_device.rx_indicate(&usb_device, cdc_get_receive_cnt());
 	}
 
 	return USBD_OK;
@@ -128,7 +192,62 @@ uint8_t cdc_check_receive(void)
 
 uint32_t cdc_get_receive_cnt(void)
 {
-	return ringbuffer_getlen(rb);
+	uint32_t num = ring_spsc_count(&_rx_ring);
+	uint32_t cnt = 0;
+
+	for(uint32_t i = 0 ; i < num ; i++) {
+		cnt += _rx_pkt[(_rx_ring.tail + i) & (CDC_RX_PKT_NUM - 1)].len;
+	}
+
+	return num ? cnt - _rx_offset : 0;
+}
+
+/* get received data in the oldest packet without copying */
+uint32_t cdc_peek_data(uint8_t** pbuf)
+{
+	cdc_rx_pkt* pkt;
+
+	if(ring_spsc_peek(&_rx_ring, (void**)&pkt) == 0) {
+		return 0;
+	}
+
+	*pbuf = &pkt->data[_rx_offset];
+
+	return pkt->len - _rx_offset;
+}
+
+/* release data returned by cdc_peek_data() */
+void cdc_consume_data(uint32_t len)
+{
+	rt_base_t level;
+	uint8_t* data;
+	uint32_t left;
+
+	while(len && (left = cdc_peek_data(&data)) > 0) {
+		if(len < left) {
+			_rx_offset += len;
+			break;
+		}
+
+		len -= left;
+		_rx_offset = 0;
+		ring_spsc_consume(&_rx_ring, 1);
+
+		/* a slot is free now, resume receiving if it was stopped */
+		if(_rx_stalled) {
+			level = rt_hw_interrupt_disable();
+
+			if(_rx_stalled) {
+				_rx_prepare();
+			}
+
+			rt_hw_interrupt_enable(level);
+		}
+	}
+
+	if(ring_spsc_count(&_rx_ring) == 0) {
+		data_receive = 0;
+	}
 }
 
 void cdc_send_data(uint8_t* pbuf, uint32_t buf_len)
@@ -139,11 +258,23 @@ void cdc_send_data(uint8_t* pbuf, uint32_t buf_len)
 	DCD_EP_Tx(&USB_OTG_dev, CDC_IN_EP, pbuf, buf_len);
 }
 
-uint8_t cdc_receive_data(uint8_t* pbuf, uint32_t len)
+uint32_t cdc_receive_data(uint8_t* pbuf, uint32_t len)
 {
-	data_receive = 0;
+	uint8_t* data;
+	uint32_t cnt = 0;
+	uint32_t n;
+
+	while(cnt < len && (n = cdc_peek_data(&data)) > 0) {
+		if(n > len - cnt) {
+			n = len - cnt;
+		}
+
+		memcpy(&pbuf[cnt], data, n);
+		cdc_consume_data(n);
+		cnt += n;
+	}
 
-	return ringbuffer_get(rb, pbuf, len);
+	return cnt;
 }
 
 rt_size_t usb_read(rt_device_t dev, rt_off_t pos, void* buffer, rt_size_t size)
@@ -151,8 +282,12 @@ rt_size_t usb_read(rt_device_t dev, rt_off_t pos, void* buffer, rt_size_t size)
 	return cdc_receive_data((uint8_t*)buffer, size);
 }
 
+/* data is copied into tx buffer and tx_complete is invoked once it's accepted.
+ * if there is no room, 0 is returned with errno RT_EFULL and tx_complete will be
+ * invoked when a buffer is sent, so the writer can try again */
 rt_size_t usb_write(rt_device_t dev, rt_off_t pos, const void* buffer, rt_size_t size)
 {
+	rt_base_t level;
 
 	if(!cdc_is_connected()) {
 		/* if usb not connected, involke callback to let upper layer know send is finished */
@@ -160,10 +295,37 @@ rt_size_t usb_write(rt_device_t dev, rt_off_t pos, const void* buffer, rt_size_t
 			usb_device.tx_complete(&usb_device, RT_NULL);
 		}
 
+		rt_set_errno(RT_EIO);
 		return 0;
 	}
 
-	cdc_send_data((uint8_t*)buffer, size);
+	if(size > CDC_TX_BUF_SIZE) {
+		rt_set_errno(RT_EINVAL);
+		return 0;
+	}
+
+	level = rt_hw_interrupt_disable();
+
+	if(_tx_len[_tx_fill] + size > CDC_TX_BUF_SIZE) {
+		_tx_wait = 1;
+		rt_hw_interrupt_enable(level);
+
+		rt_set_errno(RT_EFULL);
+		return 0;
+	}
+
+	memcpy(&_tx_buf[_tx_fill][_tx_len[_tx_fill]], buffer, size);
+	_tx_len[_tx_fill] += size;
+
+	if(!_tx_busy) {
+		_tx_kick();
+	}
+
+	rt_hw_interrupt_enable(level);
+
+	if(usb_device.tx_complete != RT_NULL) {
+		usb_device.tx_complete(&usb_device, RT_NULL);
+	}
 
 	return size;
 }
@@ -197,8 +359,21 @@ rt_err_t  usb_control(rt_device_t dev, int cmd, void* args)
 		}
 		break;
 
+		/* zero-copy rx, same interface as serial device */
+		case SERIAL_CTRL_RX_PEEK: {
+			struct serial_rx_span* span = (struct serial_rx_span*)args;
+
+			span->len = cdc_peek_data(&span->data);
+		}
+		break;
+
+		case SERIAL_CTRL_RX_CONSUME: {
+			cdc_consume_data((uint32_t)args);
+		}
+		break;
+
 		default:
-			break;
+			return RT_ENOSYS;
 	}
 
 	return RT_EOK;
@@ -210,7 +385,7 @@ uint8_t usb_cdc_init(void)
 	data_sent = 1;
 	data_receive = 0;
 
-	rb = ringbuffer_static_create(rb_buffer, RECEIVE_RINGBUFF_SIZE);
+	ring_spsc_init(&_rx_ring, _rx_pkt, CDC_RX_PKT_NUM, sizeof(cdc_rx_pkt));
 
 	mcn_advertise(MCN_ID(usb_status), USB_STATUS_echo);
 
@@ -0,0 +1,336 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <firmament.h>
+#include <math.h>
+#include <string.h>
+
+#include "module/calibration/bg_calib.h"
+#include "module/fms/fms_model.h"
+#include "module/sensor/sensor_manager.h"
+
+#define TAG                     "BgCalib"
+
+#define BG_CALIB_GYR            (1 << 0)
+#define BG_CALIB_MAG            (1 << 1)
+
+#define GRAVITY_MSS             9.80665f
+
+/* gyro is still if it moves less than this within a window */
+#define BG_GYR_WINDOW_SIZE      20
+#define BG_GYR_STILL_RANGE      0.02f
+#define BG_ACC_STILL_RANGE      0.3f
+#define BG_GYR_MAX_BIAS         0.1f
+#define BG_GYR_MIN_WINDOWS      10
+
+/* a mag sample is taken if it turned more than ~10 deg from the last one */
+#define BG_MAG_MIN_SEP_COS      0.985f
+#define BG_MAG_BIN_CAP          8
+#define BG_MAG_BIN_MIN          2
+#define BG_MAG_MIN_BINS         18
+#define BG_MAG_MIN_RADIUS       0.1f
+#define BG_MAG_MAX_RADIUS       1.0f
+#define BG_MAG_MAX_RADII_RATIO  1.4f
+
+MCN_DECLARE(sensor_imu);
+MCN_DECLARE(sensor_mag);
+MCN_DECLARE(fms_output);
+
+static McnNode_t _imu_nod;
+static McnNode_t _mag_nod;
+
+static const float _mag_fit_p0[ELLIPSOID_PARAM_NUM] = { 10.0f, 10.0f, 10.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+
+static struct {
+	uint8_t cnt;
+	float sum[3];
+	float min[3];
+	float max[3];
+} _gyr_window;
+
+static float _mag_last_dir[3];
+static EllipsoidFit _mag_fit;
+static BgCalibStatus _status;
+
+static void _gyr_window_reset(void)
+{
+	memset(&_gyr_window, 0, sizeof(_gyr_window));
+}
+
+static void _gyr_reset(void)
+{
+	_gyr_window_reset();
+
+	_status.gyr_windows = 0;
+	_status.gyr_bias[0] = _status.gyr_bias[1] = _status.gyr_bias[2] = 0.0f;
+	_status.gyr_ready = 0;
+}
+
+static void _mag_reset(void)
+{
+	ellipsoid_fit_init(&_mag_fit, _mag_fit_p0, 0.001f);
+
+	memset(_status.mag_bin, 0, sizeof(_status.mag_bin));
+	memset(_mag_last_dir, 0, sizeof(_mag_last_dir));
+	_status.mag_bin_filled = 0;
+	_status.mag_samples = 0;
+	_status.mag_ready = 0;
+}
+
+static void _gyr_update(const IMU_Report* imu)
+{
+	float acc_norm = sqrtf(imu->acc_B_mDs2[0] * imu->acc_B_mDs2[0] + imu->acc_B_mDs2[1] * imu->acc_B_mDs2[1]
+	                       + imu->acc_B_mDs2[2] * imu->acc_B_mDs2[2]);
+
+	if(fabsf(acc_norm - GRAVITY_MSS) > BG_ACC_STILL_RANGE) {
+		/* moving, restart window */
+		_gyr_window_reset();
+		return;
+	}
+
+	for(uint8_t i = 0; i < 3; i++) {
+		float g = imu->gyr_B_radDs[i];
+
+		if(_gyr_window.cnt == 0) {
+			_gyr_window.min[i] = _gyr_window.max[i] = g;
+		}
+
+		_gyr_window.min[i] = g < _gyr_window.min[i] ? g : _gyr_window.min[i];
+		_gyr_window.max[i] = g > _gyr_window.max[i] ? g : _gyr_window.max[i];
+		_gyr_window.sum[i] += g;
+
+		if(_gyr_window.max[i] - _gyr_window.min[i] > BG_GYR_STILL_RANGE) {
+			_gyr_window_reset();
+			return;
+		}
+	}
+
+	if(++_gyr_window.cnt < BG_GYR_WINDOW_SIZE) {
+		return;
+	}
+
+	/* a full still window, average its mean into the bias estimate */
+	for(uint8_t i = 0; i < 3; i++) {
+		float mean = _gyr_window.sum[i] / BG_GYR_WINDOW_SIZE;
+
+		if(fabsf(mean) > BG_GYR_MAX_BIAS) {
+			/* slow constant rotation rather than bias */
+			_gyr_window_reset();
+			return;
+		}
+	}
+
+	_status.gyr_windows++;
+
+	for(uint8_t i = 0; i < 3; i++) {
+		float mean = _gyr_window.sum[i] / BG_GYR_WINDOW_SIZE;
+
+		_status.gyr_bias[i] += (mean - _status.gyr_bias[i]) / _status.gyr_windows;
+	}
+
+	if(_status.gyr_windows >= BG_GYR_MIN_WINDOWS) {
+		_status.gyr_ready = 1;
+	}
+
+	_gyr_window_reset();
+}
+
+/* bin of a direction by the sign pattern of its significant components */
+static uint8_t _mag_bin(const float dir[3])
+{
+	uint8_t bin = 0;
+
+	for(uint8_t i = 0; i < 3; i++) {
+		/* components below sin(22.5deg) count as 0 */
+		uint8_t s = dir[i] > 0.38f ? 2 : (dir[i] < -0.38f ? 0 : 1);
+		bin = bin * 3 + s;
+	}
+
+	/* skip (0,0,0) at index 13, it can not happen for a unit vector */
+	return bin > 13 ? bin - 1 : bin;
+}
+
+static void _mag_update(const Mag_Report* mag)
+{
+	float dir[3];
+	float norm;
+	uint8_t bin;
+
+	/* center by the current offset so direction bins are meaningful */
+	dir[0] = mag->mag_B_gauss[0] - PARAM_GET_FLOAT(CALIB, MAG0_XOFF);
+	dir[1] = mag->mag_B_gauss[1] - PARAM_GET_FLOAT(CALIB, MAG0_YOFF);
+	dir[2] = mag->mag_B_gauss[2] - PARAM_GET_FLOAT(CALIB, MAG0_ZOFF);
+
+	norm = sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+
+	if(norm < 1e-3f) {
+		return;
+	}
+
+	dir[0] /= norm;
+	dir[1] /= norm;
+	dir[2] /= norm;
+
+	if(dir[0] * _mag_last_dir[0] + dir[1] * _mag_last_dir[1] + dir[2] * _mag_last_dir[2] > BG_MAG_MIN_SEP_COS) {
+		/* too close to the last sample */
+		return;
+	}
+
+	bin = _mag_bin(dir);
+
+	if(_status.mag_bin[bin] >= BG_MAG_BIN_CAP) {
+		return;
+	}
+
+	ellipsoid_fit_update(&_mag_fit, mag->mag_B_gauss[0], mag->mag_B_gauss[1], mag->mag_B_gauss[2]);
+	memcpy(_mag_last_dir, dir, sizeof(dir));
+
+	_status.mag_samples++;
+
+	if(++_status.mag_bin[bin] == BG_MAG_BIN_MIN) {
+		_status.mag_bin_filled++;
+	}
+}
+
+/* solve the fit once enough directions are covered, keep it if it looks sane */
+static void _mag_check(void)
+{
+	EllipsoidResult result;
+	float r_min, r_max;
+
+	if(_status.mag_ready || _status.mag_bin_filled < BG_MAG_MIN_BINS) {
+		return;
+	}
+
+	if(ellipsoid_fit_result(&_mag_fit, &result) != FMT_EOK) {
+		ulog_w(TAG, "mag fit failed, restart");
+		_mag_reset();
+		return;
+	}
+
+	r_min = r_max = result.radii[0];
+
+	for(uint8_t i = 1; i < 3; i++) {
+		r_min = result.radii[i] < r_min ? result.radii[i] : r_min;
+		r_max = result.radii[i] > r_max ? result.radii[i] : r_max;
+	}
+
+	if(r_min < BG_MAG_MIN_RADIUS || r_max > BG_MAG_MAX_RADIUS || r_max > r_min * BG_MAG_MAX_RADII_RATIO) {
+		ulog_w(TAG, "mag fit rejected, radii %.3f~%.3f", r_min, r_max);
+		_mag_reset();
+		return;
+	}
+
+	_status.mag_result = result;
+	_status.mag_ready = 1;
+}
+
+static void _commit(void)
+{
+	if(_status.gyr_ready) {
+		PARAM_SET_FLOAT(CALIB, GYRO0_XOFF, _status.gyr_bias[0]);
+		PARAM_SET_FLOAT(CALIB, GYRO0_YOFF, _status.gyr_bias[1]);
+		PARAM_SET_FLOAT(CALIB, GYRO0_ZOFF, _status.gyr_bias[2]);
+
+		ulog_i(TAG, "gyro bias %f %f %f", _status.gyr_bias[0], _status.gyr_bias[1], _status.gyr_bias[2]);
+
+		_status.gyr_commit++;
+		_gyr_reset();
+	}
+
+	if(_status.mag_ready) {
+		const float* mat = _status.mag_result.mat;
+
+		PARAM_SET_FLOAT(CALIB, MAG0_XOFF, _status.mag_result.bias[0]);
+		PARAM_SET_FLOAT(CALIB, MAG0_YOFF, _status.mag_result.bias[1]);
+		PARAM_SET_FLOAT(CALIB, MAG0_ZOFF, _status.mag_result.bias[2]);
+		PARAM_SET_FLOAT(CALIB, MAG0_XXSCALE, mat[0]);
+		PARAM_SET_FLOAT(CALIB, MAG0_XYSCALE, mat[1]);
+		PARAM_SET_FLOAT(CALIB, MAG0_XZSCALE, mat[2]);
+		PARAM_SET_FLOAT(CALIB, MAG0_YYSCALE, mat[4]);
+		PARAM_SET_FLOAT(CALIB, MAG0_YZSCALE, mat[5]);
+		PARAM_SET_FLOAT(CALIB, MAG0_ZZSCALE, mat[8]);
+
+		ulog_i(TAG, "mag bias %f %f %f", _status.mag_result.bias[0], _status.mag_result.bias[1], _status.mag_result.bias[2]);
+
+		_status.mag_commit++;
+		_mag_reset();
+	}
+}
+
+/**
+ * Take the latest samples and update the estimates. The cost is bounded: one
+ * imu and one mag sample per call, and the ellipsoid solve runs at most once
+ * for each collected sample set.
+ */
+void bg_calib_step(void)
+{
+	uint32_t mask = PARAM_GET_INT32(SYSTEM, BG_CALIB);
+	FMS_Out_Bus fms_out;
+
+	if(_imu_nod == NULL || _mag_nod == NULL) {
+		return;
+	}
+
+	if((mask & BG_CALIB_GYR) && mcn_poll(_imu_nod)) {
+		IMU_Report imu;
+
+		mcn_copy(MCN_ID(sensor_imu), _imu_nod, &imu);
+		_gyr_update(&imu);
+	}
+
+	if((mask & BG_CALIB_MAG) && mcn_poll(_mag_nod)) {
+		Mag_Report mag;
+
+		mcn_copy(MCN_ID(sensor_mag), _mag_nod, &mag);
+		_mag_update(&mag);
+		_mag_check();
+	}
+
+	if(_status.gyr_ready || _status.mag_ready) {
+		mcn_copy_from_hub(MCN_ID(fms_output), &fms_out);
+
+		/* don't change sensor calibration while armed */
+		if(fms_out.state == 0) {
+			_commit();
+		}
+	}
+}
+
+void bg_calib_reset(void)
+{
+	_gyr_reset();
+	_mag_reset();
+}
+
+void bg_calib_get_status(BgCalibStatus* status)
+{
+	*status = _status;
+}
+
+fmt_err bg_calib_init(void)
+{
+	_imu_nod = mcn_subscribe(MCN_ID(sensor_imu), NULL, NULL);
+	_mag_nod = mcn_subscribe(MCN_ID(sensor_mag), NULL, NULL);
+
+	if(_imu_nod == NULL || _mag_nod == NULL) {
+		return FMT_ERROR;
+	}
+
+	bg_calib_reset();
+
+	return FMT_EOK;
+}
@@ -0,0 +1,200 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <firmament.h>
+#include <math.h>
+#include <string.h>
+
+#include "module/calibration/ellipsoid_fit.h"
+#include "module/math/matrix.h"
+
+#define N       ELLIPSOID_PARAM_NUM
+
+/* start of row i in the packed upper triangle */
+static const uint8_t _row_offset[N] = { 0, 9, 17, 24, 30, 35, 39, 42, 44 };
+
+static inline float* _cov(float* P, uint8_t i, uint8_t j)
+{
+	return &P[_row_offset[i] + j - i];
+}
+
+/**
+ * @param p_diag initial variance of each parameter, 0 keeps the parameter
+ *               at 0 (e.g. no cross terms)
+ */
+void ellipsoid_fit_init(EllipsoidFit* fit, const float p_diag[ELLIPSOID_PARAM_NUM], float R)
+{
+	memset(fit, 0, sizeof(EllipsoidFit));
+
+	for(uint8_t i = 0; i < N; i++) {
+		*_cov(fit->P, i, i) = p_diag[i];
+	}
+
+	fit->R = R;
+}
+
+void ellipsoid_fit_update(EllipsoidFit* fit, float x, float y, float z)
+{
+	float h[N], ph[N];
+	float S, e, inv_S;
+
+	if(fit->scale == 0.0f) {
+		fit->scale = sqrtf(x * x + y * y + z * z);
+
+		if(fit->scale < 1e-6f) {
+			/* can not normalize by this sample */
+			fit->scale = 0.0f;
+			return;
+		}
+	}
+
+	x /= fit->scale;
+	y /= fit->scale;
+	z /= fit->scale;
+
+	h[0] = x * x;
+	h[1] = y * y;
+	h[2] = z * z;
+	h[3] = 2.0f * x * y;
+	h[4] = 2.0f * x * z;
+	h[5] = 2.0f * y * z;
+	h[6] = 2.0f * x;
+	h[7] = 2.0f * y;
+	h[8] = 2.0f * z;
+
+	/* ph = P * h' */
+	for(uint8_t i = 0; i < N; i++) {
+		float sum = 0.0f;
+
+		for(uint8_t j = 0; j < i; j++) {
+			sum += *_cov(fit->P, j, i) * h[j];
+		}
+
+		for(uint8_t j = i; j < N; j++) {
+			sum += *_cov(fit->P, i, j) * h[j];
+		}
+
+		ph[i] = sum;
+	}
+
+	/* innovation e = 1 - h * v, S = h * P * h' + R */
+	e = 1.0f;
+	S = fit->R;
+
+	for(uint8_t i = 0; i < N; i++) {
+		e -= h[i] * fit->v[i];
+		S += h[i] * ph[i];
+	}
+
+	inv_S = 1.0f / S;
+
+	/* v += K * e, P -= K * h * P = ph * ph' / S, K = ph / S */
+	for(uint8_t i = 0; i < N; i++) {
+		float k = ph[i] * inv_S;
+		float* row = _cov(fit->P, i, i);
+
+		fit->v[i] += k * e;
+
+		for(uint8_t j = i; j < N; j++) {
+			row[j - i] -= k * ph[j];
+		}
+	}
+
+	fit->cnt++;
+}
+
+/**
+ * Solve center and shape of the fitted ellipsoid. the correction matrix
+ * maps the ellipsoid to a sphere and is normalized to a largest gain of 1,
+ * the same as the previous matlab generated solver.
+ */
+fmt_err ellipsoid_fit_result(const EllipsoidFit* fit, EllipsoidResult* result)
+{
+	float A[9], b[3], c[3], Ac[3];
+	float eig_val[3], eig_vec[9];
+	float gain[3], gain_max;
+	float k;
+
+	if(fit->cnt == 0) {
+		return FMT_ERROR;
+	}
+
+	A[0] = fit->v[0];
+	A[1] = fit->v[3];
+	A[2] = fit->v[4];
+	A[3] = fit->v[3];
+	A[4] = fit->v[1];
+	A[5] = fit->v[5];
+	A[6] = fit->v[4];
+	A[7] = fit->v[5];
+	A[8] = fit->v[2];
+
+	/* center c = -A \ b */
+	b[0] = -fit->v[6];
+	b[1] = -fit->v[7];
+	b[2] = -fit->v[8];
+
+	if(matrix_solve(A, b, c, 3) != FMT_EOK) {
+		return FMT_ERROR;
+	}
+
+	/* translated to the center: x' * A * x = 1 + c' * A * c */
+	matrix_mul_vec(A, c, Ac, 3, 3);
+	k = 1.0f + c[0] * Ac[0] + c[1] * Ac[1] + c[2] * Ac[2];
+
+	if(k <= 0.0f) {
+		return FMT_ERROR;
+	}
+
+	for(uint8_t i = 0; i < 9; i++) {
+		A[i] /= k;
+	}
+
+	/* eigenvectors are the axes, eigenvalues are 1 / radius^2 */
+	if(matrix_eig_sym(A, eig_val, eig_vec, 3) != FMT_EOK) {
+		return FMT_ERROR;
+	}
+
+	gain_max = 0.0f;
+
+	for(uint8_t i = 0; i < 3; i++) {
+		if(eig_val[i] <= 0.0f) {
+			/* not an ellipsoid */
+			return FMT_ERROR;
+		}
+
+		gain[i] = sqrtf(eig_val[i]);
+		gain_max = gain[i] > gain_max ? gain[i] : gain_max;
+
+		result->radii[i] = fit->scale / gain[i];
+		result->bias[i] = fit->scale * c[i];
+	}
+
+	/* mat = V * diag(gain) * V' / max(gain) */
+	for(uint8_t i = 0; i < 3; i++) {
+		for(uint8_t j = 0; j < 3; j++) {
+			float sum = 0.0f;
+
+			for(uint8_t n = 0; n < 3; n++) {
+				sum += eig_vec[i * 3 + n] * gain[n] * eig_vec[j * 3 + n];
+			}
+
+			result->mat[i * 3 + j] = sum / gain_max;
+		}
+	}
+
+	return FMT_EOK;
+}
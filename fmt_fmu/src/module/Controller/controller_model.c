@@ -17,17 +17,35 @@
 #include <Controller.h>
 #include <firmament.h>
 
+#include "module/controller/controller_model.h"
+#include "module/system/model_inst.h"
+
 #define TAG "Controller"
 
 /* controller input topic */
 MCN_DECLARE(fms_output);
 MCN_DECLARE(ins_output);
+/* tunable parameter table, see model_param.h */
+MCN_DECLARE(control_param);
 
 /* controller output topic */
 MCN_DEFINE(control_output, sizeof(Control_Out_Bus));
 
+/* not exported by the codegen header */
+extern RT_MODEL_Controller_T Controller_M_;
+
+MODEL_CLASS_DEFINE(Controller, Controller_init,
+                   MODEL_STATE(Controller_DW),
+                   MODEL_STATE(Controller_U),
+                   MODEL_STATE(Controller_Y),
+                   MODEL_STATE(Controller_M_));
+
+/* instance driving the actuators */
+static model_inst_t _controller_inst;
+
 static McnNode_t _fms_out_nod;
 static McnNode_t _ins_out_nod;
+static McnNode_t _param_nod;
 
 void controller_model_step(void)
 {
@@ -39,6 +57,14 @@ void controller_model_step(void)
         start_time = time_now;
     }
 
+    /* other instances may run in this thread */
+    model_inst_switch(&_controller_inst);
+
+    /* swap in new parameters between steps */
+    if (mcn_poll(_param_nod)) {
+        mcn_copy(MCN_ID(control_param), _param_nod, &CONTROL_PARAM);
+    }
+
     if (mcn_poll(_fms_out_nod)) {
         mcn_copy(MCN_ID(fms_output), _fms_out_nod, &Controller_U.FMS_Out);
     }
@@ -61,12 +87,20 @@ void controller_model_step(void)
     }
 }
 
-void controller_model_init(void)
+fmt_err controller_model_init(void)
 {
     mcn_advertise(MCN_ID(control_output), NULL);
 
     _fms_out_nod = mcn_subscribe(MCN_ID(fms_output), NULL, NULL);
     _ins_out_nod = mcn_subscribe(MCN_ID(ins_output), NULL, NULL);
 
-    Controller_init();
+    if (model_inst_create(&_controller_inst, MODEL_CLASS_ID(Controller)) != FMT_EOK) {
+        return FMT_ERROR;
+    }
+
+    _param_nod = mcn_subscribe(MCN_ID(control_param), NULL, NULL);
+    /* parameters loaded at boot are published before subscribe */
+    mcn_copy_from_hub(MCN_ID(control_param), &CONTROL_PARAM);
+
+    return FMT_EOK;
 }
\ No newline at end of file
@@ -17,19 +17,38 @@
 #include <FMS.h>
 #include <firmament.h>
 
+#include "module/fms/fms_model.h"
+#include "module/system/model_inst.h"
+
 #define TAG "FMS"
 
 // FMS input topic
 MCN_DECLARE(pilot_cmd);
 MCN_DECLARE(ins_output);
 MCN_DECLARE(control_output);
+/* tunable parameter table, see model_param.h */
+MCN_DECLARE(fms_param);
 
 /* FMS output topic */
 MCN_DEFINE(fms_output, sizeof(FMS_Out_Bus));
 
+/* not exported by the codegen header */
+extern RT_MODEL_FMS_T FMS_M_;
+
+MODEL_CLASS_DEFINE(FMS, FMS_init,
+                   MODEL_STATE(FMS_B),
+                   MODEL_STATE(FMS_DW),
+                   MODEL_STATE(FMS_U),
+                   MODEL_STATE(FMS_Y),
+                   MODEL_STATE(FMS_M_));
+
+/* instance flying the vehicle */
+static model_inst_t _fms_inst;
+
 static McnNode_t _pilot_cmd_nod;
 static McnNode_t _ins_out_nod;
 static McnNode_t _control_out_nod;
+static McnNode_t _param_nod;
 static uint8_t _pilot_cmd_update = 1;
 
 void fms_model_step(void)
@@ -42,6 +61,14 @@ void fms_model_step(void)
         start_time = time_now;
     }
 
+    /* other instances may run in this thread */
+    model_inst_switch(&_fms_inst);
+
+    /* swap in new parameters between steps */
+    if (mcn_poll(_param_nod)) {
+        mcn_copy(MCN_ID(fms_param), _param_nod, &FMS_PARAM);
+    }
+
     if (mcn_poll(_pilot_cmd_nod)) {
         mcn_copy(MCN_ID(pilot_cmd), _pilot_cmd_nod, &FMS_U.Pilot_Cmd);
         _pilot_cmd_update = 1;
@@ -77,7 +104,7 @@ void fms_model_step(void)
     }
 }
 
-void fms_model_init(void)
+fmt_err fms_model_init(void)
 {
     mcn_advertise(MCN_ID(fms_output), NULL);
 
@@ -85,5 +112,13 @@ void fms_model_init(void)
     _ins_out_nod = mcn_subscribe(MCN_ID(ins_output), NULL, NULL);
     _control_out_nod = mcn_subscribe(MCN_ID(control_output), NULL, NULL);
 
-    FMS_init();
+    if (model_inst_create(&_fms_inst, MODEL_CLASS_ID(FMS)) != FMT_EOK) {
+        return FMT_ERROR;
+    }
+
+    _param_nod = mcn_subscribe(MCN_ID(fms_param), NULL, NULL);
+    /* parameters loaded at boot are published before subscribe */
+    mcn_copy_from_hub(MCN_ID(fms_param), &FMS_PARAM);
+
+    return FMT_EOK;
 }
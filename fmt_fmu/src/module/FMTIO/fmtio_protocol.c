@@ -15,9 +15,9 @@
  *****************************************************************************/
 
 #include <firmament.h>
-#include "module/fmtio/fmtio_protocol.h"
+#include <string.h>
 
-#define TAG     "IO_PROTOCOL"
+#include "module/fmtio/fmtio_protocol.h"
 
 /* Work as server */
 #define PROTOCOL_SERVER
@@ -35,374 +35,237 @@
 #else
 	#error Please define PROTOCOL_SERVER or PROTOCOL_CLIENT
 #endif
-#define PROTOCOL_END                0xFC
 
+/* parser states define */
+#define STATE_MAGIC                 0x00
+#define STATE_HEAD                  0x01
+#define STATE_BODY                  0x02
+
+#define CRC16_INIT                  0xFFFF
 
 /**************************** Local Function ********************************/
 
-static void _fill_head(PackageStruct* pkg)
+static uint16_t _get_uint16(const uint8_t* buff)
 {
-	pkg->head[0] = PROTOCOL_HEAD_MAGIC;
-	pkg->head[1] = PROTOCOL_HEAD_TX;
+	return (uint16_t)buff[0] | ((uint16_t)buff[1] << 8);
 }
 
-static void _fill_end(PackageStruct* pkg)
+static void _put_uint16(uint8_t* buff, uint16_t val)
 {
-	pkg->end = PROTOCOL_END;
+	buff[0] = val & 0xFF;
+	buff[1] = (val >> 8) & 0xFF;
 }
 
-static uint16_t _calc_checksum(PackageStruct* pkg)
+static void _handle_frame(ParserStruct* parser, pkg_handler_t handler)
 {
-	uint16_t cheksum;
-	uint16_t i;
-
-	cheksum = pkg->head[0] + pkg->head[1] + ((pkg->len & 0xFF) + ((pkg->len >> 8) & 0xFF)) + pkg->cmd;
-
-	for(i = 0 ; i < pkg->len ; i++) {
-		cheksum += pkg->content[i];
+	PackageStruct pkg;
+	uint8_t seq = parser->buff[2];
+	uint8_t msg_num = parser->buff[3];
+	uint16_t end = FRAME_HEAD_SIZE + parser->payload_len;
+	uint16_t offset = FRAME_HEAD_SIZE;
+
+	if(parser->seq_valid && seq != (uint8_t)(parser->last_seq + 1)) {
+		parser->stat->rx_lost += (uint8_t)(seq - parser->last_seq - 1);
 	}
 
-	cheksum += pkg->alloc;
+	parser->last_seq = seq;
+	parser->seq_valid = 1;
+	parser->stat->rx_frame++;
 
-	return cheksum;
-}
-
-/**************************** Public Function ********************************/
-
-fmt_err init_package(uint16_t cmd, uint16_t buff_len, PackageStruct* pkg)
-{
-	/* fill head */
-	_fill_head(pkg);
-
-	/* set length filed */
-	pkg->len = 0;
-	/* set command filed */
-	pkg->cmd = cmd;
-
-	/* content filed allocation */
-	if(buff_len) {
-		pkg->content = rt_malloc(buff_len);
-
-		if(pkg->content == NULL) {
-			return FMT_ERROR;
+	for(uint8_t i = 0 ; i < msg_num ; i++) {
+		if(offset + FRAME_MSG_HEAD_SIZE > end) {
+			parser->stat->rx_len_err++;
+			break;
 		}
-	} else {
-		pkg->content = NULL;
-	}
 
-	/* set default value */
-	pkg->alloc = 1;
+		pkg.cmd = _get_uint16(&parser->buff[offset]);
+		pkg.len = _get_uint16(&parser->buff[offset + 2]);
+		pkg.content = &parser->buff[offset + FRAME_MSG_HEAD_SIZE];
 
-	if(pkg->len == 0) {
-		/* calculate init checksum */
-		pkg->checksum = _calc_checksum(pkg);
-	} else {
-		pkg->checksum  = 0;
-	}
-
-	/* fill end */
-	_fill_end(pkg);
-
-	return FMT_EOK;
-}
+		if(offset + FRAME_MSG_HEAD_SIZE + pkg.len > end) {
+			parser->stat->rx_len_err++;
+			break;
+		}
 
-fmt_err init_static_package(uint16_t cmd, uint8_t* buffer, PackageStruct* pkg)
-{
-	if(buffer == NULL)
-		return FMT_EINVAL;
+		offset += FRAME_MSG_HEAD_SIZE + pkg.len;
+		parser->stat->rx_msg++;
 
-	/* fill head */
-	_fill_head(pkg);
-
-	/* set length filed */
-	pkg->len = 0;
-	/* set command filed */
-	pkg->cmd = cmd;
-	/* allocate a static memory for content filed */
-	pkg->content = buffer;
-	/* set default value */
-	pkg->alloc = 0;
-
-	if(pkg->len == 0) {
-		/* calculate init checksum */
-		pkg->checksum = _calc_checksum(pkg);
+		if(handler) {
+			handler(&pkg);
+		}
 	}
-
-	/* fill end */
-	_fill_end(pkg);
-
-	return FMT_EOK;
 }
 
-fmt_err write_package(uint8_t* content, uint16_t len, PackageStruct* pkg)
+/* drop the first n bytes taken for a frame and look for the next magic in the
+ * rest, a frame may start inside the bytes of a false magic or a bad frame */
+static void _parser_skip(ParserStruct* parser, uint16_t n)
 {
-	pkg->len = len;
+	uint8_t* magic = NULL;
 
-	/* check if content filed valid */
-	if(pkg->len && pkg->content == NULL) {
-		return FMT_ERROR;
+	if(parser->index > n) {
+		magic = memchr(&parser->buff[n], PROTOCOL_HEAD_MAGIC, parser->index - n);
 	}
 
-	/* copy content */
-	if(pkg->len && content && pkg->content != content) {
-		memcpy(pkg->content, content, pkg->len);
+	if(magic == NULL) {
+		parser->index = 0;
+		parser->state = STATE_MAGIC;
+		return;
 	}
 
-	/* calculate checksum */
-	pkg->checksum = _calc_checksum(pkg);
-
-	return FMT_EOK;
+	parser->index -= magic - parser->buff;
+	memmove(parser->buff, magic, parser->index);
+	parser->state = STATE_HEAD;
 }
 
-void free_package(PackageStruct* pkg)
+/**************************** Public Function ********************************/
+
+void proto_frame_init(FrameStruct* frame)
 {
-	if(pkg->alloc == 1 && pkg->content) {
-		/* free memory if it's allocated before */
-		rt_free(pkg->content);
-		pkg->content = NULL;
-		pkg->alloc = 0;
-	}
+	frame->size = FRAME_HEAD_SIZE;
+	frame->msg_num = 0;
 }
 
-fmt_err make_send_package(const PackageStruct pkg, SendPkgStruct* send_pkg)
+fmt_err proto_frame_append(FrameStruct* frame, uint16_t cmd, const void* data, uint16_t len)
 {
-	/* user should assgin a valid address for send_buff */
-	if(send_pkg->send_buff == NULL) {
+	uint8_t* msg;
+
+	if(len > MAX_PACKAGE_SIZE || (len && data == NULL)) {
 		return FMT_EINVAL;
 	}
 
-	send_pkg->send_buff[0] = pkg.head[0];
-	send_pkg->send_buff[1] = pkg.head[1];
-
-	/* little-endian */
-	*((uint16_t*)&send_pkg->send_buff[2]) = pkg.len;
-	*((uint16_t*)&send_pkg->send_buff[4]) = pkg.cmd;
-
-	if(pkg.len > 0) {
-		memcpy(&send_pkg->send_buff[6], pkg.content, pkg.len);
+	if(frame->size + FRAME_MSG_HEAD_SIZE + len + FRAME_CRC_SIZE > MAX_FRAME_SIZE || frame->msg_num == 0xFF) {
+		return FMT_EFULL;
 	}
 
-	send_pkg->send_buff[6 + pkg.len] = pkg.alloc;
+	msg = &frame->buff[frame->size];
 
-	*((uint16_t*)&send_pkg->send_buff[7 + pkg.len]) = pkg.checksum;
-	send_pkg->send_buff[9 + pkg.len] = pkg.end;
+	_put_uint16(&msg[0], cmd);
+	_put_uint16(&msg[2], len);
+
+	if(len) {
+		memcpy(&msg[FRAME_MSG_HEAD_SIZE], data, len);
+	}
 
-	/* buff_size = content_len + len_except_content */
-	send_pkg->buff_size = pkg.len + 10;
+	frame->size += FRAME_MSG_HEAD_SIZE + len;
+	frame->msg_num++;
 
 	return FMT_EOK;
 }
 
-/* pkg parse states define */
-#define STATE_HEAD_1	        0x00
-#define STATE_HEAD_2	        0x01
-#define STATE_LEN_1	            0x02
-#define STATE_LEN_2	            0x03
-#define STATE_CMD_1	            0x04
-#define STATE_CMD_2	            0x05
-#define STATE_CONTENT	        0x06
-#define STATE_ALLOC             0x07
-#define STATE_CS_1	            0x08
-#define STATE_CS_2	            0x09
-#define STATE_END	            0x0A
-
-fmt_err proto_parse_package(uint8_t c, PackageStruct* pkg)
+uint16_t proto_frame_finalize(FrameStruct* frame, uint8_t seq)
 {
-	fmt_err err = FMT_ERROR;
-	static uint8_t state = STATE_HEAD_1;
-	static uint16_t data_cnt;
+	uint16_t crc;
 
-	switch(state) {
-		case STATE_HEAD_1:
-			if(c == PROTOCOL_HEAD_MAGIC) {
-				pkg->head[0] = c;
+	frame->buff[0] = PROTOCOL_HEAD_MAGIC;
+	frame->buff[1] = PROTOCOL_HEAD_TX;
+	frame->buff[2] = seq;
+	frame->buff[3] = frame->msg_num;
+	_put_uint16(&frame->buff[4], frame->size - FRAME_HEAD_SIZE);
 
-				state = STATE_HEAD_2;
-			}
-
-			/* wait more data */
-			err = FMT_EEMPTY;
-			break;
-
-		case STATE_HEAD_2:
-			if(c == PROTOCOL_HEAD_RX) {
-				pkg->head[1] = c;
-
-				state = STATE_LEN_1;
-			} else {
-				/* wrong data, go back to init state */
-				state = STATE_HEAD_1;
-			}
-
-			err = FMT_EEMPTY;
-			break;
+	/* magic byte is not included */
+	crc = math_crc16(CRC16_INIT, &frame->buff[1], frame->size - 1);
+	_put_uint16(&frame->buff[frame->size], crc);
 
-		case STATE_LEN_1:
-			/* little-endian, so we first receive low byte data */
-			pkg->len = c;
-
-			state = STATE_LEN_2;
-			err = FMT_EEMPTY;
-			break;
-
-		case STATE_LEN_2:
-			/* little-endian, receive high byte data */
-			pkg->len |= c << 8;
-
-			if(pkg->len > MAX_PACKAGE_SIZE) {
-				ulog_w(TAG, "rx pkg size too big:%d", pkg->len);
-				state = STATE_HEAD_1;
-			} else {
-				state = STATE_CMD_1;
-			}
-
-			err = FMT_EEMPTY;
-			break;
+	return frame->size + FRAME_CRC_SIZE;
+}
 
-		case STATE_CMD_1:
-			pkg->cmd = c;
+void proto_parser_init(ParserStruct* parser, LinkStatStruct* stat)
+{
+	parser->state = STATE_MAGIC;
+	parser->index = 0;
+	parser->payload_len = 0;
+	parser->last_seq = 0;
+	parser->seq_valid = 0;
+	parser->stat = stat;
+}
 
-			state = STATE_CMD_2;
-			err = FMT_EEMPTY;
-			break;
+uint16_t proto_parse_buffer(ParserStruct* parser, const uint8_t* data, uint16_t len, pkg_handler_t handler)
+{
+	uint16_t frame_cnt = 0;
+	uint16_t frame_size;
+	uint16_t n;
 
-		case STATE_CMD_2:
-			pkg->cmd |= c << 8;
+	parser->stat->rx_byte += len;
 
-			if(pkg->len) {
-				data_cnt = 0;
-				state = STATE_CONTENT;
-			} else {
-				/* if there is no content, we skip content state */
-				state = STATE_ALLOC;
-			}
+	/* bytes put back by _parser_skip() are parsed again before new data */
+	while(1) {
+		switch(parser->state) {
+			case STATE_MAGIC: {
+				const uint8_t* magic = len ? memchr(data, PROTOCOL_HEAD_MAGIC, len) : NULL;
 
-			err = FMT_EEMPTY;
-			break;
+				if(magic == NULL) {
+					/* no frame start in this chunk */
+					return frame_cnt;
+				}
 
-		case STATE_CONTENT:
-			pkg->content[data_cnt++] = c;
+				len -= magic - data + 1;
+				data = magic + 1;
 
-			if(data_cnt >= pkg->len) {
-				state = STATE_ALLOC;
+				parser->buff[0] = PROTOCOL_HEAD_MAGIC;
+				parser->index = 1;
+				parser->state = STATE_HEAD;
 			}
-
-			err = FMT_EEMPTY;
-			break;
-
-		case STATE_ALLOC:
-			pkg->alloc = c;
-
-			state = STATE_CS_1;
-			err = FMT_EEMPTY;
-			break;
-
-		case STATE_CS_1:
-			pkg->checksum = c;
-
-			state = STATE_CS_2;
-			err = FMT_EEMPTY;
 			break;
 
-		case STATE_CS_2: {
-			uint16_t exp_checksum;
-			pkg->checksum |= c << 8;
-
-			exp_checksum = _calc_checksum(pkg);
-
-			if(exp_checksum != pkg->checksum) {
-				ulog_w(TAG, "msg:%d bad checksum, expect:%x recv:%x", pkg->cmd, exp_checksum, pkg->checksum);
-				state = STATE_HEAD_1;
-			} else {
-				state = STATE_END;
-			}
-
-			err = FMT_EEMPTY;
+			case STATE_HEAD:
+				if(parser->index < FRAME_HEAD_SIZE) {
+					n = FRAME_HEAD_SIZE - parser->index;
+					n = n < len ? n : len;
+					memcpy(&parser->buff[parser->index], data, n);
+					parser->index += n;
+					data += n;
+					len -= n;
+
+					if(parser->index < FRAME_HEAD_SIZE) {
+						return frame_cnt;
+					}
+				}
+
+				parser->payload_len = _get_uint16(&parser->buff[4]);
+
+				if(parser->buff[1] != PROTOCOL_HEAD_RX) {
+					_parser_skip(parser, 1);
+				} else if(parser->payload_len > MAX_FRAME_PAYLOAD_SIZE) {
+					parser->stat->rx_len_err++;
+					_parser_skip(parser, 1);
+				} else {
+					parser->state = STATE_BODY;
+				}
+
+				break;
+
+			case STATE_BODY:
+				frame_size = FRAME_HEAD_SIZE + parser->payload_len + FRAME_CRC_SIZE;
+
+				if(parser->index < frame_size) {
+					n = frame_size - parser->index;
+					n = n < len ? n : len;
+					memcpy(&parser->buff[parser->index], data, n);
+					parser->index += n;
+					data += n;
+					len -= n;
+
+					if(parser->index < frame_size) {
+						return frame_cnt;
+					}
+				}
+
+				if(math_crc16(CRC16_INIT, &parser->buff[1], frame_size - FRAME_CRC_SIZE - 1)
+				        != _get_uint16(&parser->buff[frame_size - FRAME_CRC_SIZE])) {
+					parser->stat->rx_crc_err++;
+					_parser_skip(parser, 1);
+				} else {
+					_handle_frame(parser, handler);
+					frame_cnt++;
+					_parser_skip(parser, frame_size);
+				}
+
+				break;
+
+			default:
+				parser->state = STATE_MAGIC;
+				parser->index = 0;
+				break;
 		}
-		break;
-
-		case STATE_END:
-			if(c == PROTOCOL_END) {
-				pkg->end = c;
-				/* we have received a complate pkg */
-				state = STATE_HEAD_1;
-				err = FMT_EOK;
-			} else {
-				state = STATE_HEAD_1;
-				err = FMT_EEMPTY;
-			}
-
-			break;
 	}
-
-	return err;
 }
-
-// fmt_err handle_rx_package(const PackageStruct* pkg)
-// {
-// 	switch(pkg->cmd) {
-// 		case PROTO_CMD_SYNC: {
-// 			console_printf("receive px4io sync\n");
-// 			//reply_io_sync_package();
-// 		}
-// 		break;
-
-// 		// case ACK_REBOOT: {
-// 		// 	console_printf( "ack reboot\n");
-// 		// }
-// 		// break;
-
-// 		// case CMD_CHANNEL_VAL: {
-// 		// 	uint32_t chan_val[6];
-
-// 		// 	for(int i = 0 ; i < 6 ; i++){
-// 		// 		// chan_val[i] = rc_raw2chanval(((uint32_t*)package.usr_data)[i]);
-// 		// 		chan_val[i] = ((uint32_t*)package.usr_data)[i];
-// 		// 	}
-// 		// 	console_printf("chan val:%d %d %d %d %d %d\n", chan_val[0],chan_val[1],chan_val[2],
-// 		// 	chan_val[3],chan_val[4],chan_val[5]);
-// 		// 	// rc_handle_ppm_signal(chan_val);
-// 		// }
-// 		// break;
-
-// 		// case ACK_CONFIG_CHANNEL: {
-// 		// 	//console_printf( "ack config channel\n");
-// 		// } break;
-
-// 		// case CMD_LIDAR_DIS: {
-// 		// 	// OS_ENTER_CRITICAL;
-// 		// 	// _lidar_dis = *((float*)package.usr_data);
-// 		// 	// _lidar_recv_stamp = systime_now_ms();
-// 		// 	// OS_EXIT_CRITICAL;
-// 		// }
-// 		// break;
-
-// 		// case CMD_DEBUG: {
-// 		// 	char* str = (char*)package.usr_data;
-// 		// 	str[package.len] = '\0';
-// 		// 	console_printf("IO:%s", str);
-// 		// }
-// 		// break;
-
-// 		// case ACK_GET_PWM_CHANNEL: {
-// 		// 	float* pwm_dc = (float*)package.usr_data;
-// 		// 	console_printf("pwm get channel\n");
-
-// 		// 	for(uint8_t i = 0 ; i < MAX_PWM_MAIN_CHAN ; i++) {
-// 		// 		_remote_pwm_duty_cycle[i] = pwm_dc[i];
-// 		// 	}
-
-// 		// 	//rt_sem_release(_sem_pwm_chan_recv);
-// 		// }
-// 		// break;
-
-// 		// case ACK_CONFIG_PWM_CHANNEL: {
-// 		// 	//TODO
-// 		// } break;
-
-// 		// default :
-// 		// 	console_printf( "unknow package:%d\n", package.cmd);
-// 	}
-
-//     return FMT_EOK;
-// }
@@ -0,0 +1,227 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <firmament.h>
+#include <string.h>
+
+#include "module/fs_manager/fs_manager.h"
+#include "module/ftp/ftp_log.h"
+#include "module/math/ap_math.h"
+#include "module/utils/lz.h"
+#include "task/task_logger.h"
+
+#define MAX_PATH_LEN            100
+#define MAX_BUS_NAME_LEN        32
+
+static uint16_t _lz_hash_table[LZ_HASH_SIZE];
+
+static void _session_summary(const char* path, uint32_t* total_size, uint32_t* file_num)
+{
+	char file_name[MAX_PATH_LEN];
+	struct dirent* de;
+	struct stat sta;
+	DIR* dir;
+
+	*total_size = 0;
+	*file_num = 0;
+
+	dir = opendir(path);
+
+	if(dir == NULL) {
+		return;
+	}
+
+	while((de = readdir(dir)) != NULL) {
+		if(de->d_type == FT_DIRECTORY) {
+			continue;
+		}
+
+		snprintf(file_name, sizeof(file_name), "%s/%s", path, de->d_name);
+
+		if(stat(file_name, &sta) == 0) {
+			*total_size += sta.st_size;
+			(*file_num)++;
+		}
+	}
+
+	closedir(dir);
+}
+
+/* append "<entry>\0" to payload, return 0 if it doesn't fit */
+static uint8_t _append_entry(FTP_Msg_Payload* payload, uint16_t* size, const char* entry)
+{
+	uint16_t len = strlen(entry);
+
+	if(*size + len + 1 > MAX_FTP_DATA_LEN) {
+		return 0;
+	}
+
+	memcpy(&payload->data[*size], entry, len + 1);
+	*size += len + 1;
+
+	return 1;
+}
+
+uint8_t ftp_log_list_sessions(FTP_Msg_Payload* payload)
+{
+	char path[MAX_PATH_LEN];
+	char entry[MAX_FTP_DATA_LEN];
+	uint32_t total_size, file_num;
+	uint32_t index = 0;
+	uint16_t size = 0;
+	struct dirent* de;
+	DIR* dir;
+
+	dir = opendir(LOG_SESSION_FOLDER);
+
+	if(dir == NULL) {
+		return kErrEOF;
+	}
+
+	while((de = readdir(dir)) != NULL) {
+		if(de->d_type != FT_DIRECTORY || strncmp(de->d_name, "session_", 8) != 0) {
+			continue;
+		}
+
+		if(index++ < payload->offset) {
+			continue;
+		}
+
+		snprintf(path, sizeof(path), "%s/%s", LOG_SESSION_FOLDER, de->d_name);
+		_session_summary(path, &total_size, &file_num);
+
+		snprintf(entry, sizeof(entry), "%s\t%u\t%u", de->d_name, (unsigned)total_size, (unsigned)file_num);
+
+		if(!_append_entry(payload, &size, entry)) {
+			/* client continues from the entries it got */
+			break;
+		}
+	}
+
+	closedir(dir);
+
+	payload->size = size;
+
+	return size ? kErrNone : kErrEOF;
+}
+
+uint8_t ftp_log_list_bus(FTP_Msg_Payload* payload)
+{
+	char path[MAX_PATH_LEN];
+	char entry[MAX_FTP_DATA_LEN];
+	char name[MAX_BUS_NAME_LEN + 1];
+	uint16_t version, max_name_len, max_desc_len;
+	uint8_t num_bus, msg_id, num_elem;
+	uint16_t size = 0;
+	uint8_t err = kErrNone;
+	int fd;
+
+	if(payload->size == 0 || payload->size >= MAX_PATH_LEN) {
+		return kErrInvalidDataSize;
+	}
+
+	memcpy(path, payload->data, payload->size);
+	path[payload->size] = '\0';
+
+	fd = open(path, O_RDONLY);
+
+	if(fd < 0) {
+		return kErrFail;
+	}
+
+	/* version, timestamp, max_name_len, max_desc_len, description, num_bus */
+	if(read(fd, &version, 2) != 2 || lseek(fd, 4, SEEK_CUR) < 0 || read(fd, &max_name_len, 2) != 2
+	        || read(fd, &max_desc_len, 2) != 2 || lseek(fd, max_desc_len, SEEK_CUR) < 0
+	        || read(fd, &num_bus, 1) != 1 || max_name_len > MAX_BUS_NAME_LEN) {
+		close(fd);
+		return kErrFail;
+	}
+
+	for(uint16_t n = 0; n < num_bus; n++) {
+		memset(name, 0, sizeof(name));
+
+		if(read(fd, name, max_name_len) != max_name_len || read(fd, &msg_id, 1) != 1 || read(fd, &num_elem, 1) != 1) {
+			err = kErrFail;
+			break;
+		}
+
+		/* skip element list, each is name, type(2) and number(2) */
+		if(lseek(fd, (max_name_len + 4) * num_elem, SEEK_CUR) < 0) {
+			err = kErrFail;
+			break;
+		}
+
+		if(n < payload->offset) {
+			continue;
+		}
+
+		snprintf(entry, sizeof(entry), "%u\t%s\t%u", msg_id, name, num_elem);
+
+		if(!_append_entry(payload, &size, entry)) {
+			break;
+		}
+	}
+
+	close(fd);
+
+	payload->size = size;
+
+	if(err != kErrNone) {
+		return err;
+	}
+
+	return size ? kErrNone : kErrEOF;
+}
+
+/**
+ * Fill payload data with one chunk, compressed if it helps.
+ *
+ * @param raw file data starting at payload offset
+ * @param chunk_raw_len number of file bytes packed in the chunk
+ */
+uint8_t ftp_log_pack_chunk(const uint8_t* raw, uint32_t raw_len, FTP_Msg_Payload* payload, uint32_t* chunk_raw_len)
+{
+	FTP_Log_Chunk_Header header;
+	uint8_t* out = (uint8_t*)&payload->data[sizeof(header)];
+	uint32_t cap = MAX_FTP_DATA_LEN - sizeof(header);
+	uint32_t out_len, consumed;
+
+	if(raw_len == 0) {
+		return kErrEOF;
+	}
+
+	out_len = lz_compress(raw, raw_len, out, cap, &consumed, _lz_hash_table);
+
+	if(consumed > cap) {
+		header.method = kLogChunkLz;
+		header.raw_len = consumed;
+	} else {
+		/* not compressible, raw carries more */
+		out_len = raw_len < cap ? raw_len : cap;
+		memcpy(out, raw, out_len);
+
+		header.method = kLogChunkRaw;
+		header.raw_len = out_len;
+	}
+
+	header.crc32 = math_crc32(0, raw, header.raw_len);
+
+	memcpy(payload->data, &header, sizeof(header));
+	payload->size = sizeof(header) + out_len;
+	*chunk_raw_len = header.raw_len;
+
+	return kErrNone;
+}
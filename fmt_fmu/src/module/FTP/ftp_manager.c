@@ -19,6 +19,7 @@
 #include "task/task_comm.h"
 #include "module/fs_manager/fs_manager.h"
 #include "module/ftp/ftp_manager.h"
+#include "module/ftp/ftp_log.h"
 #include "module/mavproxy/mavcmd.h"
 
 #define TAG         "MAV_FTP"
@@ -38,14 +39,122 @@ static const char   kDirentDir = 'D';   ///< Identifies Directory returned from
 static const char   kDirentSkip = 'S';  ///< Identifies Skipped entry from List command
 
 static uint8_t _errno;
-// static FIL _fp;
-static int _fd = -1;
-static StreamSession _stream_session = {
-	.fd = -1,
-};
+static StreamSession _sessions[FTP_MAX_SESSION_NUM];
+/* requests come from mavproxy monitor thread while bursts are sent by mavproxy thread */
+static struct rt_mutex _ftp_lock;
+/* file data of the chunk being packed, only used under _ftp_lock */
+static uint8_t _log_raw_buf[FTP_LOG_CHUNK_RAW_MAX];
 
 /**************************** Local Function ********************************/
 
+static StreamSession* _get_session(uint8_t session)
+{
+	if(session >= FTP_MAX_SESSION_NUM || _sessions[session].fd < 0) {
+		return NULL;
+	}
+
+	return &_sessions[session];
+}
+
+static void _close_session(StreamSession* stream_session)
+{
+	if(stream_session->fd >= 0) {
+		close(stream_session->fd);
+	}
+
+	if(stream_session->ra_buf) {
+		rt_free(stream_session->ra_buf);
+	}
+
+	stream_session->fd = -1;
+	stream_session->ra_buf = NULL;
+	stream_session->file_size = 0;
+	stream_session->streaming = 0;
+	stream_session->compress = 0;
+}
+
+/* a session can be taken over once its client went silent, otherwise a lost
+ * connection would hold the session forever. a complete burst is not enough,
+ * the client re-requests its lost chunks after the burst on the same session */
+static uint8_t _session_reclaimable(StreamSession* stream_session)
+{
+	return !stream_session->streaming
+	       && systime_now_ms() - stream_session->last_active_ms > FTP_SESSION_TIMEOUT_MS;
+}
+
+/* read from file at offset, served from read-ahead buffer if possible. file is
+ * only seeked if requested offset is not where the last read stopped */
+static int _session_read(StreamSession* stream_session, uint32_t offset, uint8_t* buffer, uint32_t len)
+{
+	uint32_t cnt = 0;
+	uint32_t n;
+	int br;
+
+	while(cnt < len) {
+		if(offset < stream_session->ra_offset || offset >= stream_session->ra_offset + stream_session->ra_len) {
+			/* refill read-ahead buffer */
+			if(offset != stream_session->file_pos) {
+				if(lseek(stream_session->fd, offset, SEEK_SET) != offset) {
+					_errno = rt_get_errno();
+					return -1;
+				}
+
+				stream_session->file_pos = offset;
+				stream_session->stat.seeks++;
+			}
+
+			br = read(stream_session->fd, stream_session->ra_buf, FTP_READ_AHEAD_SIZE);
+			stream_session->stat.reads++;
+
+			if(br < 0) {
+				_errno = rt_get_errno();
+				stream_session->ra_len = 0;
+				return -1;
+			}
+
+			stream_session->file_pos += br;
+			stream_session->ra_offset = offset;
+			stream_session->ra_len = br;
+
+			if(br == 0) {
+				/* end of file */
+				break;
+			}
+		}
+
+		n = stream_session->ra_offset + stream_session->ra_len - offset;
+		n = n < len - cnt ? n : len - cnt;
+
+		memcpy(&buffer[cnt], &stream_session->ra_buf[offset - stream_session->ra_offset], n);
+		cnt += n;
+		offset += n;
+	}
+
+	return cnt;
+}
+
+/* pack file data at offset into one log chunk */
+static uint8_t _session_read_chunk(StreamSession* stream_session, FTP_Msg_Payload* payload, uint32_t* raw_len)
+{
+	uint32_t len_to_read;
+	int br;
+
+	if(payload->offset >= stream_session->file_size) {
+		return kErrEOF;
+	}
+
+	len_to_read = stream_session->file_size - payload->offset;
+	len_to_read = len_to_read > FTP_LOG_CHUNK_RAW_MAX ? FTP_LOG_CHUNK_RAW_MAX : len_to_read;
+
+	br = _session_read(stream_session, payload->offset, _log_raw_buf, len_to_read);
+
+	if(br < 0) {
+		return kErrFailErrno;
+	}
+
+	return ftp_log_pack_chunk(_log_raw_buf, br, payload, raw_len);
+}
+
 static uint8_t _request_list(FTP_Msg_Payload* payload)
 {
 	char dir_buffer[MAX_DIR_PATH_LEN + 1] = {0};
@@ -165,16 +274,31 @@ static uint8_t _request_open(FTP_Msg_Payload* payload, int oflag)
 {
 	char file_name[MAX_DIR_PATH_LEN + 1];
 	struct stat fno;
+	StreamSession* stream_session = NULL;
+	uint8_t session;
+	int fd;
 
 	DBG("open file:%s, oflag:%x", payload->data, oflag);
 
-	if(_stream_session.fd >= 0 && _stream_session.complete) {
-		close(_stream_session.fd);
-		_stream_session.fd = -1;
-		_stream_session.file_size = 0;
+	/* find a free session, an abandoned session can be reused */
+	for(session = 0; session < FTP_MAX_SESSION_NUM; session++) {
+		if(_sessions[session].fd < 0) {
+			stream_session = &_sessions[session];
+			break;
+		}
+	}
+
+	if(stream_session == NULL) {
+		for(session = 0; session < FTP_MAX_SESSION_NUM; session++) {
+			if(_sessions[session].fd >= 0 && _session_reclaimable(&_sessions[session])) {
+				stream_session = &_sessions[session];
+				_close_session(stream_session);
+				break;
+			}
+		}
 	}
 
-	if(_stream_session.fd >= 0) {
+	if(stream_session == NULL) {
 		DBG("no available session\n");
 		return kErrNoSessionsAvailable;
 	}
@@ -182,86 +306,106 @@ static uint8_t _request_open(FTP_Msg_Payload* payload, int oflag)
 	strncpy(file_name, payload->data, payload->size);
 	file_name[payload->size] = '\0';
 
-	if(stat(file_name, &fno) < 0 && !(oflag & O_CREAT)) {
-		DBG("no file existed\n");
-		_errno = rt_get_errno();
-		return kErrFailErrno;
+	if(stat(file_name, &fno) < 0) {
+		if(!(oflag & O_CREAT)) {
+			DBG("no file existed\n");
+			_errno = rt_get_errno();
+			return kErrFailErrno;
+		}
+
+		fno.st_size = 0;
 	}
 
-	_fd = open(file_name, oflag);
+	if(oflag == O_RDONLY) {
+		stream_session->ra_buf = (uint8_t*)rt_malloc(FTP_READ_AHEAD_SIZE);
 
-	if(_fd < 0) {
+		if(stream_session->ra_buf == NULL) {
+			DBG("no memory for read-ahead buffer");
+			return kErrFail;
+		}
+	}
+
+	fd = open(file_name, oflag);
+
+	if(fd < 0) {
 		_errno = rt_get_errno();
 		DBG("open fail:%d", _errno);
+		_close_session(stream_session);
 		return kErrFailErrno;
 	}
 
-	payload->session = 0;
+	payload->session = session;
 	payload->size = sizeof(uint32_t);
 	memcpy(payload->data, &fno.st_size, payload->size);
 
+	stream_session->fd = fd;
+	stream_session->file_size = fno.st_size;
+	stream_session->file_pos = 0;
+	stream_session->ra_offset = 0;
+	stream_session->ra_len = 0;
+	stream_session->streaming = 0;
+	stream_session->complete = 0;
+	stream_session->compress = 0;
+	stream_session->last_active_ms = systime_now_ms();
+	memset(&stream_session->stat, 0, sizeof(StreamStat));
 
-	_stream_session.fd = _fd;
-	_stream_session.file_size = fno.st_size;
-
-	DBG("open success, fd:%d", _stream_session.fd);
+	DBG("open success, session:%d fd:%d", session, fd);
 
 	return kErrNone;
 }
 
-static uint8_t _request_burst(FTP_Msg_Payload* payload, uint8_t target_system, uint8_t target_component)
+static uint8_t _request_burst(FTP_Msg_Payload* payload, uint8_t target_system, uint8_t target_component, uint8_t compress)
 {
-	if(payload->session != 0 || _stream_session.fd < 0) {
-		DBG("no valid session:%d fd:%d\n", payload->session, _stream_session.fd);
+	StreamSession* stream_session = _get_session(payload->session);
+
+	if(stream_session == NULL || stream_session->ra_buf == NULL) {
+		DBG("no valid session:%d\n", payload->session);
 		return kErrInvalidSession;
 	}
 
-	_stream_session.stream_seq_number = payload->seq_number + 1;
-	_stream_session.stream_offset = payload->offset;
-	_stream_session.stream_target_system_id = target_system;
-	_stream_session.stream_target_component_id = target_component;
-	_stream_session.complete = 0;
+	stream_session->stream_seq_number = payload->seq_number + 1;
+	stream_session->stream_offset = payload->offset;
+	stream_session->stream_target_system_id = target_system;
+	stream_session->stream_target_component_id = target_component;
+	stream_session->complete = 0;
+	stream_session->compress = compress;
+	stream_session->streaming = 1;
+	stream_session->stat.start_ms = systime_now_ms();
 
-	mavcmd_set(MAVCMD_STREAM_SESSION, &_stream_session);
+	mavcmd_set(MAVCMD_STREAM_SESSION, NULL);
 
-	DBG("burst read, session seq:%d offset:%d sys_id:%d comp_id:%d", _stream_session.stream_seq_number,
-	    _stream_session.stream_offset, _stream_session.stream_target_system_id, _stream_session.stream_target_component_id);
+	DBG("burst read, session:%d seq:%d offset:%d sys_id:%d comp_id:%d", payload->session, stream_session->stream_seq_number,
+	    stream_session->stream_offset, stream_session->stream_target_system_id, stream_session->stream_target_component_id);
 
 	return kErrNone;
 }
 
 static uint8_t _request_read(FTP_Msg_Payload* payload)
 {
-	// FRESULT fres;
-	// UINT br;
+	StreamSession* stream_session = _get_session(payload->session);
+	uint32_t len_to_read;
 	int br;
 
-	DBG("read %s, offset:%d fd:%d", payload->data, payload->offset, _stream_session.fd);
+	DBG("read session:%d, offset:%d", payload->session, payload->offset);
 
-	if(payload->session != 0 || _stream_session.fd < 0) {
-		DBG("no valid session:%d fd:%d", payload->session, _stream_session.fd);
+	if(stream_session == NULL || stream_session->ra_buf == NULL) {
+		DBG("no valid session:%d", payload->session);
 		return kErrInvalidSession;
 	}
 
-	if(payload->offset >= _stream_session.file_size) {
+	if(payload->offset >= stream_session->file_size) {
 		/* request past EOF */
-		DBG("request past EOF offset:%d file size:%d", payload->offset, _stream_session.file_size);
+		DBG("request past EOF offset:%d file size:%d", payload->offset, stream_session->file_size);
 		return kErrEOF;
 	}
 
-	// fres = f_lseek(_stream_session.fd, payload->offset);
-	off_t off = lseek(_stream_session.fd, payload->offset, SEEK_SET);
-
-	if(off != payload->offset) {
-		_errno = rt_get_errno();
-		return kErrFailErrno;
-	}
+	/* the last block can be shorter */
+	len_to_read = stream_session->file_size - payload->offset;
+	len_to_read = len_to_read > MAX_FTP_DATA_LEN ? MAX_FTP_DATA_LEN : len_to_read;
 
-	// fres = f_read(_stream_session.fd, payload->data, MAX_FTP_DATA_LEN, &br);
-	br = read(_stream_session.fd, payload->data, MAX_FTP_DATA_LEN);
+	br = _session_read(stream_session, payload->offset, (uint8_t*)payload->data, len_to_read);
 
-	if(br != MAX_FTP_DATA_LEN) {
-		_errno = rt_get_errno();
+	if(br < 0) {
 		return kErrFailErrno;
 	}
 
@@ -275,38 +419,49 @@ static uint8_t _request_read(FTP_Msg_Payload* payload)
 	return kErrNone;
 }
 
-static uint8_t _request_write(FTP_Msg_Payload* payload)
+static uint8_t _request_read_chunk(FTP_Msg_Payload* payload)
 {
-	// FRESULT fres;
-	// UINT bw;
-	int bw;
+	StreamSession* stream_session = _get_session(payload->session);
+	uint32_t raw_len;
 
-	if(payload->session != 0 && _stream_session.fd < 0) {
+	if(stream_session == NULL || stream_session->ra_buf == NULL) {
 		return kErrInvalidSession;
 	}
 
-	// fres = f_lseek(_stream_session.fd, payload->offset);
-	off_t off = lseek(_stream_session.fd, payload->offset, SEEK_SET);
+	return _session_read_chunk(stream_session, payload, &raw_len);
+}
 
-	if(off != payload->offset) {
-		_errno = rt_get_errno();
-		return kErrFailErrno;
+static uint8_t _request_write(FTP_Msg_Payload* payload)
+{
+	StreamSession* stream_session = _get_session(payload->session);
+	int bw;
+
+	if(stream_session == NULL) {
+		return kErrInvalidSession;
 	}
 
-	// if(fres != FR_OK) {
-	// 	_errno = fres;
-	// 	return kErrFailErrno;
-	// }
+	if(payload->offset != stream_session->file_pos) {
+		off_t off = lseek(stream_session->fd, payload->offset, SEEK_SET);
+
+		if(off != payload->offset) {
+			_errno = rt_get_errno();
+			return kErrFailErrno;
+		}
 
+		stream_session->file_pos = off;
+	}
 
-	// fres = f_write(_stream_session.fd, payload->data, payload->size, &bw);
-	bw = write(_stream_session.fd, payload->data, payload->size);
+	bw = write(stream_session->fd, payload->data, payload->size);
 
 	if(bw != payload->size) {
 		_errno = rt_get_errno();
 		return kErrFailErrno;
 	}
 
+	stream_session->file_pos += bw;
+	/* data in read-ahead buffer may be stale now */
+	stream_session->ra_len = 0;
+
 	payload->size = sizeof(uint32_t);
 	memcpy(payload->data, &bw, payload->size);
 
@@ -315,16 +470,13 @@ static uint8_t _request_write(FTP_Msg_Payload* payload)
 
 static uint8_t _request_terminate(FTP_Msg_Payload* payload)
 {
-	if(payload->session != 0 || _stream_session.fd < 0) {
+	StreamSession* stream_session = _get_session(payload->session);
+
+	if(stream_session == NULL) {
 		return kErrInvalidSession;
 	}
 
-	// f_close(_stream_session.fd);
-	close(_stream_session.fd);
-	_stream_session.fd = -1;
-	_stream_session.file_size = 0;
-
-	mavcmd_clear(MAVCMD_STREAM_SESSION);
+	_close_session(stream_session);
 
 	payload->size = 0;
 
@@ -333,14 +485,8 @@ static uint8_t _request_terminate(FTP_Msg_Payload* payload)
 
 static uint8_t _request_reset(FTP_Msg_Payload* payload)
 {
-
-	if(_stream_session.fd) {
-		// f_close(_stream_session.fd);
-		close(_stream_session.fd);
-		_stream_session.fd = -1;
-		_stream_session.file_size = 0;
-
-		mavcmd_clear(MAVCMD_STREAM_SESSION);
+	for(uint8_t i = 0; i < FTP_MAX_SESSION_NUM; i++) {
+		_close_session(&_sessions[i]);
 	}
 
 	payload->size = 0;
@@ -348,15 +494,148 @@ static uint8_t _request_reset(FTP_Msg_Payload* payload)
 	return kErrNone;
 }
 
+/* send one burst packet, return 0 if packet can not be sent */
+static uint8_t _stream_send(StreamSession* stream_session, uint8_t session)
+{
+	mavlink_file_transfer_protocol_t ftp_protocol_t;
+	FTP_Msg_Payload* ftp_msg_t = (FTP_Msg_Payload*)ftp_protocol_t.payload;
+	mavlink_message_t msg;
+	uint8_t err_code = kErrNone;
+	uint8_t err_no = 0;
+	mavlink_system_t system;
+	uint32_t len_to_read;
+	uint32_t raw_len;
+	int br;
+
+	DBG("send stream, session:%d seq:%d offset:%d", session, stream_session->stream_seq_number,
+	    stream_session->stream_offset);
+
+	ftp_msg_t->seq_number = stream_session->stream_seq_number;
+	ftp_msg_t->offset = stream_session->stream_offset;
+	ftp_msg_t->session = session;
+	ftp_msg_t->burst_complete = 0;
+	ftp_msg_t->opcode = kRspAck;
+	ftp_msg_t->req_opcode = stream_session->compress ? kCmdLogBurstChunk : kCmdBurstReadFile;
+	ftp_msg_t->size = 0;
+
+	if(ftp_msg_t->offset >= stream_session->file_size) {
+		err_code = kErrEOF;
+		goto Out;
+	}
+
+	if(stream_session->compress) {
+		err_code = _session_read_chunk(stream_session, ftp_msg_t, &raw_len);
+		err_no = _errno;
+
+		if(err_code == kErrNone && ftp_msg_t->offset + raw_len >= stream_session->file_size) {
+			ftp_msg_t->burst_complete = 1;
+		}
+
+		goto Out;
+	}
+
+	len_to_read = stream_session->file_size - ftp_msg_t->offset;
+	len_to_read = len_to_read > MAX_FTP_DATA_LEN ? MAX_FTP_DATA_LEN : len_to_read;
+	br = _session_read(stream_session, ftp_msg_t->offset, (uint8_t*)ftp_msg_t->data, len_to_read);
+
+	if(br <= 0) {
+		err_code = br < 0 ? kErrFailErrno : kErrEOF;
+		err_no = _errno;
+
+		DBG("read fail:%d, len:%d br:%d", err_no, len_to_read, br);
+		goto Out;
+	}
+
+	ftp_msg_t->size = br;
+	raw_len = br;
+
+	if(ftp_msg_t->offset + br >= stream_session->file_size) {
+		ftp_msg_t->burst_complete = 1;
+	}
+
+Out:
+
+	if(err_code != kErrNone) {
+		ftp_msg_t->opcode = kRspNak;
+		ftp_msg_t->size = 1;
+		ftp_msg_t->data[0] = err_code;
+
+		DBG("err code:%d", ftp_msg_t->data[0]);
+
+		if(err_code == kErrFailErrno) {
+			ftp_msg_t->size = 2;
+			ftp_msg_t->data[1] = err_no;
+		}
+	}
+
+	ftp_protocol_t.target_system = stream_session->stream_target_system_id;
+	ftp_protocol_t.target_component = stream_session->stream_target_component_id;
+	ftp_protocol_t.target_network = 0;
+
+	system = mavproxy_get_system();
+
+	mavlink_msg_file_transfer_protocol_encode(system.sysid, system.compid, &msg, &ftp_protocol_t);
+
+	if(!mavproxy_send_immediate_msg(&msg, 1)) {
+		/* link is down, try the same packet next time */
+		stream_session->stat.send_fail++;
+		return 0;
+	}
+
+	stream_session->stream_seq_number++;
+	stream_session->last_active_ms = systime_now_ms();
+
+	if(err_code == kErrNone) {
+		stream_session->stream_offset += raw_len;
+		stream_session->stat.bytes += raw_len;
+		stream_session->stat.wire_bytes += ftp_msg_t->size;
+		stream_session->stat.chunks++;
+	}
+
+	if(err_code != kErrNone || ftp_msg_t->burst_complete) {
+		/* burst session finished */
+		stream_session->streaming = 0;
+		stream_session->complete = 1;
+		stream_session->stat.time_ms = systime_now_ms() - stream_session->stat.start_ms;
+
+		DBG("stream session complete");
+	}
+
+	return 1;
+}
+
 /**************************** Public Function ********************************/
 
+fmt_err ftp_manager_init(void)
+{
+	for(uint8_t i = 0; i < FTP_MAX_SESSION_NUM; i++) {
+		_sessions[i].fd = -1;
+		_sessions[i].ra_buf = NULL;
+	}
+
+	if(rt_mutex_init(&_ftp_lock, "ftp_lock", RT_IPC_FLAG_FIFO) != RT_EOK) {
+		return FMT_ERROR;
+	}
+
+	return FMT_EOK;
+}
+
 fmt_err ftp_process_request(uint8_t* payload, uint8_t target_system, uint8_t target_component)
 {
 	uint8_t err_code;
 	FTP_Msg_Payload* ftp_payload = (FTP_Msg_Payload*)payload;
+	StreamSession* stream_session;
 
 	DBG("session:%d opcode:%d seq:%d size:%d", ftp_payload->session, ftp_payload->opcode, ftp_payload->seq_number, ftp_payload->size);
 
+	rt_mutex_take(&_ftp_lock, RT_WAITING_FOREVER);
+
+	stream_session = _get_session(ftp_payload->session);
+
+	if(stream_session) {
+		stream_session->last_active_ms = systime_now_ms();
+	}
+
 	switch(ftp_payload->opcode) {
 		case kCmdTerminateSession: {
 			err_code = _request_terminate(ftp_payload);
@@ -393,10 +672,16 @@ fmt_err ftp_process_request(uint8_t* payload, uint8_t target_system, uint8_t tar
 		}
 		break;
 
-		case kCmdBurstReadFile: {
-			err_code = _request_burst(ftp_payload, target_system, target_component);
-			/* do not need send ack here */
-			return FMT_ENOTHANDLE;
+		case kCmdBurstReadFile:
+		case kCmdLogBurstChunk: {
+			err_code = _request_burst(ftp_payload, target_system, target_component,
+			                          ftp_payload->opcode == kCmdLogBurstChunk);
+
+			if(err_code == kErrNone) {
+				/* do not need send ack here, burst packets are the response */
+				rt_mutex_release(&_ftp_lock);
+				return FMT_ENOTHANDLE;
+			}
 		}
 		break;
 
@@ -405,12 +690,30 @@ fmt_err ftp_process_request(uint8_t* payload, uint8_t target_system, uint8_t tar
 		}
 		break;
 
+		case kCmdLogListSessions: {
+			err_code = ftp_log_list_sessions(ftp_payload);
+		}
+		break;
+
+		case kCmdLogListBus: {
+			err_code = ftp_log_list_bus(ftp_payload);
+		}
+		break;
+
+		case kCmdLogReadChunk: {
+			err_code = _request_read_chunk(ftp_payload);
+		}
+		break;
+
 		default: {
+			rt_mutex_release(&_ftp_lock);
 			console_printf("ftp unknow opcode:%d\n", ftp_payload->opcode);
 			return FMT_ENOTHANDLE;
 		}
 	}
 
+	rt_mutex_release(&_ftp_lock);
+
 	ftp_payload->seq_number++;
 
 	if(err_code == kErrNone) {
@@ -431,119 +734,47 @@ fmt_err ftp_process_request(uint8_t* payload, uint8_t target_system, uint8_t tar
 	return FMT_EOK;
 }
 
-fmt_err ftp_stream_send(StreamSession* stream_session)
+/* called by mavproxy thread. burst packets of all sessions are sent back to
+ * back until the time slice runs out, so the link is kept busy if it is fast
+ * and the thread is released after one packet if it is slow */
+fmt_err ftp_stream_process(void)
 {
-	mavlink_file_transfer_protocol_t ftp_protocol_t;
-	FTP_Msg_Payload* ftp_msg_t = (FTP_Msg_Payload*)ftp_protocol_t.payload;
-	mavlink_message_t msg;
-	// FRESULT fres;
-	// UINT br;
-	uint8_t err_code = kCmdNone;
-	uint8_t err_no;
-	mavlink_system_t system;
-	int br;
-
-	DBG("send stream, seq:%d offset:%d fd:%d", stream_session->stream_seq_number,
-	    stream_session->stream_offset, stream_session->fd);
+	uint32_t start = systime_now_ms();
+	uint8_t active;
+	uint8_t sent;
 
-	if(stream_session->fd < 0) {
-		DBG("no valid session");
-		return FMT_ERROR;
-	}
+	rt_mutex_take(&_ftp_lock, RT_WAITING_FOREVER);
 
-	ftp_msg_t->seq_number = stream_session->stream_seq_number;
-	ftp_msg_t->offset = stream_session->stream_offset;
-	ftp_msg_t->session = 0;
-	ftp_msg_t->burst_complete = 0;
-	ftp_msg_t->opcode = kRspAck;
-	ftp_msg_t->req_opcode = kCmdBurstReadFile;
+	do {
+		active = 0;
+		sent = 0;
 
-	stream_session->stream_seq_number++;
+		for(uint8_t i = 0; i < FTP_MAX_SESSION_NUM; i++) {
+			if(_sessions[i].fd >= 0 && _sessions[i].streaming) {
+				sent |= _stream_send(&_sessions[i], i);
+				active |= _sessions[i].streaming;
+			}
+		}
+	} while(active && sent && systime_now_ms() - start < FTP_BURST_SLICE_MS);
 
-	if(ftp_msg_t->offset >= stream_session->file_size) {
-		/* stream session complete */
+	if(!active) {
 		mavcmd_clear(MAVCMD_STREAM_SESSION);
-
-		stream_session->complete = 1;
-
-		err_code = kErrEOF;
-
-		DBG("stream session complete");
-		goto Out;
-	}
-
-	// fres = f_lseek(stream_session->fd, ftp_msg_t->offset);
-	// if(fres != FR_OK) {
-	// 	err_code = kErrFailErrno;
-	// 	err_no = fres;
-	// 	goto Out;
-	// }
-
-	off_t off = lseek(stream_session->fd, ftp_msg_t->offset, SEEK_SET);
-
-	if(off != ftp_msg_t->offset) {
-		err_no = rt_get_errno();
-		err_code = kErrFailErrno;
-
-		DBG("seek fail:%d, offset:%d cur_offset:%d", err_no, ftp_msg_t->offset, off);
-		goto Out;
-	}
-
-	// fres = f_read(stream_session->fd, ftp_msg_t->data, MAX_FTP_DATA_LEN, &br);
-	size_t len_to_read = stream_session->file_size - ftp_msg_t->offset;
-	len_to_read = len_to_read > MAX_FTP_DATA_LEN ? MAX_FTP_DATA_LEN : len_to_read;
-	br = read(stream_session->fd, ftp_msg_t->data, len_to_read);
-
-	// if(fres != FR_OK) {
-	// 	err_code = kErrFailErrno;
-	// 	err_no = fres;
-	// 	goto Out;
-	// }
-
-	if(br != len_to_read) {
-		err_code = kErrFailErrno;
-		err_no = rt_get_errno();
-
-		DBG("read fail:%d, len:%d br:%d", err_no, len_to_read, br);
-		goto Out;
 	}
 
-	ftp_msg_t->size = br;
-
-Out:
-
-	if(err_code == kErrNone) {
-		ftp_msg_t->opcode = kRspAck;
-		stream_session->stream_offset += ftp_msg_t->size;
-
-		if(stream_session->stream_offset >= stream_session->file_size) {
-			ftp_msg_t->burst_complete = 1;
-		}
+	rt_mutex_release(&_ftp_lock);
 
-		DBG("RspAck, size:%d offset:%d complete:%d", ftp_msg_t->size, stream_session->stream_offset, ftp_msg_t->burst_complete);
-	} else {
-		ftp_msg_t->opcode = kRspNak;
-		ftp_msg_t->size = 1;
-		ftp_msg_t->data[0] = err_code;
-
-		DBG("err code:%d", ftp_msg_t->data[0]);
-
-		if(err_code == kErrFailErrno) {
-			ftp_msg_t->size = 2;
-			ftp_msg_t->data[1] = err_no;
+	return FMT_EOK;
+}
 
-			DBG("err no:%d", ftp_msg_t->data[1]);
-		}
+fmt_err ftp_get_session(uint8_t session, StreamSession* stream_session)
+{
+	if(session >= FTP_MAX_SESSION_NUM) {
+		return FMT_EINVAL;
 	}
 
-	ftp_protocol_t.target_system = _stream_session.stream_target_system_id;
-	ftp_protocol_t.target_component = _stream_session.stream_target_component_id;
-	ftp_protocol_t.target_network = 0;
-
-	system = mavproxy_get_system();
-
-	mavlink_msg_file_transfer_protocol_encode(system.sysid, system.compid, &msg, &ftp_protocol_t);
-	mavproxy_send_immediate_msg(&msg, 1);
+	rt_mutex_take(&_ftp_lock, RT_WAITING_FOREVER);
+	*stream_session = _sessions[session];
+	rt_mutex_release(&_ftp_lock);
 
 	return FMT_EOK;
 }
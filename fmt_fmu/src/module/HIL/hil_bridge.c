@@ -0,0 +1,335 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <Controller.h>
+#include <firmament.h>
+#include <string.h>
+
+#include "module/hil/hil_bridge.h"
+#include "module/hil/hil_frame.h"
+#include "module/sensor/sensor_manager.h"
+
+#ifdef FMT_USING_HIL_BRIDGE
+
+#ifndef FMT_USING_HIL
+	#error "hil bridge takes the place of sensors, it needs FMT_USING_HIL"
+#endif
+
+#ifdef FMT_USING_SIH
+	#error "hil bridge replaces the sih plant, do not use both"
+#endif
+
+#define TAG "HIL"
+
+/* leave lockstep if the simulator is silent for this long, ms */
+#define HIL_LOCKSTEP_TIMEOUT		500
+
+MCN_DECLARE(sensor_imu);
+MCN_DECLARE(sensor_mag);
+MCN_DECLARE(sensor_baro);
+MCN_DECLARE(sensor_gps);
+MCN_DECLARE(control_output);
+
+static char _hil_thread_stack[2048];
+static struct rt_thread _hil_thread;
+static struct rt_semaphore _rx_sem;
+static rt_device_t _hil_dev;
+static hil_parser_t _parser;
+
+static void (*_step)(void);
+static hil_bridge_status_t _status;
+static uint32_t _last_seq;
+
+/* simulated time is mapped onto the local time of the session start */
+static uint8_t _time_synced;
+static uint64_t _sim_base_us;
+static uint64_t _local_base_us;
+static volatile uint32_t _time_ms;
+
+static rt_err_t _hil_rx_ind(rt_device_t dev, rt_size_t size)
+{
+	return rt_sem_release(&_rx_sem);
+}
+
+static void _send_frame(uint8_t type, const void* payload, uint8_t len)
+{
+	uint8_t buffer[HIL_FRAME_MAX_LEN];
+	uint16_t size = hil_frame_pack(buffer, type, payload, len);
+
+	if(rt_device_write(_hil_dev, 0, buffer, size) != size) {
+		_status.tx_err++;
+	}
+}
+
+static void _publish_imu(const hil_imu_t* imu, uint64_t time_us)
+{
+	IMU_Report report;
+
+	report.timestamp_us = time_us + imu->dt_us;
+	report.timestamp_ms = (uint32_t)(report.timestamp_us / 1000);
+	memcpy(report.gyr_B_radDs, imu->gyr, sizeof(report.gyr_B_radDs));
+	memcpy(report.acc_B_mDs2, imu->acc, sizeof(report.acc_B_mDs2));
+
+	mcn_publish(MCN_ID(sensor_imu), &report);
+}
+
+// publish the samples of mask taken up to dt_us, return the samples left
+static uint8_t _publish_other(const hil_sensor_t* sensor, uint8_t mask, uint64_t time_us, int32_t dt_us)
+{
+	if((mask & HIL_SENSOR_MAG) && sensor->mag.dt_us <= dt_us) {
+		Mag_Report report;
+
+		report.timestamp_us = time_us + sensor->mag.dt_us;
+		report.timestamp_ms = (uint32_t)(report.timestamp_us / 1000);
+		memcpy(report.mag_B_gauss, sensor->mag.mag, sizeof(report.mag_B_gauss));
+
+		mcn_publish(MCN_ID(sensor_mag), &report);
+		mask &= ~HIL_SENSOR_MAG;
+	}
+
+	if((mask & HIL_SENSOR_BARO) && sensor->baro.dt_us <= dt_us) {
+		Baro_Report report = { 0 };
+
+		report.timestamp_us = time_us + sensor->baro.dt_us;
+		report.timestamp_ms = (uint32_t)(report.timestamp_us / 1000);
+		report.pressure_pa = (int32_t)sensor->baro.pressure;
+		report.temperature_deg = sensor->baro.temperature;
+
+		mcn_publish(MCN_ID(sensor_baro), &report);
+		mask &= ~HIL_SENSOR_BARO;
+	}
+
+	if((mask & HIL_SENSOR_GPS) && sensor->gps.dt_us <= dt_us) {
+		GPS_Report report = { 0 };
+
+		report.timestamp_us = time_us + sensor->gps.dt_us;
+		report.timestamp_ms = (uint32_t)(report.timestamp_us / 1000);
+		report.lat = sensor->gps.lat;
+		report.lon = sensor->gps.lon;
+		report.height = sensor->gps.height;
+		report.velN = sensor->gps.velN;
+		report.velE = sensor->gps.velE;
+		report.velD = sensor->gps.velD;
+		report.hAcc = sensor->gps.hAcc;
+		report.vAcc = sensor->gps.vAcc;
+		report.sAcc = sensor->gps.sAcc;
+		report.fixType = sensor->gps.fixType;
+		report.numSV = sensor->gps.numSV;
+
+		mcn_publish(MCN_ID(sensor_gps), &report);
+		mask &= ~HIL_SENSOR_GPS;
+	}
+
+	return mask;
+}
+
+// step the vehicle loop on the simulated time of a sample
+static void _step_at(uint64_t time_us)
+{
+	_time_ms = (uint32_t)(time_us / 1000);
+	/* vehicle and model threads preempt us, they are done when step returns */
+	_step();
+}
+
+static void _handle_hello(const uint8_t* payload, uint8_t len)
+{
+	hil_hello_t hello;
+
+	if(len != sizeof(hello)) {
+		return;
+	}
+
+	memcpy(&hello, payload, sizeof(hello));
+
+	if(hello.version != HIL_FRAME_VERSION) {
+		ulog_w(TAG, "simulator frame version %d, expect %d\n", hello.version, HIL_FRAME_VERSION);
+		return;
+	}
+
+	_status.lockstep = (hello.flag & HIL_FLAG_LOCKSTEP) ? 1 : 0;
+	_status.frame = 0;
+	_status.lost = 0;
+	_status.batch_err = 0;
+	_time_synced = 0;
+
+	ulog_i(TAG, "simulator connected, %s, frame period %d us\n",
+	       _status.lockstep ? "lockstep" : "free running", hello.period_us);
+
+	/* echo the accepted session */
+	hello.version = HIL_FRAME_VERSION;
+	_send_frame(HIL_FRAME_HELLO, &hello, sizeof(hello));
+}
+
+static void _handle_sensor(const uint8_t* payload, uint8_t len)
+{
+	hil_sensor_t sensor;
+	hil_actuator_t actuator;
+	Control_Out_Bus control_out;
+	uint64_t time_us;
+	uint8_t mask;
+
+	if(hil_sensor_decode(payload, len, &sensor) != 0) {
+		return;
+	}
+
+	if(!_status.lockstep && sensor.imu_num > 1) {
+		/* the vehicle loop runs on its timer and only sees the latest imu sample */
+		if(_status.batch_err++ == 0) {
+			ulog_w(TAG, "%d imu samples in a frame, free running takes 1, use lockstep\n", sensor.imu_num);
+		}
+
+		return;
+	}
+
+	if(_status.frame && sensor.seq != _last_seq + 1) {
+		_status.lost += sensor.seq - _last_seq - 1;
+	}
+
+	_last_seq = sensor.seq;
+	_status.frame++;
+
+	if(_status.lockstep) {
+		if(!_time_synced) {
+			_sim_base_us = sensor.time_us;
+			_local_base_us = systime_now_us();
+			_time_synced = 1;
+		}
+
+		time_us = _local_base_us + (sensor.time_us - _sim_base_us);
+	} else {
+		time_us = systime_now_us();
+	}
+
+	mask = sensor.mask;
+
+	/* each imu sample with the other samples taken up to it, in lockstep the vehicle loop steps on each */
+	for(int k = 0 ; k < sensor.imu_num ; k++) {
+		_publish_imu(&sensor.imu[k], time_us);
+		mask = _publish_other(&sensor, mask, time_us, sensor.imu[k].dt_us);
+
+		if(_status.lockstep) {
+			_step_at(time_us + sensor.imu[k].dt_us);
+		}
+	}
+
+	if(mask) {
+		_publish_other(&sensor, mask, time_us, INT32_MAX);
+	}
+
+	if(_status.lockstep && sensor.imu_num == 0) {
+		_step_at(time_us);
+	}
+
+	if(mcn_copy_from_hub(MCN_ID(control_output), &control_out) != FMT_EOK) {
+		memset(&control_out, 0, sizeof(control_out));
+	}
+
+	actuator.seq = sensor.seq;
+	actuator.time_us = sensor.time_us;
+	actuator.timestamp = control_out.timestamp;
+	memcpy(actuator.actuator_cmd, control_out.actuator_cmd, sizeof(actuator.actuator_cmd));
+
+	_send_frame(HIL_FRAME_ACTUATOR, &actuator, sizeof(actuator));
+}
+
+static void _hil_thread_entry(void* parameter)
+{
+	uint8_t buffer[64];
+	rt_size_t len;
+
+	while(1) {
+		if(rt_sem_take(&_rx_sem, _status.lockstep ? HIL_LOCKSTEP_TIMEOUT : RT_WAITING_FOREVER) != RT_EOK) {
+			/* give the vehicle loop back to its timer */
+			ulog_w(TAG, "simulator lost, leave lockstep\n");
+			_status.lockstep = 0;
+			continue;
+		}
+
+		while((len = rt_device_read(_hil_dev, 0, buffer, sizeof(buffer))) > 0) {
+			for(rt_size_t i = 0 ; i < len ; i++) {
+				int found = hil_frame_parse(&_parser, buffer[i]);
+
+				/* a rescan after a false sync can find more than one frame */
+				for( ; found ; found = hil_frame_parse_next(&_parser)) {
+					if(_parser.type == HIL_FRAME_HELLO) {
+						_handle_hello(_parser.payload, _parser.len);
+					} else if(_parser.type == HIL_FRAME_SENSOR) {
+						_handle_sensor(_parser.payload, _parser.len);
+					}
+				}
+			}
+		}
+
+		_status.crc_err = _parser.crc_err;
+	}
+}
+
+uint8_t hil_bridge_lockstep(void)
+{
+	return _status.lockstep;
+}
+
+// simulated time of the last SENSOR frame in lockstep, on the local time axis
+uint32_t hil_bridge_time_ms(void)
+{
+	return _time_ms;
+}
+
+hil_bridge_status_t hil_bridge_get_status(void)
+{
+	return _status;
+}
+
+// step is called for each imu sample in lockstep, it should run the vehicle loop once
+fmt_err hil_bridge_init(void (*step)(void))
+{
+	if(step == NULL) {
+		return FMT_EINVAL;
+	}
+
+	_step = step;
+
+	_hil_dev = rt_device_find(HIL_BRIDGE_DEVICE_NAME);
+
+	if(_hil_dev == RT_NULL) {
+		ulog_e(TAG, "can not find %s\n", HIL_BRIDGE_DEVICE_NAME);
+		return FMT_ERROR;
+	}
+
+	if(rt_sem_init(&_rx_sem, "hil_rx", 0, RT_IPC_FLAG_FIFO) != RT_EOK) {
+		return FMT_ERROR;
+	}
+
+	if(rt_device_open(_hil_dev, RT_DEVICE_OFLAG_RDWR | RT_DEVICE_FLAG_DMA_RX | RT_DEVICE_FLAG_DMA_TX) != RT_EOK) {
+		ulog_e(TAG, "%s open fail\n", HIL_BRIDGE_DEVICE_NAME);
+		return FMT_ERROR;
+	}
+
+	rt_device_set_rx_indicate(_hil_dev, _hil_rx_ind);
+
+	if(rt_thread_init(&_hil_thread, "hil", _hil_thread_entry, RT_NULL,
+	                  _hil_thread_stack, sizeof(_hil_thread_stack), HIL_BRIDGE_THREAD_PRIORITY, 5) != RT_EOK) {
+		return FMT_ERROR;
+	}
+
+	if(rt_thread_startup(&_hil_thread) != RT_EOK) {
+		return FMT_ERROR;
+	}
+
+	return FMT_EOK;
+}
+
+#endif
@@ -0,0 +1,217 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <string.h>
+
+#include "module/hil/hil_frame.h"
+
+/* seq, time_us, imu_num and mask */
+#define SENSOR_HEAD_LEN		14
+
+/* crc16 ccitt, polynomial 0x1021 */
+static uint16_t _crc16_update(uint16_t crc, uint8_t data)
+{
+	crc ^= (uint16_t)data << 8;
+
+	for(int i = 0 ; i < 8 ; i++) {
+		crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+
+	return crc;
+}
+
+// pack payload into buf, which should hold HIL_FRAME_MAX_LEN, return frame length
+uint16_t hil_frame_pack(uint8_t* buf, uint8_t type, const void* payload, uint8_t len)
+{
+	uint16_t crc = 0xFFFF;
+
+	buf[0] = HIL_FRAME_SYNC0;
+	buf[1] = HIL_FRAME_SYNC1;
+	buf[2] = type;
+	buf[3] = len;
+	memcpy(&buf[4], payload, len);
+
+	for(int i = 2 ; i < len + 4 ; i++) {
+		crc = _crc16_update(crc, buf[i]);
+	}
+
+	buf[len + 4] = crc & 0xFF;
+	buf[len + 5] = crc >> 8;
+
+	return len + HIL_FRAME_OVERHEAD;
+}
+
+// look for a frame in the kept bytes, drop the bytes which can not start one
+static int _scan(hil_parser_t* parser)
+{
+	while(parser->head < parser->tail) {
+		uint8_t* p = &parser->buf[parser->head];
+		uint16_t avail = parser->tail - parser->head;
+		uint16_t crc = 0xFFFF;
+		uint16_t size;
+
+		if(p[0] != HIL_FRAME_SYNC0) {
+			uint8_t* sync = memchr(p, HIL_FRAME_SYNC0, avail);
+
+			parser->head = sync ? sync - parser->buf : parser->tail;
+			continue;
+		}
+
+		if(avail < 2) {
+			return 0;
+		}
+
+		if(p[1] != HIL_FRAME_SYNC1) {
+			parser->head++;
+			continue;
+		}
+
+		if(avail < 4) {
+			return 0;
+		}
+
+		size = p[3] + HIL_FRAME_OVERHEAD;
+
+		if(avail < size) {
+			return 0;
+		}
+
+		for(int i = 2 ; i < size - 2 ; i++) {
+			crc = _crc16_update(crc, p[i]);
+		}
+
+		if(p[size - 2] != (crc & 0xFF) || p[size - 1] != (crc >> 8)) {
+			/* false sync or corrupted frame, a frame may start in the bytes after the sync */
+			parser->crc_err++;
+			parser->head++;
+			continue;
+		}
+
+		parser->type = p[2];
+		parser->len = p[3];
+		memcpy(parser->payload, &p[4], p[3]);
+		parser->head += size;
+
+		return 1;
+	}
+
+	parser->head = parser->tail = 0;
+
+	return 0;
+}
+
+// feed one received byte, return 1 if a valid frame is in parser->type/len/payload
+int hil_frame_parse(hil_parser_t* parser, uint8_t c)
+{
+	if(parser->tail == sizeof(parser->buf)) {
+		/* less than a frame is kept, move it to the front */
+		memmove(parser->buf, &parser->buf[parser->head], parser->tail - parser->head);
+		parser->tail -= parser->head;
+		parser->head = 0;
+	}
+
+	parser->buf[parser->tail++] = c;
+
+	return _scan(parser);
+}
+
+// return 1 if another frame is in the bytes already fed, call it after each frame
+int hil_frame_parse_next(hil_parser_t* parser)
+{
+	return _scan(parser);
+}
+
+// serialize the samples of sensor into payload, return payload length
+uint8_t hil_sensor_encode(uint8_t* payload, const hil_sensor_t* sensor)
+{
+	uint8_t imu_num = sensor->imu_num > HIL_SENSOR_MAX_IMU ? HIL_SENSOR_MAX_IMU : sensor->imu_num;
+	uint8_t* p = payload;
+
+	memcpy(p, &sensor->seq, 4);
+	memcpy(p + 4, &sensor->time_us, 8);
+	p[12] = imu_num;
+	p[13] = sensor->mask;
+	p += SENSOR_HEAD_LEN;
+
+	memcpy(p, sensor->imu, imu_num * sizeof(hil_imu_t));
+	p += imu_num * sizeof(hil_imu_t);
+
+	if(sensor->mask & HIL_SENSOR_MAG) {
+		memcpy(p, &sensor->mag, sizeof(hil_mag_t));
+		p += sizeof(hil_mag_t);
+	}
+
+	if(sensor->mask & HIL_SENSOR_BARO) {
+		memcpy(p, &sensor->baro, sizeof(hil_baro_t));
+		p += sizeof(hil_baro_t);
+	}
+
+	if(sensor->mask & HIL_SENSOR_GPS) {
+		memcpy(p, &sensor->gps, sizeof(hil_gps_t));
+		p += sizeof(hil_gps_t);
+	}
+
+	return p - payload;
+}
+
+// return 0 if payload is a complete SENSOR frame
+int hil_sensor_decode(const uint8_t* payload, uint8_t len, hil_sensor_t* sensor)
+{
+	const uint8_t* p = payload;
+	uint32_t expect = SENSOR_HEAD_LEN;
+
+	if(len < SENSOR_HEAD_LEN) {
+		return -1;
+	}
+
+	memcpy(&sensor->seq, p, 4);
+	memcpy(&sensor->time_us, p + 4, 8);
+	sensor->imu_num = p[12];
+	sensor->mask = p[13];
+	p += SENSOR_HEAD_LEN;
+
+	if(sensor->imu_num > HIL_SENSOR_MAX_IMU) {
+		return -1;
+	}
+
+	expect += sensor->imu_num * sizeof(hil_imu_t);
+	expect += (sensor->mask & HIL_SENSOR_MAG) ? sizeof(hil_mag_t) : 0;
+	expect += (sensor->mask & HIL_SENSOR_BARO) ? sizeof(hil_baro_t) : 0;
+	expect += (sensor->mask & HIL_SENSOR_GPS) ? sizeof(hil_gps_t) : 0;
+
+	if(len != expect) {
+		return -1;
+	}
+
+	memcpy(sensor->imu, p, sensor->imu_num * sizeof(hil_imu_t));
+	p += sensor->imu_num * sizeof(hil_imu_t);
+
+	if(sensor->mask & HIL_SENSOR_MAG) {
+		memcpy(&sensor->mag, p, sizeof(hil_mag_t));
+		p += sizeof(hil_mag_t);
+	}
+
+	if(sensor->mask & HIL_SENSOR_BARO) {
+		memcpy(&sensor->baro, p, sizeof(hil_baro_t));
+		p += sizeof(hil_baro_t);
+	}
+
+	if(sensor->mask & HIL_SENSOR_GPS) {
+		memcpy(&sensor->gps, p, sizeof(hil_gps_t));
+	}
+
+	return 0;
+}
@@ -16,26 +16,53 @@
 
 #include <INS.h>
 #include <firmament.h>
+#include <string.h>
 
+#include "module/ins/ins_model.h"
 #include "module/sensor/sensor_manager.h"
+#include "module/system/model_inst.h"
 #include "task/task_logger.h"
 
 /* INS output bus */
 MCN_DEFINE(ins_output, sizeof(INS_Out_Bus));
+#if INS_INSTANCE_NUM > 1
+/* output of redundant INS fed by the second imu */
+MCN_DEFINE(ins_output1, sizeof(INS_Out_Bus));
+#endif
 
 /* for input */
 MCN_DECLARE(sensor_imu);
+#if INS_INSTANCE_NUM > 1
+MCN_DECLARE(sensor_imu1);
+#endif
 MCN_DECLARE(sensor_mag);
 MCN_DECLARE(sensor_baro);
 MCN_DECLARE(sensor_gps);
 
+/* not exported by the codegen header */
+extern PrevZCSigStates_INS_T INS_PrevZCSigState;
+extern RT_MODEL_INS_T INS_M_;
+
+MODEL_CLASS_DEFINE(INS, INS_init,
+                   MODEL_STATE(INS_B),
+                   MODEL_STATE(INS_DWork),
+                   MODEL_STATE(INS_PrevZCSigState),
+                   MODEL_STATE(INS_U),
+                   MODEL_STATE(INS_Y),
+                   MODEL_STATE(INS_M_));
+
 struct INS_Handler {
-    McnNode_t imu_sub_node_t;
+    model_inst_t inst[INS_INSTANCE_NUM];
+    uint8_t inst_num; /* instances running, one per imu present */
+    McnHub* out_hub[INS_INSTANCE_NUM];
+
+    McnHub* imu_hub[INS_INSTANCE_NUM];
+    McnNode_t imu_sub_node_t[INS_INSTANCE_NUM];
     McnNode_t mag_sub_node_t;
     McnNode_t baro_sub_node_t;
     McnNode_t gps_sub_node_t;
 
-    IMU_Report imu_report;
+    IMU_Report imu_report[INS_INSTANCE_NUM];
     Mag_Report mag_report;
     Baro_Report baro_report;
     GPS_Report gps_report;
@@ -64,11 +91,40 @@ static int _ins_output_echo(void* param)
     return 0;
 }
 
+/* convert sensor sample time to INS time */
+static uint32_t _ins_timestamp(uint32_t sample_time_ms)
+{
+    /* samples taken before INS start are treated as taken at INS start */
+    if (sample_time_ms < ins_handle.start_time) {
+        return 0;
+    }
+
+    return sample_time_ms - ins_handle.start_time;
+}
+
+static void _log_sensor_bus(const void* bus, uint8_t msg_id, uint16_t len, uint64_t timestamp_us)
+{
+#ifdef FMT_BLOG_SENSOR_TIMESTAMP_US
+    uint8_t buffer[sizeof(GPS_uBlox_Bus) + sizeof(uint64_t)];
+
+    RT_ASSERT(len <= sizeof(GPS_uBlox_Bus));
+
+    memcpy(buffer, bus, len);
+    memcpy(&buffer[len], &timestamp_us, sizeof(uint64_t));
+
+    blog_push_msg(buffer, msg_id, len + sizeof(uint64_t));
+#else
+    blog_push_msg((uint8_t*)bus, msg_id, len);
+#endif
+}
+
 void ins_model_step(void)
 {
     DEFINE_TIMETAG(ins_output, 100);
 
     uint32_t time_now = systime_now_ms();
+    uint8_t imu_new[INS_INSTANCE_NUM];
+    uint8_t mag_new, baro_new, gps_new;
 
     if (ins_handle.start_time == 0) {
         /* record first execution time */
@@ -76,94 +132,111 @@ void ins_model_step(void)
     }
 
     /* get sensor data */
-    if (mcn_poll(ins_handle.imu_sub_node_t)) {
-        mcn_copy(MCN_ID(sensor_imu), ins_handle.imu_sub_node_t, &ins_handle.imu_report);
-
-        INS_U.IMU1.gyr_x = ins_handle.imu_report.gyr_B_radDs[0];
-        INS_U.IMU1.gyr_y = ins_handle.imu_report.gyr_B_radDs[1];
-        INS_U.IMU1.gyr_z = ins_handle.imu_report.gyr_B_radDs[2];
-        INS_U.IMU1.acc_x = ins_handle.imu_report.acc_B_mDs2[0];
-        INS_U.IMU1.acc_y = ins_handle.imu_report.acc_B_mDs2[1];
-        INS_U.IMU1.acc_z = ins_handle.imu_report.acc_B_mDs2[2];
-        INS_U.IMU1.timestamp = time_now - ins_handle.start_time;
-
-        ins_handle.imu_updated = 1;
+    for (int i = 0; i < ins_handle.inst_num; i++) {
+        imu_new[i] = mcn_poll(ins_handle.imu_sub_node_t[i]);
+
+        if (imu_new[i]) {
+            mcn_copy(ins_handle.imu_hub[i], ins_handle.imu_sub_node_t[i], &ins_handle.imu_report[i]);
+        }
     }
+    ins_handle.imu_updated |= imu_new[0];
 
-    if (mcn_poll(ins_handle.mag_sub_node_t)) {
+    mag_new = mcn_poll(ins_handle.mag_sub_node_t);
+    if (mag_new) {
         mcn_copy(MCN_ID(sensor_mag), ins_handle.mag_sub_node_t, &ins_handle.mag_report);
-
-        INS_U.MAG.mag_x = ins_handle.mag_report.mag_B_gauss[0];
-        INS_U.MAG.mag_y = ins_handle.mag_report.mag_B_gauss[1];
-        INS_U.MAG.mag_z = ins_handle.mag_report.mag_B_gauss[2];
-        INS_U.MAG.timestamp = time_now - ins_handle.start_time;
-
         ins_handle.mag_updated = 1;
     }
 
-    if (mcn_poll(ins_handle.baro_sub_node_t)) {
+    baro_new = mcn_poll(ins_handle.baro_sub_node_t);
+    if (baro_new) {
         mcn_copy(MCN_ID(sensor_baro), ins_handle.baro_sub_node_t, &ins_handle.baro_report);
-
-        INS_U.Barometer.pressure = (float)ins_handle.baro_report.pressure_pa;
-        INS_U.Barometer.temperature = ins_handle.baro_report.temperature_deg;
-        INS_U.Barometer.timestamp = time_now - ins_handle.start_time;
-
         ins_handle.baro_updated = 1;
     }
 
-    /* update gps data */
-    if (mcn_poll(ins_handle.gps_sub_node_t)) {
+    gps_new = mcn_poll(ins_handle.gps_sub_node_t);
+    if (gps_new) {
         mcn_copy(MCN_ID(sensor_gps), ins_handle.gps_sub_node_t, &ins_handle.gps_report);
-
-        INS_U.GPS_uBlox.fixType = ins_handle.gps_report.fixType;
-        INS_U.GPS_uBlox.lat = ins_handle.gps_report.lat;
-        INS_U.GPS_uBlox.lon = ins_handle.gps_report.lon;
-        INS_U.GPS_uBlox.height = ins_handle.gps_report.height;
-        INS_U.GPS_uBlox.velN = (int32_t)(ins_handle.gps_report.velN * 1e3);
-        INS_U.GPS_uBlox.velE = (int32_t)(ins_handle.gps_report.velE * 1e3);
-        INS_U.GPS_uBlox.velD = (int32_t)(ins_handle.gps_report.velD * 1e3);
-        INS_U.GPS_uBlox.hAcc = (uint32_t)(ins_handle.gps_report.hAcc * 1e3);
-        INS_U.GPS_uBlox.vAcc = (uint32_t)(ins_handle.gps_report.vAcc * 1e3);
-        INS_U.GPS_uBlox.sAcc = (uint32_t)(ins_handle.gps_report.sAcc * 1e3);
-        INS_U.GPS_uBlox.numSV = ins_handle.gps_report.numSV;
-        INS_U.GPS_uBlox.timestamp = time_now - ins_handle.start_time;
-
         ins_handle.gps_updated = 1;
     }
 
-    /* run INS */
-    INS_step();
-
-    /* publish INS output */
-    mcn_publish(MCN_ID(ins_output), &INS_Y.INS_Out);
+    /* the main instance runs last, so it stays resident for the logging below */
+    for (int i = ins_handle.inst_num - 1; i >= 0; i--) {
+        model_inst_switch(&ins_handle.inst[i]);
+
+        /* inputs hold their last sample in the state of each instance */
+        if (imu_new[i]) {
+            INS_U.IMU1.gyr_x = ins_handle.imu_report[i].gyr_B_radDs[0];
+            INS_U.IMU1.gyr_y = ins_handle.imu_report[i].gyr_B_radDs[1];
+            INS_U.IMU1.gyr_z = ins_handle.imu_report[i].gyr_B_radDs[2];
+            INS_U.IMU1.acc_x = ins_handle.imu_report[i].acc_B_mDs2[0];
+            INS_U.IMU1.acc_y = ins_handle.imu_report[i].acc_B_mDs2[1];
+            INS_U.IMU1.acc_z = ins_handle.imu_report[i].acc_B_mDs2[2];
+            INS_U.IMU1.timestamp = _ins_timestamp(ins_handle.imu_report[i].timestamp_ms);
+        }
+
+        if (mag_new) {
+            INS_U.MAG.mag_x = ins_handle.mag_report.mag_B_gauss[0];
+            INS_U.MAG.mag_y = ins_handle.mag_report.mag_B_gauss[1];
+            INS_U.MAG.mag_z = ins_handle.mag_report.mag_B_gauss[2];
+            INS_U.MAG.timestamp = _ins_timestamp(ins_handle.mag_report.timestamp_ms);
+        }
+
+        if (baro_new) {
+            INS_U.Barometer.pressure = (float)ins_handle.baro_report.pressure_pa;
+            INS_U.Barometer.temperature = ins_handle.baro_report.temperature_deg;
+            INS_U.Barometer.timestamp = _ins_timestamp(ins_handle.baro_report.timestamp_ms);
+        }
+
+        /* update gps data */
+        if (gps_new) {
+            INS_U.GPS_uBlox.fixType = ins_handle.gps_report.fixType;
+            INS_U.GPS_uBlox.lat = ins_handle.gps_report.lat;
+            INS_U.GPS_uBlox.lon = ins_handle.gps_report.lon;
+            INS_U.GPS_uBlox.height = ins_handle.gps_report.height;
+            INS_U.GPS_uBlox.velN = (int32_t)(ins_handle.gps_report.velN * 1e3);
+            INS_U.GPS_uBlox.velE = (int32_t)(ins_handle.gps_report.velE * 1e3);
+            INS_U.GPS_uBlox.velD = (int32_t)(ins_handle.gps_report.velD * 1e3);
+            INS_U.GPS_uBlox.hAcc = (uint32_t)(ins_handle.gps_report.hAcc * 1e3);
+            INS_U.GPS_uBlox.vAcc = (uint32_t)(ins_handle.gps_report.vAcc * 1e3);
+            INS_U.GPS_uBlox.sAcc = (uint32_t)(ins_handle.gps_report.sAcc * 1e3);
+            INS_U.GPS_uBlox.numSV = ins_handle.gps_report.numSV;
+            INS_U.GPS_uBlox.timestamp = _ins_timestamp(ins_handle.gps_report.timestamp_ms);
+        }
+
+        /* run INS */
+        INS_step();
+
+        /* publish INS output */
+        mcn_publish(ins_handle.out_hub[i], &INS_Y.INS_Out);
+    }
 
     /* record INS input bus data if updated */
     if (ins_handle.imu_updated) {
 
         ins_handle.imu_updated = 0;
         /* Log IMU data if IMU updated */
-        blog_push_msg((uint8_t*)&INS_U.IMU1, BLOG_IMU_ID, sizeof(INS_U.IMU1));
+        _log_sensor_bus(&INS_U.IMU1, BLOG_IMU_ID, sizeof(INS_U.IMU1), ins_handle.imu_report[0].timestamp_us);
     }
 
     if (ins_handle.mag_updated) {
 
         ins_handle.mag_updated = 0;
         /* Log Magnetometer data */
-        blog_push_msg((uint8_t*)&INS_U.MAG, BLOG_MAG_ID, sizeof(INS_U.MAG));
+        _log_sensor_bus(&INS_U.MAG, BLOG_MAG_ID, sizeof(INS_U.MAG), ins_handle.mag_report.timestamp_us);
     }
 
     if (ins_handle.baro_updated) {
 
         ins_handle.baro_updated = 0;
         /* Log Barometer data */
-        blog_push_msg((uint8_t*)&INS_U.Barometer, BLOG_BARO_ID, sizeof(INS_U.Barometer));
+        _log_sensor_bus(&INS_U.Barometer, BLOG_BARO_ID, sizeof(INS_U.Barometer), ins_handle.baro_report.timestamp_us);
     }
 
     if (ins_handle.gps_updated) {
 
         ins_handle.gps_updated = 0;
         /* Log GPS data */
-        blog_push_msg((uint8_t*)&INS_U.GPS_uBlox, BLOG_GPS_ID, sizeof(INS_U.GPS_uBlox));
+        _log_sensor_bus(&INS_U.GPS_uBlox, BLOG_GPS_ID, sizeof(INS_U.GPS_uBlox), ins_handle.gps_report.timestamp_us);
     }
 
     /* Log INS output bus data */
@@ -175,16 +248,38 @@ void ins_model_step(void)
     }
 }
 
-void ins_model_init(void)
+fmt_err ins_model_init(void)
 {
-    mcn_advertise(MCN_ID(ins_output), _ins_output_echo);
+    ins_handle.out_hub[0] = MCN_ID(ins_output);
+    ins_handle.imu_hub[0] = MCN_ID(sensor_imu);
+#if INS_INSTANCE_NUM > 1
+    ins_handle.out_hub[1] = MCN_ID(ins_output1);
+    ins_handle.imu_hub[1] = MCN_ID(sensor_imu1);
+#endif
+
+    ins_handle.inst_num = sensor_manager_imu_num() < INS_INSTANCE_NUM ? sensor_manager_imu_num() : INS_INSTANCE_NUM;
+
+    for (int i = 0; i < ins_handle.inst_num; i++) {
+        if (mcn_advertise(ins_handle.out_hub[i], _ins_output_echo) != FMT_EOK) {
+            return FMT_ERROR;
+        }
+
+        ins_handle.imu_sub_node_t[i] = mcn_subscribe(ins_handle.imu_hub[i], NULL, NULL);
+        if (ins_handle.imu_sub_node_t[i] == NULL) {
+            return FMT_ERROR;
+        }
+
+        /* the instance created last is resident, so create the main one last */
+        if (model_inst_create(&ins_handle.inst[ins_handle.inst_num - 1 - i], MODEL_CLASS_ID(INS)) != FMT_EOK) {
+            return FMT_ERROR;
+        }
+
+        INS_U.reset = 0;
+    }
 
-    ins_handle.imu_sub_node_t = mcn_subscribe(MCN_ID(sensor_imu), NULL, NULL);
     ins_handle.mag_sub_node_t = mcn_subscribe(MCN_ID(sensor_mag), NULL, NULL);
     ins_handle.baro_sub_node_t = mcn_subscribe(MCN_ID(sensor_baro), NULL, NULL);
     ins_handle.gps_sub_node_t = mcn_subscribe(MCN_ID(sensor_gps), NULL, NULL);
 
-    INS_init();
-
-    INS_U.reset = 0;
+    return FMT_EOK;
 }
@@ -18,6 +18,8 @@
 #include <string.h>
 
 #include "module/fs_manager/fs_manager.h"
+#include "module/system/memstat.h"
+#include "module/system/perf.h"
 #include "task/task_logger.h"
 
 #define TAG "BLog"
@@ -31,6 +33,9 @@ blog_elem_t IMU_Elems[] = {
     BLOG_ELEMENT("acc_x", BLOG_FLOAT),
     BLOG_ELEMENT("acc_y", BLOG_FLOAT),
     BLOG_ELEMENT("acc_z", BLOG_FLOAT),
+#ifdef FMT_BLOG_SENSOR_TIMESTAMP_US
+    BLOG_ELEMENT("timestamp_us", BLOG_UINT64),
+#endif
 };
 
 blog_elem_t MAG_Elems[] = {
@@ -38,12 +43,18 @@ blog_elem_t MAG_Elems[] = {
     BLOG_ELEMENT("mag_x", BLOG_FLOAT),
     BLOG_ELEMENT("mag_y", BLOG_FLOAT),
     BLOG_ELEMENT("mag_z", BLOG_FLOAT),
+#ifdef FMT_BLOG_SENSOR_TIMESTAMP_US
+    BLOG_ELEMENT("timestamp_us", BLOG_UINT64),
+#endif
 };
 
 blog_elem_t Barometer_Elems[] = {
     BLOG_ELEMENT("timestamp", BLOG_UINT32),
     BLOG_ELEMENT("pressure", BLOG_FLOAT),
     BLOG_ELEMENT("temperature", BLOG_FLOAT),
+#ifdef FMT_BLOG_SENSOR_TIMESTAMP_US
+    BLOG_ELEMENT("timestamp_us", BLOG_UINT64),
+#endif
 };
 
 blog_elem_t GPS_uBlox_Elems[] = {
@@ -77,6 +88,9 @@ blog_elem_t GPS_uBlox_Elems[] = {
     BLOG_ELEMENT("headAcc", BLOG_UINT32),
     BLOG_ELEMENT("pDOP", BLOG_UINT16),
     BLOG_ELEMENT("reserved2", BLOG_UINT16),
+#ifdef FMT_BLOG_SENSOR_TIMESTAMP_US
+    BLOG_ELEMENT("timestamp_us", BLOG_UINT64),
+#endif
 };
 
 blog_elem_t Pilot_Cmd_Elems[] = {
@@ -141,6 +155,57 @@ blog_elem_t Control_Out_Elems[] = {
     BLOG_ELEMENT_VEC("actuator_cmd", BLOG_UINT16, 16),
 };
 
+blog_elem_t Perf_Elems[] = {
+    BLOG_ELEMENT("timestamp", BLOG_UINT32),
+    BLOG_ELEMENT("scope", BLOG_UINT32),
+    BLOG_ELEMENT_VEC("name", BLOG_UINT8, PERF_NAME_LEN),
+    BLOG_ELEMENT("count", BLOG_UINT32),
+    BLOG_ELEMENT("min_us", BLOG_FLOAT),
+    BLOG_ELEMENT("mean_us", BLOG_FLOAT),
+    BLOG_ELEMENT("max_us", BLOG_FLOAT),
+    BLOG_ELEMENT_VEC("hist", BLOG_UINT32, PERF_HIST_BINS),
+};
+
+blog_elem_t Mem_Stat_Elems[] = {
+    BLOG_ELEMENT("timestamp", BLOG_UINT32),
+    BLOG_ELEMENT("heap_used", BLOG_UINT32),
+    BLOG_ELEMENT("heap_max_used", BLOG_UINT32),
+    BLOG_ELEMENT("heap_max_free_blk", BLOG_UINT32),
+    BLOG_ELEMENT("heap_free_blocks", BLOG_UINT32),
+    BLOG_ELEMENT("heap_frag", BLOG_FLOAT),
+    BLOG_ELEMENT_VEC("stack_max_used", BLOG_UINT32, MEMSTAT_MAX_THREAD),
+    BLOG_ELEMENT_VEC("stack_size", BLOG_UINT32, MEMSTAT_MAX_THREAD),
+    BLOG_ELEMENT("thread_num", BLOG_UINT32),
+    BLOG_ELEMENT_VEC("thread_name", BLOG_UINT8, MEMSTAT_MAX_THREAD * RT_NAME_MAX),
+};
+
+blog_elem_t IO_Latency_Elems[] = {
+    BLOG_ELEMENT("timestamp", BLOG_UINT32),
+    BLOG_ELEMENT("cmd_timestamp_us", BLOG_UINT32),
+    BLOG_ELEMENT("rtt_us", BLOG_UINT32),
+    BLOG_ELEMENT("link_us", BLOG_UINT32),
+    BLOG_ELEMENT("io_proc_us", BLOG_UINT16),
+    BLOG_ELEMENT("io_hold_us", BLOG_UINT16),
+    BLOG_ELEMENT("latency_us", BLOG_UINT32),
+};
+
+blog_elem_t ESC_RPM_Elems[] = {
+    BLOG_ELEMENT("timestamp", BLOG_UINT32),
+    BLOG_ELEMENT("valid_mask", BLOG_UINT32),
+    BLOG_ELEMENT_VEC("rpm", BLOG_FLOAT, 16),
+};
+
+blog_elem_t Model_Sched_Elems[] = {
+    BLOG_ELEMENT("timestamp", BLOG_UINT32),
+    BLOG_ELEMENT("model", BLOG_UINT32),
+    BLOG_ELEMENT_VEC("name", BLOG_UINT8, RT_NAME_MAX),
+    BLOG_ELEMENT("period", BLOG_UINT32),
+    BLOG_ELEMENT("priority", BLOG_UINT32),
+    BLOG_ELEMENT("release", BLOG_UINT32),
+    BLOG_ELEMENT("miss", BLOG_UINT32),
+    BLOG_ELEMENT("resp_max_us", BLOG_FLOAT),
+};
+
 #if defined(FMT_USING_SIH)
 blog_elem_t Plant_States_Elems[] = {
     BLOG_ELEMENT("timestamp", BLOG_UINT32),
@@ -178,6 +243,11 @@ blog_bus_t _blog_bus[] = {
     BLOG_BUS("INS_Out", BLOG_INS_OUT_ID, INS_Out_Elems),
     BLOG_BUS("FMS_Out", BLOG_FMS_OUT_ID, FMS_Out_Elems),
     BLOG_BUS("Control_Out", BLOG_CONTROL_OUT_ID, Control_Out_Elems),
+    BLOG_BUS("Perf", BLOG_PERF_ID, Perf_Elems),
+    BLOG_BUS("Mem_Stat", BLOG_MEM_STAT_ID, Mem_Stat_Elems),
+    BLOG_BUS("IO_Latency", BLOG_IO_LATENCY_ID, IO_Latency_Elems),
+    BLOG_BUS("ESC_RPM", BLOG_ESC_RPM_ID, ESC_RPM_Elems),
+    BLOG_BUS("Model_Sched", BLOG_MODEL_SCHED_ID, Model_Sched_Elems),
 #if defined(FMT_USING_SIH)
     BLOG_BUS("Plant_States", BLOG_PLANT_STATE_ID, Plant_States_Elems),
 #endif
@@ -305,15 +375,25 @@ static void _buffer_write(const uint8_t* data, uint16_t len)
 
 /**************************** Public Function ********************************/
 
+/*
+ * The push functions are called by the model threads (priority 2 to 7), the
+ * vehicle thread and the system statistics, and one may preempt another in
+ * the middle of a message. The space check and the copy are one critical
+ * section, so messages never interleave and head/index stay consistent.
+ */
 fmt_err blog_push_data(const void* payload, uint16_t len)
 {
+    OS_ENTER_CRITICAL;
+
     /* chceck log status */
     if (blog.log_status != BLOG_STATUS_LOGGING) {
+        OS_EXIT_CRITICAL;
         return FMT_EEMPTY;
     }
 
     /* check if buffer has enough space to store data */
     if (_buffer_check_full(len)) {
+        OS_EXIT_CRITICAL;
         TIMETAG_CHECK_EXECUTE(blog_buff_full1, 500, ulog_w(TAG, "buffer is full");)
         return FMT_EFULL;
     }
@@ -321,6 +401,8 @@ fmt_err blog_push_data(const void* payload, uint16_t len)
     /* write payload */
     _buffer_write(payload, len);
 
+    OS_EXIT_CRITICAL;
+
     return FMT_EOK;
 }
 
@@ -333,13 +415,17 @@ fmt_err blog_push_msg(const uint8_t* payload, uint8_t msg_id, uint16_t len)
 
     int32_t bus_index;
 
+    OS_ENTER_CRITICAL;
+
     /* check log status */
     if (blog.log_status != BLOG_STATUS_LOGGING) {
+        OS_EXIT_CRITICAL;
         return FMT_EEMPTY;
     }
 
     /* check if buffer has enough space to store msg */
     if (_buffer_check_full(len + 4)) {
+        OS_EXIT_CRITICAL;
         TIMETAG_CHECK_EXECUTE(blog_buff_full2, 500, ulog_w(TAG, "buffer is full");)
         return FMT_EFULL;
     }
@@ -363,6 +449,8 @@ fmt_err blog_push_msg(const uint8_t* payload, uint8_t msg_id, uint16_t len)
         blog.monitor[bus_index].total_msg += 1;
     }
 
+    OS_EXIT_CRITICAL;
+
     return FMT_EOK;
 }
 
@@ -84,6 +84,26 @@ uint16_t math_crc16(uint16_t crc, const void* data, uint16_t len)
     return crc;
 }
 
+/* CRC-32 (IEEE 802.3, same as zlib crc32), crc is the last result, 0 at start */
+uint32_t math_crc32(uint32_t crc, const void* data, uint32_t len)
+{
+    const static uint32_t crc_tab[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    const uint8_t* ptr = (const uint8_t*)data;
+
+    crc = ~crc;
+
+    while (len--) {
+        crc ^= *ptr++;
+        crc = (crc >> 4) ^ crc_tab[crc & 0x0F];
+        crc = (crc >> 4) ^ crc_tab[crc & 0x0F];
+    }
+
+    return ~crc;
+}
+
 // 整数转字符串。
 void math_itoa(int32_t val, char* str)
 {
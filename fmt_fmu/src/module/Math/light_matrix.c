@@ -18,8 +18,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 
 #include "module/math/light_matrix.h"
+#include "module/math/matrix.h"
 
 #define MAT_LEGAL_CHECKING
 
@@ -31,48 +33,20 @@
 /*                          Private Function                            */
 /************************************************************************/
 
-void swap(int* a, int* b)
+/* copy to contiguous storage for the fixed size kernels in matrix.c */
+static uint8_t _mat_pack(const Mat* mat, float* buffer)
 {
-	int m;
-	m = *a;
-	*a = *b;
-	*b = m;
-}
-
-void perm(int list[], int k, int m, int* p, Mat* mat, LIGHT_MATRIX_TYPE* det)
-{
-	int i;
+	int row;
 
-	if(k > m) {
-		LIGHT_MATRIX_TYPE res = mat->element[0][list[0]];
+	if(mat->row != mat->col || mat->row > MATRIX_MAX_DIM) {
+		printf("err check, matrix must be square and no larger than %d\n", MATRIX_MAX_DIM);
+		return 0;
+	}
 
-		for(i = 1; i < mat->row ; i++) {
-			res *= mat->element[i][list[i]];
-		}
+	for(row = 0 ; row < mat->row ; row++)
+		memcpy(&buffer[row * mat->col], mat->element[row], sizeof(float) * mat->col);
 
-		if(*p % 2) {
-			//odd is negative
-			*det -= res;
-		} else {
-			//even is positive
-			*det += res;
-		}
-	} else {
-		// if the element is 0, we don't need to calculate the value for this permutation
-//		if(!equal(mat->element[k][list[k]], 0.0f))
-//			perm(list, k + 1, m, p, mat, det);
-		perm(list, k + 1, m, p, mat, det);
-
-		for(i = k + 1; i <= m; i++) {
-//			if(equal(mat->element[k][list[i]], 0.0f))
-//				continue;
-			swap(&list[k], &list[i]);
-			*p += 1;
-			perm(list, k + 1, m, p, mat, det);
-			swap(&list[k], &list[i]);
-			*p -= 1;
-		}
-	}
+	return 1;
 }
 
 /************************************************************************/
@@ -297,35 +271,15 @@ Mat* MatTrans(Mat* src, Mat* dst)
 // return det(mat)
 LIGHT_MATRIX_TYPE MatDet(Mat* mat)
 {
-	LIGHT_MATRIX_TYPE det = 0.0f;
-	int plarity = 0;
-	int* list;
-	int i;
-
-#ifdef MAT_LEGAL_CHECKING
-
-	if(mat->row != mat->col) {
-		printf("err check, not a square matrix for MatDetermine\n");
-		MatDump(mat);
-		return 0.0f;
-	}
+	float buffer[MATRIX_MAX_DIM * MATRIX_MAX_DIM];
 
-#endif
-
-	list = (int*)rt_malloc(sizeof(int) * mat->col);
-
-	if(list == NULL) {
-		printf("malloc list fail\n");
-		return 0.0f;
+	if(!_mat_pack(mat, buffer)) {
+		/* not 0, which would read as singular */
+		return NAN;
 	}
 
-	for(i = 0 ; i < mat->col ; i++)
-		list[i] = i;
-
-	perm(list, 0, mat->row - 1, &plarity, mat, &det);
-	rt_free(list);
-
-	return det;
+	/* LU decomposition instead of expanding all n! permutations */
+	return matrix_det(buffer, mat->row);
 }
 
 // dst = adj(src)
@@ -387,9 +341,9 @@ Mat* MatAdj(Mat* src, Mat* dst)
 // dst = src^(-1)
 Mat* MatInv(Mat* src, Mat* dst)
 {
-	Mat adj_mat;
-	LIGHT_MATRIX_TYPE det;
-	int row, col;
+	float buffer[MATRIX_MAX_DIM * MATRIX_MAX_DIM];
+	float inv[MATRIX_MAX_DIM * MATRIX_MAX_DIM];
+	int row;
 
 #ifdef MAT_LEGAL_CHECKING
 
@@ -401,25 +355,18 @@ Mat* MatInv(Mat* src, Mat* dst)
 	}
 
 #endif
-	//printf("create\n");
-	MatCreate(&adj_mat, src->row, src->col);
-	//printf("create finish\n");
-	MatAdj(src, &adj_mat);
-	//printf("adj\n");
-	det = MatDet(src);
-	//printf("inv det:%f\n", det);
-
-	if(equal(det, 0.0f)) {
-		printf("err, determinate is 0 for MatInv\n");
+
+	if(!_mat_pack(src, buffer)) {
 		return NULL;
 	}
 
-	for(row = 0 ; row < src->row ; row++) {
-		for(col = 0 ; col < src->col ; col++)
-			dst->element[row][col] = adj_mat.element[row][col] / det;
+	if(matrix_inv(buffer, inv, src->row) != FMT_EOK) {
+		printf("err, matrix is singular for MatInv\n");
+		return NULL;
 	}
 
-	MatDelete(&adj_mat);
+	for(row = 0 ; row < src->row ; row++)
+		memcpy(dst->element[row], &inv[row * src->col], sizeof(float) * src->col);
 
 	return dst;
 }
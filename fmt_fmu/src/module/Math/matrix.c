@@ -0,0 +1,528 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <firmament.h>
+#include <math.h>
+#include <string.h>
+
+#include "module/math/matrix.h"
+#include "module/math/ap_math.h"
+
+#ifdef ARM_MATH_CM4
+	#include "arm_math.h"
+	/* below this size the call overhead of cmsis-dsp is larger than the gain */
+	#define MATRIX_DSP_MIN_DIM      4
+#endif
+
+#define MATRIX_EPS              1e-12f
+
+void matrix_zeros(float* a, uint8_t row, uint8_t col)
+{
+	memset(a, 0, sizeof(float) * row * col);
+}
+
+void matrix_eye(float* a, uint8_t n)
+{
+	matrix_zeros(a, n, n);
+
+	for(uint8_t i = 0; i < n; i++) {
+		a[i * n + i] = 1.0f;
+	}
+}
+
+void matrix_add(const float* a, const float* b, float* c, uint8_t row, uint8_t col)
+{
+#ifdef ARM_MATH_CM4
+	arm_add_f32((float*)a, (float*)b, c, row * col);
+#else
+
+	for(uint16_t i = 0; i < row * col; i++) {
+		c[i] = a[i] + b[i];
+	}
+
+#endif
+}
+
+void matrix_sub(const float* a, const float* b, float* c, uint8_t row, uint8_t col)
+{
+#ifdef ARM_MATH_CM4
+	arm_sub_f32((float*)a, (float*)b, c, row * col);
+#else
+
+	for(uint16_t i = 0; i < row * col; i++) {
+		c[i] = a[i] - b[i];
+	}
+
+#endif
+}
+
+/* c(row x col) = a(row x n) * b(n x col), c must not overlap a or b */
+void matrix_mul(const float* a, const float* b, float* c, uint8_t row, uint8_t n, uint8_t col)
+{
+#ifdef ARM_MATH_CM4
+
+	if(row >= MATRIX_DSP_MIN_DIM && col >= MATRIX_DSP_MIN_DIM) {
+		arm_matrix_instance_f32 ma = { row, n, (float*)a };
+		arm_matrix_instance_f32 mb = { n, col, (float*)b };
+		arm_matrix_instance_f32 mc = { row, col, c };
+
+		arm_mat_mult_f32(&ma, &mb, &mc);
+		return;
+	}
+
+#endif
+
+	for(uint8_t i = 0; i < row; i++) {
+		for(uint8_t j = 0; j < col; j++) {
+			float sum = 0.0f;
+
+			for(uint8_t k = 0; k < n; k++) {
+				sum += a[i * n + k] * b[k * col + j];
+			}
+
+			c[i * col + j] = sum;
+		}
+	}
+}
+
+void matrix_trans(const float* a, float* b, uint8_t row, uint8_t col)
+{
+	for(uint8_t i = 0; i < row; i++) {
+		for(uint8_t j = 0; j < col; j++) {
+			b[j * row + i] = a[i * col + j];
+		}
+	}
+}
+
+void matrix_mul_vec(const float* a, const float* x, float* y, uint8_t row, uint8_t col)
+{
+	for(uint8_t i = 0; i < row; i++) {
+#ifdef ARM_MATH_CM4
+		arm_dot_prod_f32((float*)&a[i * col], (float*)x, col, &y[i]);
+#else
+		float sum = 0.0f;
+
+		for(uint8_t j = 0; j < col; j++) {
+			sum += a[i * col + j] * x[j];
+		}
+
+		y[i] = sum;
+#endif
+	}
+}
+
+/**
+ * In place LU decomposition with partial pivoting, P * A = L * U.
+ *
+ * @param a n x n matrix, replaced by L (unit diagonal not stored) and U
+ * @param pivot row permutation, pivot[i] is the original row of row i
+ * @param sign permutation sign, can be NULL
+ */
+fmt_err matrix_lu(float* a, uint8_t* pivot, uint8_t n, int8_t* sign)
+{
+	int8_t s = 1;
+
+	for(uint8_t i = 0; i < n; i++) {
+		pivot[i] = i;
+	}
+
+	for(uint8_t k = 0; k < n; k++) {
+		uint8_t p = k;
+		float max = fabsf(a[k * n + k]);
+
+		for(uint8_t i = k + 1; i < n; i++) {
+			if(fabsf(a[i * n + k]) > max) {
+				max = fabsf(a[i * n + k]);
+				p = i;
+			}
+		}
+
+		if(max < MATRIX_EPS) {
+			/* singular */
+			return FMT_ERROR;
+		}
+
+		if(p != k) {
+			for(uint8_t j = 0; j < n; j++) {
+				float tmp = a[k * n + j];
+				a[k * n + j] = a[p * n + j];
+				a[p * n + j] = tmp;
+			}
+
+			uint8_t tmp = pivot[k];
+			pivot[k] = pivot[p];
+			pivot[p] = tmp;
+			s = -s;
+		}
+
+		float inv = 1.0f / a[k * n + k];
+
+		for(uint8_t i = k + 1; i < n; i++) {
+			float f = a[i * n + k] * inv;
+
+			a[i * n + k] = f;
+
+			for(uint8_t j = k + 1; j < n; j++) {
+				a[i * n + j] -= f * a[k * n + j];
+			}
+		}
+	}
+
+	if(sign) {
+		*sign = s;
+	}
+
+	return FMT_EOK;
+}
+
+/* solve A * x = b with the result of matrix_lu(), x and b can be the same.
+ * n is at most MATRIX_MAX_DIM, which bounds the workspace */
+void matrix_lu_solve(const float* lu, const uint8_t* pivot, const float* b, float* x, uint8_t n)
+{
+	float y[MATRIX_MAX_DIM];
+
+	/* L * y = P * b */
+	for(uint8_t i = 0; i < n; i++) {
+		float sum = b[pivot[i]];
+
+		for(uint8_t j = 0; j < i; j++) {
+			sum -= lu[i * n + j] * y[j];
+		}
+
+		y[i] = sum;
+	}
+
+	/* U * x = y */
+	for(int8_t i = n - 1; i >= 0; i--) {
+		float sum = y[i];
+
+		for(uint8_t j = i + 1; j < n; j++) {
+			sum -= lu[i * n + j] * x[j];
+		}
+
+		x[i] = sum / lu[i * n + i];
+	}
+}
+
+/**
+ * Cholesky decomposition A = L * L' of a symmetric positive definite matrix.
+ * only the lower triangle of a is read, the upper triangle of l is zeroed.
+ */
+fmt_err matrix_cholesky(const float* a, float* l, uint8_t n)
+{
+	for(uint8_t j = 0; j < n; j++) {
+		float d = a[j * n + j];
+
+		for(uint8_t k = 0; k < j; k++) {
+			d -= l[j * n + k] * l[j * n + k];
+		}
+
+		if(d <= MATRIX_EPS) {
+			/* not positive definite */
+			return FMT_ERROR;
+		}
+
+		d = sqrtf(d);
+		l[j * n + j] = d;
+
+		float inv = 1.0f / d;
+
+		for(uint8_t i = j + 1; i < n; i++) {
+			float sum = a[i * n + j];
+
+			for(uint8_t k = 0; k < j; k++) {
+				sum -= l[i * n + k] * l[j * n + k];
+			}
+
+			l[i * n + j] = sum * inv;
+			l[j * n + i] = 0.0f;
+		}
+	}
+
+	return FMT_EOK;
+}
+
+/* solve A * x = b with L from matrix_cholesky(), x and b can be the same */
+void matrix_cholesky_solve(const float* l, const float* b, float* x, uint8_t n)
+{
+	/* L * y = b */
+	for(uint8_t i = 0; i < n; i++) {
+		float sum = b[i];
+
+		for(uint8_t j = 0; j < i; j++) {
+			sum -= l[i * n + j] * x[j];
+		}
+
+		x[i] = sum / l[i * n + i];
+	}
+
+	/* L' * x = y */
+	for(int8_t i = n - 1; i >= 0; i--) {
+		float sum = x[i];
+
+		for(uint8_t j = i + 1; j < n; j++) {
+			sum -= l[j * n + i] * x[j];
+		}
+
+		x[i] = sum / l[i * n + i];
+	}
+}
+
+/* solve A * x = b for a general square A */
+fmt_err matrix_solve(const float* a, const float* b, float* x, uint8_t n)
+{
+	float lu[MATRIX_MAX_DIM * MATRIX_MAX_DIM];
+	uint8_t pivot[MATRIX_MAX_DIM];
+
+	if(n > MATRIX_MAX_DIM) {
+		return FMT_EINVAL;
+	}
+
+	memcpy(lu, a, sizeof(float) * n * n);
+
+	if(matrix_lu(lu, pivot, n, NULL) != FMT_EOK) {
+		return FMT_ERROR;
+	}
+
+	matrix_lu_solve(lu, pivot, b, x, n);
+
+	return FMT_EOK;
+}
+
+float matrix_det(const float* a, uint8_t n)
+{
+	float lu[MATRIX_MAX_DIM * MATRIX_MAX_DIM];
+	uint8_t pivot[MATRIX_MAX_DIM];
+	int8_t sign;
+	float det;
+
+	if(n > MATRIX_MAX_DIM) {
+		/* not 0, which would read as singular */
+		return NAN;
+	}
+
+	memcpy(lu, a, sizeof(float) * n * n);
+
+	if(matrix_lu(lu, pivot, n, &sign) != FMT_EOK) {
+		return 0.0f;
+	}
+
+	det = sign;
+
+	for(uint8_t i = 0; i < n; i++) {
+		det *= lu[i * n + i];
+	}
+
+	return det;
+}
+
+fmt_err matrix_inv(const float* a, float* inv, uint8_t n)
+{
+	float lu[MATRIX_MAX_DIM * MATRIX_MAX_DIM];
+	uint8_t pivot[MATRIX_MAX_DIM];
+	float col[MATRIX_MAX_DIM];
+
+	if(n > MATRIX_MAX_DIM) {
+		return FMT_EINVAL;
+	}
+
+	memcpy(lu, a, sizeof(float) * n * n);
+
+	if(matrix_lu(lu, pivot, n, NULL) != FMT_EOK) {
+		return FMT_ERROR;
+	}
+
+	for(uint8_t j = 0; j < n; j++) {
+		for(uint8_t i = 0; i < n; i++) {
+			col[i] = (i == j) ? 1.0f : 0.0f;
+		}
+
+		matrix_lu_solve(lu, pivot, col, col, n);
+
+		for(uint8_t i = 0; i < n; i++) {
+			inv[i * n + j] = col[i];
+		}
+	}
+
+	return FMT_EOK;
+}
+
+/**
+ * Eigen decomposition of a symmetric matrix by cyclic Jacobi rotations.
+ *
+ * @param eig_val eigenvalues, not sorted
+ * @param eig_vec eigenvectors in columns, A = V * diag(eig_val) * V'
+ */
+fmt_err matrix_eig_sym(const float* a, float* eig_val, float* eig_vec, uint8_t n)
+{
+	float w[MATRIX_MAX_DIM * MATRIX_MAX_DIM];
+	float off, norm;
+
+	if(n > MATRIX_MAX_DIM) {
+		return FMT_EINVAL;
+	}
+
+	memcpy(w, a, sizeof(float) * n * n);
+	matrix_eye(eig_vec, n);
+
+	for(uint8_t sweep = 0; sweep < 50; sweep++) {
+		off = norm = 0.0f;
+
+		for(uint8_t i = 0; i < n; i++) {
+			for(uint8_t j = 0; j < n; j++) {
+				norm += w[i * n + j] * w[i * n + j];
+
+				if(i != j) {
+					off += w[i * n + j] * w[i * n + j];
+				}
+			}
+		}
+
+		if(off <= 1e-12f * norm) {
+			for(uint8_t i = 0; i < n; i++) {
+				eig_val[i] = w[i * n + i];
+			}
+
+			return FMT_EOK;
+		}
+
+		for(uint8_t p = 0; p < n - 1; p++) {
+			for(uint8_t q = p + 1; q < n; q++) {
+				float apq = w[p * n + q];
+
+				if(fabsf(apq) < 1e-30f) {
+					continue;
+				}
+
+				/* rotation angle which zeroes w[p][q] */
+				float theta = (w[q * n + q] - w[p * n + p]) / (2.0f * apq);
+				float t = (theta >= 0.0f ? 1.0f : -1.0f) / (fabsf(theta) + sqrtf(theta * theta + 1.0f));
+				float c = 1.0f / sqrtf(t * t + 1.0f);
+				float s = t * c;
+
+				for(uint8_t k = 0; k < n; k++) {
+					float wkp = w[k * n + p];
+					float wkq = w[k * n + q];
+
+					w[k * n + p] = c * wkp - s * wkq;
+					w[k * n + q] = s * wkp + c * wkq;
+				}
+
+				for(uint8_t k = 0; k < n; k++) {
+					float wpk = w[p * n + k];
+					float wqk = w[q * n + k];
+
+					w[p * n + k] = c * wpk - s * wqk;
+					w[q * n + k] = s * wpk + c * wqk;
+				}
+
+				for(uint8_t k = 0; k < n; k++) {
+					float vkp = eig_vec[k * n + p];
+					float vkq = eig_vec[k * n + q];
+
+					eig_vec[k * n + p] = c * vkp - s * vkq;
+					eig_vec[k * n + q] = s * vkp + c * vkq;
+				}
+
+				/* exact zero instead of round-off */
+				w[p * n + q] = w[q * n + p] = 0.0f;
+			}
+		}
+	}
+
+	/* not converged */
+	return FMT_ERROR;
+}
+
+/* direction cosine matrix from body frame to navigation frame, v_n = C * v_b */
+void mat3_from_quaternion(Mat3f* dcm, const quaternion* q)
+{
+	float x2 = q->x * 2.0f;
+	float y2 = q->y * 2.0f;
+	float z2 = q->z * 2.0f;
+	float wx2 = q->w * x2;
+	float wy2 = q->w * y2;
+	float wz2 = q->w * z2;
+	float xx2 = q->x * x2;
+	float yy2 = q->y * y2;
+	float zz2 = q->z * z2;
+	float xy2 = q->x * y2;
+	float yz2 = q->y * z2;
+	float xz2 = q->z * x2;
+
+	dcm->e[0][0] = 1.0f - yy2 - zz2;
+	dcm->e[0][1] = xy2 - wz2;
+	dcm->e[0][2] = xz2 + wy2;
+	dcm->e[1][0] = xy2 + wz2;
+	dcm->e[1][1] = 1.0f - xx2 - zz2;
+	dcm->e[1][2] = yz2 - wx2;
+	dcm->e[2][0] = xz2 - wy2;
+	dcm->e[2][1] = yz2 + wx2;
+	dcm->e[2][2] = 1.0f - xx2 - yy2;
+}
+
+/* inverse of mat3_from_quaternion(), picks the largest component to stay accurate */
+void mat3_to_quaternion(const Mat3f* dcm, quaternion* q)
+{
+	float tr = dcm->e[0][0] + dcm->e[1][1] + dcm->e[2][2];
+	float s;
+
+	if(tr > 0.0f) {
+		s = sqrtf(tr + 1.0f) * 2.0f;
+		q->w = 0.25f * s;
+		q->x = (dcm->e[2][1] - dcm->e[1][2]) / s;
+		q->y = (dcm->e[0][2] - dcm->e[2][0]) / s;
+		q->z = (dcm->e[1][0] - dcm->e[0][1]) / s;
+	} else if(dcm->e[0][0] > dcm->e[1][1] && dcm->e[0][0] > dcm->e[2][2]) {
+		s = sqrtf(1.0f + dcm->e[0][0] - dcm->e[1][1] - dcm->e[2][2]) * 2.0f;
+		q->w = (dcm->e[2][1] - dcm->e[1][2]) / s;
+		q->x = 0.25f * s;
+		q->y = (dcm->e[0][1] + dcm->e[1][0]) / s;
+		q->z = (dcm->e[0][2] + dcm->e[2][0]) / s;
+	} else if(dcm->e[1][1] > dcm->e[2][2]) {
+		s = sqrtf(1.0f + dcm->e[1][1] - dcm->e[0][0] - dcm->e[2][2]) * 2.0f;
+		q->w = (dcm->e[0][2] - dcm->e[2][0]) / s;
+		q->x = (dcm->e[0][1] + dcm->e[1][0]) / s;
+		q->y = 0.25f * s;
+		q->z = (dcm->e[1][2] + dcm->e[2][1]) / s;
+	} else {
+		s = sqrtf(1.0f + dcm->e[2][2] - dcm->e[0][0] - dcm->e[1][1]) * 2.0f;
+		q->w = (dcm->e[1][0] - dcm->e[0][1]) / s;
+		q->x = (dcm->e[0][2] + dcm->e[2][0]) / s;
+		q->y = (dcm->e[1][2] + dcm->e[2][1]) / s;
+		q->z = 0.25f * s;
+	}
+
+	if(q->w < 0.0f) {
+		/* keep scalar part positive */
+		q->w = -q->w;
+		q->x = -q->x;
+		q->y = -q->y;
+		q->z = -q->z;
+	}
+}
+
+/* rotate a batch of vectors, the dcm is built once so each vector costs 9 mul */
+void quaternion_rotate_vectors(const quaternion* q, const float (*from)[3], float (*to)[3], uint32_t num)
+{
+	Mat3f dcm;
+
+	mat3_from_quaternion(&dcm, q);
+
+	for(uint32_t i = 0; i < num; i++) {
+		mat3_mul_vec(&dcm, from[i], to[i]);
+	}
+}
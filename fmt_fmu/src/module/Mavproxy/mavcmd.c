@@ -16,13 +16,14 @@
 
 #include <firmament.h>
 #include <string.h>
-#include <calibration.h>
 
 #include "task/task_vehicle.h"
 #include "task/task_comm.h"
 #include "module/mavproxy/mavcmd.h"
 #include "module/sensor/sensor_manager.h"
 #include "module/ftp/ftp_manager.h"
+#include "module/calibration/ellipsoid_fit.h"
+#include "module/system/perf.h"
 
 MCN_DECLARE(sensor_imu);
 MCN_DECLARE(sensor_mag);
@@ -60,12 +61,9 @@ typedef struct {
 	uint8_t             done_flag[6];
 	uint32_t            cnt[6];
 	acc_position        acc_pos;
-	double              v[9];
-	double              next_v[9];
-	double              P[81];
-	double              next_P[81];
-	double              bias[3];
-	double              RotM[9];
+	EllipsoidFit        fit;
+	float               bias[3];
+	float               RotM[9];
 } MAVCMD_CALIB_ACC;
 
 typedef struct {
@@ -74,12 +72,9 @@ typedef struct {
 	uint8_t             done_flag[3];
 	uint32_t            cnt;
 	acc_position        acc_pos;
-	double              v[9];
-	double              next_v[9];
-	double              P[81];
-	double              next_P[81];
-	double              bias[3];
-	double              RotM[9];
+	EllipsoidFit        fit;
+	float               bias[3];
+	float               RotM[9];
 } MAVCMD_CALIB_MAG;
 
 typedef struct {
@@ -95,8 +90,11 @@ static MAVCMD_CALIB_MAG mavcmd_calib_mag = {0};
 static JitterDetect jitter_detect;
 // static uint32_t mavcmd_timestamp = 0;
 static uint8_t _mavcmd_set[MAVCMD_ITEM_NUM] = {0};
+/* initial parameter variance, acc calibration doesn't fit cross terms */
+static const float _acc_fit_p0[ELLIPSOID_PARAM_NUM] = { 10.0f, 10.0f, 10.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+static const float _mag_fit_p0[ELLIPSOID_PARAM_NUM] = { 10.0f, 10.0f, 10.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
 
-static StreamSession* _ftp_stream_session = NULL;
+PERF_DEFINE(calib_fit);
 
 static acc_position _acc_position_detect(void)
 {
@@ -294,25 +292,8 @@ void _acc_mavlink_calibration(void)
 
 	if(mavcmd_calib_acc.status == 0) {
 
-		calibration_initialize();
-
-		for(uint8_t i = 0 ; i < 81 ; i++) {
-			mavcmd_calib_acc.P[i] = 0.0;
-		}
-
-		mavcmd_calib_acc.P[0] = 10.0;
-		mavcmd_calib_acc.P[1 + 9] = 10.0;
-		mavcmd_calib_acc.P[2 + 18] = 10.0;
-		mavcmd_calib_acc.P[3 + 27] = 0.0;
-		mavcmd_calib_acc.P[4 + 36] = 0.0;
-		mavcmd_calib_acc.P[5 + 45] = 0.0;
-		mavcmd_calib_acc.P[6 + 54] = 1.0;
-		mavcmd_calib_acc.P[7 + 63] = 1.0;
-		mavcmd_calib_acc.P[8 + 72] = 1.0;
-
-		for(uint8_t i = 0 ; i < 9 ; i++) {
-			mavcmd_calib_acc.v[i] = 0.0;
-		}
+		ellipsoid_fit_init(&mavcmd_calib_acc.fit, _acc_fit_p0, 0.001f);
+		perf_register(PERF_ID(calib_fit));
 
 		mavcmd_calib_acc.acc_pos = ACC_POS_IDLE;
 		mavcmd_calib_acc.status = 1;
@@ -337,17 +318,10 @@ void _acc_mavlink_calibration(void)
 			IMU_Report imu_report;
 			mcn_copy_from_hub(MCN_ID(sensor_imu), &imu_report);
 
-			ellipsoid_fit_step(imu_report.acc_B_mDs2[0], imu_report.acc_B_mDs2[1], imu_report.acc_B_mDs2[2],
-			                   mavcmd_calib_acc.v, mavcmd_calib_acc.P, 0.001,
-			                   mavcmd_calib_acc.next_v, mavcmd_calib_acc.next_P);
-
-			for(uint8_t i = 0 ; i < 9 ; i++) {
-				mavcmd_calib_acc.v[i] = mavcmd_calib_acc.next_v[i];
-			}
-
-			for(uint8_t i = 0 ; i < 81 ; i++) {
-				mavcmd_calib_acc.P[i] = mavcmd_calib_acc.next_P[i];
-			}
+			PERF_BEGIN(calib_fit);
+			ellipsoid_fit_update(&mavcmd_calib_acc.fit, imu_report.acc_B_mDs2[0], imu_report.acc_B_mDs2[1],
+			                     imu_report.acc_B_mDs2[2]);
+			PERF_END(calib_fit);
 
 			mavcmd_calib_acc.cnt[mavcmd_calib_acc.acc_pos] += 1;
 
@@ -376,16 +350,17 @@ void _acc_mavlink_calibration(void)
 		}
 
 		if(finish) {
-			creal_T mat[9];
-			double u[9];
-			creal_T radii[3];
-
-			ellipsoid_fit_solve(mavcmd_calib_acc.v, mat, mavcmd_calib_acc.bias, u, radii);
+			EllipsoidResult result;
 
-			for(uint8_t i = 0; i < 9; i++) {
-				mavcmd_calib_acc.RotM[i] = mat[i].re;
+			if(ellipsoid_fit_result(&mavcmd_calib_acc.fit, &result) != FMT_EOK) {
+				_send_statustext_msg(CAL_FAILED, &msg);
+				_acc_calibration_reset();
+				return;
 			}
 
+			memcpy(mavcmd_calib_acc.bias, result.bias, sizeof(mavcmd_calib_acc.bias));
+			memcpy(mavcmd_calib_acc.RotM, result.mat, sizeof(mavcmd_calib_acc.RotM));
+
 			_send_statustext_msg(CAL_DONE, &msg);
 
 			console_printf("bias:%f %f %f\n", mavcmd_calib_acc.bias[0], mavcmd_calib_acc.bias[1], mavcmd_calib_acc.bias[2]);
@@ -432,25 +407,8 @@ void _mag_mavlink_calibration(void)
 
 	switch(mavcmd_calib_mag.status) {
 		case 0: {
-			calibration_initialize();
-
-			for(uint8_t i = 0 ; i < 81 ; i++) {
-				mavcmd_calib_mag.P[i] = 0.0;
-			}
-
-			mavcmd_calib_mag.P[0] = 10.0;
-			mavcmd_calib_mag.P[1 + 9] = 10.0;
-			mavcmd_calib_mag.P[2 + 18] = 10.0;
-			mavcmd_calib_mag.P[3 + 27] = 1.0;
-			mavcmd_calib_mag.P[4 + 36] = 1.0;
-			mavcmd_calib_mag.P[5 + 45] = 1.0;
-			mavcmd_calib_mag.P[6 + 54] = 1.0;
-			mavcmd_calib_mag.P[7 + 63] = 1.0;
-			mavcmd_calib_mag.P[8 + 72] = 1.0;
-
-			for(uint8_t i = 0 ; i < 9 ; i++) {
-				mavcmd_calib_mag.v[i] = 0.0;
-			}
+			ellipsoid_fit_init(&mavcmd_calib_mag.fit, _mag_fit_p0, 0.001f);
+			perf_register(PERF_ID(calib_fit));
 
 			_send_statustext_msg(CAL_START_MAG, &msg);
 
@@ -515,17 +473,10 @@ void _mag_mavlink_calibration(void)
 
 				mcn_copy_from_hub(MCN_ID(sensor_mag), &mag_report);
 
-				ellipsoid_fit_step(mag_report.mag_B_gauss[0], mag_report.mag_B_gauss[1], mag_report.mag_B_gauss[2],
-				                   mavcmd_calib_mag.v, mavcmd_calib_mag.P, 0.001,
-				                   mavcmd_calib_mag.next_v, mavcmd_calib_mag.next_P);
-
-				for(uint8_t i = 0 ; i < 9 ; i++) {
-					mavcmd_calib_mag.v[i] = mavcmd_calib_mag.next_v[i];
-				}
-
-				for(uint8_t i = 0 ; i < 81 ; i++) {
-					mavcmd_calib_mag.P[i] = mavcmd_calib_mag.next_P[i];
-				}
+				PERF_BEGIN(calib_fit);
+				ellipsoid_fit_update(&mavcmd_calib_mag.fit, mag_report.mag_B_gauss[0], mag_report.mag_B_gauss[1],
+				                     mag_report.mag_B_gauss[2]);
+				PERF_END(calib_fit);
 
 				if(++mavcmd_calib_mag.cnt >= MAG_CALIBRATE_COUNT) {
 					if(mavcmd_calib_mag.acc_pos == ACC_POS_DOWN) {
@@ -560,16 +511,17 @@ void _mag_mavlink_calibration(void)
 		break;
 
 		case 3: {
-			creal_T mat[9];
-			double u[9];
-			creal_T radii[3];
-
-			ellipsoid_fit_solve(mavcmd_calib_mag.v, mat, mavcmd_calib_mag.bias, u, radii);
+			EllipsoidResult result;
 
-			for(uint8_t i = 0; i < 9; i++) {
-				mavcmd_calib_mag.RotM[i] = mat[i].re;
+			if(ellipsoid_fit_result(&mavcmd_calib_mag.fit, &result) != FMT_EOK) {
+				_send_statustext_msg(CAL_FAILED, &msg);
+				_mag_calibration_reset();
+				break;
 			}
 
+			memcpy(mavcmd_calib_mag.bias, result.bias, sizeof(mavcmd_calib_mag.bias));
+			memcpy(mavcmd_calib_mag.RotM, result.mat, sizeof(mavcmd_calib_mag.RotM));
+
 			_send_statustext_msg(CAL_DONE, &msg);
 
 			console_printf("bias:%f %f %f\n", mavcmd_calib_mag.bias[0], mavcmd_calib_mag.bias[1], mavcmd_calib_mag.bias[2]);
@@ -623,11 +575,8 @@ void mavcmd_set(MavCmd_ID cmd, void* data)
 		_mag_calibration_init();
 	} else if(cmd == MAVCMD_STREAM_SESSION) {
 
-		if(data) {
-			/* ftp stream session */
-			_ftp_stream_session = (StreamSession*)data;
-			_mavcmd_set[cmd] = 1;
-		}
+		/* ftp burst sessions are kept by ftp manager */
+		_mavcmd_set[cmd] = 1;
 	} else {
 		/* unknown command */
 		return ;
@@ -654,6 +603,6 @@ void mavcmd_process(void)
 	}
 
 	if(_mavcmd_set[MAVCMD_STREAM_SESSION]) {
-		ftp_stream_send(_ftp_stream_session);
+		ftp_stream_process();
 	}
 }
\ No newline at end of file
@@ -69,21 +69,8 @@ void mav_console_handle_timeout(void)
     serial_control.device = SERIAL_CONTROL_DEV_SHELL;
     serial_control.flags = SERIAL_CONTROL_FLAG_REPLY;
 
-    while (ringbuffer_getlen(_mav_console_tx_rb) >= 70) {
-
-        serial_control.count = 70;
-        ringbuffer_get(_mav_console_tx_rb, serial_control.data, serial_control.count);
-
-        send_serial_control_msg(&serial_control);
-    }
-
-    uint32_t len = ringbuffer_getlen(_mav_console_tx_rb);
-
-    if (len) {
-        serial_control.count = len;
-
-        ringbuffer_get(_mav_console_tx_rb, serial_control.data, serial_control.count);
-
+    /* a writer may drain the buffer at the same time, only send what is read */
+    while ((serial_control.count = ringbuffer_get(_mav_console_tx_rb, serial_control.data, 70)) > 0) {
         send_serial_control_msg(&serial_control);
     }
 }
@@ -202,12 +189,15 @@ static rt_size_t _write(struct rt_device* dev,
             mavlink_serial_control_t serial_control;
 
             serial_control.baudrate = 0;
-            serial_control.count = 70;
             serial_control.device = SERIAL_CONTROL_DEV_SHELL;
             serial_control.flags = SERIAL_CONTROL_FLAG_REPLY;
 
-            /* read data from buffer */
-            ringbuffer_get(_mav_console_tx_rb, serial_control.data, serial_control.count);
+            /* read data from buffer, another thread may have drained it since */
+            serial_control.count = ringbuffer_get(_mav_console_tx_rb, serial_control.data, 70);
+
+            if (serial_control.count == 0) {
+                break;
+            }
 
             send_serial_control_msg(&serial_control);
         }
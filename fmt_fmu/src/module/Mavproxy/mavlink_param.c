@@ -19,6 +19,7 @@
 
 #include "task/task_comm.h"
 #include "module/mavproxy/mavlink_param.h"
+#include "module/param/model_param.h"
 
 #define MAV_PARAM_COUNT         (sizeof(mav_param_list_t) / sizeof(mav_param_t))
 
@@ -453,6 +454,8 @@ fmt_err mavlink_param_set(const char* name, float val)
 			return FMT_EINVAL;
 	}
 
+	model_param_notify(param);
+
 	return FMT_EOK;
 }
 
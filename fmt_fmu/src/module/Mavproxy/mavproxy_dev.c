@@ -21,7 +21,7 @@
 #include "task/task_comm.h"
 #include "module/mavproxy/mavcmd.h"
 #include "hal/cdcacm.h"
-#include "hal/cdcacm.h"
+#include "hal/serial.h"
 
 
 #define MAVPROXY_DEV_CHAN_NUM       2
@@ -29,6 +29,9 @@
 static rt_device_t _mavproxy_dev = RT_NULL;
 static rt_sem_t _mavproxy_dev_rx_sem, _mavproxy_dev_tx_sem;
 static uint8_t _dev_chan;
+/* for devices without zero-copy rx, data is read into this buffer by peek */
+static uint8_t _rx_copy_buf[64];
+static uint8_t _rx_copied;
 
 static char chan_device[MAVPROXY_DEV_CHAN_NUM][10] = {
 	{MAVPROXY_CHAN1_DEVICE_NAME},
@@ -104,16 +107,22 @@ uint8_t mavproxy_dev_used_channel(void)
 rt_size_t mavproxy_dev_sync_write(uint8_t chan, const void* buffer, uint32_t len)
 {
 	rt_size_t size;
+	rt_err_t err;
 
 	switch_chan_if_needed(chan);
 
-	/* write data to device */
-	OS_ENTER_CRITICAL;
-	size = rt_device_write(_mavproxy_dev, 0, buffer, len);
-	OS_EXIT_CRITICAL;
+	do {
+		/* write data to device */
+		OS_ENTER_CRITICAL;
+		rt_set_errno(RT_EOK);
+		size = rt_device_write(_mavproxy_dev, 0, buffer, len);
+		err = rt_get_errno();
+		OS_EXIT_CRITICAL;
 
-	/* wait write complete (synchronized write) */
-	rt_sem_take(_mavproxy_dev_tx_sem, RT_WAITING_FOREVER);
+		/* wait write complete (synchronized write). if device tx buffer is full,
+		 * the semaphore is released once there is room and the write is retried */
+		rt_sem_take(_mavproxy_dev_tx_sem, RT_WAITING_FOREVER);
+	} while(size == 0 && err == RT_EFULL);
 
 	return size;
 }
@@ -170,6 +179,34 @@ rt_size_t mavproxy_dev_read(uint8_t chan, void* buffer, uint32_t len, int32_t ti
 	return cnt;
 }
 
+/* get received data without copying it out of the device fifo if possible,
+ * the data should be released by mavproxy_dev_consume() after processed */
+rt_size_t mavproxy_dev_peek(uint8_t chan, uint8_t** data)
+{
+	struct serial_rx_span span = { RT_NULL, 0 };
+
+	switch_chan_if_needed(chan);
+
+	if(rt_device_control(_mavproxy_dev, SERIAL_CTRL_RX_PEEK, &span) == RT_EOK && span.data != RT_NULL) {
+		_rx_copied = 0;
+		*data = span.data;
+
+		return span.len;
+	}
+
+	_rx_copied = 1;
+	*data = _rx_copy_buf;
+
+	return rt_device_read(_mavproxy_dev, 0, _rx_copy_buf, sizeof(_rx_copy_buf));
+}
+
+void mavproxy_dev_consume(uint8_t chan, rt_size_t len)
+{
+	if(!_rx_copied) {
+		rt_device_control(_mavproxy_dev, SERIAL_CTRL_RX_CONSUME, (void*)len);
+	}
+}
+
 void mavproxy_dev_set_rx_indicate(fmt_err(*rx_ind)(uint32_t size))
 {
 	_mav_rx_indicate = rx_ind;
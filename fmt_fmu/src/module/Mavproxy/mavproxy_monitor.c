@@ -138,7 +138,8 @@ void mavproxy_rx_entry(void* param)
     mavlink_message_t msg;
     mavlink_status_t mav_status;
     mavlink_system_t mavlink_system;
-    char byte;
+    uint8_t* data;
+    rt_size_t len;
     rt_uint32_t recv_set = 0;
     rt_uint32_t wait_set = EVENT_MAV_RX;
     rt_err_t rt_err;
@@ -152,11 +153,15 @@ void mavproxy_rx_entry(void* param)
 
         if (rt_err == RT_EOK) {
             if (recv_set & EVENT_MAV_RX) {
-                while (mavproxy_dev_read(_mav_dev_chan, &byte, 1, 0)) {
-                    /* decode mavlink package */
-                    if (mavlink_parse_char(0, byte, &msg, &mav_status) == 1) {
-                        _handle_mavlink_msg(&msg, mavlink_system);
+                while ((len = mavproxy_dev_peek(_mav_dev_chan, &data)) > 0) {
+                    for (rt_size_t i = 0; i < len; i++) {
+                        /* decode mavlink package */
+                        if (mavlink_parse_char(0, data[i], &msg, &mav_status) == 1) {
+                            _handle_mavlink_msg(&msg, mavlink_system);
+                        }
                     }
+
+                    mavproxy_dev_consume(_mav_dev_chan, len);
                 }
             }
         } else {
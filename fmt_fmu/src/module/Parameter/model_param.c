@@ -0,0 +1,121 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <Controller.h>
+#include <FMS.h>
+#include <firmament.h>
+
+#include "module/param/model_param.h"
+
+#define TAG "Model_Param"
+
+#define MODEL_PARAM_MAX_NUM 64
+
+typedef struct {
+    param_group_t* group;
+    McnHub* hub;
+    void* model; /* parameter struct of codegen model */
+    uint32_t size;
+} model_param_table_t;
+
+/* latest parameter table of each model */
+MCN_DEFINE(control_param, sizeof(CONTROL_PARAM));
+MCN_DEFINE(fms_param, sizeof(FMS_PARAM));
+
+static model_param_table_t _table[] = {
+    { &param_list.PARAM_GROUP(CONTROL), MCN_ID(control_param), &CONTROL_PARAM, sizeof(CONTROL_PARAM) },
+    { &param_list.PARAM_GROUP(FMS), MCN_ID(fms_param), &FMS_PARAM, sizeof(FMS_PARAM) },
+};
+
+static struct rt_mutex _publish_lock;
+static uint8_t _ready = 0;
+
+static fmt_err _publish(model_param_table_t* table)
+{
+    float buffer[MODEL_PARAM_MAX_NUM];
+    fmt_err err;
+
+    /* serialize setters, so the last published table has every update */
+    rt_mutex_take(&_publish_lock, RT_WAITING_FOREVER);
+
+    for (int i = 0; i < table->group->param_num; i++) {
+        buffer[i] = table->group->content[i].val.f;
+    }
+
+    err = mcn_publish(table->hub, buffer);
+
+    rt_mutex_release(&_publish_lock);
+
+    return err;
+}
+
+// called by parameter module after the value of param is changed
+void model_param_notify(const param_t* param)
+{
+    if (!_ready) {
+        return;
+    }
+
+    for (int i = 0; i < sizeof(_table) / sizeof(model_param_table_t); i++) {
+        param_group_t* group = _table[i].group;
+
+        if (param >= group->content && param < group->content + group->param_num) {
+            _publish(&_table[i]);
+            return;
+        }
+    }
+}
+
+// should be called before parameters are loaded from file
+fmt_err model_param_init(void)
+{
+    if (rt_mutex_init(&_publish_lock, "mparam", RT_IPC_FLAG_FIFO) != RT_EOK) {
+        return FMT_ERROR;
+    }
+
+    for (int i = 0; i < sizeof(_table) / sizeof(model_param_table_t); i++) {
+        model_param_table_t* table = &_table[i];
+        const float* model = (const float*)table->model;
+
+        /* group must mirror the struct member by member */
+        if (table->group->param_num > MODEL_PARAM_MAX_NUM
+            || table->group->param_num * sizeof(float) != table->size) {
+            ulog_e(TAG, "%s does not match model parameter", table->group->name);
+            return FMT_EINVAL;
+        }
+
+        for (int k = 0; k < table->group->param_num; k++) {
+            if (table->group->content[k].type != PARAM_TYPE_FLOAT) {
+                ulog_e(TAG, "%s.%s is not float", table->group->name, table->group->content[k].name);
+                return FMT_EINVAL;
+            }
+            /* model default is the parameter default */
+            table->group->content[k].val.f = model[k];
+        }
+
+        if (mcn_advertise(table->hub, NULL) != FMT_EOK) {
+            return FMT_ERROR;
+        }
+
+        if (_publish(table) != FMT_EOK) {
+            return FMT_ERROR;
+        }
+    }
+
+    _ready = 1;
+
+    return FMT_EOK;
+}
@@ -19,6 +19,7 @@
 #include <string.h>
 
 #include "module/fs_manager/fs_manager.h"
+#include "module/param/model_param.h"
 
 #define TAG "Param"
 
@@ -42,6 +43,20 @@ PARAM_DECLARE_GROUP(SYSTEM) = {
 	2: from boot until disarm
 	3: from boot until shutdown  */
     PARAM_DEFINE_INT32(BLOG_MODE, 0),
+    /* vehicle loop trigger source:
+	0: os tick timer (1ms)
+	1: main imu data-ready interrupt */
+    PARAM_DEFINE_INT32(IMU_SYNC, 0),
+    /* gps navigation solution rate in Hz (1 ~ 25) */
+    PARAM_DEFINE_INT32(GPS_RATE, 10),
+    /* motor output protocol, 0: pwm 1: dshot150 2: dshot300 3: dshot600 */
+    PARAM_DEFINE_INT32(MOTOR_PROTOCOL, 0),
+    /* 1: enable bidirectional dshot (eRPM telemetry) */
+    PARAM_DEFINE_INT32(MOTOR_BIDIR, 0),
+    /* motor magnetic pole number, to convert eRPM to RPM */
+    PARAM_DEFINE_INT32(MOTOR_POLES, 14),
+    /* background calibration, bit0: gyro bias bit1: mag */
+    PARAM_DEFINE_INT32(BG_CALIB, 0),
 };
 
 PARAM_GROUP(CALIB)
@@ -102,10 +117,61 @@ PARAM_DECLARE_GROUP(CALIB) = {
     PARAM_DEFINE_FLOAT(MAG1_YZSCALE, 0.0),
 };
 
+/* tunables of the codegen models, defaults are taken from the model by model_param_init() */
+PARAM_GROUP(CONTROL)
+PARAM_DECLARE_GROUP(CONTROL) = {
+    PARAM_DEFINE_FLOAT(VEL_XY_P, 0.0),
+    PARAM_DEFINE_FLOAT(VEL_XY_I, 0.0),
+    PARAM_DEFINE_FLOAT(VEL_XY_D, 0.0),
+    PARAM_DEFINE_FLOAT(VEL_Z_P, 0.0),
+    PARAM_DEFINE_FLOAT(VEL_Z_I, 0.0),
+    PARAM_DEFINE_FLOAT(VEL_Z_D, 0.0),
+    PARAM_DEFINE_FLOAT(VEL_XY_I_MIN, 0.0),
+    PARAM_DEFINE_FLOAT(VEL_XY_I_MAX, 0.0),
+    PARAM_DEFINE_FLOAT(VEL_XY_D_MIN, 0.0),
+    PARAM_DEFINE_FLOAT(VEL_XY_D_MAX, 0.0),
+    PARAM_DEFINE_FLOAT(VEL_Z_I_MIN, 0.0),
+    PARAM_DEFINE_FLOAT(VEL_Z_I_MAX, 0.0),
+    PARAM_DEFINE_FLOAT(VEL_Z_D_MIN, 0.0),
+    PARAM_DEFINE_FLOAT(VEL_Z_D_MAX, 0.0),
+    PARAM_DEFINE_FLOAT(RP_CMD_LIM, 0.0),
+    PARAM_DEFINE_FLOAT(RP_RATE_CMD_LIM, 0.0),
+    PARAM_DEFINE_FLOAT(YAW_RATE_CMD_LIM, 0.0),
+    PARAM_DEFINE_FLOAT(ROLL_P, 0.0),
+    PARAM_DEFINE_FLOAT(PITCH_P, 0.0),
+    PARAM_DEFINE_FLOAT(ROLL_RATE_P, 0.0),
+    PARAM_DEFINE_FLOAT(PITCH_RATE_P, 0.0),
+    PARAM_DEFINE_FLOAT(YAW_RATE_P, 0.0),
+    PARAM_DEFINE_FLOAT(ROLL_RATE_I, 0.0),
+    PARAM_DEFINE_FLOAT(PITCH_RATE_I, 0.0),
+    PARAM_DEFINE_FLOAT(YAW_RATE_I, 0.0),
+    PARAM_DEFINE_FLOAT(ROLL_RATE_D, 0.0),
+    PARAM_DEFINE_FLOAT(PITCH_RATE_D, 0.0),
+    PARAM_DEFINE_FLOAT(YAW_RATE_D, 0.0),
+    PARAM_DEFINE_FLOAT(RATE_I_MIN, 0.0),
+    PARAM_DEFINE_FLOAT(RATE_I_MAX, 0.0),
+    PARAM_DEFINE_FLOAT(RATE_D_MIN, 0.0),
+    PARAM_DEFINE_FLOAT(RATE_D_MAX, 0.0),
+};
+
+PARAM_GROUP(FMS)
+PARAM_DECLARE_GROUP(FMS) = {
+    PARAM_DEFINE_FLOAT(STICK_DEADZONE, 0.0),
+    PARAM_DEFINE_FLOAT(XY_P, 0.0),
+    PARAM_DEFINE_FLOAT(Z_P, 0.0),
+    PARAM_DEFINE_FLOAT(VEL_XY_LIM, 0.0),
+    PARAM_DEFINE_FLOAT(VEL_Z_LIM, 0.0),
+    PARAM_DEFINE_FLOAT(YAW_P, 0.0),
+    PARAM_DEFINE_FLOAT(YAW_RATE_LIM, 0.0),
+    PARAM_DEFINE_FLOAT(ROLL_PITCH_LIM, 0.0),
+};
+
 /******************** Step 2: Define Group ********************/
 param_list_t param_list = {
     PARAM_DEFINE_GROUP(SYSTEM),
     PARAM_DEFINE_GROUP(CALIB),
+    PARAM_DEFINE_GROUP(CONTROL),
+    PARAM_DEFINE_GROUP(FMS),
 };
 
 static fmt_err _parse_xml(yxml_t* x, yxml_ret_t r, PARAM_PARSE_STATE* status)
@@ -385,6 +451,8 @@ fmt_err param_set_string_val(param_t* param, char* val)
         param->val.lf = atof(val);
     }
 
+    model_param_notify(param);
+
     return FMT_EOK;
 }
 
@@ -441,6 +509,8 @@ fmt_err param_set_val(param_t* param, void* val)
         return FMT_ENOTHANDLE;
     }
 
+    model_param_notify(param);
+
     return FMT_EOK;
 }
 
@@ -591,6 +661,11 @@ fmt_err param_load(char* path)
 
 fmt_err param_init(void)
 {
+    /* take model defaults before loading, so loaded values reach the models */
+    if (model_param_init() != FMT_EOK) {
+        ulog_e(TAG, "model parameter init fail");
+    }
+
     param_load(PARAM_FILE_NAME);
 
     return FMT_EOK;
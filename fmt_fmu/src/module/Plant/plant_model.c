@@ -18,6 +18,7 @@
 #include <firmament.h>
 
 #include "module/sensor/sensor_manager.h"
+#include "module/system/perf.h"
 
 #define TAG "Plant"
 
@@ -25,6 +26,9 @@
 
 // sensor topics to publish
 MCN_DECLARE(sensor_imu);
+#if defined(FMT_INS_INSTANCE_NUM) && FMT_INS_INSTANCE_NUM > 1
+MCN_DECLARE(sensor_imu1);
+#endif
 MCN_DECLARE(sensor_mag);
 MCN_DECLARE(sensor_baro);
 MCN_DECLARE(sensor_gps);
@@ -32,20 +36,45 @@ MCN_DECLARE(sensor_gps);
 // plant model input
 MCN_DECLARE(control_output);
 
+
+/* wakeup period of the sih thread in ms, plant catches up with real time in sub-steps */
+#ifndef FMT_SIH_PERIOD
+    #define FMT_SIH_PERIOD 1
+#endif
+
+/* plant slips behind real time if it needs more sub-steps in one wakeup */
+#define SIH_MAX_SUBSTEP 8
+
 static McnNode_t _control_out_nod;
 
-static void _publish_sensor_data(void)
+static struct rt_thread _sih_thread;
+static uint8_t _sih_thread_stack[2048] __attribute__((aligned(8)));
+static struct rt_timer _sih_timer;
+static struct rt_semaphore _sih_sem;
+
+/* integration step of the plant codegen, plant time only moves by this step */
+static uint32_t _sih_step_us;
+/* time the plant has been simulated to */
+static uint64_t _plant_time_us;
+/* number of times the plant slipped behind real time */
+static uint32_t _sih_slip;
+
+/* all sub-steps run in one wakeup */
+PERF_DEFINE(sih_step);
+
+static void _publish_sensor_data(uint64_t time_now_us)
 {
     static uint32_t imu_timestamp = 0xFFFF;
     static uint32_t mag_timestamp = 0xFFFF;
     static uint32_t baro_timestamp = 0xFFFF;
     static uint32_t gps_timestamp = 0xFFFF;
-    uint32_t time_now = systime_now_ms();
+    uint32_t time_now = (uint32_t)(time_now_us / 1000);
 
     if (Plant_Y.IMU.timestamp != imu_timestamp) {
         IMU_Report imu_report;
 
         imu_report.timestamp_ms = time_now;
+        imu_report.timestamp_us = time_now_us;
         imu_report.gyr_B_radDs[0] = Plant_Y.IMU.gyr_x;
         imu_report.gyr_B_radDs[1] = Plant_Y.IMU.gyr_y;
         imu_report.gyr_B_radDs[2] = Plant_Y.IMU.gyr_z;
@@ -54,6 +83,10 @@ static void _publish_sensor_data(void)
         imu_report.acc_B_mDs2[2] = Plant_Y.IMU.acc_z;
         // publish sensor_imu data
         mcn_publish(MCN_ID(sensor_imu), &imu_report);
+#if defined(FMT_INS_INSTANCE_NUM) && FMT_INS_INSTANCE_NUM > 1
+        /* plant has a single imu, the second INS gets the same data */
+        mcn_publish(MCN_ID(sensor_imu1), &imu_report);
+#endif
 
         imu_timestamp = Plant_Y.IMU.timestamp;
     }
@@ -62,6 +95,7 @@ static void _publish_sensor_data(void)
         Mag_Report mag_report;
 
         mag_report.timestamp_ms = time_now;
+        mag_report.timestamp_us = time_now_us;
         mag_report.mag_B_gauss[0] = Plant_Y.MAG.mag_x;
         mag_report.mag_B_gauss[1] = Plant_Y.MAG.mag_y;
         mag_report.mag_B_gauss[2] = Plant_Y.MAG.mag_z;
@@ -75,6 +109,7 @@ static void _publish_sensor_data(void)
         Baro_Report baro_report;
 
         baro_report.timestamp_ms = time_now;
+        baro_report.timestamp_us = time_now_us;
         baro_report.temperature_deg = Plant_Y.Barometer.temperature;
         baro_report.pressure_pa = Plant_Y.Barometer.pressure;
         // publish SNESOR_BARO data
@@ -84,9 +119,10 @@ static void _publish_sensor_data(void)
     }
 
     if (Plant_Y.GPS_uBlox.timestamp != gps_timestamp) {
-        GPS_Report gps_report;
+        GPS_Report gps_report = { 0 };
 
         gps_report.timestamp_ms = time_now;
+        gps_report.timestamp_us = time_now_us;
         gps_report.fixType = Plant_Y.GPS_uBlox.fixType;
         gps_report.numSV = Plant_Y.GPS_uBlox.numSV;
         gps_report.lon = Plant_Y.GPS_uBlox.lon;
@@ -105,16 +141,17 @@ static void _publish_sensor_data(void)
     }
 }
 
-void plant_model_step(void)
+static void _plant_step(void)
 {
     static uint32_t start_time = 0;
-    uint32_t time_now = systime_now_ms();
+    uint32_t time_now = (uint32_t)(_plant_time_us / 1000);
 
     if (start_time == 0) {
         /* record first execution time */
         start_time = time_now;
     }
 
+    /* hold the latest actuator command, controller runs at its own rate */
     if (mcn_poll(_control_out_nod)) {
         mcn_copy(MCN_ID(control_output), _control_out_nod, &Plant_U.Control_Out);
     }
@@ -127,26 +164,103 @@ void plant_model_step(void)
     if (check_timetag(TIMETAG(plant_output))) {
         /* rewrite timestmp */
         Plant_Y.Plant_States.timestamp = time_now - start_time;
-        /* Log Control out data */
+        /* pushed from the sih thread above the models, blog_push_msg takes the lock */
         blog_push_msg((uint8_t*)&Plant_Y.Plant_States, BLOG_PLANT_STATE_ID, sizeof(Plant_States_Bus));
     }
 
-    _publish_sensor_data();
+    /* each sensor is published when the plant samples it, stamped with plant time */
+    _publish_sensor_data(_plant_time_us);
+}
+
+static void _sih_timer_update(void* parameter)
+{
+    rt_sem_release(&_sih_sem);
+}
+
+static void _sih_thread_entry(void* parameter)
+{
+    uint64_t time_now_us;
+    uint8_t substep;
+
+    while (1) {
+        if (rt_sem_take(&_sih_sem, RT_WAITING_FOREVER) != RT_EOK) {
+            continue;
+        }
+
+        PERF_BEGIN(sih_step);
+
+        time_now_us = systime_now_us();
+
+        for (substep = 0; time_now_us - _plant_time_us >= _sih_step_us; substep++) {
+            if (substep == SIH_MAX_SUBSTEP) {
+                /* restart from now instead of running late forever */
+                _plant_time_us = time_now_us;
+                _sih_slip++;
+                break;
+            }
+
+            _plant_time_us += _sih_step_us;
+            _plant_step();
+        }
+
+        PERF_END(sih_step);
+    }
 }
 
-void plant_model_init(void)
+uint32_t plant_model_get_slip(void)
 {
+    return _sih_slip;
+}
+
+fmt_err plant_model_init(void)
+{
+    _sih_step_us = PLANT_EXPORT.period * 1000;
+
+#ifdef FMT_SIH_STEP_US
+    /* the step is fixed when the plant is generated, a different one runs it at the wrong speed */
+    if (FMT_SIH_STEP_US != _sih_step_us) {
+        ulog_e(TAG, "FMT_SIH_STEP_US %u does not match the plant step %u us\n", (unsigned)FMT_SIH_STEP_US, (unsigned)_sih_step_us);
+        return FMT_EINVAL;
+    }
+#endif
+
     _control_out_nod = mcn_subscribe(MCN_ID(control_output), NULL, NULL);
 
     if (_control_out_nod == NULL) {
         ulog_e(TAG, "uMCN topic control_output subscribe fail!\n");
+        return FMT_ERROR;
     }
 
     Plant_init();
 
     /* run plant model to ensure INS can get valid sensor in its first run */
-    Plant_step();
-    _publish_sensor_data();
+    _plant_time_us = systime_now_us();
+    _plant_step();
+
+    perf_register(PERF_ID(sih_step));
+
+    if (rt_sem_init(&_sih_sem, "sih", 0, RT_IPC_FLAG_FIFO) != RT_EOK) {
+        return FMT_ERROR;
+    }
+
+    if (rt_thread_init(&_sih_thread, "sih", _sih_thread_entry, RT_NULL,
+            _sih_thread_stack, sizeof(_sih_thread_stack), SIH_THREAD_PRIORITY, 1)
+        != RT_EOK) {
+        return FMT_ERROR;
+    }
+
+    if (rt_thread_startup(&_sih_thread) != RT_EOK) {
+        return FMT_ERROR;
+    }
+
+    rt_timer_init(&_sih_timer, "sih", _sih_timer_update, RT_NULL, FMT_SIH_PERIOD,
+        RT_TIMER_FLAG_PERIODIC | RT_TIMER_FLAG_HARD_TIMER);
+
+    if (rt_timer_start(&_sih_timer) != RT_EOK) {
+        return FMT_ERROR;
+    }
+
+    return FMT_EOK;
 }
 
-#endif
\ No newline at end of file
+#endif
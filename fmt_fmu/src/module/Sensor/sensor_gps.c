@@ -20,13 +20,14 @@
 #include "driver/gps.h"
 
 static rt_device_t _gps_device_t;
-struct vehicle_gps_position_s _gps_position;
+static struct vehicle_gps_position_s _gps_position;
 
 fmt_err sensor_gps_get_report(GPS_Report* gps_report)
 {
 	rt_size_t r_size = rt_device_read(_gps_device_t, RD_COMPLETED_REPORT, &_gps_position, sizeof(_gps_position));
 
 	gps_report->timestamp_ms = _gps_position.timestamp_velocity;
+	gps_report->timestamp_us = _gps_position.timestamp_us;
 	gps_report->fixType = _gps_position.fix_type;
 	gps_report->numSV = _gps_position.satellites_used;
 	gps_report->lon = _gps_position.lon;
@@ -38,6 +39,11 @@ fmt_err sensor_gps_get_report(GPS_Report* gps_report)
 	gps_report->velE = _gps_position.vel_e_m_s;
 	gps_report->velD = _gps_position.vel_d_m_s;
 	gps_report->sAcc = _gps_position.s_variance_m_s;
+	gps_report->carrSoln = _gps_position.carr_soln;
+	gps_report->headingValid = _gps_position.heading_valid;
+	gps_report->iTOW = _gps_position.iTOW;
+	gps_report->heading = _gps_position.heading_rad;
+	gps_report->headingAcc = _gps_position.heading_acc_rad;
 
 	return (r_size == sizeof(_gps_position)) ? FMT_EOK : FMT_ERROR;
 }
@@ -31,11 +31,11 @@ fmt_err sensor_gyr_raw_measure(int16_t gyr[3], uint8_t imu_id)
 
 	if(imu_id > SENSOR_IMU_NUM - 1) {
 		/* invalid imu id */
-		return 0;
+		return FMT_EINVAL;
 	}
 
 	if(gyro_t[imu_id] == NULL) {
-		return 0;
+		return FMT_EEMPTY;
 	}
 
 	r_size = rt_device_read(gyro_t[imu_id], GYRO_RD_RAW, (void*)gyr, 6);
@@ -50,11 +50,11 @@ fmt_err sensor_gyr_measure(float gyr[3], uint8_t imu_id)
 
 	if(imu_id > SENSOR_IMU_NUM - 1) {
 		/* invalid imu id */
-		return 0;
+		return FMT_EINVAL;
 	}
 
 	if(gyro_t[imu_id] == NULL) {
-		return 0;
+		return FMT_EEMPTY;
 	}
 
 	r_size = rt_device_read(gyro_t[imu_id], GYRO_RD_SCALE, (void*)gyr, 12);
@@ -71,11 +71,11 @@ fmt_err sensor_acc_raw_measure(int16_t acc[3], uint8_t imu_id)
 
 	if(imu_id > SENSOR_IMU_NUM - 1) {
 		/* invalid imu id */
-		return 0;
+		return FMT_EINVAL;
 	}
 
 	if(accel_t[imu_id] == NULL) {
-		return 0;
+		return FMT_EEMPTY;
 	}
 
 	r_size = rt_device_read(accel_t[imu_id], ACCEL_RD_RAW, (void*)acc, 6);
@@ -90,11 +90,11 @@ fmt_err sensor_acc_measure(float acc[3], uint8_t imu_id)
 
 	if(imu_id > SENSOR_IMU_NUM - 1) {
 		/* invalid imu id */
-		return 0;
+		return FMT_EINVAL;
 	}
 
 	if(accel_t[imu_id] == NULL) {
-		return 0;
+		return FMT_EEMPTY;
 	}
 
 	r_size = rt_device_read(accel_t[imu_id], ACCEL_RD_SCALE, (void*)acc, 12);
@@ -102,6 +102,74 @@ fmt_err sensor_acc_measure(float acc[3], uint8_t imu_id)
 	return r_size == 12 ? FMT_EOK : FMT_ERROR;
 }
 
+/**************************	IMU API	**************************/
+
+// unit: us, timestamp of the last gyro sample
+fmt_err sensor_imu_get_timestamp(uint64_t* timestamp_us, uint8_t imu_id)
+{
+	rt_size_t r_size = 0;
+
+	if(imu_id > SENSOR_IMU_NUM - 1) {
+		/* invalid imu id */
+		return FMT_EINVAL;
+	}
+
+	if(gyro_t[imu_id]) {
+		r_size = rt_device_read(gyro_t[imu_id], GYRO_RD_TIMESTAMP, (void*)timestamp_us, sizeof(uint64_t));
+	}
+
+	if(r_size != sizeof(uint64_t)) {
+		/* driver doesn't stamp its samples, use current time instead */
+		*timestamp_us = systime_now_us();
+	}
+
+	return FMT_EOK;
+}
+
+// both gyro and accel of imu_id are present
+bool sensor_imu_available(uint8_t imu_id)
+{
+	if(imu_id > SENSOR_IMU_NUM - 1) {
+		/* invalid imu id */
+		return false;
+	}
+
+	return gyro_t[imu_id] != NULL && accel_t[imu_id] != NULL;
+}
+
+// drdy_ind is called in interrupt context on each imu data-ready, RT_NULL to disable it
+fmt_err sensor_imu_set_drdy_indicate(uint8_t imu_id, rt_err_t (*drdy_ind)(rt_device_t dev, rt_size_t size))
+{
+	rt_err_t rt_err;
+
+	if(imu_id > SENSOR_IMU_NUM - 1) {
+		/* invalid imu id */
+		return FMT_EINVAL;
+	}
+
+	if(gyro_t[imu_id] == NULL) {
+		return FMT_EEMPTY;
+	}
+
+	if(drdy_ind == RT_NULL) {
+		rt_device_control(gyro_t[imu_id], GYRO_CMD_DISABLE_DRDY, RT_NULL);
+		rt_device_set_rx_indicate(gyro_t[imu_id], RT_NULL);
+
+		return FMT_EOK;
+	}
+
+	rt_device_set_rx_indicate(gyro_t[imu_id], drdy_ind);
+	rt_err = rt_device_control(gyro_t[imu_id], GYRO_CMD_ENABLE_DRDY, RT_NULL);
+
+	if(rt_err != RT_EOK) {
+		/* driver doesn't support data-ready interrupt */
+		rt_device_set_rx_indicate(gyro_t[imu_id], RT_NULL);
+		return FMT_ENOSYS;
+	}
+
+	return FMT_EOK;
+}
+
 fmt_err sensor_imu_init(void)
 {
 	rt_err_t rt_err = FMT_EOK;
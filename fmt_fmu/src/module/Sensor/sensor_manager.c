@@ -22,12 +22,26 @@
 #include "module/sensor/sensor_baro.h"
 #include "module/sensor/sensor_gps.h"
 
+/* imu 1 feeds the second INS instance */
+#if defined(FMT_INS_INSTANCE_NUM) && FMT_INS_INSTANCE_NUM > 1
+	#define SENSOR_PUBLISH_IMU1
+#endif
+
 static IMU_Report _imu_report;
+#ifdef SENSOR_PUBLISH_IMU1
+static IMU_Report _imu1_report;
+#endif
 static Mag_Report _mag_report;
 static Baro_Report _baro_report;
 static GPS_Report _gps_report;
+static void (*_imu_drdy_cb)(void);
+/* imus published, sensor_imu and sensor_imu1 */
+static uint8_t _imu_num = 1;
 
 MCN_DEFINE(sensor_imu, sizeof(IMU_Report));
+#ifdef SENSOR_PUBLISH_IMU1
+MCN_DEFINE(sensor_imu1, sizeof(IMU_Report));
+#endif
 MCN_DEFINE(sensor_mag, sizeof(Mag_Report));
 MCN_DEFINE(sensor_baro, sizeof(Baro_Report));
 MCN_DEFINE(sensor_gps, sizeof(GPS_Report));
@@ -102,24 +116,71 @@ static int SENSOR_GPS_echo(void* param)
 	return 0;
 }
 
-// should be called in each 1ms
+static rt_err_t _imu_drdy_indicate(rt_device_t dev, rt_size_t size)
+{
+	if(_imu_drdy_cb) {
+		_imu_drdy_cb();
+	}
+
+	return RT_EOK;
+}
+
+/**
+ * Synchronize to the main imu data-ready interrupt. drdy_cb is called in
+ * interrupt context, and sensor_collect() then reads the imu on every call.
+ * Pass RT_NULL to go back to polling.
+ */
+fmt_err sensor_imu_drdy_sync(void (*drdy_cb)(void))
+{
+	fmt_err err;
+
+	if(drdy_cb == RT_NULL) {
+		_imu_drdy_cb = RT_NULL;
+		return sensor_imu_set_drdy_indicate(0, RT_NULL);
+	}
+
+	_imu_drdy_cb = drdy_cb;
+	err = sensor_imu_set_drdy_indicate(0, _imu_drdy_indicate);
+
+	if(err != FMT_EOK) {
+		_imu_drdy_cb = RT_NULL;
+	}
+
+	return err;
+}
+
+// should be called in each 1ms, or on each imu data-ready if synchronized
 void sensor_collect(void)
 {
 	DEFINE_TIMETAG(imu_update, 1);
 	DEFINE_TIMETAG(mag_update, 10);
 
-	if(check_timetag(TIMETAG(imu_update))) {
+	if(_imu_drdy_cb || check_timetag(TIMETAG(imu_update))) {
+
+		/* a failed read is not published, the INS keeps the last sample */
+		if(sensor_gyr_measure(_imu_report.gyr_B_radDs, 0) == FMT_EOK
+		        && sensor_acc_measure(_imu_report.acc_B_mDs2, 0) == FMT_EOK) {
+			sensor_imu_get_timestamp(&_imu_report.timestamp_us, 0);
+			_imu_report.timestamp_ms = (uint32_t)(_imu_report.timestamp_us / 1000);
+
+			mcn_publish(MCN_ID(sensor_imu), &_imu_report);
+		}
 
-		_imu_report.timestamp_ms = systime_now_ms();
-		sensor_gyr_measure(_imu_report.gyr_B_radDs, 0);
-		sensor_acc_measure(_imu_report.acc_B_mDs2, 0);
+#ifdef SENSOR_PUBLISH_IMU1
+		if(_imu_num > 1 && sensor_gyr_measure(_imu1_report.gyr_B_radDs, 1) == FMT_EOK
+		        && sensor_acc_measure(_imu1_report.acc_B_mDs2, 1) == FMT_EOK) {
+			sensor_imu_get_timestamp(&_imu1_report.timestamp_us, 1);
+			_imu1_report.timestamp_ms = (uint32_t)(_imu1_report.timestamp_us / 1000);
 
-		mcn_publish(MCN_ID(sensor_imu), &_imu_report);
+			mcn_publish(MCN_ID(sensor_imu1), &_imu1_report);
+		}
+#endif
 	}
 
 	if(check_timetag(TIMETAG(mag_update))) {
 
-		_mag_report.timestamp_ms = systime_now_ms();
+		_mag_report.timestamp_us = systime_now_us();
+		_mag_report.timestamp_ms = (uint32_t)(_mag_report.timestamp_us / 1000);
 		sensor_mag_measure(_mag_report.mag_B_gauss, 0);
 
 		mcn_publish(MCN_ID(sensor_mag), &_mag_report);
@@ -133,6 +194,7 @@ void sensor_collect(void)
 			_baro_report.pressure_pa = report.pressure_Pa;
 			_baro_report.altitude_m = report.altitude_m;
 			_baro_report.timestamp_ms = report.timestamp_ms;
+			_baro_report.timestamp_us = report.timestamp_us;
 
 			mcn_publish(MCN_ID(sensor_baro), &_baro_report);
 		}
@@ -146,6 +208,12 @@ void sensor_collect(void)
 	}
 }
 
+// number of imus published, the second INS only runs if there are 2
+uint8_t sensor_manager_imu_num(void)
+{
+	return _imu_num;
+}
+
 rt_err_t sensor_manager_init(void)
 {
 	rt_err_t res = RT_EOK;
@@ -157,6 +225,20 @@ rt_err_t sensor_manager_init(void)
 
 	/* advertise sensor data */
 	mcn_advertise(MCN_ID(sensor_imu), SENSOR_IMU_echo);
+#ifdef SENSOR_PUBLISH_IMU1
+#if defined(FMT_USING_SIH)
+	/* the plant feeds its imu to both */
+	_imu_num = 2;
+#elif !defined(FMT_USING_HIL)
+	_imu_num = sensor_imu_available(1) ? 2 : 1;
+#endif
+
+	if(_imu_num > 1) {
+		mcn_advertise(MCN_ID(sensor_imu1), SENSOR_IMU_echo);
+	} else {
+		console_printf("imu1 is not available, no second INS\n");
+	}
+#endif
 	mcn_advertise(MCN_ID(sensor_mag), SENSOR_MAG_echo);
 	mcn_advertise(MCN_ID(sensor_baro), SENSOR_BARO_echo);
 	mcn_advertise(MCN_ID(sensor_gps), SENSOR_GPS_echo);
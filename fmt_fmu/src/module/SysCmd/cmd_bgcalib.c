@@ -0,0 +1,69 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <firmament.h>
+#include <string.h>
+
+#include "module/calibration/bg_calib.h"
+#include "module/syscmd/syscmd.h"
+
+static void show_usage(void)
+{
+	PRINT_USAGE(bgcalib, ACTION);
+
+	PRINT_STRING("\nAction:\n");
+	PRINT_ACTION("status", 6, "Show background calibration progress.");
+	PRINT_ACTION("reset", 5, "Drop collected samples and start over.");
+}
+
+static void show_status(void)
+{
+	BgCalibStatus status;
+
+	bg_calib_get_status(&status);
+
+	console_printf("BG_CALIB:%d\n", (int)PARAM_GET_INT32(SYSTEM, BG_CALIB));
+	console_printf("gyro: still windows:%u bias:%f %f %f %s commit:%u\n", (unsigned)status.gyr_windows,
+	               status.gyr_bias[0], status.gyr_bias[1], status.gyr_bias[2], status.gyr_ready ? "ready" : "",
+	               (unsigned)status.gyr_commit);
+	console_printf("mag: samples:%u bins:%u/%d %s commit:%u\n", (unsigned)status.mag_samples,
+	               status.mag_bin_filled, BG_MAG_BIN_NUM, status.mag_ready ? "ready" : "", (unsigned)status.mag_commit);
+
+	if(status.mag_ready) {
+		console_printf("  bias:%f %f %f radii:%f %f %f\n", status.mag_result.bias[0], status.mag_result.bias[1],
+		               status.mag_result.bias[2], status.mag_result.radii[0], status.mag_result.radii[1],
+		               status.mag_result.radii[2]);
+	}
+}
+
+static int handle_cmd(int argc, char** argv, int optc, optv_t* optv)
+{
+	if(argc >= 2 && STRING_COMPARE(argv[1], "status")) {
+		show_status();
+	} else if(argc >= 2 && STRING_COMPARE(argv[1], "reset")) {
+		bg_calib_reset();
+	} else {
+		show_usage();
+	}
+
+	return 0;
+}
+
+int cmd_bgcalib(int argc, char** argv)
+{
+	return syscmd_process(argc, argv, handle_cmd);
+}
+FINSH_FUNCTION_EXPORT_ALIAS(cmd_bgcalib, __cmd_bgcalib, background calibration commands);
@@ -31,6 +31,7 @@ static void show_usage(void)
 	PRINT_ACTION("upload", 6, "Upload firmware to FMT IO.");
 	PRINT_ACTION("config", 6, "Configure FMT IO.");
 	PRINT_ACTION("hello", 6, "Say hello to FMT IO.");
+	PRINT_ACTION("stat", 6, "Show FMT IO link statistics.");
 
 	PRINT_STRING("\nOption:\n");
 	PRINT_ACTION("-h, --help", 13, "Show command usage.");
@@ -39,6 +40,19 @@ static void show_usage(void)
 	PRINT_ACTION("--pwm-freq", 13, "Config pwm output frequency.");
 }
 
+static void show_link_stat(void)
+{
+	LinkStatStruct stat;
+
+	fmtio_get_link_stat(&stat);
+
+	console_printf("tx: frame:%u msg:%u byte:%u drop:%u\n", (unsigned)stat.tx_frame, (unsigned)stat.tx_msg,
+	               (unsigned)stat.tx_byte, (unsigned)stat.tx_drop);
+	console_printf("rx: frame:%u msg:%u byte:%u crc_err:%u len_err:%u lost:%u\n", (unsigned)stat.rx_frame,
+	               (unsigned)stat.rx_msg, (unsigned)stat.rx_byte, (unsigned)stat.rx_crc_err,
+	               (unsigned)stat.rx_len_err, (unsigned)stat.rx_lost);
+}
+
 static int handle_cmd(int argc, char** argv, int optc, optv_t* optv)
 {
 	uint32_t baud_rate = 0;
@@ -81,6 +95,8 @@ static int handle_cmd(int argc, char** argv, int optc, optv_t* optv)
 		} else if(STRING_COMPARE(argv[1], "hello")) {
 			/* say hello to fmt io */
 			fmtio_send_message(PROTO_DBG_TEXT, "hello", strlen("hello"));
+		} else if(STRING_COMPARE(argv[1], "stat")) {
+			show_link_stat();
 		} else if(STRING_COMPARE(argv[1], "config")) {
 			/* config fmt io */
 			fmtio_config(baud_rate, rc_chan_num, pwm_freq);
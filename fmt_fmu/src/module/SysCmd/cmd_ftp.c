@@ -0,0 +1,78 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <firmament.h>
+#include <string.h>
+
+#include "module/ftp/ftp_manager.h"
+#include "module/syscmd/syscmd.h"
+
+static void show_usage(void)
+{
+	PRINT_USAGE(ftp, ACTION);
+
+	PRINT_STRING("\nAction:\n");
+	PRINT_ACTION("stat", 4, "Show mavlink ftp session and transfer statistics.");
+}
+
+static void show_session_stat(void)
+{
+	StreamSession session;
+	uint32_t time_ms;
+
+	for(uint8_t i = 0; i < FTP_MAX_SESSION_NUM; i++) {
+		if(ftp_get_session(i, &session) != FMT_EOK) {
+			continue;
+		}
+
+		if(session.fd < 0) {
+			console_printf("session %d: idle\n", i);
+			continue;
+		}
+
+		/* duration of a burst in progress is counted up to now */
+		time_ms = session.streaming ? systime_now_ms() - session.stat.start_ms : session.stat.time_ms;
+
+		console_printf("session %d: %s offset:%u/%u\n", i, session.streaming ? "streaming" : (session.complete ? "complete" : "open"),
+		               (unsigned)session.stream_offset, (unsigned)session.file_size);
+		console_printf("  byte:%u chunk:%u fail:%u read:%u seek:%u time:%ums rate:%.1fKB/s\n", (unsigned)session.stat.bytes,
+		               (unsigned)session.stat.chunks, (unsigned)session.stat.send_fail, (unsigned)session.stat.reads,
+		               (unsigned)session.stat.seeks, (unsigned)time_ms,
+		               time_ms ? (float)session.stat.bytes / time_ms * 1000.0f / 1024.0f : 0.0f);
+
+		if(session.compress) {
+			console_printf("  compressed wire byte:%u ratio:%.2f\n", (unsigned)session.stat.wire_bytes,
+			               session.stat.wire_bytes ? (float)session.stat.bytes / session.stat.wire_bytes : 0.0f);
+		}
+	}
+}
+
+static int handle_cmd(int argc, char** argv, int optc, optv_t* optv)
+{
+	if(argc >= 2 && STRING_COMPARE(argv[1], "stat")) {
+		show_session_stat();
+	} else {
+		show_usage();
+	}
+
+	return 0;
+}
+
+int cmd_ftp(int argc, char** argv)
+{
+	return syscmd_process(argc, argv, handle_cmd);
+}
+FINSH_FUNCTION_EXPORT_ALIAS(cmd_ftp, __cmd_ftp, mavlink ftp commands);
@@ -0,0 +1,42 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <firmament.h>
+
+#include "module/hil/hil_bridge.h"
+#include "module/syscmd/syscmd.h"
+
+#ifdef FMT_USING_HIL_BRIDGE
+
+static int handle_cmd(int argc, char** argv, int optc, optv_t* optv)
+{
+	hil_bridge_status_t status = hil_bridge_get_status();
+
+	console_printf("device: %s\n", HIL_BRIDGE_DEVICE_NAME);
+	console_printf("mode: %s\n", status.lockstep ? "lockstep" : "free running");
+	console_printf("frame: %u lost: %u crc err: %u tx err: %u batch err: %u\n", (unsigned)status.frame,
+	               (unsigned)status.lost, (unsigned)status.crc_err, (unsigned)status.tx_err, (unsigned)status.batch_err);
+
+	return 0;
+}
+
+int cmd_hil(int argc, char** argv)
+{
+	return syscmd_process(argc, argv, handle_cmd);
+}
+FINSH_FUNCTION_EXPORT_ALIAS(cmd_hil, __cmd_hil, show hil bridge status);
+
+#endif
@@ -0,0 +1,91 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <firmament.h>
+#include <string.h>
+
+#include "module/syscmd/syscmd.h"
+#include "task/task_comm.h"
+
+#define BENCH_DEFAULT_TIME_S 5
+
+static void show_usage(void)
+{
+	PRINT_USAGE(mavdev, ACTION[ARGS]);
+
+	PRINT_STRING("\nAction:\n");
+	PRINT_ACTION("bench", 5, "Measure mavproxy tx throughput, args: [seconds].");
+}
+
+static void mavdev_bench(uint32_t time_s)
+{
+	mavlink_system_t mav_sys = mavproxy_get_system();
+	mavlink_message_t msg;
+	uint8_t payload[MAVLINK_MSG_ENCAPSULATED_DATA_FIELD_DATA_LEN];
+	uint32_t msg_cnt = 0;
+	uint32_t fail_cnt = 0;
+	uint32_t byte_cnt = 0;
+	uint32_t start, elapse;
+	uint16_t seq = 0;
+
+	for(uint16_t i = 0; i < sizeof(payload); i++) {
+		payload[i] = (uint8_t)i;
+	}
+
+	console_printf("mavdev bench for %u s...\n", (unsigned)time_s);
+
+	start = systime_now_ms();
+
+	while(systime_now_ms() - start < time_s * 1000) {
+		mavlink_msg_encapsulated_data_pack(mav_sys.sysid, mav_sys.compid, &msg, seq++, payload);
+
+		/* send through mavproxy_dev in synchronized mode */
+		if(mavproxy_send_immediate_msg(&msg, 1)) {
+			msg_cnt++;
+			byte_cnt += mavlink_msg_get_send_buffer_length(&msg);
+		} else {
+			fail_cnt++;
+		}
+	}
+
+	elapse = systime_now_ms() - start;
+
+	console_printf("msg:%u fail:%u byte:%u time:%ums throughput:%.1fKB/s\n", (unsigned)msg_cnt, (unsigned)fail_cnt,
+	               (unsigned)byte_cnt, (unsigned)elapse, elapse ? (float)byte_cnt / elapse * 1000.0f / 1024.0f : 0.0f);
+}
+
+static int handle_cmd(int argc, char** argv, int optc, optv_t* optv)
+{
+	if(argc >= 2 && STRING_COMPARE(argv[1], "bench")) {
+		uint32_t time_s = BENCH_DEFAULT_TIME_S;
+
+		if(argc >= 3 && syscmd_is_num(argv[2])) {
+			time_s = atoi(argv[2]);
+		}
+
+		mavdev_bench(time_s);
+	} else {
+		show_usage();
+	}
+
+	return 0;
+}
+
+int cmd_mavdev(int argc, char** argv)
+{
+	return syscmd_process(argc, argv, handle_cmd);
+}
+FINSH_FUNCTION_EXPORT_ALIAS(cmd_mavdev, __cmd_mavdev, mavproxy device commands);
@@ -0,0 +1,151 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <firmament.h>
+#include <string.h>
+
+#include "module/syscmd/syscmd.h"
+#include "module/system/perf.h"
+
+static int _name_maxlen(const char* title)
+{
+    int max_len = strlen(title);
+
+    for (perf_counter_t* cp = perf_get_list(); cp != NULL; cp = cp->next) {
+        int len = strlen(cp->name);
+
+        if (len > max_len) {
+            max_len = len;
+        }
+    }
+
+    return max_len;
+}
+
+static void _list_scopes(void)
+{
+    char* title[] = { "Scope", "Count", "Min(us)", "Mean(us)", "Max(us)" };
+    uint32_t title_len[5];
+
+    title_len[0] = _name_maxlen(title[0]) + 2;
+
+    for (int i = 1; i < 5; i++) {
+        title_len[i] = 12;
+    }
+
+    for (int i = 0; i < 5; i++) {
+        syscmd_printf(' ', title_len[i], SYSCMD_ALIGN_MIDDLE, title[i]);
+        syscmd_putc(' ', 1);
+    }
+    console_printf("\n");
+
+    for (int i = 0; i < 5; i++) {
+        syscmd_putc('-', title_len[i]);
+        syscmd_putc(' ', 1);
+    }
+    console_printf("\n");
+
+    for (perf_counter_t* cp = perf_get_list(); cp != NULL; cp = cp->next) {
+        /* take a snapshot, the counter is updated by other thread */
+        perf_counter_t pc = *cp;
+
+        syscmd_printf(' ', title_len[0], SYSCMD_ALIGN_LEFT, pc.name);
+        syscmd_putc(' ', 1);
+        syscmd_printf(' ', title_len[1], SYSCMD_ALIGN_MIDDLE, "%u", (unsigned)pc.count);
+        syscmd_putc(' ', 1);
+        syscmd_printf(' ', title_len[2], SYSCMD_ALIGN_MIDDLE, "%.2f", pc.count ? perf_cycle_to_us(pc.min) : 0.0f);
+        syscmd_putc(' ', 1);
+        syscmd_printf(' ', title_len[3], SYSCMD_ALIGN_MIDDLE, "%.2f", pc.count ? perf_cycle_to_us(pc.total) / pc.count : 0.0f);
+        syscmd_putc(' ', 1);
+        syscmd_printf(' ', title_len[4], SYSCMD_ALIGN_MIDDLE, "%.2f", perf_cycle_to_us(pc.max));
+        console_printf("\n");
+    }
+}
+
+static void _show_hist(const char* scope)
+{
+    perf_counter_t* cp;
+    perf_counter_t pc;
+
+    for (cp = perf_get_list(); cp != NULL; cp = cp->next) {
+        if (strcmp(cp->name, scope) == 0) {
+            break;
+        }
+    }
+
+    if (cp == NULL) {
+        console_printf("can not find scope %s\n", scope);
+        return;
+    }
+
+    pc = *cp;
+
+    console_printf("%s: %u samples\n", pc.name, (unsigned)pc.count);
+
+    for (int i = 0; i < PERF_HIST_BINS; i++) {
+        uint32_t low = i ? 1 << (i - 1) : 0;
+
+        if (i < PERF_HIST_BINS - 1) {
+            console_printf("%6u - %-6u us: %u\n", (unsigned)low, (unsigned)(1 << i), (unsigned)pc.hist[i]);
+        } else {
+            console_printf("%6u - %-6s us: %u\n", (unsigned)low, "inf", (unsigned)pc.hist[i]);
+        }
+    }
+}
+
+static void show_usage(void)
+{
+    PRINT_USAGE(perf, ACTION[ARGS]);
+
+    PRINT_STRING("\nAction:\n");
+    PRINT_ACTION("list", 5, "List min/mean/max execution time of all perf scopes.");
+    PRINT_ACTION("hist", 5, "Show execution time histogram of a perf scope, e.g, perf hist ins_step.");
+    PRINT_ACTION("reset", 5, "Reset all perf scopes.");
+}
+
+static int handle_cmd(int argc, char** argv, int optc, optv_t* optv)
+{
+    /* handle operation */
+    for (uint16_t i = 0; i < optc; i++) {
+        if (STRING_COMPARE(optv[i].opt, "-h") || STRING_COMPARE(optv[i].opt, "--help")) {
+            show_usage();
+            return 0;
+        }
+    }
+
+    if (argc < 2 || strcmp(argv[1], "list") == 0) {
+        _list_scopes();
+    } else if (strcmp(argv[1], "hist") == 0) {
+        if (argc < 3) {
+            console_printf("usage: perf hist <scope>\n");
+            return -1;
+        }
+
+        _show_hist(argv[2]);
+    } else if (strcmp(argv[1], "reset") == 0) {
+        perf_reset(NULL);
+    } else {
+        show_usage();
+    }
+
+    return 0;
+}
+
+int cmd_perf(int argc, char** argv)
+{
+    return syscmd_process(argc, argv, handle_cmd);
+}
+FINSH_FUNCTION_EXPORT_ALIAS(cmd_perf, __cmd_perf, show control loop execution time);
@@ -0,0 +1,99 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <firmament.h>
+#include <string.h>
+
+#include "module/syscmd/syscmd.h"
+#include "module/plant/plant_model.h"
+#include "module/system/model_sched.h"
+
+#define COLUMN_NUM 9
+
+static void show_usage(void)
+{
+    PRINT_USAGE(sched, [ACTION]);
+
+    PRINT_STRING("\nAction:\n");
+    PRINT_ACTION("reset", 5, "Reset release, deadline miss and timing statistics.");
+}
+
+static void _list_models(void)
+{
+    char* title[COLUMN_NUM] = { "Model", "Period(ms)", "Prio", "Release", "Miss", "Min(us)", "Mean(us)", "Max(us)", "Resp(us)" };
+    uint32_t title_len[COLUMN_NUM];
+
+    for (int i = 0; i < COLUMN_NUM; i++) {
+        title_len[i] = i == 0 ? 10 : 11;
+        syscmd_printf(' ', title_len[i], SYSCMD_ALIGN_MIDDLE, title[i]);
+        syscmd_putc(' ', 1);
+    }
+    console_printf("\n");
+
+    for (int i = 0; i < COLUMN_NUM; i++) {
+        syscmd_putc('-', title_len[i]);
+        syscmd_putc(' ', 1);
+    }
+    console_printf("\n");
+
+    for (model_task_t* task = model_sched_get_list(); task != NULL; task = task->next) {
+        /* take a snapshot, the counter is updated by model thread */
+        perf_counter_t exec = task->exec;
+
+        syscmd_printf(' ', title_len[0], SYSCMD_ALIGN_LEFT, task->name);
+        syscmd_putc(' ', 1);
+        syscmd_printf(' ', title_len[1], SYSCMD_ALIGN_MIDDLE, "%u", (unsigned)task->period);
+        syscmd_putc(' ', 1);
+        syscmd_printf(' ', title_len[2], SYSCMD_ALIGN_MIDDLE, "%u", (unsigned)task->priority);
+        syscmd_putc(' ', 1);
+        syscmd_printf(' ', title_len[3], SYSCMD_ALIGN_MIDDLE, "%u", (unsigned)task->release);
+        syscmd_putc(' ', 1);
+        syscmd_printf(' ', title_len[4], SYSCMD_ALIGN_MIDDLE, "%u", (unsigned)task->miss);
+        syscmd_putc(' ', 1);
+        syscmd_printf(' ', title_len[5], SYSCMD_ALIGN_MIDDLE, "%.2f", exec.count ? perf_cycle_to_us(exec.min) : 0.0f);
+        syscmd_putc(' ', 1);
+        syscmd_printf(' ', title_len[6], SYSCMD_ALIGN_MIDDLE, "%.2f", exec.count ? perf_cycle_to_us(exec.total) / exec.count : 0.0f);
+        syscmd_putc(' ', 1);
+        syscmd_printf(' ', title_len[7], SYSCMD_ALIGN_MIDDLE, "%.2f", perf_cycle_to_us(exec.max));
+        syscmd_putc(' ', 1);
+        syscmd_printf(' ', title_len[8], SYSCMD_ALIGN_MIDDLE, "%.2f", perf_cycle_to_us(task->resp_max));
+        console_printf("\n");
+    }
+
+#ifdef FMT_USING_SIH
+    /* plant is not a scheduled model, its step time is the sih_step perf scope */
+    console_printf("\nsih plant slipped behind real time: %u\n", (unsigned)plant_model_get_slip());
+#endif
+}
+
+static int handle_cmd(int argc, char** argv, int optc, optv_t* optv)
+{
+    if (argc < 2) {
+        _list_models();
+    } else if (STRING_COMPARE(argv[1], "reset")) {
+        model_sched_reset();
+    } else {
+        show_usage();
+    }
+
+    return 0;
+}
+
+int cmd_sched(int argc, char** argv)
+{
+    return syscmd_process(argc, argv, handle_cmd);
+}
+FINSH_FUNCTION_EXPORT_ALIAS(cmd_sched, __cmd_sched, show model scheduler status);
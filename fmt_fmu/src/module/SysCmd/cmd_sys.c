@@ -17,6 +17,7 @@
 #include <firmament.h>
 
 #include "module/syscmd/syscmd.h"
+#include "module/system/memstat.h"
 #include "module/system/statistic.h"
 
 extern long list_device(void);
@@ -31,12 +32,80 @@ extern long list_thread(void);
 extern void list_mem(void);
 extern int df(const char* path);
 
+static void _show_top(void)
+{
+    Sys_Stat_Report report;
+
+    if (sysstat_get_report(&report) != FMT_EOK) {
+        console_printf("system statistic is not available\n");
+        return;
+    }
+
+    console_printf("cpu usage: %.2f%%  irq usage: %.2f%%\n\n", report.cpu_usage, report.irq_usage);
+
+    console_printf("%-*s %8s %10s %12s\n", RT_NAME_MAX, "thread", "usage(%)", "switch/s", "max_run(us)");
+    syscmd_putc('-', RT_NAME_MAX);
+    console_printf(" -------- ---------- ------------\n");
+    for (uint16_t i = 0; i < report.thread_num; i++) {
+        console_printf("%-*.*s %8.2f %10u %12.1f\n", RT_NAME_MAX, RT_NAME_MAX, report.thread[i].name, report.thread[i].usage,
+            (unsigned)report.thread[i].switch_cnt, report.thread[i].max_run_us);
+    }
+
+    console_printf("\n%-6s %8s %10s\n", "irqn", "usage(%)", "count/s");
+    console_printf("------ -------- ----------\n");
+    for (uint16_t i = 0; i < report.irq_num; i++) {
+        console_printf("%-6d %8.2f %10u\n", report.irq[i].irqn, report.irq[i].usage, (unsigned)report.irq[i].count);
+    }
+}
+
+static void _show_mem(void)
+{
+    static Alloc_Site sites[MEMSTAT_MAX_ALLOC_SITE];
+    Mem_Stat_Report report;
+    uint16_t site_num;
+
+    /* get the latest status */
+    memstat_update();
+
+    if (memstat_get_report(&report) != FMT_EOK) {
+        console_printf("memory statistic is not available\n");
+        return;
+    }
+
+    console_printf("heap total: %u used: %u max used: %u\n", (unsigned)report.heap_total,
+        (unsigned)report.heap_used, (unsigned)report.heap_max_used);
+    console_printf("free blocks: %u largest free block: %u fragmentation: %.1f%%\n\n",
+        (unsigned)report.heap_free_blocks, (unsigned)report.heap_max_free_block, report.heap_fragmentation);
+
+    console_printf("%-*s %10s %10s %6s\n", RT_NAME_MAX, "thread", "stack size", "max used", "usage");
+    syscmd_putc('-', RT_NAME_MAX);
+    console_printf(" ---------- ---------- ------\n");
+    for (uint16_t i = 0; i < report.thread_num; i++) {
+        console_printf("%-*.*s %10u %10u %5.1f%%\n", RT_NAME_MAX, RT_NAME_MAX, report.stack[i].name,
+            (unsigned)report.stack[i].stack_size, (unsigned)report.stack[i].stack_max_used,
+            report.stack[i].stack_size ? 100.0f * report.stack[i].stack_max_used / report.stack[i].stack_size : 0.0f);
+    }
+
+    site_num = memstat_get_alloc_sites(sites, MEMSTAT_MAX_ALLOC_SITE);
+
+    if (site_num) {
+        console_printf("\n%-10s %8s %10s %6s\n", "caller", "count", "bytes", "fail");
+        console_printf("---------- -------- ---------- ------\n");
+        for (uint16_t i = 0; i < site_num; i++) {
+            console_printf("0x%08x %8u %10u %6u\n", (unsigned)sites[i].caller, (unsigned)sites[i].alloc_cnt,
+                (unsigned)sites[i].alloc_bytes, (unsigned)sites[i].fail_cnt);
+        }
+    }
+}
+
 static void show_usage(void)
 {
     PRINT_USAGE(sys, ACTION);
 
     PRINT_STRING("\nAction:\n");
     PRINT_ACTION("status", 13, "Show system status.");
+    PRINT_ACTION("top", 13, "Show cpu usage of each thread and interrupt.");
+    PRINT_ACTION("mem", 13, "Show stack high-water mark and heap status.");
     PRINT_ACTION("list_device", 13, "List device in system.");
     PRINT_ACTION("list_timer", 13, "List timer in system.");
     PRINT_ACTION("list_mempool", 13, "List memory pool in system.");
@@ -68,6 +137,10 @@ static int handle_cmd(int argc, char** argv, int optc, optv_t* optv)
         list_mem();
         console_printf("\n");
         df("/");
+    } else if (STRING_COMPARE(argv[1], "top")) {
+        _show_top();
+    } else if (STRING_COMPARE(argv[1], "mem")) {
+        _show_mem();
     } else if (STRING_COMPARE(argv[1], "list_device")) {
         list_device();
     } else if (STRING_COMPARE(argv[1], "list_timer")) {
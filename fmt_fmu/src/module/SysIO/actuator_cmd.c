@@ -18,15 +18,69 @@
 
 #include "hal/motor.h"
 #include "module/controller/controller_model.h"
+#include "module/param/param.h"
+#include "module/sysio/actuator_cmd.h"
+#include "task/task_fmtio.h"
 
 MCN_DECLARE(control_output);
+MCN_DECLARE(fmtio_latency);
+
+MCN_DEFINE(esc_rpm, sizeof(ESC_RPM_Report));
 
 static McnNode_t _control_out_nod;
+static McnNode_t _io_latency_nod;
 static rt_device_t _motor_dev = NULL;
+static uint8_t _motor_bidir = 0;
+static uint32_t _erpm_timestamp = 0;
+
+static int _esc_rpm_echo(void* parameter)
+{
+    ESC_RPM_Report report;
+
+    if (mcn_copy_from_hub((McnHub*)parameter, &report) != FMT_EOK) {
+        return -1;
+    }
+
+    console_printf("timestamp:%u rpm:", (unsigned)report.timestamp_ms);
+    for (uint8_t i = 0; i < MAX_MOTOR_CHANNEL_NUM; i++) {
+        if (report.valid_mask & (1 << i)) {
+            console_printf(" [%d]%.0f", i + 1, report.rpm[i]);
+        }
+    }
+    console_printf("\n");
+
+    return 0;
+}
+
+/* publish rpm from bidirectional dshot telemetry */
+static void _update_esc_rpm(void)
+{
+    struct motor_erpm erpm;
+    ESC_RPM_Report report;
+    int32_t pole_pairs = PARAM_GET_INT32(SYSTEM, MOTOR_POLES) / 2;
+
+    if (rt_device_control(_motor_dev, MOTOR_CMD_GET_ERPM, &erpm) != RT_EOK || erpm.timestamp_ms == _erpm_timestamp) {
+        return;
+    }
+
+    _erpm_timestamp = erpm.timestamp_ms;
+
+    report.timestamp_ms = erpm.timestamp_ms;
+    report.valid_mask = erpm.valid_mask;
+    for (uint8_t i = 0; i < MAX_MOTOR_CHANNEL_NUM; i++) {
+        report.rpm[i] = (float)erpm.erpm[i] / (pole_pairs > 0 ? pole_pairs : 1);
+    }
+
+    mcn_publish(MCN_ID(esc_rpm), &report);
+
+    if (blog_get_status() == BLOG_STATUS_LOGGING) {
+        blog_push_msg((uint8_t*)&report, BLOG_ESC_RPM_ID, sizeof(report));
+    }
+}
 
 fmt_err send_actuator_cmd(void)
 {
-    rt_size_t size = 0;
+    fmt_err err = FMT_EOK;
     Control_Out_Bus control_out;
 
     if (_motor_dev == NULL) {
@@ -35,11 +89,27 @@ fmt_err send_actuator_cmd(void)
 
     if (mcn_poll(_control_out_nod)) {
         mcn_copy(MCN_ID(control_output), _control_out_nod, &control_out);
-        size = rt_device_write(_motor_dev, MOTOR_MASK_1_4, control_out.actuator_cmd, 8);
-        return size == 8 ? FMT_EOK : FMT_ERROR;
+        if (rt_device_write(_motor_dev, MOTOR_MASK_1_4, control_out.actuator_cmd, 8) != 8) {
+            err = FMT_ERROR;
+        }
     }
 
-    return FMT_EOK;
+    if (_motor_bidir) {
+        _update_esc_rpm();
+    }
+
+    /* log latency measured by io for previous commands, blog is written from vehicle thread */
+    if (_io_latency_nod && mcn_poll(_io_latency_nod)) {
+        FMTIO_Latency_Report latency;
+
+        mcn_copy(MCN_ID(fmtio_latency), _io_latency_nod, &latency);
+
+        if (blog_get_status() == BLOG_STATUS_LOGGING) {
+            blog_push_msg((uint8_t*)&latency, BLOG_IO_LATENCY_ID, sizeof(latency));
+        }
+    }
+
+    return err;
 }
 
 fmt_err actuator_deinit(void)
@@ -54,6 +124,8 @@ fmt_err actuator_deinit(void)
 
 fmt_err actuator_init(const char* device_name)
 {
+    uint32_t protocol;
+
     _motor_dev = rt_device_find(device_name);
 
     if (_motor_dev == NULL) {
@@ -70,11 +142,29 @@ fmt_err actuator_init(const char* device_name)
         return FMT_ERROR;
     }
 
+    /* select output protocol */
+    protocol = PARAM_GET_INT32(SYSTEM, MOTOR_PROTOCOL);
+    if (protocol != MOTOR_PROTOCOL_PWM) {
+        _motor_bidir = PARAM_GET_INT32(SYSTEM, MOTOR_BIDIR) ? 1 : 0;
+
+        if (rt_device_control(_motor_dev, MOTOR_CMD_SET_PROTOCOL, (void*)(protocol | (_motor_bidir ? MOTOR_PROTOCOL_BIDIR : 0))) != RT_EOK) {
+            console_printf("Fail to set motor protocol %d!\n", protocol);
+            _motor_bidir = 0;
+        }
+    }
+
+    if (mcn_advertise(MCN_ID(esc_rpm), _esc_rpm_echo) != FMT_EOK) {
+        return FMT_ERROR;
+    }
+
     _control_out_nod = mcn_subscribe(MCN_ID(control_output), NULL, NULL);
     if (_control_out_nod == NULL) {
         console_printf("Fail to subscribe control_output topic\n");
         return FMT_ERROR;
     }
 
+    /* only published if motor device is driven by fmt io */
+    _io_latency_nod = mcn_subscribe(MCN_ID(fmtio_latency), NULL, NULL);
+
     return FMT_EOK;
 }
\ No newline at end of file
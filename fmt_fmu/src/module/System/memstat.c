@@ -0,0 +1,249 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <firmament.h>
+#include <string.h>
+
+#include "module/system/memstat.h"
+
+typedef struct {
+	uint32_t timestamp;
+	uint32_t heap_used;
+	uint32_t heap_max_used;
+	uint32_t heap_max_free_block;
+	uint32_t heap_free_blocks;
+	float heap_fragmentation;
+	uint32_t stack_max_used[MEMSTAT_MAX_THREAD];
+	uint32_t stack_size[MEMSTAT_MAX_THREAD];
+	uint32_t thread_num;
+	/* name of the thread of each stack entry, they are in thread creation order */
+	char thread_name[MEMSTAT_MAX_THREAD][RT_NAME_MAX];
+} memstat_log_t;
+
+static Mem_Stat_Report _report;
+static rt_thread_t _thread[MEMSTAT_MAX_THREAD];
+
+MCN_DEFINE(mem_stat, sizeof(Mem_Stat_Report));
+
+#ifdef FMT_MEMSTAT_TRACK_ALLOC
+/* allocation call sites are recorded by wrapping the heap api with linker
+ * option --wrap, which is enabled for debug build in rtconfig.py */
+static Alloc_Site _alloc_site[MEMSTAT_MAX_ALLOC_SITE];
+
+void* __real_rt_malloc(rt_size_t size);
+void* __real_rt_calloc(rt_size_t count, rt_size_t size);
+void* __real_rt_realloc(void* ptr, rt_size_t size);
+
+static void _track_alloc(void* caller, void* ptr, rt_size_t size)
+{
+	rt_base_t level;
+
+	level = rt_hw_interrupt_disable();
+
+	for(uint16_t i = 0 ; i < MEMSTAT_MAX_ALLOC_SITE ; i++) {
+		if(_alloc_site[i].caller == caller || _alloc_site[i].caller == NULL) {
+			_alloc_site[i].caller = caller;
+
+			if(ptr) {
+				_alloc_site[i].alloc_cnt++;
+				_alloc_site[i].alloc_bytes += size;
+			} else {
+				_alloc_site[i].fail_cnt++;
+			}
+
+			break;
+		}
+	}
+
+	rt_hw_interrupt_enable(level);
+}
+
+void* __wrap_rt_malloc(rt_size_t size)
+{
+	void* ptr = __real_rt_malloc(size);
+
+	_track_alloc(__builtin_return_address(0), ptr, size);
+
+	return ptr;
+}
+
+void* __wrap_rt_calloc(rt_size_t count, rt_size_t size)
+{
+	void* ptr = __real_rt_calloc(count, size);
+
+	_track_alloc(__builtin_return_address(0), ptr, count * size);
+
+	return ptr;
+}
+
+void* __wrap_rt_realloc(void* rmem, rt_size_t size)
+{
+	void* ptr = __real_rt_realloc(rmem, size);
+
+	if(size) {
+		_track_alloc(__builtin_return_address(0), ptr, size);
+	}
+
+	return ptr;
+}
+#endif
+
+static int echo_mem_stat(void* param)
+{
+	Mem_Stat_Report report;
+
+	mcn_copy_from_hub((McnHub*)param, &report);
+
+	console_printf("heap used:%d max used:%d max free block:%d frag:%.1f%%\n", report.heap_used,
+	               report.heap_max_used, report.heap_max_free_block, report.heap_fragmentation);
+
+	return 0;
+}
+
+/* scheduler must be locked, a deleted thread is removed from the list before its stack is freed */
+static rt_bool_t _thread_alive(rt_thread_t thread, struct rt_object_information* info)
+{
+	struct rt_list_node* node;
+
+	for(node = info->object_list.next ; node != &info->object_list ; node = node->next) {
+		if(rt_list_entry(node, struct rt_thread, list) == thread) {
+			return RT_TRUE;
+		}
+	}
+
+	return RT_FALSE;
+}
+
+// scan stack high-water mark and heap status, should be called periodically in low priority thread
+void memstat_update(void)
+{
+	struct rt_object_information* info;
+	struct rt_list_node* node;
+	rt_uint32_t total_free;
+	uint16_t num = 0;
+
+	info = rt_object_get_information(RT_Object_Class_Thread);
+
+	OS_ENTER_CRITICAL;
+
+	for(node = info->object_list.next ; node != &info->object_list && num < MEMSTAT_MAX_THREAD ; node = node->next) {
+		rt_thread_t thread = rt_list_entry(node, struct rt_thread, list);
+
+		strncpy(_report.stack[num].name, thread->name, RT_NAME_MAX);
+		_report.stack[num].name[RT_NAME_MAX - 1] = '\0';
+		_report.stack[num].stack_size = thread->stack_size;
+		_report.stack[num].stack_max_used = 0;
+		_thread[num] = thread;
+		num++;
+	}
+
+	OS_EXIT_CRITICAL;
+
+	/* scan one stack at a time with scheduler locked, so the thread can not be
+	 * deleted under the scan and other threads are held off only briefly */
+	for(uint16_t i = 0 ; i < num ; i++) {
+		OS_ENTER_CRITICAL;
+
+		if(_thread_alive(_thread[i], info)) {
+			rt_uint8_t* ptr = (rt_uint8_t*)_thread[i]->stack_addr;
+			rt_uint8_t* end = ptr + _thread[i]->stack_size;
+
+			/* stack is filled with '#' when thread is created and grows downwards */
+			while(ptr < end && *ptr == '#') {
+				ptr++;
+			}
+
+			_report.stack[i].stack_max_used = end - ptr;
+		}
+
+		OS_EXIT_CRITICAL;
+	}
+
+	_report.thread_num = num;
+
+	rt_memory_info(&_report.heap_total, &_report.heap_used, &_report.heap_max_used);
+	rt_memory_free_info(&_report.heap_max_free_block, &_report.heap_free_blocks);
+
+	total_free = _report.heap_total - _report.heap_used;
+	_report.heap_fragmentation = total_free ? 100.0f * (1.0f - (float)_report.heap_max_free_block / total_free) : 0.0f;
+	_report.timestamp_ms = systime_now_ms();
+
+	mcn_publish(MCN_ID(mem_stat), &_report);
+}
+
+// push latest report into blog, should be called in the same thread as other blog msg
+void memstat_log(void)
+{
+	Mem_Stat_Report report;
+	memstat_log_t log;
+
+	if(blog_get_status() != BLOG_STATUS_LOGGING) {
+		return;
+	}
+
+	if(memstat_get_report(&report) != FMT_EOK) {
+		return;
+	}
+
+	memset(&log, 0, sizeof(log));
+	log.timestamp = report.timestamp_ms;
+	log.heap_used = report.heap_used;
+	log.heap_max_used = report.heap_max_used;
+	log.heap_max_free_block = report.heap_max_free_block;
+	log.heap_free_blocks = report.heap_free_blocks;
+	log.heap_fragmentation = report.heap_fragmentation;
+	log.thread_num = report.thread_num;
+
+	for(uint16_t i = 0 ; i < report.thread_num ; i++) {
+		log.stack_max_used[i] = report.stack[i].stack_max_used;
+		log.stack_size[i] = report.stack[i].stack_size;
+		memcpy(log.thread_name[i], report.stack[i].name, RT_NAME_MAX);
+	}
+
+	blog_push_msg((uint8_t*)&log, BLOG_MEM_STAT_ID, sizeof(log));
+}
+
+fmt_err memstat_get_report(Mem_Stat_Report* report)
+{
+	return mcn_copy_from_hub(MCN_ID(mem_stat), report);
+}
+
+// return the number of recorded allocation sites, 0 if allocation tracking is disabled
+uint16_t memstat_get_alloc_sites(Alloc_Site* sites, uint16_t max_num)
+{
+#ifdef FMT_MEMSTAT_TRACK_ALLOC
+	uint16_t num = 0;
+	rt_base_t level;
+
+	level = rt_hw_interrupt_disable();
+
+	while(num < max_num && num < MEMSTAT_MAX_ALLOC_SITE && _alloc_site[num].caller) {
+		sites[num] = _alloc_site[num];
+		num++;
+	}
+
+	rt_hw_interrupt_enable(level);
+
+	return num;
+#else
+	return 0;
+#endif
+}
+
+void memstat_init(void)
+{
+	FMT_CHECK(mcn_advertise(MCN_ID(mem_stat), echo_mem_stat));
+}
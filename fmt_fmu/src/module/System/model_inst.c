@@ -0,0 +1,121 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <firmament.h>
+
+#include "module/system/model_inst.h"
+
+/* exchange the content of a and b */
+static void _exchange(uint8_t* a, uint8_t* b, uint32_t size)
+{
+	if((((uintptr_t)a | (uintptr_t)b) & 3) == 0) {
+		uint32_t* wa = (uint32_t*)a;
+		uint32_t* wb = (uint32_t*)b;
+		uint32_t tmp;
+
+		for(uint32_t i = 0 ; i < size / 4 ; i++) {
+			tmp = wa[i];
+			wa[i] = wb[i];
+			wb[i] = tmp;
+		}
+
+		a += size & ~3;
+		b += size & ~3;
+		size &= 3;
+	}
+
+	while(size--) {
+		uint8_t tmp = *a;
+
+		*a++ = *b;
+		*b++ = tmp;
+	}
+}
+
+static void _exchange_state(model_class_t* cls, uint8_t* ctx)
+{
+	for(int i = 0 ; i < cls->state_num ; i++) {
+		_exchange(cls->state[i].addr, ctx, cls->state[i].size);
+		/* keep each state word aligned in the buffer */
+		ctx += (cls->state[i].size + 3) & ~3;
+	}
+}
+
+uint32_t model_inst_ctx_size(const model_class_t* cls)
+{
+	uint32_t size = 0;
+
+	for(int i = 0 ; i < cls->state_num ; i++) {
+		size += (cls->state[i].size + 3) & ~3;
+	}
+
+	return size;
+}
+
+// make inst the resident instance, the model step then works on its state
+void model_inst_switch(model_inst_t* inst)
+{
+	model_class_t* cls = inst->cls;
+
+	if(cls->resident == inst) {
+		return;
+	}
+
+	perf_begin(&cls->swap);
+
+	/* globals go to the buffer of inst, which now holds the previous resident */
+	_exchange_state(cls, inst->ctx);
+	cls->resident->ctx = inst->ctx;
+	inst->ctx = NULL;
+	cls->resident = inst;
+
+	perf_end(&cls->swap);
+}
+
+// create an instance and initialize its state with the init function of model
+fmt_err model_inst_create(model_inst_t* inst, model_class_t* cls)
+{
+	if(inst == NULL || cls == NULL) {
+		return FMT_EINVAL;
+	}
+
+	inst->cls = cls;
+	inst->ctx = NULL;
+	inst->id = cls->inst_num;
+
+	if(cls->resident) {
+		/* save the resident instance before the globals are initialized */
+		void* ctx = rt_malloc(model_inst_ctx_size(cls));
+
+		if(ctx == NULL) {
+			return FMT_ENOMEM;
+		}
+
+		memset(ctx, 0, model_inst_ctx_size(cls));
+		_exchange_state(cls, ctx);
+		cls->resident->ctx = ctx;
+	} else {
+		if(perf_register(&cls->swap) != FMT_EOK) {
+			return FMT_ERROR;
+		}
+	}
+
+	cls->init();
+	cls->resident = inst;
+	cls->inst_num++;
+
+	return FMT_EOK;
+}
@@ -0,0 +1,202 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <firmament.h>
+#include <string.h>
+
+#include "module/system/model_sched.h"
+
+typedef struct {
+	uint32_t timestamp;
+	uint32_t model;
+	char name[RT_NAME_MAX];		/* thread name of the model */
+	uint32_t period;
+	uint32_t priority;
+	uint32_t release;
+	uint32_t miss;
+	float resp_max_us;
+} model_sched_log_t;
+
+static model_task_t* _task_list = NULL;
+static uint8_t _task_num = 0;
+static uint8_t _started = 0;
+
+static void _model_thread_entry(void* parameter)
+{
+	model_task_t* task = (model_task_t*)parameter;
+	uint32_t resp;
+
+	while(1) {
+		if(rt_sem_take(&task->sem, RT_WAITING_FOREVER) != RT_EOK) {
+			continue;
+		}
+
+		perf_begin(&task->exec);
+		task->step();
+		perf_end(&task->exec);
+
+		resp = perf_cycle_now() - task->release_cycle;
+
+		if(resp > task->resp_max) {
+			task->resp_max = resp;
+		}
+
+		task->busy = 0;
+	}
+}
+
+fmt_err model_sched_register(model_task_t* task, uint32_t period)
+{
+	model_task_t** tail;
+
+	if(task == NULL || task->step == NULL || period == 0) {
+		return FMT_EINVAL;
+	}
+
+	if(_started || _task_num >= MODEL_SCHED_MAX_NUM) {
+		return FMT_ERROR;
+	}
+
+	/* keep list sorted by period, same period keeps registration order */
+	for(tail = &_task_list ; *tail != NULL ; tail = &(*tail)->next) {
+		if(*tail == task) {
+			return FMT_EOK;
+		}
+
+		if((*tail)->period > period) {
+			break;
+		}
+	}
+
+	task->period = period;
+	task->next = *tail;
+	*tail = task;
+	_task_num++;
+
+	return FMT_EOK;
+}
+
+fmt_err model_sched_start(void)
+{
+	uint8_t priority = MODEL_THREAD_PRIORITY;
+	uint32_t time_now = systime_now_ms();
+	model_task_t* task;
+
+	if(_started) {
+		return FMT_EOK;
+	}
+
+	/* rate monotonic, shorter period gets higher priority (smaller number) */
+	for(task = _task_list ; task != NULL ; task = task->next) {
+		task->priority = priority++;
+		task->next_release = time_now;
+		task->busy = 0;
+
+		if(perf_register(&task->exec) != FMT_EOK) {
+			return FMT_ERROR;
+		}
+
+		if(rt_sem_init(&task->sem, task->name, 0, RT_IPC_FLAG_FIFO) != RT_EOK) {
+			return FMT_ERROR;
+		}
+
+		if(rt_thread_init(&task->thread, task->name, _model_thread_entry, task,
+		                  task->stack, task->stack_size, task->priority, 1) != RT_EOK) {
+			return FMT_ERROR;
+		}
+
+		if(rt_thread_startup(&task->thread) != RT_EOK) {
+			return FMT_ERROR;
+		}
+	}
+
+	_started = 1;
+
+	return FMT_EOK;
+}
+
+// called by vehicle task every ms, release models whose period is due
+void model_sched_tick(uint32_t time_now)
+{
+	if(!_started) {
+		return;
+	}
+
+	for(model_task_t* task = _task_list ; task != NULL ; task = task->next) {
+		if((int32_t)(time_now - task->next_release) < 0) {
+			continue;
+		}
+
+		/* stay on the period grid, restart from now if we fall behind more than one period */
+		if((int32_t)(time_now - task->next_release) >= (int32_t)task->period) {
+			task->next_release = time_now + task->period;
+		} else {
+			task->next_release += task->period;
+		}
+
+		task->release++;
+
+		if(task->busy) {
+			/* previous step has not finished in its period, drop this release */
+			task->miss++;
+			continue;
+		}
+
+		task->busy = 1;
+		task->release_cycle = perf_cycle_now();
+		rt_sem_release(&task->sem);
+	}
+}
+
+void model_sched_reset(void)
+{
+	for(model_task_t* task = _task_list ; task != NULL ; task = task->next) {
+		task->release = 0;
+		task->miss = 0;
+		task->resp_max = 0;
+		perf_reset(&task->exec);
+	}
+}
+
+model_task_t* model_sched_get_list(void)
+{
+	return _task_list;
+}
+
+// push a record of each model into blog, model is its index in the period sorted list, name identifies it
+void model_sched_log(void)
+{
+	model_sched_log_t log;
+	uint32_t model = 0;
+
+	if(blog_get_status() != BLOG_STATUS_LOGGING) {
+		return;
+	}
+
+	for(model_task_t* task = _task_list ; task != NULL ; task = task->next, model++) {
+		log.timestamp = systime_now_ms();
+		log.model = model;
+		strncpy(log.name, task->name, RT_NAME_MAX);
+		log.name[RT_NAME_MAX - 1] = '\0';
+		log.period = task->period;
+		log.priority = task->priority;
+		log.release = task->release;
+		log.miss = task->miss;
+		log.resp_max_us = perf_cycle_to_us(task->resp_max);
+
+		blog_push_msg((uint8_t*)&log, BLOG_MODEL_SCHED_ID, sizeof(log));
+	}
+}
@@ -0,0 +1,176 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <firmament.h>
+#include <string.h>
+
+#include "module/system/perf.h"
+
+typedef struct {
+	uint32_t timestamp;
+	uint32_t scope;
+	char name[PERF_NAME_LEN];
+	uint32_t count;
+	float min_us;
+	float mean_us;
+	float max_us;
+	uint32_t hist[PERF_HIST_BINS];
+} perf_log_t;
+
+static perf_counter_t* _perf_list = NULL;
+static uint32_t _cycle_per_us = 1;
+
+static inline uint32_t _hist_bin(uint32_t us)
+{
+	uint32_t bin;
+
+	if(us == 0) {
+		return 0;
+	}
+
+	bin = 32 - __builtin_clz(us);
+
+	return bin < PERF_HIST_BINS ? bin : PERF_HIST_BINS - 1;
+}
+
+static void _clear(perf_counter_t* pc)
+{
+	pc->count = 0;
+	pc->min = 0xFFFFFFFF;
+	pc->max = 0;
+	pc->total = 0;
+	memset(pc->hist, 0, sizeof(pc->hist));
+}
+
+void perf_end(perf_counter_t* pc)
+{
+	uint32_t elapsed;
+
+	if(pc->start == 0) {
+		/* scope has never begun */
+		return;
+	}
+
+	elapsed = perf_cycle_now() - pc->start;
+
+	/* reset is done here so it never races with the update */
+	if(pc->reset) {
+		_clear(pc);
+		pc->reset = 0;
+	}
+
+	pc->count++;
+	pc->total += elapsed;
+
+	if(elapsed < pc->min) {
+		pc->min = elapsed;
+	}
+
+	if(elapsed > pc->max) {
+		pc->max = elapsed;
+	}
+
+	pc->hist[_hist_bin(elapsed / _cycle_per_us)]++;
+}
+
+// reset all registered scopes if pc is NULL
+void perf_reset(perf_counter_t* pc)
+{
+	if(pc) {
+		pc->reset = 1;
+		return;
+	}
+
+	for(perf_counter_t* cp = _perf_list ; cp != NULL ; cp = cp->next) {
+		cp->reset = 1;
+	}
+}
+
+fmt_err perf_register(perf_counter_t* pc)
+{
+	perf_counter_t** tail;
+
+	if(pc == NULL) {
+		return FMT_EINVAL;
+	}
+
+	OS_ENTER_CRITICAL;
+
+	for(tail = &_perf_list ; *tail != NULL ; tail = &(*tail)->next) {
+		if(*tail == pc) {
+			/* already registered */
+			OS_EXIT_CRITICAL;
+			return FMT_EOK;
+		}
+	}
+
+	pc->next = NULL;
+	*tail = pc;
+
+	OS_EXIT_CRITICAL;
+
+	return FMT_EOK;
+}
+
+perf_counter_t* perf_get_list(void)
+{
+	return _perf_list;
+}
+
+float perf_cycle_to_us(uint64_t cycle)
+{
+	return (float)cycle / _cycle_per_us;
+}
+
+// push a snapshot of each scope into blog, scope is its index in perf list and only the name identifies it across builds
+void perf_log(void)
+{
+	perf_log_t log;
+	uint32_t scope = 0;
+
+	if(blog_get_status() != BLOG_STATUS_LOGGING) {
+		return;
+	}
+
+	for(perf_counter_t* cp = _perf_list ; cp != NULL ; cp = cp->next, scope++) {
+		log.timestamp = systime_now_ms();
+		log.scope = scope;
+		strncpy(log.name, cp->name, PERF_NAME_LEN);
+		log.name[PERF_NAME_LEN - 1] = '\0';
+		log.count = cp->count;
+		log.min_us = cp->count ? perf_cycle_to_us(cp->min) : 0.0f;
+		log.mean_us = cp->count ? perf_cycle_to_us(cp->total) / cp->count : 0.0f;
+		log.max_us = perf_cycle_to_us(cp->max);
+		memcpy(log.hist, cp->hist, sizeof(log.hist));
+
+		blog_push_msg((uint8_t*)&log, BLOG_PERF_ID, sizeof(log));
+	}
+}
+
+void perf_init(void)
+{
+#if defined(__arm__)
+	/* enable dwt cycle counter */
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	_cycle_per_us = SystemCoreClock / 1000000;
+#else
+	/* clock_gettime() counts in ns */
+	_cycle_per_us = 1000;
+#endif
+}
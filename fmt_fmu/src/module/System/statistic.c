@@ -15,39 +15,293 @@
  *****************************************************************************/
 
 #include <firmament.h>
+#include <string.h>
 
+#include "module/system/perf.h"
 #include "module/system/statistic.h"
 #include "module/system/systime.h"
 #include "module/console/console.h"
 
-/* calculate CPU usage each 500ms */
-#define OS_STATISTIC_INTERVAL		500
+/* calculate CPU usage each 1000ms */
+#define OS_STATISTIC_INTERVAL		1000
 
-static uint64_t _os_idle_ctr = 0;
-static uint64_t _os_ctr_max = 1;
+/* exception number of the last irq (SPI6) + 1 */
+#define SYS_STAT_EXCEPTION_NUM		(16 + 87)
+#define SYS_STAT_IRQ_NEST_MAX		8
+
+/* run time of each thread and interrupt is accumulated with cycle counter
+ * at every context switch and interrupt enter/leave, so the time spent in
+ * interrupts is not charged to the interrupted thread. Interrupts which don't
+ * call rt_interrupt_enter()/rt_interrupt_leave() are charged to the thread. */
+typedef struct {
+	rt_thread_t thread;
+	uint32_t run_cycle;
+	uint32_t switch_cnt;
+	uint32_t cur_run;
+	uint32_t max_run;
+} thread_acct_t;
+
+typedef struct {
+	uint32_t run_cycle;
+	uint32_t count;
+} irq_acct_t;
+
+static thread_acct_t _thread_acct[SYS_STAT_MAX_THREAD];
+static irq_acct_t _irq_acct[SYS_STAT_EXCEPTION_NUM];
+static thread_acct_t* _cur_acct = NULL;
+static uint8_t _irq_stack[SYS_STAT_IRQ_NEST_MAX];
+static uint8_t _irq_depth = 0;
+static uint32_t _last_stamp;
+static uint32_t _window_start;
+
+static Sys_Stat_Report _report;
 static float _cpu_usage = 0;
 
 static struct rt_timer timer_sta;
 
-void _thread_idle_hook_func(void)
+MCN_DEFINE(sys_stat, sizeof(Sys_Stat_Report));
+
+/* charge the time since last event to current context, called with irq disabled */
+static inline void _charge(void)
+{
+	uint32_t now = perf_cycle_now();
+	uint32_t elapsed = now - _last_stamp;
+
+	_last_stamp = now;
+
+	if(_irq_depth) {
+		uint8_t top = _irq_depth < SYS_STAT_IRQ_NEST_MAX ? _irq_depth : SYS_STAT_IRQ_NEST_MAX;
+
+		_irq_acct[_irq_stack[top - 1]].run_cycle += elapsed;
+	} else if(_cur_acct) {
+		_cur_acct->run_cycle += elapsed;
+		_cur_acct->cur_run += elapsed;
+	}
+}
+
+/* slots are looked up by thread handle, the table is small enough to scan at
+ * each switch and thread->user_data is left to its owner */
+static thread_acct_t* _find_acct(rt_thread_t thread)
+{
+	for(uint32_t idx = 0 ; idx < SYS_STAT_MAX_THREAD ; idx++) {
+		if(_thread_acct[idx].thread == thread) {
+			return &_thread_acct[idx];
+		}
+	}
+
+	return NULL;
+}
+
+static thread_acct_t* _get_acct(rt_thread_t thread)
+{
+	thread_acct_t* acct = _find_acct(thread);
+
+	if(acct) {
+		return acct;
+	}
+
+	acct = _find_acct(NULL);
+
+	if(acct) {
+		memset(acct, 0, sizeof(thread_acct_t));
+		acct->thread = thread;
+	}
+
+	/* NULL if no slot available, the thread is not accounted */
+	return acct;
+}
+
+static void _scheduler_hook(rt_thread_t from, rt_thread_t to)
 {
-	OS_ENTER_CRITICAL;
-	_os_idle_ctr++;
-	OS_EXIT_CRITICAL;
+	_charge();
+
+	if(_cur_acct) {
+		if(_cur_acct->cur_run > _cur_acct->max_run) {
+			_cur_acct->max_run = _cur_acct->cur_run;
+		}
+
+		_cur_acct->cur_run = 0;
+	}
+
+	_cur_acct = _get_acct(to);
+
+	if(_cur_acct) {
+		_cur_acct->switch_cnt++;
+	}
+}
+
+static void _interrupt_enter_hook(void)
+{
+	uint8_t exception = __get_IPSR() & 0xFF;
+
+	_charge();
+
+	if(exception >= SYS_STAT_EXCEPTION_NUM) {
+		/* unknown exception, accounted to slot 0 */
+		exception = 0;
+	}
+
+	_irq_acct[exception].count++;
+
+	/* too deep nesting is charged to the outer interrupt */
+	if(_irq_depth < SYS_STAT_IRQ_NEST_MAX) {
+		_irq_stack[_irq_depth] = exception;
+	}
+
+	_irq_depth++;
+}
+
+static void _interrupt_leave_hook(void)
+{
+	_charge();
+
+	if(_irq_depth) {
+		_irq_depth--;
+	}
+}
+
+static void _object_detach_hook(struct rt_object* object)
+{
+	rt_base_t level;
+	rt_thread_t thread;
+	thread_acct_t* acct;
+
+	if((object->type & ~RT_Object_Class_Static) != RT_Object_Class_Thread) {
+		return;
+	}
+
+	thread = (rt_thread_t)object;
+
+	level = rt_hw_interrupt_disable();
+
+	acct = _find_acct(thread);
+
+	if(acct) {
+		if(_cur_acct == acct) {
+			_cur_acct = NULL;
+		}
+
+		acct->thread = NULL;
+	}
+
+	rt_hw_interrupt_enable(level);
+}
+
+static int echo_sys_stat(void* param)
+{
+	Sys_Stat_Report report;
+
+	mcn_copy_from_hub((McnHub*)param, &report);
+
+	console_printf("cpu:%.2f%% irq:%.2f%%", report.cpu_usage, report.irq_usage);
+
+	for(uint16_t i = 0 ; i < report.thread_num ; i++) {
+		console_printf(" %s:%.2f%%", report.thread[i].name, report.thread[i].usage);
+	}
+
+	console_printf("\n");
+
+	return 0;
 }
 
 static void timer_stat_entry(void* parameter)
 {
-	/* calculate cpu usage */
-	OS_ENTER_CRITICAL;
-	float usage = 100.0 * (1.0 - ((double)_os_idle_ctr) / _os_ctr_max);
+	static thread_acct_t thread_acct[SYS_STAT_MAX_THREAD];
+	static irq_acct_t irq_acct[SYS_STAT_EXCEPTION_NUM];
+	static char name[SYS_STAT_MAX_THREAD][RT_NAME_MAX];
+	rt_base_t level;
+	uint32_t window;
+	float idle_usage = 0.0f;
+	float irq_usage = 0.0f;
+	float ratio;
+
+	/* take a snapshot of the window and restart it */
+	level = rt_hw_interrupt_disable();
+
+	_charge();
+	window = _last_stamp - _window_start;
+	_window_start = _last_stamp;
+
+	memcpy(thread_acct, _thread_acct, sizeof(thread_acct));
+	memcpy(irq_acct, _irq_acct, sizeof(irq_acct));
+	memset(_irq_acct, 0, sizeof(_irq_acct));
+
+	for(uint8_t i = 0 ; i < SYS_STAT_MAX_THREAD ; i++) {
+		if(_thread_acct[i].thread) {
+			strncpy(name[i], _thread_acct[i].thread->name, RT_NAME_MAX);
+		}
+
+		_thread_acct[i].run_cycle = 0;
+		_thread_acct[i].switch_cnt = 0;
+		_thread_acct[i].max_run = 0;
+	}
+
+	rt_hw_interrupt_enable(level);
+
+	if(window == 0) {
+		return;
+	}
 
-	/* some time the timer could be not accurate, which will generate some wrong usage. so filter it */
-	if(usage > 0.0f && usage < 100.0f)
-		_cpu_usage = usage;
+	ratio = 100.0f / window;
+	_report.thread_num = 0;
 
-	_os_idle_ctr = 0;
-	OS_EXIT_CRITICAL;
+	for(uint8_t i = 0 ; i < SYS_STAT_MAX_THREAD ; i++) {
+		Thread_Stat* stat = &_report.thread[_report.thread_num];
+
+		if(thread_acct[i].thread == NULL) {
+			continue;
+		}
+
+		memcpy(stat->name, name[i], RT_NAME_MAX);
+		stat->name[RT_NAME_MAX - 1] = '\0';
+		stat->usage = thread_acct[i].run_cycle * ratio;
+		stat->switch_cnt = thread_acct[i].switch_cnt * 1000 / OS_STATISTIC_INTERVAL;
+		stat->max_run_us = perf_cycle_to_us(thread_acct[i].max_run);
+
+		if(thread_acct[i].thread == rt_thread_idle_gethandler()) {
+			idle_usage = stat->usage;
+		}
+
+		_report.thread_num++;
+	}
+
+	/* select the busiest interrupts */
+	_report.irq_num = 0;
+
+	for(uint16_t i = 0 ; i < SYS_STAT_EXCEPTION_NUM ; i++) {
+		irq_usage += irq_acct[i].run_cycle * ratio;
+	}
+
+	while(_report.irq_num < SYS_STAT_MAX_IRQ) {
+		uint16_t busiest = 0;
+
+		for(uint16_t i = 1 ; i < SYS_STAT_EXCEPTION_NUM ; i++) {
+			if(irq_acct[i].run_cycle > irq_acct[busiest].run_cycle) {
+				busiest = i;
+			}
+		}
+
+		if(irq_acct[busiest].count == 0) {
+			break;
+		}
+
+		_report.irq[_report.irq_num].irqn = (int16_t)busiest - 16;
+		_report.irq[_report.irq_num].reserved = 0;
+		_report.irq[_report.irq_num].usage = irq_acct[busiest].run_cycle * ratio;
+		_report.irq[_report.irq_num].count = irq_acct[busiest].count * 1000 / OS_STATISTIC_INTERVAL;
+		_report.irq_num++;
+
+		irq_acct[busiest].run_cycle = 0;
+		irq_acct[busiest].count = 0;
+	}
+
+	_report.irq_usage = irq_usage;
+	_report.cpu_usage = 100.0f - idle_usage;
+	_report.timestamp_ms = systime_now_ms();
+
+	_cpu_usage = _report.cpu_usage;
+
+	mcn_publish(MCN_ID(sys_stat), &_report);
 }
 
 float sysstat_get_cpu_usage(void)
@@ -55,17 +309,28 @@ float sysstat_get_cpu_usage(void)
 	return _cpu_usage;
 }
 
+fmt_err sysstat_get_report(Sys_Stat_Report* report)
+{
+	return mcn_copy_from_hub(MCN_ID(sys_stat), report);
+}
+
 void sys_stat_init(void)
 {
-	_os_idle_ctr = 0;
+	rt_base_t level;
+
+	FMT_CHECK(mcn_advertise(MCN_ID(sys_stat), echo_sys_stat));
+
+	level = rt_hw_interrupt_disable();
+
+	_last_stamp = _window_start = perf_cycle_now();
+	_cur_acct = _get_acct(rt_thread_self());
 
-	/* we increment idle counter in idle thread */
-	rt_thread_idle_sethook(_thread_idle_hook_func);
+	rt_object_detach_sethook(_object_detach_hook);
+	rt_interrupt_enter_sethook(_interrupt_enter_hook);
+	rt_interrupt_leave_sethook(_interrupt_leave_hook);
+	rt_scheduler_sethook(_scheduler_hook);
 
-	/* suspend current thread and let idle thread wakeup to count the maximal value of counter */
-	rt_thread_delay(OS_STATISTIC_INTERVAL);
-	_os_ctr_max = _os_idle_ctr;
-	_os_idle_ctr = 0;
+	rt_hw_interrupt_enable(level);
 
 	/* register a timer event to calculate CPU usage */
 	rt_timer_init(&timer_sta, "timer_sta",
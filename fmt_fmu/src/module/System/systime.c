@@ -22,6 +22,8 @@
 typedef struct {
 	volatile uint32_t msPeriod;		/* current time in ms */
 	uint32_t msPerPeriod; 			/* ms count for each period (SysTick_Handler fire) */
+	uint32_t ticksPerUs;			/* systick count for 1us */
+	uint32_t ticksPerMs;			/* systick count for 1ms */
 } systime_t;
 
 static systime_t _systime;
@@ -32,6 +34,26 @@ static void systick_isr_cb(void)
 	_systime.msPeriod += _systime.msPerPeriod;
 }
 
+/* read the systick counter directly, avoiding the device read and float math,
+ * since this is called on every sensor sample and uMCN publish. */
+static inline void _systick_read(uint32_t* ms, uint32_t* ticks)
+{
+	uint32_t period;
+
+	do {
+		period = _systime.msPeriod;
+		*ms = period;
+		*ticks = SysTick->LOAD - SysTick->VAL;
+
+		if(SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+			/* systick has reloaded but the isr is not served yet (e.g, irq disabled) */
+			*ms += _systime.msPerPeriod;
+			*ticks = SysTick->LOAD - SysTick->VAL;
+		}
+		/* read again if systick isr happened during the read */
+	} while(period != _systime.msPeriod);
+}
+
 uint8_t check_timetag(TimeTag* timetag)
 {
 	uint32_t now = systime_now_ms();
@@ -69,20 +91,20 @@ uint8_t check_timetag3(TimeTag* timetag, uint32_t now, uint32_t period)
 
 uint64_t systime_now_us(void)
 {
-	uint32_t systick_us;
+	uint32_t ms, ticks;
 
-	rt_device_read(_systick_dev, SYSTICK_RD_TIME_US, &systick_us, sizeof(uint32_t));
+	_systick_read(&ms, &ticks);
 
-	return _systime.msPeriod * (uint64_t)1000 + systick_us;
+	return ms * (uint64_t)1000 + ticks / _systime.ticksPerUs;
 }
 
 uint32_t systime_now_ms(void)
 {
-	uint32_t systick_us;
+	uint32_t ms, ticks;
 
-	rt_device_read(_systick_dev, SYSTICK_RD_TIME_US, &systick_us, sizeof(uint32_t));
+	_systick_read(&ms, &ticks);
 
-	return _systime.msPeriod + systick_us / 1e3;
+	return ms + ticks / _systime.ticksPerMs;
 }
 
 void systime_delay_us(uint32_t time_us)
@@ -114,6 +136,8 @@ uint8_t systime_init(void)
 
 	_systime.msPeriod = 0;
 	_systime.msPerPeriod = systick_device->ticks_per_isr / systick_device->ticks_per_us / 1e3;
+	_systime.ticksPerUs = systick_device->ticks_per_us;
+	_systime.ticksPerMs = systick_device->ticks_per_us * 1000;
 
 	systick_device->systick_isr_cb = systick_isr_cb;
 
@@ -17,10 +17,17 @@
 #include <firmament.h>
 
 #include "module/utils/fifo.h"
+#include "module/utils/ring.h"
 #include "module/console/console.h"
 
 uint8_t fifo_create(FIFO* fifo, uint16_t size)
 {
+	/* size is used as mask, it must be power of 2 */
+	if(!RING_IS_POW2(size)) {
+		console_printf("fifo size %u is not power of 2\n", size);
+		return 1;
+	}
+
 	fifo->data = (float*)OS_MALLOC(size * sizeof(float));
 
 	if(fifo->data == NULL) {
@@ -54,7 +61,7 @@ void fifo_flush(FIFO* fifo)
 
 void fifo_push(FIFO* fifo, float val)
 {
-	fifo->head = (fifo->head + 1) % fifo->size;
+	fifo->head = (fifo->head + 1) & (fifo->size - 1);
 	fifo->data[fifo->head] = val;
 
 	if(fifo->cnt < fifo->size)
@@ -63,13 +70,11 @@ void fifo_push(FIFO* fifo, float val)
 
 float fifo_pop(FIFO* fifo)
 {
-	uint16_t tail = (fifo->head + 1) % fifo->size;
+	uint16_t tail = (fifo->head + 1) & (fifo->size - 1);
 	return fifo->data[tail];
 }
 
 float fifo_read_back(FIFO* fifo, uint16_t offset)
 {
-	offset = offset % fifo->size;
-	uint16_t index = (fifo->head >= offset) ? (fifo->head - offset) : (fifo->head + fifo->size - offset);
-	return fifo->data[index];
+	return fifo->data[(fifo->head - offset) & (fifo->size - 1)];
 }
\ No newline at end of file
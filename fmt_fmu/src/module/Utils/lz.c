@@ -0,0 +1,226 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <string.h>
+
+#include "module/utils/lz.h"
+
+static uint32_t _hash(const uint8_t* p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* extra bytes needed for length n in a 4-bit field */
+static uint32_t _len_ext_cost(uint32_t n)
+{
+	return n < 15 ? 0 : (n - 15) / 255 + 1;
+}
+
+static uint8_t* _write_len_ext(uint8_t* op, uint32_t n)
+{
+	n -= 15;
+
+	while(n >= 255) {
+		*op++ = 255;
+		n -= 255;
+	}
+
+	*op++ = (uint8_t)n;
+
+	return op;
+}
+
+static uint8_t* _write_literals(uint8_t* op, const uint8_t* lit, uint32_t lit_len, uint32_t match_code)
+{
+	*op++ = (uint8_t)(((lit_len < 15 ? lit_len : 15) << 4) | (match_code < 15 ? match_code : 15));
+
+	if(lit_len >= 15) {
+		op = _write_len_ext(op, lit_len);
+	}
+
+	memcpy(op, lit, lit_len);
+
+	return op + lit_len;
+}
+
+/**
+ * Compress src into dst without exceeding dst_cap. If dst is too small, the
+ * compression stops early and *consumed tells how many input bytes are
+ * encoded, the rest can go to next block.
+ *
+ * @param hash_table work memory, content needn't be initialized
+ * @return compressed size
+ */
+uint32_t lz_compress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_cap, uint32_t* consumed,
+                     uint16_t hash_table[LZ_HASH_SIZE])
+{
+	const uint8_t* ip = src;
+	const uint8_t* anchor = src;
+	const uint8_t* end;
+	const uint8_t* ref;
+	uint8_t* op = dst;
+	uint8_t* op_end = dst + dst_cap;
+	uint32_t lit_len, match_len, cost, h;
+
+	if(src_len > LZ_MAX_INPUT) {
+		src_len = LZ_MAX_INPUT;
+	}
+
+	end = src + src_len;
+	/* position + 1 is stored, 0 means empty */
+	memset(hash_table, 0, LZ_HASH_SIZE * sizeof(uint16_t));
+
+	while(ip + LZ_MIN_MATCH <= end) {
+		h = _hash(ip);
+		ref = hash_table[h] ? src + hash_table[h] - 1 : NULL;
+		hash_table[h] = (uint16_t)(ip - src + 1);
+
+		if(ref == NULL || memcmp(ref, ip, LZ_MIN_MATCH) != 0) {
+			ip++;
+			continue;
+		}
+
+		match_len = LZ_MIN_MATCH;
+
+		while(ip + match_len < end && ref[match_len] == ip[match_len]) {
+			match_len++;
+		}
+
+		lit_len = ip - anchor;
+		cost = 1 + _len_ext_cost(lit_len) + lit_len + 2 + _len_ext_cost(match_len - LZ_MIN_MATCH);
+
+		if(op + cost > op_end) {
+			/* no room for this sequence, finish with literals */
+			break;
+		}
+
+		op = _write_literals(op, anchor, lit_len, match_len - LZ_MIN_MATCH);
+		*op++ = (uint8_t)(ip - ref);
+		*op++ = (uint8_t)((ip - ref) >> 8);
+
+		if(match_len - LZ_MIN_MATCH >= 15) {
+			op = _write_len_ext(op, match_len - LZ_MIN_MATCH);
+		}
+
+		ip += match_len;
+		anchor = ip;
+	}
+
+	/* last sequence, only literals. take as many as fit */
+	lit_len = end - anchor;
+
+	if(op < op_end) {
+		if(1 + _len_ext_cost(lit_len) + lit_len > (uint32_t)(op_end - op)) {
+			lit_len = op_end - op - 1;
+
+			while(lit_len && 1 + _len_ext_cost(lit_len) + lit_len > (uint32_t)(op_end - op)) {
+				lit_len--;
+			}
+		}
+
+		if(lit_len) {
+			op = _write_literals(op, anchor, lit_len, 0);
+		}
+	} else {
+		lit_len = 0;
+	}
+
+	*consumed = anchor - src + lit_len;
+
+	return op - dst;
+}
+
+/**
+ * Decompress a block produced by lz_compress().
+ *
+ * @return decompressed size, -1 if the block is malformed or dst is too small
+ */
+int32_t lz_decompress(const uint8_t* src, uint32_t src_len, uint8_t* dst, uint32_t dst_cap)
+{
+	const uint8_t* ip = src;
+	const uint8_t* ip_end = src + src_len;
+	uint8_t* op = dst;
+	uint8_t* op_end = dst + dst_cap;
+	uint32_t lit_len, match_len, offset;
+	uint8_t token, b;
+
+	while(ip < ip_end) {
+		token = *ip++;
+
+		lit_len = token >> 4;
+
+		if(lit_len == 15) {
+			do {
+				if(ip >= ip_end) {
+					return -1;
+				}
+
+				b = *ip++;
+				lit_len += b;
+			} while(b == 255);
+		}
+
+		if(lit_len > (uint32_t)(ip_end - ip) || lit_len > (uint32_t)(op_end - op)) {
+			return -1;
+		}
+
+		memcpy(op, ip, lit_len);
+		ip += lit_len;
+		op += lit_len;
+
+		if(ip >= ip_end) {
+			break;
+		}
+
+		if(ip_end - ip < 2) {
+			return -1;
+		}
+
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+
+		match_len = token & 0x0F;
+
+		if(match_len == 15) {
+			do {
+				if(ip >= ip_end) {
+					return -1;
+				}
+
+				b = *ip++;
+				match_len += b;
+			} while(b == 255);
+		}
+
+		match_len += LZ_MIN_MATCH;
+
+		if(offset == 0 || offset > (uint32_t)(op - dst) || match_len > (uint32_t)(op_end - op)) {
+			return -1;
+		}
+
+		/* byte copy, source may overlap */
+		while(match_len--) {
+			*op = *(op - offset);
+			op++;
+		}
+	}
+
+	return op - dst;
+}
@@ -21,23 +21,30 @@
 
 ringbuffer* ringbuffer_create(uint32_t size)
 {
-	ringbuffer* rb = (ringbuffer*)rt_malloc(sizeof(ringbuffer));
+	ringbuffer* rb;
+	uint8_t* buff;
+
+	if(!RING_IS_POW2(size)) {
+		console_printf("ringbuffer size %u is not power of 2\r\n", (unsigned)size);
+		return NULL;
+	}
+
+	rb = (ringbuffer*)rt_malloc(sizeof(ringbuffer));
 
 	if(rb == NULL) {
 		console_printf("ringbuffer_create fail\r\n");
 		return NULL;
 	}
 
-	rb->buff = (uint8_t*)rt_malloc(size);
+	buff = (uint8_t*)rt_malloc(size);
 
-	if(rb->buff == NULL) {
+	if(buff == NULL) {
 		console_printf("ringbuffer_create fail\r\n");
+		rt_free(rb);
 		return NULL;
 	}
 
-	rb->size = size;
-	rb->head = 0;
-	rb->tail = 0;
+	ring_spsc_init(&rb->ring, buff, size, 1);
 	rb->static_flag = 0;
 
 	return rb;
@@ -45,18 +52,21 @@ ringbuffer* ringbuffer_create(uint32_t size)
 
 ringbuffer* ringbuffer_static_create(uint8_t* buffer, uint32_t size)
 {
-	ringbuffer* rb = (ringbuffer*)rt_malloc(sizeof(ringbuffer));
+	ringbuffer* rb;
+
+	if(!RING_IS_POW2(size)) {
+		console_printf("ringbuffer size %u is not power of 2\r\n", (unsigned)size);
+		return NULL;
+	}
+
+	rb = (ringbuffer*)rt_malloc(sizeof(ringbuffer));
 
 	if(rb == NULL) {
 		console_printf("ringbuffer_static_create fail\r\n");
 		return NULL;
 	}
 
-	rb->buff = buffer;
-
-	rb->size = size;
-	rb->head = 0;
-	rb->tail = 0;
+	ring_spsc_init(&rb->ring, buffer, size, 1);
 	rb->static_flag = 1;
 
 	return rb;
@@ -65,50 +75,36 @@ ringbuffer* ringbuffer_static_create(uint8_t* buffer, uint32_t size)
 void ringbuffer_delete(ringbuffer* rb)
 {
 	if(!rb->static_flag)
-		rt_free(rb->buff);
+		rt_free(rb->ring.buff);
 
 	rt_free(rb);
 }
 
+/* the console rings are written and drained from any thread (console_printf,
+ * the mavlink console timeout in comm thread), so unlike the single producer
+ * single consumer ring_spsc underneath, every operation holds the lock */
 uint32_t ringbuffer_getlen(ringbuffer* rb)
 {
-	uint32_t len;
-
-	OS_ENTER_CRITICAL;
-
-	if(rb->head >= rb->tail)
-		len = rb->head - rb->tail;
-	else
-		len = rb->head + (rb->size - rb->tail);
-
-	OS_EXIT_CRITICAL;
-
-	return len;
+	return ring_spsc_count(&rb->ring);
 }
 
 uint8_t ringbuffer_putc(ringbuffer* rb, uint8_t c)
 {
-	OS_ENTER_CRITICAL;
-
-	if((rb->head + 1) % rb->size == rb->tail) {
-		OS_EXIT_CRITICAL;
-		return 0;
-	}
+	uint8_t len;
 
-	rb->buff[rb->head] = c;
-	rb->head = (rb->head + 1) % rb->size;
+	OS_ENTER_CRITICAL;
+	len = ring_spsc_put(&rb->ring, &c, 1);
 	OS_EXIT_CRITICAL;
 
-	return 1;
+	return len;
 }
 
 uint8_t ringbuffer_getc(ringbuffer* rb)
 {
-	uint8_t c;
+	uint8_t c = 0;
 
 	OS_ENTER_CRITICAL;
-	c = rb->buff[rb->tail];
-	rb->tail = (rb->tail + 1) % rb->size;
+	ring_spsc_get(&rb->ring, &c, 1);
 	OS_EXIT_CRITICAL;
 
 	return c;
@@ -116,57 +112,25 @@ uint8_t ringbuffer_getc(ringbuffer* rb)
 
 uint32_t ringbuffer_get(ringbuffer* rb, uint8_t* buffer, uint32_t len)
 {
-	uint32_t r_len, buffer_len;
-
-	/* check if there are enough data to read */
-	buffer_len = ringbuffer_getlen(rb);
-	r_len = buffer_len < len ? buffer_len : len;
-
 	OS_ENTER_CRITICAL;
-
-	for(uint32_t i = 0 ; i < r_len ; i++) {
-		buffer[i] = rb->buff[rb->tail];
-		rb->tail = (rb->tail + 1) % rb->size;
-	}
-
+	len = ring_spsc_get(&rb->ring, buffer, len);
 	OS_EXIT_CRITICAL;
 
-	return r_len;
+	return len;
 }
 
 uint32_t ringbuffer_put(ringbuffer* rb, const uint8_t* buffer, uint32_t len)
 {
-	uint32_t w_len, buffer_len;
-	uint32_t free_space;
-	uint32_t space_to_end;
-
-	/* check if there are enough space to write */
-	buffer_len = ringbuffer_getlen(rb);
-	free_space = rb->size - buffer_len;
-	w_len = (len <= free_space) ? len : free_space;
-
 	OS_ENTER_CRITICAL;
-
-	space_to_end = rb->size - rb->head;
-
-	if(w_len <= space_to_end) {
-		memcpy(&rb->buff[rb->head], buffer, w_len);
-	} else {
-		memcpy(&rb->buff[rb->head], buffer, space_to_end);
-		memcpy(rb->buff, &buffer[space_to_end], w_len - space_to_end);
-	}
-
-	rb->head = (rb->head + w_len) % rb->size;
-
+	len = ring_spsc_put(&rb->ring, buffer, len);
 	OS_EXIT_CRITICAL;
 
-	return w_len;
+	return len;
 }
 
 void ringbuffer_flush(ringbuffer* rb)
 {
 	OS_ENTER_CRITICAL;
-	rb->head = rb->tail = 0;
+	ring_spsc_flush(&rb->ring);
 	OS_EXIT_CRITICAL;
 }
-
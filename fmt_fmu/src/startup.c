@@ -25,7 +25,8 @@
 static rt_thread_t tid0;
 
 // Task Stack
-static char thread_vehicle_stack[10240];
+// models run in their own threads, see module/system/model_sched.h
+static char thread_vehicle_stack[4096];
 struct rt_thread thread_vehicle_handle;
 
 static char thread_comm_stack[8192];
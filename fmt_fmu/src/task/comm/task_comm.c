@@ -60,6 +60,7 @@ static void usb_status_change_cb(void* parameter)
 {
     USB_Status* usb_status = (USB_Status*)parameter;
 
+#ifndef FMT_USING_HIL_BRIDGE
     /* channel 0: usart    channel 1: usb */
     if (usb_status->connected && _mav_dev_chan != 1) {
         _mav_dev_chan = 1;
@@ -68,6 +69,10 @@ static void usb_status_change_cb(void* parameter)
     if (!usb_status->connected && _mav_dev_chan != 0) {
         _mav_dev_chan = 0;
     }
+#else
+    /* usb carries the hil bridge, mavlink stays on usart */
+    (void)usb_status;
+#endif
 }
 
 static void mavproxy_msg_heartbeat_pack(mavlink_message_t* msg_t)
@@ -86,6 +91,33 @@ static void mavproxy_msg_heartbeat_pack(mavlink_message_t* msg_t)
         msg_t, &heartbeat);
 }
 
+/* send usage of one thread per call, so all threads are covered in turn */
+static void mavproxy_msg_thread_usage_pack(mavlink_message_t* msg_t)
+{
+    static uint16_t thread_idx = 0;
+    Sys_Stat_Report report;
+    mavlink_named_value_float_t named_value;
+
+    memset(&named_value, 0, sizeof(named_value));
+    named_value.time_boot_ms = systime_now_ms();
+
+    if (sysstat_get_report(&report) == FMT_EOK && report.thread_num) {
+        if (thread_idx >= report.thread_num) {
+            thread_idx = 0;
+        }
+
+        strncpy(named_value.name, report.thread[thread_idx].name, sizeof(named_value.name));
+        named_value.value = report.thread[thread_idx].usage;
+        thread_idx++;
+    } else {
+        strncpy(named_value.name, "cpu", sizeof(named_value.name));
+        named_value.value = sysstat_get_cpu_usage();
+    }
+
+    mavlink_msg_named_value_float_encode(mavlink_system.sysid, mavlink_system.compid,
+        msg_t, &named_value);
+}
+
 static void mavproxy_msg_sys_status_pack(mavlink_message_t* msg_t)
 {
     mavlink_sys_status_t sys_status;
@@ -174,12 +206,12 @@ void mavproxy_proc_command(mavlink_command_long_t* command,
 
 static uint8_t try_send_immediate_msg(void)
 {
-    while (_imm_msg_queue.head != _imm_msg_queue.tail) {
-        if (mavproxy_send_immediate_msg(&_imm_msg_queue.queue[_imm_msg_queue.tail],
-                1)) {
-            OS_ENTER_CRITICAL;
-            _imm_msg_queue.tail = (_imm_msg_queue.tail + 1) % MAX_IMMEDIATE_MSG_QUEUE_SIZE;
-            OS_EXIT_CRITICAL;
+    mavlink_message_t* msg;
+
+    /* send msg from queue slot directly, release it once it's sent */
+    while ((msg = ring_mpsc_peek(&_imm_msg_queue.ring)) != NULL) {
+        if (mavproxy_send_immediate_msg(msg, 1)) {
+            ring_mpsc_consume(&_imm_msg_queue.ring);
         }
     }
 
@@ -259,18 +291,12 @@ uint8_t mavproxy_send_immediate_msg(const mavlink_message_t* msg,
         return size == len ? 1 : 0;
     }
 
-    /* otherwise, push msg into queue (asynchronize mode) */
-    OS_ENTER_CRITICAL;
-
-    if ((_imm_msg_queue.head + 1) % MAX_IMMEDIATE_MSG_QUEUE_SIZE == _imm_msg_queue.tail) {
-        OS_EXIT_CRITICAL;
+    /* otherwise, push msg into queue (asynchronize mode). the queue is lock-free
+     * for multiple senders, so it can also be called from isr */
+    if (ring_mpsc_push(&_imm_msg_queue.ring, msg)) {
         return 0;
     }
 
-    _imm_msg_queue.queue[_imm_msg_queue.head] = *msg;
-    _imm_msg_queue.head = (_imm_msg_queue.head + 1) % MAX_IMMEDIATE_MSG_QUEUE_SIZE;
-    OS_EXIT_CRITICAL;
-
     /* wakeup mavproxy to send out temporary msg immediately */
     rt_event_send(&event_mavproxy, EVENT_MAVPROXY_UPDATE);
 
@@ -286,11 +312,12 @@ fmt_err task_comm_init(void)
     /* init message queue */
     _period_msg_queue.size = 0;
     _period_msg_queue.index = 0;
-    _imm_msg_queue.head = 0;
-    _imm_msg_queue.tail = 0;
+    ring_mpsc_init(&_imm_msg_queue.ring, _imm_msg_queue.queue, _imm_msg_queue.seq,
+        MAX_IMMEDIATE_MSG_QUEUE_SIZE, sizeof(mavlink_message_t));
 
     mavproxy_dev_init(_mav_dev_chan);
     mavlink_console_init();
+    ftp_manager_init();
 
     _mavproxy_tx_lock = rt_sem_create("mav_tx_lock", 1, RT_IPC_FLAG_FIFO);
 
@@ -312,6 +339,8 @@ fmt_err task_comm_init(void)
         mavproxy_msg_heartbeat_pack, 1);
     mavproxy_register_period_msg(MAVLINK_MSG_ID_SYS_STATUS, 1000,
         mavproxy_msg_sys_status_pack, 1);
+    mavproxy_register_period_msg(MAVLINK_MSG_ID_NAMED_VALUE_FLOAT, 100,
+        mavproxy_msg_thread_usage_pack, 1);
     mavproxy_register_period_msg(MAVLINK_MSG_ID_ATTITUDE, 100,
         mavproxy_msg_attitude_pack, 1);
     mavproxy_register_period_msg(MAVLINK_MSG_ID_LOCAL_POSITION_NED, 200,
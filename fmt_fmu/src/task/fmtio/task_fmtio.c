@@ -21,6 +21,7 @@
 #include "module/console/console.h"
 #include "module/fmtio/fmtio_protocol.h"
 #include "module/ipc/uMCN.h"
+#include "module/utils/ring.h"
 
 #include "hal/fmtio_dev.h"
 #include "hal/motor.h"
@@ -29,6 +30,7 @@
 
 #define EVENT_FMTIO_RX (1 << 0)
 #define EVENT_FMTIO_TX (1 << 1)
+#define EVENT_FMTIO_TX_DONE (1 << 2)
 
 typedef struct {
     uint32_t timestamp_ms;
@@ -44,39 +46,191 @@ typedef struct {
 static struct rt_event _fmtio_event;
 /* suspend io package send */
 static uint8_t _io_comm_suspend = 0;
-/* io send package buffer */
-static PackageStruct _io_pkg_buff[FMT_IO_BUFFER_SIZE];
-static uint16_t _pkg_buff_head = 0;
-static uint16_t _pkg_buff_tail = 0;
-/* send package data buffer */
-static uint8_t _pkg_data[FMT_IO_PKG_DATA_SIZE];
-/* io rx pkg */
-static uint8_t _rx_pkg_buff[MAX_PACKAGE_SIZE];
-static PackageStruct _rx_pkg = {
-    .content = _rx_pkg_buff
-};
+/* io tx frame ring, messages are appended to the open frame reserved at ring
+ * head, committed frames are waiting to be sent by fmtio thread */
+static FrameStruct _frame_pool[FMT_IO_FRAME_POOL_SIZE];
+static ring_spsc _frame_ring;
+static uint8_t _tx_seq = 0;
+/* io tx link, frames are sent by dma without waiting in the sender. motor frames
+ * are built and started directly from the vehicle thread, or started from tx done
+ * isr if the link is busy, so they never wait for the fmtio thread */
+static FrameStruct _motor_frame[FMT_IO_MOTOR_FRAME_NUM];
+static FrameStruct* volatile _motor_pending = NULL;
+static FrameStruct* volatile _tx_frame = NULL;
+static volatile uint8_t _tx_busy = 0;
+static uint32_t _rx_stamp_us;
+/* io rx */
+static ParserStruct _rx_parser;
+static LinkStatStruct _link_stat;
 /* rc channel value */
 static rc_data_t _rc_data;
 static uint8_t _rc_updated = 0;
+/* esc erpm reported by io */
+static struct motor_erpm _motor_erpm;
 static rt_device_t _fmtio_dev;
 static rc_dev_t _rc_dev_t;
 static motor_dev_t _motor_dev_t;
 
-static uint16_t _motor_cmd[FMTIO_MOTOR_CHANNEL_NUM];
-static PackageStruct _motor_cmd_pkg;
-
 static uint8_t _sync_finish = 0;
 
+MCN_DEFINE(fmtio_latency, sizeof(FMTIO_Latency_Report));
+
 /**************************** Callback Function ********************************/
 
+static void _tx_start(FrameStruct* frame);
+
 static rt_err_t fmtio_rx_ind(rt_device_t dev, rt_size_t size)
 {
+    /* stamp arrival for latency measurement, thread wakeup delay is excluded */
+    _rx_stamp_us = (uint32_t)systime_now_us();
+
     /* wakeup thread to handle received data */
     return rt_event_send(&_fmtio_event, EVENT_FMTIO_RX);
 }
 
+static rt_err_t fmtio_tx_done(rt_device_t dev, void* buffer)
+{
+    FrameStruct* frame;
+    rt_base_t level;
+
+    /* pending motor frame goes out right away */
+    level = rt_hw_interrupt_disable();
+    frame = _motor_pending;
+    _motor_pending = NULL;
+    _tx_frame = frame;
+    _tx_busy = (frame != NULL);
+    rt_hw_interrupt_enable(level);
+
+    if (frame) {
+        _tx_start(frame);
+    }
+
+    /* wakeup thread waiting for the link */
+    return rt_event_send(&_fmtio_event, EVENT_FMTIO_TX_DONE);
+}
+
+static int echo_fmtio_latency(void* param)
+{
+    FMTIO_Latency_Report report;
+
+    mcn_copy_from_hub((McnHub*)param, &report);
+
+    console_printf("rtt:%u link:%u io_proc:%u io_hold:%u latency:%u us\n", (unsigned)report.rtt_us,
+        (unsigned)report.link_us, report.io_proc_us, report.io_hold_us, (unsigned)report.latency_us);
+
+    return 0;
+}
+
 /**************************** Local Function ********************************/
 
+/* the link must be claimed, i.e. _tx_busy is set and _tx_frame is frame */
+static void _tx_start(FrameStruct* frame)
+{
+    uint16_t size = proto_frame_finalize(frame, _tx_seq++);
+
+    _link_stat.tx_frame++;
+    _link_stat.tx_byte += size;
+
+    /* asynchronous write, frame buffer is kept until tx done */
+    rt_device_write(_fmtio_dev, 0, frame->buff, size);
+}
+
+static uint8_t _tx_claim(FrameStruct* frame)
+{
+    uint8_t claimed = 0;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (!_tx_busy) {
+        _tx_busy = 1;
+        _tx_frame = frame;
+        claimed = 1;
+    }
+    rt_hw_interrupt_enable(level);
+
+    return claimed;
+}
+
+static void _handle_motor_ack(const PackageStruct* pkg)
+{
+    FMTIO_Latency_Report report;
+    uint32_t cmd_stamp;
+    uint16_t io_proc, io_hold;
+
+    if (pkg->len != PROTO_ACK_MOTOR_TS_SIZE) {
+        return;
+    }
+
+    memcpy(&cmd_stamp, &pkg->content[0], 4);
+    memcpy(&io_proc, &pkg->content[4], 2);
+    memcpy(&io_hold, &pkg->content[6], 2);
+
+    report.timestamp_ms = systime_now_ms();
+    report.cmd_timestamp_us = cmd_stamp;
+    report.rtt_us = _rx_stamp_us - cmd_stamp;
+    report.io_proc_us = io_proc;
+    report.io_hold_us = io_hold;
+    /* the two directions are assumed to take the same time */
+    report.link_us = report.rtt_us > io_hold ? (report.rtt_us - io_hold) / 2 : 0;
+    report.latency_us = report.link_us + io_proc;
+
+    mcn_publish(MCN_ID(fmtio_latency), &report);
+}
+
+/* called from vehicle thread through motor device */
+static fmt_err _send_motor_frame(uint16_t chan_mask, const uint16_t* chan_val, uint16_t size)
+{
+    FrameStruct* frame = NULL;
+    uint8_t start = 0;
+    uint8_t msg[PROTO_MOTOR_TS_HEAD_SIZE + FMTIO_MOTOR_CHANNEL_NUM * sizeof(uint16_t)];
+    uint32_t stamp;
+    rt_base_t level;
+    fmt_err err;
+
+    /* pick a frame which is neither in transmission nor pending */
+    level = rt_hw_interrupt_disable();
+    for (uint8_t i = 0; i < FMT_IO_MOTOR_FRAME_NUM; i++) {
+        if (&_motor_frame[i] != _tx_frame && &_motor_frame[i] != _motor_pending) {
+            frame = &_motor_frame[i];
+            break;
+        }
+    }
+    rt_hw_interrupt_enable(level);
+
+    stamp = (uint32_t)systime_now_us();
+    memcpy(&msg[0], &stamp, 4);
+    memcpy(&msg[4], &chan_mask, 2);
+    memcpy(&msg[PROTO_MOTOR_TS_HEAD_SIZE], chan_val, size);
+
+    proto_frame_init(frame);
+    err = proto_frame_append(frame, PROTO_CMD_MOTOR_TS, msg, PROTO_MOTOR_TS_HEAD_SIZE + size);
+
+    if (err != FMT_EOK) {
+        return err;
+    }
+
+    level = rt_hw_interrupt_disable();
+    if (!_tx_busy) {
+        _tx_busy = 1;
+        _tx_frame = frame;
+        start = 1;
+    } else {
+        /* replace the older command which has not been sent yet */
+        if (_motor_pending) {
+            _link_stat.tx_drop++;
+        }
+        _motor_pending = frame;
+    }
+    _link_stat.tx_msg++;
+    rt_hw_interrupt_enable(level);
+
+    if (start) {
+        _tx_start(frame);
+    }
+
+    return FMT_EOK;
+}
+
 static void _handle_rc_message(const PackageStruct* pkg)
 {
     uint16_t* index = (uint16_t*)pkg->content;
@@ -89,6 +243,30 @@ static void _handle_rc_message(const PackageStruct* pkg)
     _rc_updated = 1;
 }
 
+static void _handle_erpm_message(const PackageStruct* pkg)
+{
+    uint16_t mask;
+    uint16_t offset = 2;
+
+    if (pkg->len < 2) {
+        return;
+    }
+
+    mask = *(uint16_t*)&pkg->content[0];
+
+    OS_ENTER_CRITICAL;
+    _motor_erpm.valid_mask = 0;
+    for (uint8_t i = 0; i < FMTIO_MOTOR_CHANNEL_NUM; i++) {
+        if ((mask & (1 << i)) && offset + 4 <= pkg->len) {
+            memcpy(&_motor_erpm.erpm[i], &pkg->content[offset], 4);
+            _motor_erpm.valid_mask |= 1 << i;
+            offset += 4;
+        }
+    }
+    _motor_erpm.timestamp_ms = systime_now_ms();
+    OS_EXIT_CRITICAL;
+}
+
 static fmt_err _handle_package(const PackageStruct* pkg)
 {
     switch (pkg->cmd) {
@@ -107,6 +285,14 @@ static fmt_err _handle_package(const PackageStruct* pkg)
         hal_rc_rx_ind(_rc_dev_t, pkg->len);
     } break;
 
+    case PROTO_ACK_MOTOR_TS: {
+        _handle_motor_ack(pkg);
+    } break;
+
+    case PROTO_DATA_ERPM: {
+        _handle_erpm_message(pkg);
+    } break;
+
     case PROTO_ACK_MOTOR_VAL: {
         uint16_t mask = *(uint16_t*)&pkg->content[0];
         console_printf("ack motor, mask:%x ", mask);
@@ -129,30 +315,71 @@ static fmt_err _handle_package(const PackageStruct* pkg)
     return FMT_EOK;
 }
 
-static fmt_err _dump_pkg_buffer(void)
+/* should be called with OS_ENTER_CRITICAL */
+static FrameStruct* _open_frame(void)
 {
-    SendPkgStruct send_pkg;
+    FrameStruct* frame;
+
+    /* one slot is always kept free for the open frame */
+    ring_spsc_reserve(&_frame_ring, (void**)&frame);
+
+    return frame;
+}
+
+/* should be called with OS_ENTER_CRITICAL */
+static fmt_err _next_frame(void)
+{
+    if (ring_spsc_space(&_frame_ring) < 2) {
+        return FMT_EFULL;
+    }
+
+    ring_spsc_commit(&_frame_ring, 1);
+    proto_frame_init(_open_frame());
+
+    return FMT_EOK;
+}
+
+static fmt_err _dump_frame_buffer(void)
+{
+    FrameStruct* frame;
+    rt_uint32_t recv_set;
+    uint8_t pending;
 
     if (_io_comm_suspend) {
         return FMT_EBUSY;
     }
 
-    /* use static buffer to store pkg data which is going be sent */
-    send_pkg.send_buff = _pkg_data;
+    /* close the frame being filled, all messages queued so far go out together */
+    OS_ENTER_CRITICAL;
+    if (_open_frame()->msg_num) {
+        _next_frame();
+    }
+    OS_EXIT_CRITICAL;
+
+    while (ring_spsc_peek(&_frame_ring, (void**)&frame)) {
+
+        /* wait for the link, motor frames may go first */
+        while (!_tx_claim(frame)) {
+            rt_event_recv(&_fmtio_event, EVENT_FMTIO_TX_DONE, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR, 10, &recv_set);
+        }
 
-    while (_pkg_buff_tail != _pkg_buff_head) {
-        /* read pkg from buffer and make send pkg */
-        //package2sendpack_static(_io_pkg_buff[_pkg_buff_tail], &send_pkg);
-        make_send_package(_io_pkg_buff[_pkg_buff_tail], &send_pkg);
+        _tx_start(frame);
 
-        /* send out pkg data */
-        if (rt_device_write(_fmtio_dev, RT_WAITING_FOREVER, send_pkg.send_buff, send_pkg.buff_size) == send_pkg.buff_size) {
-            /* send success, free pkg and remove it from buffer */
-            free_package(&_io_pkg_buff[_pkg_buff_tail]);
-            OS_ENTER_CRITICAL;
-            _pkg_buff_tail = (_pkg_buff_tail + 1) % FMT_IO_BUFFER_SIZE;
-            OS_EXIT_CRITICAL;
+        /* frame buffer is kept until transfer completes */
+        while (_tx_frame == frame) {
+            rt_event_recv(&_fmtio_event, EVENT_FMTIO_TX_DONE, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR, 10, &recv_set);
         }
+
+        ring_spsc_consume(&_frame_ring, 1);
+    }
+
+    /* the frame may not be closed if pool was full, try again later */
+    OS_ENTER_CRITICAL;
+    pending = _open_frame()->msg_num;
+    OS_EXIT_CRITICAL;
+
+    if (pending) {
+        rt_event_send(&_fmtio_event, EVENT_FMTIO_TX);
     }
 
     return FMT_EOK;
@@ -160,16 +387,16 @@ static fmt_err _dump_pkg_buffer(void)
 
 static fmt_err _handle_rx_data(void)
 {
-    uint8_t c;
+    struct serial_rx_span span;
 
     if (_io_comm_suspend) {
         return FMT_EBUSY;
     }
 
-    while (rt_device_read(_fmtio_dev, 0, &c, 1)) {
-        if (proto_parse_package(c, &_rx_pkg) == FMT_EOK) {
-            _handle_package(&_rx_pkg);
-        }
+    /* parse on serial dma fifo without copying it out */
+    while (rt_device_control(_fmtio_dev, SERIAL_CTRL_RX_PEEK, &span) == RT_EOK && span.len > 0) {
+        proto_parse_buffer(&_rx_parser, span.data, span.len, _handle_package);
+        rt_device_control(_fmtio_dev, SERIAL_CTRL_RX_CONSUME, (void*)span.len);
     }
 
     return FMT_EOK;
@@ -203,6 +430,29 @@ static rt_err_t motor_control(motor_dev_t motor, int cmd, void* arg)
         fmtio_config(0, 0, freq);
     } break;
 
+    case MOTOR_CMD_SET_PROTOCOL: {
+        uint32_t protocol = (uint32_t)arg;
+        uint8_t msg[PROTO_MOTOR_PROTOCOL_SIZE];
+
+        if ((protocol & ~MOTOR_PROTOCOL_BIDIR) > MOTOR_PROTOCOL_DSHOT600) {
+            ret = RT_EINVAL;
+            break;
+        }
+
+        msg[0] = protocol & ~MOTOR_PROTOCOL_BIDIR;
+        msg[1] = (protocol & MOTOR_PROTOCOL_BIDIR) ? 1 : 0;
+
+        if (fmtio_send_message(PROTO_CMD_MOTOR_PROTOCOL, msg, sizeof(msg)) != FMT_EOK) {
+            ret = RT_ERROR;
+        }
+    } break;
+
+    case MOTOR_CMD_GET_ERPM: {
+        OS_ENTER_CRITICAL;
+        *(struct motor_erpm*)arg = _motor_erpm;
+        OS_EXIT_CRITICAL;
+    } break;
+
     default:
         break;
     }
@@ -213,26 +463,24 @@ static rt_err_t motor_control(motor_dev_t motor, int cmd, void* arg)
 static rt_size_t motor_read(motor_dev_t motor, rt_uint16_t chan_mask, rt_uint16_t* chan_val, rt_size_t size)
 {
     fmt_err err;
-    PackageStruct pkg;
-
-    fmtio_create_pkg(PROTO_GET_MOTOR_VAL, sizeof(chan_mask), &pkg);
 
-    err = fmtio_send_pkg(&chan_mask, sizeof(chan_mask), &pkg);
+    err = fmtio_send_message(PROTO_GET_MOTOR_VAL, &chan_mask, sizeof(chan_mask));
 
     return err == FMT_EOK ? size : 0;
 }
 
 static rt_size_t motor_write(motor_dev_t motor, rt_uint16_t chan_mask, const rt_uint16_t* chan_val, rt_size_t size)
 {
-    uint16_t data[FMTIO_MOTOR_CHANNEL_NUM + 1];
     uint16_t max_size = FMTIO_MOTOR_CHANNEL_NUM * sizeof(uint16_t);
     uint16_t w_size = size <= max_size ? size : max_size;
+    fmt_err err;
 
-    data[0] = chan_mask;
-    memcpy(&data[1], chan_val, w_size);
+    if (_io_comm_suspend || _fmtio_dev == NULL) {
+        return 0;
+    }
 
-    // 2 bytes for channel mask
-    fmt_err err = fmtio_send_pkg(data, w_size + 2, &_motor_cmd_pkg);
+    /* motor command bypasses the frame pool and fmtio thread */
+    err = _send_motor_frame(chan_mask, chan_val, w_size);
 
     return err == FMT_EOK ? w_size : 0;
 }
@@ -296,8 +544,17 @@ rt_device_t fmtio_get_device(void)
 
 void fmtio_suspend_comm(uint8_t suspend)
 {
+    rt_base_t level;
+
     _io_comm_suspend = suspend;
 
+    if (suspend) {
+        /* the link is handed over, drop motor command not sent yet */
+        level = rt_hw_interrupt_disable();
+        _motor_pending = NULL;
+        rt_hw_interrupt_enable(level);
+    }
+
     if (suspend == 0) {
         /* wakeup thread to handle TX/RX event */
         rt_event_send(&_fmtio_event, EVENT_FMTIO_RX);
@@ -305,54 +562,41 @@ void fmtio_suspend_comm(uint8_t suspend)
     }
 }
 
-fmt_err fmtio_init_pkg(uint16_t cmd, void* buffer, PackageStruct* pkg)
+void fmtio_get_link_stat(LinkStatStruct* stat)
 {
-    return init_static_package(cmd, (uint8_t*)buffer, pkg);
+    OS_ENTER_CRITICAL;
+    *stat = _link_stat;
+    OS_EXIT_CRITICAL;
 }
 
-fmt_err fmtio_create_pkg(uint16_t cmd, uint16_t buff_len, PackageStruct* pkg)
+fmt_err fmtio_send_message(uint16_t cmd, const void* data, uint16_t len)
 {
-    return init_package(cmd, buff_len, pkg);
-}
+    fmt_err err;
 
-fmt_err fmtio_send_pkg(const void* data, uint16_t len, PackageStruct* pkg)
-{
     if (_io_comm_suspend) {
         return FMT_EBUSY;
     }
 
-    if ((_pkg_buff_head + 1) % FMT_IO_BUFFER_SIZE == _pkg_buff_tail) {
-        console_printf("io package overflow\n");
-        return FMT_EFULL;
-    } else {
-        /* write pkg content */
-        if (write_package((uint8_t*)data, len, pkg) != FMT_EOK) {
-            console_printf("write pkg fail\n");
-            return FMT_ERROR;
-        }
+    /* append message to current frame, so messages sent close together
+     * (e.g. motor + config) are batched into one frame */
+    OS_ENTER_CRITICAL;
+    err = proto_frame_append(_open_frame(), cmd, data, len);
 
-        /* push pkg into send buffer */
-        OS_ENTER_CRITICAL;
-        _io_pkg_buff[_pkg_buff_head] = *pkg;
-        _pkg_buff_head = (_pkg_buff_head + 1) % FMT_IO_BUFFER_SIZE;
-        OS_EXIT_CRITICAL;
-
-        /* wakeup thread to send out pkg */
-        rt_event_send(&_fmtio_event, EVENT_FMTIO_TX);
+    if (err == FMT_EFULL && _next_frame() == FMT_EOK) {
+        /* current frame is full, continue with a new one */
+        err = proto_frame_append(_open_frame(), cmd, data, len);
     }
 
-    return FMT_EOK;
-}
-
-fmt_err fmtio_send_message(uint16_t cmd, const void* data, uint16_t len)
-{
-    fmt_err err;
-    PackageStruct pkg;
-
-    err = fmtio_create_pkg(cmd, len, &pkg);
+    if (err == FMT_EOK) {
+        _link_stat.tx_msg++;
+    } else {
+        _link_stat.tx_drop++;
+    }
+    OS_EXIT_CRITICAL;
 
     if (err == FMT_EOK) {
-        err = fmtio_send_pkg(data, len, &pkg);
+        /* wakeup thread to send out frame */
+        rt_event_send(&_fmtio_event, EVENT_FMTIO_TX);
     }
 
     return err;
@@ -410,8 +654,13 @@ fmt_err task_fmtio_init(void)
         return FMT_ERROR;
     }
 
-    /* create static pkg for motor cmd */
-    if (fmtio_init_pkg(PROTO_CMD_MOTOR, _motor_cmd, &_motor_cmd_pkg) != FMT_EOK) {
+    if (ring_spsc_init(&_frame_ring, _frame_pool, FMT_IO_FRAME_POOL_SIZE, sizeof(FrameStruct))) {
+        return FMT_ERROR;
+    }
+    proto_frame_init(_open_frame());
+    proto_parser_init(&_rx_parser, &_link_stat);
+
+    if (mcn_advertise(MCN_ID(fmtio_latency), echo_fmtio_latency) != FMT_EOK) {
         return FMT_ERROR;
     }
 
@@ -436,8 +685,9 @@ void task_fmtio_entry(void* parameter)
         return;
     }
 
-    /* set rx indicator */
+    /* set rx/tx indicator */
     rt_device_set_rx_indicate(_fmtio_dev, fmtio_rx_ind);
+    rt_device_set_tx_complete(_fmtio_dev, fmtio_tx_done);
 
     /* send sync cmd */
     fmtio_send_message(PROTO_CMD_SYNC, NULL, 0);
@@ -453,7 +703,7 @@ void task_fmtio_entry(void* parameter)
             }
 
             if (recv_set & EVENT_FMTIO_TX) {
-                _dump_pkg_buffer();
+                _dump_frame_buffer();
             }
         } else {
             //some err happen
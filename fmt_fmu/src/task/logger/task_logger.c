@@ -23,7 +23,6 @@
 #define TAG                             "Logger"
 
 #define MAX_LOG_SESSION_NUM             10
-#define LOG_SESSION_FOLDER              "/log"
 #define LOG_SESSION_ID_FILE             "session_id.txt"
 #define ULOG_FILE_NAME                  "ulog.txt"
 // #define BLOG_FILE_NAME                  "blog.bin"
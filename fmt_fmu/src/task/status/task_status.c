@@ -19,9 +19,11 @@
 #include "driver/tca62724.h"
 #include "hal/pin.h"
 #include "module/buzzer/buzzer_tune.h"
+#include "module/calibration/bg_calib.h"
 #include "module/fms/fms_model.h"
 #include "module/ins/ins_model.h"
 #include "module/sysio/pilot_cmd.h"
+#include "module/system/memstat.h"
 #include "task/task_logger.h"
 #include "task/task_status.h"
 
@@ -208,6 +210,10 @@ void task_status_entry(void* parameter)
     _ins_out_nod = mcn_subscribe(MCN_ID(ins_output), NULL, NULL);
     _pilot_cmd_nod = mcn_subscribe(MCN_ID(pilot_cmd), NULL, NULL);
 
+    if (bg_calib_init() != FMT_EOK) {
+        ulog_w(TAG, "background calibration init fail");
+    }
+
     _led_on();
 
     //rt_device_write(_rgb_led_dev, TCA62724_LED_BLUE, NULL, 0);
@@ -224,6 +230,12 @@ void task_status_entry(void* parameter)
         // update pilot command status
         _update_pilot_cmd_status();
 
+        // refine sensor calibration in background, fixed cost per loop
+        bg_calib_step();
+
+        // scan stack and heap usage
+        TIMETAG_CHECK_EXECUTE(memstat_update, 1000, memstat_update();)
+
         // breath light
         if (bright == 0)
             _inc = 1;
@@ -19,11 +19,16 @@
 #include "module/controller/controller_model.h"
 #include "module/fms/fms_model.h"
 #include "module/fs_manager/fs_manager.h"
+#include "module/hil/hil_bridge.h"
 #include "module/ins/ins_model.h"
+#include "module/param/param.h"
 #include "module/plant/plant_model.h"
 #include "module/sensor/sensor_manager.h"
 #include "module/sysio/actuator_cmd.h"
 #include "module/sysio/pilot_cmd.h"
+#include "module/system/memstat.h"
+#include "module/system/model_sched.h"
+#include "module/system/perf.h"
 #include "task/task_logger.h"
 #include "task/task_vehicle.h"
 
@@ -32,11 +37,84 @@
 static struct rt_timer timer_vehicle;
 static struct rt_event event_vehicle;
 
+/* time from trigger to the vehicle task actually running */
+PERF_DEFINE(vehicle_wakeup);
+/* period of the vehicle loop */
+PERF_DEFINE(vehicle_period);
+PERF_DEFINE(vehicle_loop);
+PERF_DEFINE(sensor_collect);
+PERF_DEFINE(actuator_cmd);
+
+static void control_step(void)
+{
+    controller_model_step();
+
+#if defined(FMT_HIL_WITH_ACTUATOR) || !defined(FMT_USING_HIL)
+    /* send actuator command as soon as controller output is ready */
+    PERF_BEGIN(actuator_cmd);
+    send_actuator_cmd();
+    PERF_END(actuator_cmd);
+#endif
+}
+
+/* each model runs in its own thread, see model_sched.h */
+MODEL_TASK_DEFINE(ins, ins_model_step, 4096);
+MODEL_TASK_DEFINE(fms, fms_model_step, 4096);
+MODEL_TASK_DEFINE(control, control_step, 4096);
+
 static void timer_vehicle_update(void* parameter)
 {
+#ifdef FMT_USING_HIL_BRIDGE
+    if (hil_bridge_lockstep()) {
+        /* simulator steps the vehicle loop */
+        return;
+    }
+#endif
+    PERF_BEGIN(vehicle_wakeup);
     rt_event_send(&event_vehicle, EVENT_VEHICLE_UPDATE);
 }
 
+#ifdef FMT_USING_HIL_BRIDGE
+static void hil_frame_update(void)
+{
+    PERF_BEGIN(vehicle_wakeup);
+    rt_event_send(&event_vehicle, EVENT_VEHICLE_UPDATE);
+}
+#endif
+
+#ifndef FMT_USING_HIL
+static void imu_drdy_update(void)
+{
+    PERF_BEGIN(vehicle_wakeup);
+    rt_event_send(&event_vehicle, EVENT_VEHICLE_UPDATE);
+}
+#endif
+
+static fmt_err vehicle_trigger_init(void)
+{
+#ifndef FMT_USING_HIL
+    if (PARAM_GET_INT32(SYSTEM, IMU_SYNC) == 1) {
+        /* run vehicle loop at imu data-ready, so sensor data is always fresh */
+        if (sensor_imu_drdy_sync(imu_drdy_update) == FMT_EOK) {
+            return FMT_EOK;
+        }
+        console_printf("imu data-ready is not available, use timer instead\n");
+    }
+#endif
+
+    /* register timer event */
+    rt_timer_init(&timer_vehicle, "vehicle",
+        timer_vehicle_update,
+        RT_NULL,
+        1,
+        RT_TIMER_FLAG_PERIODIC | RT_TIMER_FLAG_HARD_TIMER);
+    if (rt_timer_start(&timer_vehicle) != RT_EOK) {
+        return FMT_ERROR;
+    }
+
+    return FMT_EOK;
+}
+
 void task_vehicle_entry(void* parameter)
 {
     rt_err_t res;
@@ -49,32 +127,35 @@ void task_vehicle_entry(void* parameter)
 
         if (res == RT_EOK) {
             if (recv_set & EVENT_VEHICLE_UPDATE) {
+                PERF_END(vehicle_wakeup);
+                PERF_END(vehicle_period);
+                PERF_BEGIN(vehicle_period);
+                PERF_BEGIN(vehicle_loop);
 
                 uint32_t time_now = systime_now_ms();
 
+#ifdef FMT_USING_HIL_BRIDGE
+                if (hil_bridge_lockstep()) {
+                    /* release models on simulated time */
+                    time_now = hil_bridge_time_ms();
+                }
+#endif
+
 #ifndef FMT_USING_HIL
+                PERF_BEGIN(sensor_collect);
                 sensor_collect();
+                PERF_END(sensor_collect);
 #endif
 
                 pilot_cmd_collect();
 
-#ifdef FMT_USING_SIH
-                /* run Plant model in internal HIL mode */
-                TIMETAG_CHECK_EXECUTE3(plant_model_update, PLANT_EXPORT.period, time_now, plant_model_step();)
-#endif
-
-                /* run INS model */
-                TIMETAG_CHECK_EXECUTE3(ins_model_update, INS_EXPORT.period, time_now, ins_model_step();)
+                /* release models whose period is due */
+                model_sched_tick(time_now);
 
-                /* run FMS model */
-                TIMETAG_CHECK_EXECUTE3(fms_model_update, FMS_EXPORT.period, time_now, fms_model_step();)
+                PERF_END(vehicle_loop);
 
-                /* run Controller model */
-                TIMETAG_CHECK_EXECUTE3(control_model_update, CONTROL_EXPORT.period, time_now, controller_model_step();)
-
-#if defined(FMT_HIL_WITH_ACTUATOR) || !defined(FMT_USING_HIL)
-                send_actuator_cmd();
-#endif
+                /* log perf scopes and memory usage */
+                TIMETAG_CHECK_EXECUTE3(perf_log_update, 1000, time_now, perf_log(); memstat_log(); model_sched_log();)
             }
         }
     }
@@ -82,34 +163,70 @@ void task_vehicle_entry(void* parameter)
 
 fmt_err task_vehicle_init(void)
 {
+    /* register perf scopes */
+    perf_register(PERF_ID(vehicle_wakeup));
+    perf_register(PERF_ID(vehicle_period));
+    perf_register(PERF_ID(vehicle_loop));
+#ifndef FMT_USING_HIL
+    perf_register(PERF_ID(sensor_collect));
+#endif
+#if defined(FMT_HIL_WITH_ACTUATOR) || !defined(FMT_USING_HIL)
+    perf_register(PERF_ID(actuator_cmd));
+#endif
+
     /* create event */
     if (rt_event_init(&event_vehicle, "vehicle", RT_IPC_FLAG_FIFO) != RT_EOK) {
         return FMT_ERROR;
     }
 
-    /* register timer event */
-    rt_timer_init(&timer_vehicle, "vehicle",
-        timer_vehicle_update,
-        RT_NULL,
-        1,
-        RT_TIMER_FLAG_PERIODIC | RT_TIMER_FLAG_HARD_TIMER);
-    if (rt_timer_start(&timer_vehicle) != RT_EOK) {
+    if (vehicle_trigger_init() != FMT_EOK) {
         return FMT_ERROR;
     }
 
     /* init ins model */
-    ins_model_init();
+    if (ins_model_init() != FMT_EOK) {
+        return FMT_ERROR;
+    }
 
     /* init fms model */
-    fms_model_init();
+    if (fms_model_init() != FMT_EOK) {
+        return FMT_ERROR;
+    }
 
     /* init controller model */
-    controller_model_init();
+    if (controller_model_init() != FMT_EOK) {
+        return FMT_ERROR;
+    }
 
 #if defined(FMT_USING_SIH)
-    /* init plant model */
-    plant_model_init();
+    /* plant runs in its own thread, it feeds the models through sensor topics */
+    if (plant_model_init() != FMT_EOK) {
+        return FMT_ERROR;
+    }
+#endif
+
+#if defined(FMT_USING_HIL_BRIDGE)
+    /* external simulator feeds sensor topics and takes control_output */
+    if (hil_bridge_init(hil_frame_update) != FMT_EOK) {
+        return FMT_ERROR;
+    }
 #endif
 
+    /* register models, they run by period and not in this order, see model_sched.h */
+    if (model_sched_register(MODEL_TASK_ID(ins), INS_EXPORT.period) != FMT_EOK) {
+        return FMT_ERROR;
+    }
+    if (model_sched_register(MODEL_TASK_ID(control), CONTROL_EXPORT.period) != FMT_EOK) {
+        return FMT_ERROR;
+    }
+    if (model_sched_register(MODEL_TASK_ID(fms), FMS_EXPORT.period) != FMT_EOK) {
+        return FMT_ERROR;
+    }
+
+    /* model threads wait for release, which starts with the vehicle task */
+    if (model_sched_start() != FMT_EOK) {
+        return FMT_ERROR;
+    }
+
     return FMT_EOK;
 }
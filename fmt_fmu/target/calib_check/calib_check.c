@@ -0,0 +1,206 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * Runs a calibration sweep through the float ellipsoid fit of
+ * module/Calibration/ellipsoid_fit.c and through the matlab generated double
+ * precision fit of module/Calibration/calibration.c, built by calib_check.py.
+ *
+ * usage: calib_check acc|mag sweep.bin
+ *
+ * The sweep file is the raw samples as float x, y, z. The same initial
+ * covariance and noise as mavcmd.c are used for both fits. Results are
+ * printed as "key value ..." lines, matrices row-major, for calib_check.py
+ * to compare.
+ */
+
+/* ahead of firmament.h, the CMSIS core headers define __I */
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include <firmament.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "calibration.h"
+#include "module/calibration/ellipsoid_fit.h"
+
+/* same as mavcmd.c */
+static const float _acc_fit_p0[ELLIPSOID_PARAM_NUM] = { 10.0f, 10.0f, 10.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+static const float _mag_fit_p0[ELLIPSOID_PARAM_NUM] = { 10.0f, 10.0f, 10.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+
+static inline uint64_t _cycle_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static void _print(const char* key, const double* val, int num)
+{
+    printf("%s", key);
+    for (int i = 0; i < num; i++) {
+        printf(" %.9g", val[i]);
+    }
+    printf("\n");
+}
+
+static float* _load(const char* path, uint32_t* num)
+{
+    FILE* fp = fopen(path, "rb");
+    float* data;
+    long size;
+
+    if (fp == NULL) {
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    *num = size / (3 * sizeof(float));
+    data = malloc(*num * 3 * sizeof(float) + 1);
+    if (data && fread(data, 3 * sizeof(float), *num, fp) != *num) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+
+    return data;
+}
+
+static void _run_fit(const float* p0, const float* sample, uint32_t num)
+{
+    EllipsoidFit fit;
+    EllipsoidResult result;
+    uint64_t cycle = 0, worst = 0;
+    double val[9];
+
+    ellipsoid_fit_init(&fit, p0, 0.001f);
+
+    for (uint32_t n = 0; n < num; n++) {
+        uint64_t start = _cycle_now();
+        uint64_t elapsed;
+
+        ellipsoid_fit_update(&fit, sample[3 * n], sample[3 * n + 1], sample[3 * n + 2]);
+
+        elapsed = _cycle_now() - start;
+        cycle += elapsed;
+        worst = elapsed > worst ? elapsed : worst;
+    }
+
+    printf("fit_update_mean %.1f\n", (double)cycle / num);
+    printf("fit_update_max %llu\n", (unsigned long long)worst);
+
+    if (ellipsoid_fit_result(&fit, &result) != FMT_EOK) {
+        printf("fit_failed 1\n");
+        return;
+    }
+
+    for (int i = 0; i < 3; i++)
+        val[i] = result.bias[i];
+    _print("fit_bias", val, 3);
+    for (int i = 0; i < 9; i++)
+        val[i] = result.mat[i];
+    _print("fit_mat", val, 9);
+    for (int i = 0; i < 3; i++)
+        val[i] = result.radii[i];
+    _print("fit_radii", val, 3);
+}
+
+static void _run_codegen(const float* p0, const float* sample, uint32_t num)
+{
+    static double P[81], next_P[81];
+    double v[9] = { 0 }, next_v[9];
+    double bias[3], u[9], val[9];
+    creal_T mat[9], radii[3];
+    uint64_t cycle = 0, worst = 0;
+    double imag = 0.0;
+
+    calibration_initialize();
+
+    memset(P, 0, sizeof(P));
+    for (int i = 0; i < 9; i++) {
+        P[i * 10] = p0[i];
+    }
+
+    for (uint32_t n = 0; n < num; n++) {
+        uint64_t start = _cycle_now();
+        uint64_t elapsed;
+
+        ellipsoid_fit_step(sample[3 * n], sample[3 * n + 1], sample[3 * n + 2], v, P, 0.001, next_v, next_P);
+        memcpy(v, next_v, sizeof(v));
+        memcpy(P, next_P, sizeof(P));
+
+        elapsed = _cycle_now() - start;
+        cycle += elapsed;
+        worst = elapsed > worst ? elapsed : worst;
+    }
+
+    printf("codegen_update_mean %.1f\n", (double)cycle / num);
+    printf("codegen_update_max %llu\n", (unsigned long long)worst);
+
+    ellipsoid_fit_solve(v, mat, bias, u, radii);
+
+    _print("codegen_bias", bias, 3);
+    /* matlab is column-major, mavcmd stored mat[i].re with XY at index 3 */
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            val[i * 3 + j] = mat[j * 3 + i].re;
+            imag = fmax(imag, fabs(mat[j * 3 + i].im));
+        }
+    }
+    _print("codegen_mat", val, 9);
+    for (int i = 0; i < 3; i++) {
+        val[i] = radii[i].re;
+        imag = fmax(imag, fabs(radii[i].im));
+    }
+    _print("codegen_radii", val, 3);
+    printf("codegen_imag %.9g\n", imag);
+}
+
+int main(int argc, char* argv[])
+{
+    const float* p0;
+    float* sample;
+    uint32_t num;
+
+    if (argc != 3 || (strcmp(argv[1], "acc") && strcmp(argv[1], "mag"))) {
+        fprintf(stderr, "usage: %s acc|mag sweep.bin\n", argv[0]);
+        return 2;
+    }
+    p0 = strcmp(argv[1], "acc") ? _mag_fit_p0 : _acc_fit_p0;
+
+    sample = _load(argv[2], &num);
+    if (sample == NULL || num == 0) {
+        fprintf(stderr, "no sample in %s\n", argv[2]);
+        return 2;
+    }
+
+    printf("samples %u\n", num);
+    _run_fit(p0, sample, num);
+    _run_codegen(p0, sample, num);
+
+    free(sample);
+
+    return 0;
+}
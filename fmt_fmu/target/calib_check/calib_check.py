@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+
+"""
+Check the float ellipsoid fit (module/Calibration/ellipsoid_fit.c) against
+the matlab generated double precision fit it replaced (calibration.c).
+
+Both fits run on the same sweep with the initial covariance of mavcmd.c.
+The check fails if bias, correction matrix or radii differ by more than the
+tolerance, or if the float fit maps the sweep to a sphere worse than the
+codegen. The update time of both is reported.
+
+Sweeps are the MAG or IMU accelerometer messages of a BLog file recorded
+while the vehicle is turned through the calibration, or without log the
+synthetic sweeps of mavcmd.c: 3 turns about the vertical for the mag and
+6 static positions for the acc, with a known bias and scale.
+
+Examples:
+    calib_check.py
+    calib_check.py --log calib.bin --sensor mag
+"""
+
+from __future__ import print_function
+import math
+import os
+import random
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+from argparse import ArgumentParser
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HERE, '..', 'model_bench'))
+sys.path.insert(0, os.path.join(HERE, '..', 'host_test'))
+
+import host_test  # noqa: E402
+from model_bench import CMSIS, FMU, HOST_FLAGS, read_blog, run  # noqa: E402
+
+CALIB = os.path.join(FMU, 'src', 'module', 'Calibration')
+# matlab coder output of the old fit
+CODEGEN_SRC = ['calibration.c', 'rt_nonfinite.c', 'rtGetInf.c', 'rtGetNaN.c']
+FIT_SRC = ['src/module/Calibration/ellipsoid_fit.c', 'src/module/Math/matrix.c']
+# CMSIS-DSP kernels matrix.c calls with ARM_MATH_CM4
+CMSIS_SRC = ['DSP_Lib/Source/BasicMathFunctions/arm_add_f32.c',
+             'DSP_Lib/Source/BasicMathFunctions/arm_sub_f32.c',
+             'DSP_Lib/Source/BasicMathFunctions/arm_dot_prod_f32.c',
+             'DSP_Lib/Source/MatrixFunctions/arm_mat_mult_f32.c']
+
+# same as mavcmd.c
+ACC_CALIBRATE_COUNT = 200
+MAG_CALIBRATE_COUNT = 500
+
+# float against double, relative to the mean radius or absolute for the
+# correction matrix whose largest gain is 1
+TOL_BIAS = 0.005
+TOL_MAT = 0.005
+TOL_RADII = 0.005
+# the float fit may map the sweep to a sphere this much worse than the codegen
+TOL_SPHERE = 1.1
+
+
+def build(work):
+    objs = []
+    for src in CODEGEN_SRC:
+        obj = os.path.join(work, os.path.splitext(src)[0] + '.o')
+        run(['gcc', '-O2', '-std=gnu99', '-c', os.path.join(CALIB, src), '-o', obj] + HOST_FLAGS,
+            stderr=subprocess.STDOUT)
+        objs.append(obj)
+
+    exe = os.path.join(work, 'calib_check')
+    cmd = ['gcc'] + host_test.FLAGS + host_test.DEFINES + HOST_FLAGS + ['-I' + CALIB]
+    cmd += ['-I' + os.path.join(FMU, d) for d in host_test.INCLUDE]
+    cmd += ['-isystem' + os.path.join(FMU, d) for d in host_test.SYS_INCLUDE]
+    cmd += [os.path.join(HERE, 'calib_check.c'), os.path.join(host_test.HERE, 'host_stub.c')]
+    cmd += [os.path.join(FMU, s) for s in FIT_SRC] + [os.path.join(CMSIS, s) for s in CMSIS_SRC]
+    cmd += objs + ['-Wl,--gc-sections', '-lm', '-o', exe]
+    run(cmd, stderr=subprocess.STDOUT)
+    return exe
+
+
+# ----------------------------------------------------------------------------
+# sweeps
+
+def _rot(axis, angle):
+    c, s = math.cos(angle), math.sin(angle)
+    if axis == 0:
+        return [[1, 0, 0], [0, c, -s], [0, s, c]]
+    if axis == 1:
+        return [[c, 0, s], [0, 1, 0], [-s, 0, c]]
+    return [[c, -s, 0], [s, c, 0], [0, 0, 1]]
+
+
+def _mul(m, v):
+    return [sum(m[i][j] * v[j] for j in range(3)) for i in range(3)]
+
+
+def _trans(m):
+    return [[m[j][i] for j in range(3)] for i in range(3)]
+
+
+def _distort(v, scale, bias, noise, rnd):
+    return [x + b + rnd.gauss(0, noise) for x, b in zip(_mul(scale, v), bias)]
+
+
+def sweep_mag(rnd):
+    '''turned a full circle about the vertical with z, x and y axis down'''
+    scale = [[1.10, 0.05, -0.03], [0.05, 0.95, 0.02], [-0.03, 0.02, 1.02]]
+    bias = [0.12, -0.08, 0.20]
+    incl = math.radians(60)
+    field = [0.5 * math.cos(incl), 0.0, 0.5 * math.sin(incl)]
+    # body to earth of each position, the turn is about earth z
+    positions = [_rot(0, 0), _rot(1, math.pi / 2), _rot(0, -math.pi / 2)]
+    samples = []
+    for pos in positions:
+        for n in range(MAG_CALIBRATE_COUNT):
+            turn = _rot(2, 2 * math.pi * n / MAG_CALIBRATE_COUNT)
+            body = _mul(_trans(pos), _mul(_trans(turn), field))
+            samples.append(_distort(body, scale, bias, 0.003, rnd))
+    return samples, bias
+
+
+def sweep_acc(rnd):
+    '''held still with each axis up and down, no cross axis scale as mavcmd fits none'''
+    scale = [[1.02, 0.0, 0.0], [0.0, 0.98, 0.0], [0.0, 0.0, 1.01]]
+    bias = [0.15, -0.10, 0.30]
+    g = 9.80665
+    samples = []
+    for axis in range(3):
+        for sign in (1, -1):
+            up = [0.0, 0.0, 0.0]
+            up[axis] = -sign * g
+            samples += [_distort(up, scale, bias, 0.02, rnd) for _ in range(ACC_CALIBRATE_COUNT)]
+    return samples, bias
+
+
+def sweep_log(log, sensor):
+    # payload of MAG is timestamp, mag_x..z, of IMU timestamp, gyr_x..z, acc_x..z
+    bus, offset = ('MAG', 4) if sensor == 'mag' else ('IMU', 16)
+    samples = [list(struct.unpack_from('<3f', payload, offset)) for name, payload in read_blog(log) if name == bus]
+    if not samples:
+        sys.exit("no %s message in %s" % (bus, log))
+    return samples, None
+
+
+# ----------------------------------------------------------------------------
+# check
+
+def sphere_error(samples, bias, mat):
+    '''relative rms deviation of the corrected sample norms from their mean'''
+    norms = [math.sqrt(sum(c * c for c in _mul(mat, [x - b for x, b in zip(s, bias)]))) for s in samples]
+    mean = sum(norms) / len(norms)
+    return math.sqrt(sum((n - mean) ** 2 for n in norms) / len(norms)) / mean
+
+
+def check(exe, work, sensor, samples, true_bias, unit):
+    sweep = os.path.join(work, 'sweep_%s.bin' % sensor)
+    with open(sweep, 'wb') as f:
+        for s in samples:
+            f.write(struct.pack('<3f', *s))
+
+    out = {}
+    for line in run([exe, sensor, sweep]).splitlines():
+        key, _, val = line.partition(' ')
+        out[key] = [float(v) for v in val.split()]
+
+    print("%s: %d samples" % (sensor, len(samples)))
+    print("  update, %s    mean %10.1f  max %10d  (codegen mean %.1f  max %d)" % (
+        unit, out['fit_update_mean'][0], out['fit_update_max'][0],
+        out['codegen_update_mean'][0], out['codegen_update_max'][0]))
+
+    if 'fit_failed' in out:
+        print("  FAIL float fit has no result")
+        return False
+
+    radius = sum(out['codegen_radii']) / 3
+    errors = [
+        ('bias', max(abs(a - b) for a, b in zip(out['fit_bias'], out['codegen_bias'])) / radius, TOL_BIAS),
+        ('mat', max(abs(a - b) for a, b in zip(out['fit_mat'], out['codegen_mat'])), TOL_MAT),
+        ('radii', max(abs(a - b) for a, b in zip(sorted(out['fit_radii']), sorted(out['codegen_radii'])))
+         / radius, TOL_RADII),
+    ]
+    ok = True
+    for name, err, tol in errors:
+        print("  %-6s float - codegen  %.2e  (tolerance %.0e)%s" % (name, err, tol, '' if err <= tol else '  FAIL'))
+        ok &= err <= tol
+
+    fit_sphere = sphere_error(samples, out['fit_bias'], [out['fit_mat'][i:i + 3] for i in (0, 3, 6)])
+    gen_sphere = sphere_error(samples, out['codegen_bias'], [out['codegen_mat'][i:i + 3] for i in (0, 3, 6)])
+    sphere_ok = fit_sphere <= TOL_SPHERE * gen_sphere + 1e-6
+    print("  sphere rms error      float %.2e  codegen %.2e%s" % (fit_sphere, gen_sphere,
+                                                                  '' if sphere_ok else '  FAIL'))
+    ok &= sphere_ok
+
+    if out['codegen_imag'][0] != 0.0:
+        print("  codegen result has an imaginary part of %.2e" % out['codegen_imag'][0])
+    if true_bias:
+        print("  bias error to truth   float %.2e  codegen %.2e" % (
+            max(abs(a - b) for a, b in zip(out['fit_bias'], true_bias)) / radius,
+            max(abs(a - b) for a, b in zip(out['codegen_bias'], true_bias)) / radius))
+    print("")
+    return ok
+
+
+def main():
+    parser = ArgumentParser(description=__doc__)
+    parser.add_argument('--log', help='BLog file of a calibration sweep, synthetic sweeps if not given')
+    parser.add_argument('--sensor', choices=['acc', 'mag'], action='append', help='sensor to check, all if not given')
+    parser.add_argument('--seed', type=int, default=1, help='noise seed of the synthetic sweeps')
+    parser.add_argument('--keep', action='store_true', help='keep build directory')
+    args = parser.parse_args()
+
+    unit = 'tsc cycles' if os.uname()[4] in ('x86_64', 'i686') else 'ns'
+    sensors = args.sensor or ['acc', 'mag']
+    work = tempfile.mkdtemp(prefix='calib_check_')
+    failed = []
+    try:
+        exe = build(work)
+        for sensor in sensors:
+            if args.log:
+                samples, bias = sweep_log(args.log, sensor)
+            else:
+                samples, bias = (sweep_acc if sensor == 'acc' else sweep_mag)(random.Random(args.seed))
+            if not check(exe, work, sensor, samples, bias, unit):
+                failed.append(sensor)
+    finally:
+        if args.keep:
+            print("build directory: %s" % work)
+        else:
+            shutil.rmtree(work)
+
+    print("%d of %d sweeps failed%s" % (len(failed), len(sensors), (': ' + ', '.join(failed)) if failed else ''))
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+    main()
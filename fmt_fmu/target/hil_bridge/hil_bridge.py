@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+
+"""
+Host tools of the hil bridge (src/module/HIL).
+
+Builds hil_sim, the external simulator running the generated Plant model,
+and hil_fmu, a host stand-in for the board running INS, FMS and Controller.
+Both talk the frame format of include/module/hil/hil_frame.h over a serial
+port, usb cdc or udp.
+
+Examples:
+    hil_bridge.py --out build                    # then: build/hil_sim -l /dev/ttyACM0
+    hil_bridge.py --loopback --lockstep --batch 4
+    hil_bridge.py --loopback --time 20           # free running, paced by wall clock
+"""
+
+from __future__ import print_function
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+from argparse import ArgumentParser
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HERE, '..', 'model_bench'))
+
+from model_bench import CMSIS, CMSIS_SRC, FMU, compile_model, model_sources, run, toolchain  # noqa: E402
+
+LINK_SRC = [os.path.join(HERE, 'hil_link.c'), os.path.join(FMU, 'src', 'module', 'HIL', 'hil_frame.c')]
+
+# the vehicle has to be armed and climbed this high at the end of the profile, m
+LOOPBACK_MIN_HEIGHT = 2.0
+
+
+def build(out):
+    cc, _, flags = toolchain('host')
+    flags = flags + ['-I' + HERE, '-I' + os.path.join(FMU, 'include')]
+    link = [os.path.join(out, 'link_%s.o' % os.path.splitext(os.path.basename(s))[0]) for s in LINK_SRC]
+    for src, obj in zip(LINK_SRC, link):
+        run([cc] + flags + ['-c', src, '-o', obj], stderr=subprocess.STDOUT)
+
+    exes = {}
+    for tool, models in [('hil_sim', ['Plant']), ('hil_fmu', ['INS', 'FMS', 'Controller'])]:
+        objs = []
+        incs = []
+        for model in models:
+            objs += compile_model(model, 'host', out)
+            incs.append('-I' + model_sources(model)[0])
+        exe = os.path.join(out, tool)
+        sources = [os.path.join(HERE, tool + '.c')] + [os.path.join(CMSIS, s) for s in CMSIS_SRC]
+        run([cc] + flags + incs + sources + objs + link + ['-lm', '-o', exe], stderr=subprocess.STDOUT)
+        exes[tool] = exe
+    return exes
+
+
+def loopback(exes, args):
+    link = 'udp:127.0.0.1:%d' % args.port
+    sim_args = (['-l'] if args.lockstep else []) + ['-b', str(args.batch), '-t', str(args.time), link]
+
+    fmu = subprocess.Popen([exes['hil_fmu'], 'udpin:%d' % args.port], stdout=subprocess.PIPE,
+                           universal_newlines=True)
+    try:
+        sim = subprocess.run([exes['hil_sim']] + sim_args, stdout=subprocess.PIPE, universal_newlines=True)
+        fmu_out, _ = fmu.communicate(timeout=10)
+    finally:
+        if fmu.poll() is None:
+            fmu.kill()
+
+    print(sim.stdout, end='')
+    print(fmu_out, end='')
+    if sim.returncode != 0 or fmu.returncode != 0:
+        print("loopback failed, hil_sim %d, hil_fmu %d" % (sim.returncode, fmu.returncode))
+        return 1
+
+    summary = dict(f.split('=', 1) for f in sim.stdout.splitlines()[-1].split())
+    result = dict(f.split('=', 1) for f in fmu_out.splitlines()[-1].split())
+    if result['armed'] != '1' or float(summary['h_max']) < LOOPBACK_MIN_HEIGHT:
+        print("loopback failed, armed %s, climbed %s m" % (result['armed'], summary['h_max']))
+        return 1
+    if result['batch_err'] != '0':
+        print("loopback failed, %s batched frames dropped" % result['batch_err'])
+        return 1
+    if args.lockstep and (summary['ack_lost'] != '0' or result['lost'] != '0'):
+        print("loopback failed, frames lost in lockstep")
+        return 1
+
+    print("loopback ok")
+    return 0
+
+
+def main():
+    parser = ArgumentParser(description=__doc__)
+    parser.add_argument('--out', help='build directory of the tools (default a temporary one)')
+    parser.add_argument('--loopback', action='store_true', help='fly hil_sim against hil_fmu over local udp')
+    parser.add_argument('--lockstep', action='store_true', help='loopback in lockstep')
+    parser.add_argument('--batch', type=int, default=1, help='loopback imu samples per frame, 1 ~ 4, more than 1 in lockstep')
+    parser.add_argument('--time', type=int, default=12, help='loopback simulated time, s')
+    parser.add_argument('--port', type=int, default=14600, help='loopback udp port')
+    args = parser.parse_args()
+
+    if not args.out and not args.loopback:
+        parser.error('nothing to do, give --out or --loopback')
+    if args.batch > 1 and not args.lockstep:
+        parser.error('free running frames carry one imu sample, --batch needs --lockstep')
+
+    out = args.out or tempfile.mkdtemp(prefix='hil_bridge_')
+    if not os.path.isdir(out):
+        os.makedirs(out)
+
+    try:
+        exes = build(out)
+        ret = loopback(exes, args) if args.loopback else 0
+        if args.out:
+            print("tools in %s: %s" % (out, ', '.join(sorted(os.path.basename(e) for e in exes.values()))))
+    finally:
+        if not args.out:
+            shutil.rmtree(out)
+
+    sys.exit(ret)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,217 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * Host stand-in for the fmu side of the hil bridge, built by hil_bridge.py.
+ *
+ * Answers the simulator like hil_bridge.c does, but runs the INS, FMS and
+ * Controller models on the frame time of the simulator: INS on every imu
+ * sample, Controller every 4 ms and FMS every 8 ms, with the pilot profile
+ * of monte_carlo.c (arm at 4 s, climb from 6 s to 9 s in position mode).
+ * It lets the link and the simulator be checked without a board, and exits
+ * once the simulator has been silent for a while.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <Controller.h>
+#include <FMS.h>
+#include <INS.h>
+
+#include "hil_link.h"
+
+#define FMU_IDLE_TIMEOUT    3000
+
+#define T_ARM               4000
+#define T_STANDBY           5000
+#define T_CLIMB             6000
+#define T_HOLD              9000
+
+static void _pilot_cmd(uint32_t time, Pilot_Cmd_Bus* cmd)
+{
+    memset(cmd, 0, sizeof(Pilot_Cmd_Bus));
+
+    cmd->timestamp = time;
+    cmd->mode = 2; /* position mode */
+
+    if (time < T_STANDBY) {
+        cmd->ls_ud = -1.0f;
+        if (time >= T_ARM) {
+            /* arm gesture */
+            cmd->rs_lr = -1.0f;
+            cmd->rs_ud = -1.0f;
+        }
+    } else if (time < T_CLIMB) {
+        cmd->ls_ud = -1.0f;
+    } else if (time < T_HOLD) {
+        cmd->ls_ud = 0.8f;
+    }
+}
+
+static void _models_init(void)
+{
+    INS_init();
+    FMS_init();
+    Controller_init();
+}
+
+// run the models for the samples of one frame
+static void _models_step(const hil_sensor_t* sensor)
+{
+    for (int k = 0; k < sensor->imu_num; k++) {
+        uint32_t time = (uint32_t)((sensor->time_us + sensor->imu[k].dt_us) / 1000);
+
+        INS_U.IMU1.gyr_x = sensor->imu[k].gyr[0];
+        INS_U.IMU1.gyr_y = sensor->imu[k].gyr[1];
+        INS_U.IMU1.gyr_z = sensor->imu[k].gyr[2];
+        INS_U.IMU1.acc_x = sensor->imu[k].acc[0];
+        INS_U.IMU1.acc_y = sensor->imu[k].acc[1];
+        INS_U.IMU1.acc_z = sensor->imu[k].acc[2];
+        INS_U.IMU1.timestamp = time;
+
+        /* the other sensors are applied with the imu sample they were taken with */
+        if ((sensor->mask & HIL_SENSOR_MAG) && sensor->mag.dt_us == sensor->imu[k].dt_us) {
+            INS_U.MAG.mag_x = sensor->mag.mag[0];
+            INS_U.MAG.mag_y = sensor->mag.mag[1];
+            INS_U.MAG.mag_z = sensor->mag.mag[2];
+            INS_U.MAG.timestamp = time;
+        }
+
+        if ((sensor->mask & HIL_SENSOR_BARO) && sensor->baro.dt_us == sensor->imu[k].dt_us) {
+            INS_U.Barometer.pressure = sensor->baro.pressure;
+            INS_U.Barometer.temperature = sensor->baro.temperature;
+            INS_U.Barometer.timestamp = time;
+        }
+
+        if ((sensor->mask & HIL_SENSOR_GPS) && sensor->gps.dt_us == sensor->imu[k].dt_us) {
+            INS_U.GPS_uBlox.fixType = sensor->gps.fixType;
+            INS_U.GPS_uBlox.numSV = sensor->gps.numSV;
+            INS_U.GPS_uBlox.lat = sensor->gps.lat;
+            INS_U.GPS_uBlox.lon = sensor->gps.lon;
+            INS_U.GPS_uBlox.height = sensor->gps.height;
+            INS_U.GPS_uBlox.velN = (int32_t)(sensor->gps.velN * 1e3);
+            INS_U.GPS_uBlox.velE = (int32_t)(sensor->gps.velE * 1e3);
+            INS_U.GPS_uBlox.velD = (int32_t)(sensor->gps.velD * 1e3);
+            INS_U.GPS_uBlox.hAcc = (uint32_t)(sensor->gps.hAcc * 1e3);
+            INS_U.GPS_uBlox.vAcc = (uint32_t)(sensor->gps.vAcc * 1e3);
+            INS_U.GPS_uBlox.sAcc = (uint32_t)(sensor->gps.sAcc * 1e3);
+            INS_U.GPS_uBlox.timestamp = time;
+        }
+
+        INS_step();
+
+        if (time % 8 == 0) {
+            _pilot_cmd(time, &FMS_U.Pilot_Cmd);
+            FMS_U.INS_Output = INS_Y.INS_Out;
+            FMS_U.Control_Out = Controller_Y.Control_Out;
+            FMS_step();
+        }
+
+        if (time % 4 == 0) {
+            Controller_U.FMS_Out = FMS_Y.FMS_Output;
+            Controller_U.INS_Out = INS_Y.INS_Out;
+            Controller_step();
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    hil_link_t link;
+    hil_sensor_t sensor;
+    hil_actuator_t actuator;
+    uint32_t frame = 0, lost = 0, last_seq = 0, batch_err = 0;
+    int connected = 0, lockstep = 0;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s LINK\n  LINK  udpin:PORT, udp:HOST:PORT or /dev/ttyX[:baud]\n", argv[0]);
+        return 1;
+    }
+
+    if (hil_link_open(&link, argv[1]) != 0) {
+        return 1;
+    }
+
+    while (1) {
+        int type = hil_link_recv(&link, connected ? FMU_IDLE_TIMEOUT : -1);
+
+        if (type < 0) {
+            perror("recv");
+            return 1;
+        }
+        if (type == 0) {
+            /* simulator is gone */
+            break;
+        }
+
+        if (type == HIL_FRAME_HELLO && link.parser.len == sizeof(hil_hello_t)) {
+            hil_hello_t hello;
+
+            memcpy(&hello, link.parser.payload, sizeof(hello));
+            if (hello.version != HIL_FRAME_VERSION) {
+                fprintf(stderr, "simulator frame version %d, expect %d\n", hello.version, HIL_FRAME_VERSION);
+                continue;
+            }
+
+            /* a new session starts from the ground */
+            if (!connected || frame) {
+                _models_init();
+                frame = lost = batch_err = 0;
+            }
+            connected = 1;
+            lockstep = (hello.flag & HIL_FLAG_LOCKSTEP) ? 1 : 0;
+            hil_link_send(&link, HIL_FRAME_HELLO, &hello, sizeof(hello));
+            continue;
+        }
+
+        if (type != HIL_FRAME_SENSOR || !connected
+            || hil_sensor_decode(link.parser.payload, link.parser.len, &sensor) != 0) {
+            continue;
+        }
+
+        if (!lockstep && sensor.imu_num > 1) {
+            /* dropped like hil_bridge.c does, the board loop would only see the latest sample */
+            batch_err++;
+            continue;
+        }
+
+        if (frame && sensor.seq != last_seq + 1) {
+            lost += sensor.seq - last_seq - 1;
+        }
+        last_seq = sensor.seq;
+        frame++;
+
+        _models_step(&sensor);
+
+        actuator.seq = sensor.seq;
+        actuator.time_us = sensor.time_us;
+        actuator.timestamp = Controller_Y.Control_Out.timestamp;
+        memcpy(actuator.actuator_cmd, Controller_Y.Control_Out.actuator_cmd, sizeof(actuator.actuator_cmd));
+
+        if (hil_link_send(&link, HIL_FRAME_ACTUATOR, &actuator, sizeof(actuator)) != 0) {
+            perror("send");
+            return 1;
+        }
+    }
+
+    printf("frames=%u lost=%u crc_err=%u batch_err=%u armed=%d ins_h=%.2f\n", frame, lost,
+           (unsigned)link.parser.crc_err, batch_err, FMS_Y.FMS_Output.state == 2, INS_Y.INS_Out.h_R);
+
+    hil_link_close(&link);
+
+    return 0;
+}
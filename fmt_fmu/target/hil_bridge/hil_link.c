@@ -0,0 +1,224 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "hil_link.h"
+
+static speed_t _baud(int baud)
+{
+    switch (baud) {
+    case 57600:
+        return B57600;
+    case 115200:
+        return B115200;
+    case 230400:
+        return B230400;
+#ifdef B460800
+    case 460800:
+        return B460800;
+    case 921600:
+        return B921600;
+#endif
+    default:
+        return 0;
+    }
+}
+
+static int _open_serial(hil_link_t* link, const char* spec)
+{
+    char path[256];
+    const char* colon = strchr(spec, ':');
+    int baud = 921600;
+    struct termios tio;
+
+    snprintf(path, sizeof(path), "%.*s", colon ? (int)(colon - spec) : (int)strlen(spec), spec);
+    if (colon) {
+        baud = atoi(colon + 1);
+    }
+    if (_baud(baud) == 0) {
+        fprintf(stderr, "unsupported baud rate %d\n", baud);
+        return -1;
+    }
+
+    link->fd = open(path, O_RDWR | O_NOCTTY);
+    if (link->fd < 0) {
+        perror(path);
+        return -1;
+    }
+
+    /* raw 8N1, usb cdc ignores the baud rate */
+    tcgetattr(link->fd, &tio);
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, _baud(baud));
+    cfsetospeed(&tio, _baud(baud));
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    tcsetattr(link->fd, TCSANOW, &tio);
+    tcflush(link->fd, TCIOFLUSH);
+
+    return 0;
+}
+
+static int _open_udp(hil_link_t* link, const char* host, const char* port, int listen)
+{
+    struct addrinfo hints, *res;
+    int err;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = listen ? AI_PASSIVE : 0;
+
+    err = getaddrinfo(listen ? NULL : host, port, &hints, &res);
+    if (err) {
+        fprintf(stderr, "%s:%s: %s\n", host ? host : "", port, gai_strerror(err));
+        return -1;
+    }
+
+    link->fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (link->fd < 0) {
+        perror("socket");
+        freeaddrinfo(res);
+        return -1;
+    }
+
+    if (listen) {
+        if (bind(link->fd, res->ai_addr, res->ai_addrlen) < 0) {
+            perror("bind");
+            freeaddrinfo(res);
+            return -1;
+        }
+        link->peer_len = 0;
+    } else {
+        memcpy(&link->peer, res->ai_addr, res->ai_addrlen);
+        link->peer_len = res->ai_addrlen;
+    }
+
+    link->udp = 1;
+    freeaddrinfo(res);
+
+    return 0;
+}
+
+int hil_link_open(hil_link_t* link, const char* spec)
+{
+    char buf[256];
+
+    memset(link, 0, sizeof(hil_link_t));
+
+    if (strncmp(spec, "udpin:", 6) == 0) {
+        return _open_udp(link, NULL, spec + 6, 1);
+    }
+
+    if (strncmp(spec, "udp:", 4) == 0) {
+        char* port;
+
+        snprintf(buf, sizeof(buf), "%s", spec + 4);
+        port = strrchr(buf, ':');
+        if (port == NULL) {
+            fprintf(stderr, "expect udp:HOST:PORT\n");
+            return -1;
+        }
+        *port++ = '\0';
+        return _open_udp(link, buf, port, 0);
+    }
+
+    return _open_serial(link, spec);
+}
+
+int hil_link_send(hil_link_t* link, uint8_t type, const void* payload, uint8_t len)
+{
+    uint8_t frame[HIL_FRAME_MAX_LEN];
+    uint16_t size = hil_frame_pack(frame, type, payload, len);
+
+    if (link->udp) {
+        if (link->peer_len == 0) {
+            /* listening side has not heard from anyone yet */
+            return 0;
+        }
+        return sendto(link->fd, frame, size, 0, (struct sockaddr*)&link->peer, link->peer_len) == size ? 0 : -1;
+    }
+
+    for (uint16_t sent = 0; sent < size;) {
+        ssize_t n = write(link->fd, frame + sent, size - sent);
+
+        if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            return -1;
+        }
+        sent += n > 0 ? n : 0;
+    }
+
+    return 0;
+}
+
+// wait up to timeout_ms for a frame, return its type with payload in link->parser, 0 on timeout
+int hil_link_recv(hil_link_t* link, int timeout_ms)
+{
+    struct pollfd pfd = { link->fd, POLLIN, 0 };
+
+    /* frames found by a rescan after a false sync, before new bytes */
+    if (hil_frame_parse_next(&link->parser)) {
+        return link->parser.type;
+    }
+
+    while (1) {
+        while (link->buf_pos < link->buf_len) {
+            if (hil_frame_parse(&link->parser, link->buf[link->buf_pos++])) {
+                return link->parser.type;
+            }
+        }
+
+        if (poll(&pfd, 1, timeout_ms) <= 0) {
+            return 0;
+        }
+
+        if (link->udp) {
+            struct sockaddr_storage from;
+            socklen_t from_len = sizeof(from);
+
+            link->buf_len = recvfrom(link->fd, link->buf, sizeof(link->buf), 0, (struct sockaddr*)&from, &from_len);
+            if (link->peer_len == 0 || from_len != link->peer_len || memcmp(&from, &link->peer, from_len)) {
+                /* answer whoever talked last */
+                memcpy(&link->peer, &from, from_len);
+                link->peer_len = from_len;
+            }
+        } else {
+            link->buf_len = read(link->fd, link->buf, sizeof(link->buf));
+        }
+
+        if (link->buf_len < 0) {
+            return -1;
+        }
+        link->buf_pos = 0;
+    }
+}
+
+void hil_link_close(hil_link_t* link)
+{
+    if (link->fd >= 0) {
+        close(link->fd);
+    }
+}
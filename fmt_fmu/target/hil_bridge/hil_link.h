@@ -0,0 +1,47 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef __HIL_LINK_H__
+#define __HIL_LINK_H__
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "module/hil/hil_frame.h"
+
+/*
+ * Byte link of the host tools, given as
+ *   /dev/ttyACM0[:baud]   serial port or usb cdc of the board
+ *   udp:HOST:PORT         send to HOST:PORT
+ *   udpin:PORT            listen on PORT, answer the last sender
+ */
+typedef struct {
+    int fd;
+    int udp;
+    struct sockaddr_storage peer;
+    socklen_t peer_len;
+    hil_parser_t parser;
+    uint8_t buf[512];
+    int buf_len;
+    int buf_pos;
+} hil_link_t;
+
+int hil_link_open(hil_link_t* link, const char* spec);
+int hil_link_send(hil_link_t* link, uint8_t type, const void* payload, uint8_t len);
+int hil_link_recv(hil_link_t* link, int timeout_ms);
+void hil_link_close(hil_link_t* link);
+
+#endif
@@ -0,0 +1,295 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * External simulator for the hil bridge, runs the generated Plant model on
+ * host, built by hil_bridge.py.
+ *
+ * The plant steps every 2 ms. A SENSOR frame carries the imu samples of -b
+ * plant steps and every mag, baro and gps sample taken meanwhile, the plant
+ * runs on the latest actuator command received. Free running frames are
+ * paced by the wall clock and carry one imu sample, the fmu drops batches
+ * it can not step through; in lockstep (-l) each frame waits for its
+ * ACTUATOR, so the simulation runs as fast as the fmu answers.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <Plant.h>
+
+#include "hil_link.h"
+
+#define SIM_STEP_US         2000
+#define SIM_HELLO_RETRY     25
+#define SIM_HELLO_TIMEOUT   200
+/* a lockstep fmu gives up after 500 ms, see hil_bridge.c */
+#define SIM_ACK_TIMEOUT     400
+
+typedef struct {
+    uint32_t frame;
+    uint32_t ack_lost;
+    double rtt_sum;
+    double rtt_max;
+    uint32_t rtt_num;
+    float h_max;
+} sim_stat_t;
+
+static uint64_t _now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void _sleep_until(uint64_t time_us)
+{
+    struct timespec ts = { time_us / 1000000, (time_us % 1000000) * 1000 };
+
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static int _hello(hil_link_t* link, uint8_t flag, uint16_t period_us)
+{
+    hil_hello_t hello = { HIL_FRAME_VERSION, flag, period_us };
+
+    for (int i = 0; i < SIM_HELLO_RETRY; i++) {
+        uint64_t deadline = _now_us() + SIM_HELLO_TIMEOUT * 1000;
+
+        hil_link_send(link, HIL_FRAME_HELLO, &hello, sizeof(hello));
+
+        while (_now_us() < deadline) {
+            int type = hil_link_recv(link, SIM_HELLO_TIMEOUT);
+
+            if (type < 0) {
+                return -1;
+            }
+            if (type == HIL_FRAME_HELLO && link->parser.len == sizeof(hil_hello_t)) {
+                memcpy(&hello, link->parser.payload, sizeof(hello));
+                return hello.flag == flag ? 0 : -1;
+            }
+        }
+    }
+
+    return -1;
+}
+
+static void _take_actuator(hil_link_t* link, uint32_t* ack_seq)
+{
+    hil_actuator_t act;
+
+    if (link->parser.type != HIL_FRAME_ACTUATOR || link->parser.len != sizeof(act)) {
+        return;
+    }
+
+    memcpy(&act, link->parser.payload, sizeof(act));
+    memcpy(Plant_U.Control_Out.actuator_cmd, act.actuator_cmd, sizeof(act.actuator_cmd));
+    Plant_U.Control_Out.timestamp = act.timestamp;
+    *ack_seq = act.seq;
+}
+
+// step the plant for one frame and collect the samples, time is at the last step
+static void _simulate(hil_sensor_t* sensor, int batch, uint64_t* time_us)
+{
+    static uint32_t mag_ts = 0xFFFFFFFF, baro_ts = 0xFFFFFFFF, gps_ts = 0xFFFFFFFF;
+
+    sensor->imu_num = batch;
+    sensor->mask = 0;
+
+    for (int k = 0; k < batch; k++) {
+        int32_t dt_us = -(batch - 1 - k) * SIM_STEP_US;
+
+        Plant_step();
+        *time_us += SIM_STEP_US;
+
+        sensor->imu[k].dt_us = dt_us;
+        sensor->imu[k].gyr[0] = Plant_Y.IMU.gyr_x;
+        sensor->imu[k].gyr[1] = Plant_Y.IMU.gyr_y;
+        sensor->imu[k].gyr[2] = Plant_Y.IMU.gyr_z;
+        sensor->imu[k].acc[0] = Plant_Y.IMU.acc_x;
+        sensor->imu[k].acc[1] = Plant_Y.IMU.acc_y;
+        sensor->imu[k].acc[2] = Plant_Y.IMU.acc_z;
+
+        if (Plant_Y.MAG.timestamp != mag_ts) {
+            mag_ts = Plant_Y.MAG.timestamp;
+            sensor->mask |= HIL_SENSOR_MAG;
+            sensor->mag.dt_us = dt_us;
+            sensor->mag.mag[0] = Plant_Y.MAG.mag_x;
+            sensor->mag.mag[1] = Plant_Y.MAG.mag_y;
+            sensor->mag.mag[2] = Plant_Y.MAG.mag_z;
+        }
+
+        if (Plant_Y.Barometer.timestamp != baro_ts) {
+            baro_ts = Plant_Y.Barometer.timestamp;
+            sensor->mask |= HIL_SENSOR_BARO;
+            sensor->baro.dt_us = dt_us;
+            sensor->baro.pressure = Plant_Y.Barometer.pressure;
+            sensor->baro.temperature = Plant_Y.Barometer.temperature;
+        }
+
+        if (Plant_Y.GPS_uBlox.timestamp != gps_ts) {
+            gps_ts = Plant_Y.GPS_uBlox.timestamp;
+            sensor->mask |= HIL_SENSOR_GPS;
+            sensor->gps.dt_us = dt_us;
+            sensor->gps.lat = Plant_Y.GPS_uBlox.lat;
+            sensor->gps.lon = Plant_Y.GPS_uBlox.lon;
+            sensor->gps.height = Plant_Y.GPS_uBlox.height;
+            sensor->gps.velN = Plant_Y.GPS_uBlox.velN * 1e-3f;
+            sensor->gps.velE = Plant_Y.GPS_uBlox.velE * 1e-3f;
+            sensor->gps.velD = Plant_Y.GPS_uBlox.velD * 1e-3f;
+            sensor->gps.hAcc = Plant_Y.GPS_uBlox.hAcc * 1e-3f;
+            sensor->gps.vAcc = Plant_Y.GPS_uBlox.vAcc * 1e-3f;
+            sensor->gps.sAcc = Plant_Y.GPS_uBlox.sAcc * 1e-3f;
+            sensor->gps.fixType = Plant_Y.GPS_uBlox.fixType;
+            sensor->gps.numSV = Plant_Y.GPS_uBlox.numSV;
+        }
+    }
+}
+
+static void _usage(const char* name)
+{
+    fprintf(stderr,
+            "usage: %s [-l] [-b batch] [-t seconds] LINK\n"
+            "  -l          lockstep, wait for the fmu to answer each frame\n"
+            "  -b batch    plant steps (imu samples) in one frame, 1 ~ %d, more than 1 with -l, default 1\n"
+            "  -t seconds  simulated time, default 30\n"
+            "  LINK        /dev/ttyACM0[:baud], udp:HOST:PORT or udpin:PORT\n",
+            name, HIL_SENSOR_MAX_IMU);
+}
+
+int main(int argc, char** argv)
+{
+    hil_link_t link;
+    hil_sensor_t sensor;
+    uint8_t payload[HIL_FRAME_MAX_PAYLOAD];
+    sim_stat_t stat = { 0 };
+    uint64_t time_us = 0;
+    uint64_t wall_start, wall_next;
+    uint32_t ack_seq = 0;
+    int lockstep = 0, batch = 1, seconds = 30;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "lb:t:")) != -1) {
+        switch (opt) {
+        case 'l':
+            lockstep = 1;
+            break;
+        case 'b':
+            batch = atoi(optarg);
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        default:
+            _usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind != argc - 1 || batch < 1 || batch > HIL_SENSOR_MAX_IMU || (batch > 1 && !lockstep) || seconds <= 0) {
+        _usage(argv[0]);
+        return 1;
+    }
+
+    if (hil_link_open(&link, argv[optind]) != 0) {
+        return 1;
+    }
+
+    if (_hello(&link, lockstep ? HIL_FLAG_LOCKSTEP : 0, batch * SIM_STEP_US) != 0) {
+        fprintf(stderr, "no answer from fmu\n");
+        return 1;
+    }
+    printf("connected, %s, %d imu per frame\n", lockstep ? "lockstep" : "free running", batch);
+
+    Plant_init();
+    memset(&Plant_U.Control_Out, 0, sizeof(Plant_U.Control_Out));
+
+    wall_start = wall_next = _now_us();
+
+    for (uint32_t seq = 1; time_us < (uint64_t)seconds * 1000000; seq++) {
+        uint64_t sent_us;
+        uint8_t len;
+
+        _simulate(&sensor, batch, &time_us);
+        sensor.seq = seq;
+        sensor.time_us = time_us;
+        len = hil_sensor_encode(payload, &sensor);
+
+        sent_us = _now_us();
+        if (hil_link_send(&link, HIL_FRAME_SENSOR, payload, len) != 0) {
+            perror("send");
+            return 1;
+        }
+        stat.frame++;
+
+        if (lockstep) {
+            /* the plant does not move on before the fmu has seen this frame */
+            while (ack_seq != seq) {
+                int type = hil_link_recv(&link, SIM_ACK_TIMEOUT);
+
+                if (type <= 0) {
+                    stat.ack_lost++;
+                    break;
+                }
+                _take_actuator(&link, &ack_seq);
+            }
+
+            if (ack_seq == seq) {
+                double rtt = (_now_us() - sent_us) * 1e-3;
+
+                stat.rtt_sum += rtt;
+                stat.rtt_num++;
+                stat.rtt_max = rtt > stat.rtt_max ? rtt : stat.rtt_max;
+            }
+        } else {
+            wall_next += batch * SIM_STEP_US;
+
+            /* take what arrived until the next frame is due */
+            while (_now_us() < wall_next) {
+                int wait_ms = (int)((wall_next - _now_us()) / 1000);
+
+                if (hil_link_recv(&link, wait_ms) <= 0) {
+                    break;
+                }
+                _take_actuator(&link, &ack_seq);
+            }
+            _sleep_until(wall_next);
+        }
+
+        if (Plant_Y.Plant_States.h_R > stat.h_max) {
+            stat.h_max = Plant_Y.Plant_States.h_R;
+        }
+
+        if (time_us % 1000000 < (uint64_t)batch * SIM_STEP_US) {
+            printf("t=%2us h=%6.2f m motor=%u %u %u %u\n", (unsigned)(time_us / 1000000),
+                   Plant_Y.Plant_States.h_R, Plant_U.Control_Out.actuator_cmd[0], Plant_U.Control_Out.actuator_cmd[1],
+                   Plant_U.Control_Out.actuator_cmd[2], Plant_U.Control_Out.actuator_cmd[3]);
+            fflush(stdout);
+        }
+    }
+
+    printf("frames=%u ack_lost=%u rtt_mean_ms=%.3f rtt_max_ms=%.3f h_max=%.2f h_end=%.2f realtime=%.2f\n",
+           stat.frame, stat.ack_lost, stat.rtt_num ? stat.rtt_sum / stat.rtt_num : 0.0, stat.rtt_max, stat.h_max,
+           Plant_Y.Plant_States.h_R, time_us / (double)(_now_us() - wall_start));
+
+    hil_link_close(&link);
+
+    return 0;
+}
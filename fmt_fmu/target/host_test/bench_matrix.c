@@ -0,0 +1,226 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * Micro-benchmark of the fixed size kernels of module/math/matrix.h against
+ * light_matrix (heap rows, pointer per row), and of the LU determinant and
+ * inverse against the permutation expansion and adjugate light_matrix used
+ * before them.
+ *
+ * Host numbers only rank the variants, on target the CMSIS-DSP kernels behind
+ * ARM_MATH_CM4 and the FPU change the ratios.
+ */
+// host_test: src/module/Math/matrix.c src/module/Math/light_matrix.c
+// host_test: src/lib/STM_Lib/CMSIS/DSP_Lib/Source/BasicMathFunctions/arm_add_f32.c
+// host_test: src/lib/STM_Lib/CMSIS/DSP_Lib/Source/BasicMathFunctions/arm_sub_f32.c
+// host_test: src/lib/STM_Lib/CMSIS/DSP_Lib/Source/BasicMathFunctions/arm_dot_prod_f32.c
+// host_test: src/lib/STM_Lib/CMSIS/DSP_Lib/Source/MatrixFunctions/arm_mat_mult_f32.c
+
+#include <firmament.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "module/math/light_matrix.h"
+#include "module/math/matrix.h"
+
+/* run stmt in doubling batches until a batch takes 50ms, print ns per run */
+#define BENCH(_name, _stmt)                                                     \
+    do {                                                                        \
+        uint32_t _n = 1;                                                        \
+        double _t;                                                              \
+        for (;;) {                                                              \
+            double _t0 = _now_ns();                                             \
+            for (uint32_t _i = 0; _i < _n; _i++) {                              \
+                _stmt;                                                          \
+                __asm__ volatile("" ::: "memory");                              \
+            }                                                                   \
+            _t = _now_ns() - _t0;                                               \
+            if (_t > 5e7 || _n >= (1u << 28))                                   \
+                break;                                                          \
+            _n *= 2;                                                            \
+        }                                                                       \
+        printf("  %-34s %12.1f ns\n", _name, _t / _n);                          \
+    } while (0)
+
+static volatile float _sink;
+
+void* rt_malloc(rt_size_t size)
+{
+    return malloc(size);
+}
+
+void rt_free(void* ptr)
+{
+    free(ptr);
+}
+
+static double _now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* light_matrix determinant and inverse before the LU kernels, by expanding
+ * all n! permutations and the adjugate */
+static void _legacy_perm(int list[], int k, int m, int* p, Mat* mat, float* det)
+{
+    if (k > m) {
+        float res = mat->element[0][list[0]];
+
+        for (int i = 1; i < mat->row; i++) {
+            res *= mat->element[i][list[i]];
+        }
+
+        *det += (*p % 2) ? -res : res;
+    } else {
+        _legacy_perm(list, k + 1, m, p, mat, det);
+
+        for (int i = k + 1; i <= m; i++) {
+            int t = list[k];
+            list[k] = list[i];
+            list[i] = t;
+            *p += 1;
+            _legacy_perm(list, k + 1, m, p, mat, det);
+            list[i] = list[k];
+            list[k] = t;
+            *p -= 1;
+        }
+    }
+}
+
+static float _legacy_det(Mat* mat)
+{
+    int list[16];
+    int p = 0;
+    float det = 0.0f;
+
+    for (int i = 0; i < mat->col; i++)
+        list[i] = i;
+
+    _legacy_perm(list, 0, mat->row - 1, &p, mat, &det);
+
+    return det;
+}
+
+static void _legacy_inv(Mat* src, Mat* dst)
+{
+    Mat smat;
+    float det = _legacy_det(src);
+
+    MatCreate(&smat, src->row - 1, src->col - 1);
+
+    for (int row = 0; row < src->row; row++) {
+        for (int col = 0; col < src->col; col++) {
+            for (int i = 0, r = 0; i < src->row; i++) {
+                if (i == row)
+                    continue;
+                for (int j = 0, c = 0; j < src->col; j++) {
+                    if (j == col)
+                        continue;
+                    smat.element[r][c++] = src->element[i][j];
+                }
+                r++;
+            }
+            dst->element[col][row] = ((row + col) % 2 ? -_legacy_det(&smat) : _legacy_det(&smat)) / det;
+        }
+    }
+
+    MatDelete(&smat);
+}
+
+/* diagonally dominant, so well conditioned */
+static void _fill(float* a, uint8_t n)
+{
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            a[i * n + j] = (i == j) ? n + 1.0f : 1.0f / (1 + i + 2 * j);
+        }
+    }
+}
+
+static void bench_size(uint8_t n)
+{
+    float a[MATRIX_MAX_DIM * MATRIX_MAX_DIM], b[MATRIX_MAX_DIM * MATRIX_MAX_DIM];
+    float c[MATRIX_MAX_DIM * MATRIX_MAX_DIM];
+    Mat ma, mb, mc;
+    char name[64];
+
+    _fill(a, n);
+    _fill(b, n);
+
+    MatCreate(&ma, n, n);
+    MatCreate(&mb, n, n);
+    MatCreate(&mc, n, n);
+    MatSetVal(&ma, a);
+    MatSetVal(&mb, b);
+
+    printf("%dx%d:\n", n, n);
+
+    BENCH("MatMul", MatMul(&ma, &mb, &mc); _sink = mc.element[0][0]);
+    BENCH("matrix_mul", matrix_mul(a, b, c, n, n, n); _sink = c[0]);
+    if (n == 3) {
+        BENCH("mat3_mul", mat3_mul((const Mat3f*)a, (const Mat3f*)b, (Mat3f*)c); _sink = c[0]);
+    }
+    BENCH("MatAdd", MatAdd(&ma, &mb, &mc); _sink = mc.element[0][0]);
+    BENCH("matrix_add", matrix_add(a, b, c, n, n); _sink = c[0]);
+    BENCH("MatTrans", MatTrans(&ma, &mc); _sink = mc.element[0][0]);
+    BENCH("matrix_trans", matrix_trans(a, c, n, n); _sink = c[0]);
+
+    snprintf(name, sizeof(name), "det, %d! permutations (before)", n);
+    BENCH(name, _sink = _legacy_det(&ma));
+    BENCH("MatDet (LU)", _sink = MatDet(&ma));
+    BENCH("matrix_det", _sink = matrix_det(a, n));
+
+    BENCH("inverse, adjugate (before)", _legacy_inv(&ma, &mc); _sink = mc.element[0][0]);
+    BENCH("MatInv (LU)", MatInv(&ma, &mc); _sink = mc.element[0][0]);
+    BENCH("matrix_inv", matrix_inv(a, c, n); _sink = c[0]);
+    BENCH("matrix_solve", matrix_solve(a, b, c, n); _sink = c[0]);
+
+    MatDelete(&ma);
+    MatDelete(&mb);
+    MatDelete(&mc);
+}
+
+static void bench_rotate(void)
+{
+    static float from[64][3], to[64][3];
+    quaternion q = { 0.9238795f, 0.0f, 0.0f, 0.3826834f };
+    Mat3f dcm;
+
+    for (int i = 0; i < 64; i++) {
+        from[i][0] = i;
+        from[i][1] = 1.0f;
+        from[i][2] = -i;
+    }
+
+    printf("rotate 64 vectors by a quaternion:\n");
+    BENCH("quaternion_rotate_fast each", for (int i = 0; i < 64; i++) quaternion_rotate_fast(&q, from[i], to[i]); _sink = to[63][0]);
+    BENCH("dcm, then mat3_mul_vec each", mat3_from_quaternion(&dcm, &q); for (int i = 0; i < 64; i++) mat3_mul_vec(&dcm, from[i], to[i]); _sink = to[63][0]);
+    BENCH("quaternion_rotate_vectors", quaternion_rotate_vectors(&q, (const float(*)[3])from, to, 64); _sink = to[63][0]);
+}
+
+int main(void)
+{
+    bench_size(3);
+    bench_size(6);
+    bench_size(9);
+    bench_rotate();
+
+    return 0;
+}
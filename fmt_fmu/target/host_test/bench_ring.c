@@ -0,0 +1,279 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * Micro-benchmark of module/utils/ring.h against the rings it replaced: the
+ * byte ring of module/Utils/ringbuffer.c and the mavlink immediate queue,
+ * both locked on every index update and wrapped by % on any size.
+ *
+ * Host numbers only rank the variants. The lock is a counter here, on target
+ * rt_enter_critical()/rt_exit_critical() cost more, which favours ring.h more.
+ */
+// host_test: src/module/Utils/ringbuffer.c
+
+#include <firmament.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "module/utils/ring.h"
+#include "module/utils/ringbuffer.h"
+
+#define BYTES     (64 * 1024 * 1024)
+#define ELEMS     (4 * 1024 * 1024)
+#define ELEM_SIZE 32
+
+static volatile int _lock;
+
+void rt_enter_critical(void)
+{
+    _lock++;
+}
+
+void rt_exit_critical(void)
+{
+    _lock--;
+}
+
+void* rt_malloc(rt_size_t size)
+{
+    return malloc(size);
+}
+
+void rt_free(void* ptr)
+{
+    free(ptr);
+}
+
+static double _now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* byte ring before ring.h, copied from module/Utils/ringbuffer.c */
+typedef struct {
+    uint8_t* buff;
+    uint32_t size;
+    uint32_t head;
+    uint32_t tail;
+} legacy_rb;
+
+static uint32_t _legacy_getlen(legacy_rb* rb)
+{
+    uint32_t len;
+
+    OS_ENTER_CRITICAL;
+    if (rb->head >= rb->tail)
+        len = rb->head - rb->tail;
+    else
+        len = rb->head + (rb->size - rb->tail);
+    OS_EXIT_CRITICAL;
+
+    return len;
+}
+
+static uint32_t _legacy_put(legacy_rb* rb, const uint8_t* buffer, uint32_t len)
+{
+    uint32_t free_space = rb->size - _legacy_getlen(rb);
+    uint32_t w_len = (len <= free_space) ? len : free_space;
+    uint32_t space_to_end;
+
+    OS_ENTER_CRITICAL;
+    space_to_end = rb->size - rb->head;
+    if (w_len <= space_to_end) {
+        memcpy(&rb->buff[rb->head], buffer, w_len);
+    } else {
+        memcpy(&rb->buff[rb->head], buffer, space_to_end);
+        memcpy(rb->buff, &buffer[space_to_end], w_len - space_to_end);
+    }
+    rb->head = (rb->head + w_len) % rb->size;
+    OS_EXIT_CRITICAL;
+
+    return w_len;
+}
+
+static uint32_t _legacy_get(legacy_rb* rb, uint8_t* buffer, uint32_t len)
+{
+    uint32_t buffer_len = _legacy_getlen(rb);
+    uint32_t r_len = buffer_len < len ? buffer_len : len;
+
+    OS_ENTER_CRITICAL;
+    for (uint32_t i = 0; i < r_len; i++) {
+        buffer[i] = rb->buff[rb->tail];
+        rb->tail = (rb->tail + 1) % rb->size;
+    }
+    OS_EXIT_CRITICAL;
+
+    return r_len;
+}
+
+/* mavlink immediate queue before ring.h, from task/comm/task_comm.c */
+#define LEGACY_QUEUE_SIZE 10
+
+static struct {
+    uint8_t queue[LEGACY_QUEUE_SIZE][ELEM_SIZE];
+    uint32_t head;
+    uint32_t tail;
+} _legacy_queue;
+
+static uint8_t _legacy_push(const void* elem)
+{
+    OS_ENTER_CRITICAL;
+    if ((_legacy_queue.head + 1) % LEGACY_QUEUE_SIZE == _legacy_queue.tail) {
+        OS_EXIT_CRITICAL;
+        return 1;
+    }
+    memcpy(_legacy_queue.queue[_legacy_queue.head], elem, ELEM_SIZE);
+    _legacy_queue.head = (_legacy_queue.head + 1) % LEGACY_QUEUE_SIZE;
+    OS_EXIT_CRITICAL;
+
+    return 0;
+}
+
+static uint8_t _legacy_pop(void* elem)
+{
+    if (_legacy_queue.head == _legacy_queue.tail) {
+        return 1;
+    }
+    memcpy(elem, _legacy_queue.queue[_legacy_queue.tail], ELEM_SIZE);
+    OS_ENTER_CRITICAL;
+    _legacy_queue.tail = (_legacy_queue.tail + 1) % LEGACY_QUEUE_SIZE;
+    OS_EXIT_CRITICAL;
+
+    return 0;
+}
+
+static void _report(const char* name, double t0, uint32_t num, const char* unit, uint32_t check)
+{
+    printf("  %-36s %6.2f ns/%s  (%08x)\n", name, (_now_ns() - t0) / num, unit, (unsigned)check);
+}
+
+/* console traffic: chunks of 1 to 70 byte through a ring of 1 kB */
+static void bench_bytes(void)
+{
+    static uint8_t legacy_buff[1000], rb_buff[1024], spsc_buff[1024];
+    uint8_t in[70], out[70];
+    legacy_rb legacy = { legacy_buff, sizeof(legacy_buff), 0, 0 };
+    ringbuffer* rb = ringbuffer_static_create(rb_buff, sizeof(rb_buff));
+    ring_spsc spsc;
+    uint32_t done, n, check;
+    double t0;
+
+    ring_spsc_init(&spsc, spsc_buff, sizeof(spsc_buff), 1);
+
+    for (uint32_t i = 0; i < sizeof(in); i++) {
+        in[i] = i * 7;
+    }
+
+    t0 = _now_ns();
+    for (done = 0, check = 0; done < BYTES; done += n) {
+        n = 1 + done % sizeof(in);
+        _legacy_put(&legacy, in, n);
+        _legacy_get(&legacy, out, n);
+        check += out[n - 1];
+    }
+    _report("legacy ringbuffer, % and lock", t0, BYTES, "byte", check);
+
+    t0 = _now_ns();
+    for (done = 0, check = 0; done < BYTES; done += n) {
+        n = 1 + done % sizeof(in);
+        ringbuffer_put(rb, in, n);
+        ringbuffer_get(rb, out, n);
+        check += out[n - 1];
+    }
+    _report("ringbuffer on ring_spsc, lock", t0, BYTES, "byte", check);
+
+    t0 = _now_ns();
+    for (done = 0, check = 0; done < BYTES; done += n) {
+        n = 1 + done % sizeof(in);
+        ring_spsc_put(&spsc, in, n);
+        ring_spsc_get(&spsc, out, n);
+        check += out[n - 1];
+    }
+    _report("ring_spsc put/get", t0, BYTES, "byte", check);
+
+    t0 = _now_ns();
+    for (done = 0, check = 0; done < BYTES; done += n) {
+        uint8_t* p;
+        uint32_t span = ring_spsc_reserve(&spsc, (void**)&p);
+
+        n = 1 + done % sizeof(in);
+        n = n < span ? n : span;
+        memcpy(p, in, n);
+        ring_spsc_commit(&spsc, n);
+        n = ring_spsc_peek(&spsc, (void**)&p);
+        check += p[n - 1];
+        ring_spsc_consume(&spsc, n);
+    }
+    _report("ring_spsc reserve/peek in place", t0, BYTES, "byte", check);
+
+    ringbuffer_delete(rb);
+}
+
+/* message queue: one element in, one out */
+static void bench_elems(void)
+{
+    static uint8_t spsc_buff[16][ELEM_SIZE], mpsc_buff[16][ELEM_SIZE];
+    static uint32_t mpsc_seq[16];
+    uint8_t in[ELEM_SIZE] = { 1 }, out[ELEM_SIZE];
+    ring_spsc spsc;
+    ring_mpsc mpsc;
+    uint32_t check;
+    double t0;
+
+    ring_spsc_init(&spsc, spsc_buff, 16, ELEM_SIZE);
+    ring_mpsc_init(&mpsc, mpsc_buff, mpsc_seq, 16, ELEM_SIZE);
+
+    t0 = _now_ns();
+    for (uint32_t i = check = 0; i < ELEMS; i++) {
+        in[0] = i;
+        _legacy_push(in);
+        _legacy_pop(out);
+        check += out[0];
+    }
+    _report("legacy immediate queue, % and lock", t0, ELEMS, "elem", check);
+
+    t0 = _now_ns();
+    for (uint32_t i = check = 0; i < ELEMS; i++) {
+        in[0] = i;
+        ring_mpsc_push(&mpsc, in);
+        ring_mpsc_pop(&mpsc, out);
+        check += out[0];
+    }
+    _report("ring_mpsc push/pop", t0, ELEMS, "elem", check);
+
+    t0 = _now_ns();
+    for (uint32_t i = check = 0; i < ELEMS; i++) {
+        in[0] = i;
+        ring_spsc_put(&spsc, in, 1);
+        ring_spsc_get(&spsc, out, 1);
+        check += out[0];
+    }
+    _report("ring_spsc put/get", t0, ELEMS, "elem", check);
+}
+
+int main(void)
+{
+    printf("bytes, chunks of 1 to 70:\n");
+    bench_bytes();
+    printf("elements of %d byte:\n", ELEM_SIZE);
+    bench_elems();
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * The io side of the fmtio protocol, fmt_io/project/source/protocol.c, built
+ * on host for test_fmtio.c. Its types and functions have the same names as
+ * the fmu side, so it lives in its own unit behind the io_ calls below.
+ */
+
+/* stm32f10x.h of fmt_io is stood in by the one next to this file */
+#define proto_frame_init     _io_frame_init
+#define proto_frame_append   _io_frame_append
+#define proto_frame_finalize _io_frame_finalize
+#define proto_parser_init    _io_parser_init
+#define proto_parse_buffer   _io_parse_buffer
+
+#include "../../../fmt_io/project/source/protocol.c"
+
+#include "fmtio_client.h"
+
+static ParserStruct _io_parser;
+static LinkStatStruct _io_stat;
+static FrameStruct _io_frame;
+static io_msg_t* _io_msg;
+static uint16_t _io_msg_max;
+static uint16_t _io_msg_num;
+
+static FMT_Error _io_handler(const PackageStruct* pkg)
+{
+    if (_io_msg_num < _io_msg_max) {
+        _io_msg[_io_msg_num].cmd = pkg->cmd;
+        _io_msg[_io_msg_num].len = pkg->len;
+        memcpy(_io_msg[_io_msg_num].content, pkg->content, pkg->len);
+    }
+    _io_msg_num++;
+
+    return SYS_EOK;
+}
+
+void io_init(void)
+{
+    memset(&_io_stat, 0, sizeof(_io_stat));
+    _io_parser_init(&_io_parser, &_io_stat);
+}
+
+uint16_t io_encode(uint8_t* buff, uint8_t seq, const io_msg_t* msg, uint16_t msg_num)
+{
+    uint16_t size;
+
+    _io_frame_init(&_io_frame);
+
+    for (uint16_t i = 0; i < msg_num; i++) {
+        if (_io_frame_append(&_io_frame, msg[i].cmd, msg[i].content, msg[i].len) != SYS_EOK) {
+            return 0;
+        }
+    }
+
+    size = _io_frame_finalize(&_io_frame, seq);
+    memcpy(buff, _io_frame.buff, size);
+
+    return size;
+}
+
+uint16_t io_parse(const uint8_t* data, uint16_t len, io_msg_t* msg, uint16_t msg_max, uint16_t* msg_num)
+{
+    uint16_t frame_cnt;
+
+    _io_msg = msg;
+    _io_msg_max = msg_max;
+    _io_msg_num = 0;
+
+    frame_cnt = _io_parse_buffer(&_io_parser, data, len, _io_handler);
+
+    *msg_num = _io_msg_num;
+
+    return frame_cnt;
+}
+
+void io_stat(uint32_t* rx_frame, uint32_t* rx_crc_err, uint32_t* rx_len_err, uint32_t* rx_lost)
+{
+    *rx_frame = _io_stat.rx_frame;
+    *rx_crc_err = _io_stat.rx_crc_err;
+    *rx_len_err = _io_stat.rx_len_err;
+    *rx_lost = _io_stat.rx_lost;
+}
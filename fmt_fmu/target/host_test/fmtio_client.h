@@ -0,0 +1,36 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef __FMTIO_CLIENT_H__
+#define __FMTIO_CLIENT_H__
+
+/* io side of the fmtio protocol on host, see fmtio_client.c */
+#include <stdint.h>
+
+typedef struct {
+    uint16_t cmd;
+    uint16_t len;
+    uint8_t content[128];
+} io_msg_t;
+
+void io_init(void);
+/* encode msg into one frame sent by io, returns the frame size or 0 */
+uint16_t io_encode(uint8_t* buff, uint8_t seq, const io_msg_t* msg, uint16_t msg_num);
+/* parse a chunk received by io, returns the frames found, fills msg up to msg_max */
+uint16_t io_parse(const uint8_t* data, uint16_t len, io_msg_t* msg, uint16_t msg_max, uint16_t* msg_num);
+void io_stat(uint32_t* rx_frame, uint32_t* rx_crc_err, uint32_t* rx_len_err, uint32_t* rx_lost);
+
+#endif
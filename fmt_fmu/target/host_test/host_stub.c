@@ -0,0 +1,128 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * Single thread stand-in of the RT-Thread and system calls the firmware
+ * sources under test make. Time only moves when a test or a delay moves it.
+ * Every symbol is weak, a test defines its own to observe or fake a call.
+ */
+
+#include <firmament.h>
+#include <stdarg.h>
+
+#include "host_test.h"
+
+#define HOST_WEAK __attribute__((weak))
+
+int host_test_fail;
+
+static uint64_t _time_us;
+
+void host_time_set_us(uint64_t time_us)
+{
+    _time_us = time_us;
+}
+
+void host_time_advance_us(uint64_t time_us)
+{
+    _time_us += time_us;
+}
+
+HOST_WEAK uint64_t systime_now_us(void)
+{
+    return _time_us;
+}
+
+HOST_WEAK uint32_t systime_now_ms(void)
+{
+    return (uint32_t)(_time_us / 1000);
+}
+
+HOST_WEAK void systime_delay_us(uint32_t delay)
+{
+    _time_us += delay;
+}
+
+HOST_WEAK void systime_delay_ms(uint32_t time_ms)
+{
+    _time_us += (uint64_t)time_ms * 1000;
+}
+
+HOST_WEAK rt_err_t rt_thread_delay(rt_tick_t tick)
+{
+    _time_us += (uint64_t)tick * 1000000 / RT_TICK_PER_SECOND;
+    return RT_EOK;
+}
+
+HOST_WEAK rt_tick_t rt_tick_get(void)
+{
+    return (rt_tick_t)(_time_us * RT_TICK_PER_SECOND / 1000000);
+}
+
+HOST_WEAK void rt_enter_critical(void)
+{
+}
+
+HOST_WEAK void rt_exit_critical(void)
+{
+}
+
+HOST_WEAK rt_base_t rt_hw_interrupt_disable(void)
+{
+    return 0;
+}
+
+HOST_WEAK void rt_hw_interrupt_enable(rt_base_t level)
+{
+    (void)level;
+}
+
+HOST_WEAK uint32_t console_printf(const char* fmt, ...)
+{
+    va_list args;
+    int len;
+
+    va_start(args, fmt);
+    len = vprintf(fmt, args);
+    va_end(args);
+
+    return len > 0 ? len : 0;
+}
+
+HOST_WEAK rt_size_t rt_device_write(rt_device_t dev, rt_off_t pos, const void* buffer, rt_size_t size)
+{
+    (void)dev;
+    (void)pos;
+    (void)buffer;
+    return size;
+}
+
+HOST_WEAK rt_size_t rt_device_read(rt_device_t dev, rt_off_t pos, void* buffer, rt_size_t size)
+{
+    (void)dev;
+    (void)pos;
+    (void)buffer;
+    (void)size;
+    return 0;
+}
+
+HOST_WEAK rt_err_t rt_device_control(rt_device_t dev, int cmd, void* arg)
+{
+    (void)dev;
+    (void)cmd;
+    (void)arg;
+    return RT_EOK;
+}
@@ -0,0 +1,64 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef __HOST_TEST_H__
+#define __HOST_TEST_H__
+
+/*
+ * Checks of the host tests, built by host_test.py.
+ *
+ * A test is a function run with TEST_RUN, a failed TEST_CHECK is reported
+ * and the test goes on. main returns TEST_RESULT(), non zero if any check
+ * failed.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+extern int host_test_fail;
+
+#define TEST_CHECK(_cond)                                                            \
+    do {                                                                             \
+        if (!(_cond)) {                                                              \
+            printf("  %s:%d: check failed: %s\n", __FILE__, __LINE__, #_cond);       \
+            host_test_fail++;                                                        \
+        }                                                                            \
+    } while (0)
+
+#define TEST_CHECK_NEAR(_a, _b, _tol)                                                \
+    do {                                                                             \
+        double _va = (_a), _vb = (_b);                                               \
+        if (!(fabs(_va - _vb) <= (_tol))) {                                          \
+            printf("  %s:%d: check failed: %s = %g, expect %g\n", __FILE__, __LINE__, \
+                   #_a, _va, _vb);                                                   \
+            host_test_fail++;                                                        \
+        }                                                                            \
+    } while (0)
+
+#define TEST_RUN(_test)                                                              \
+    do {                                                                             \
+        int _fail = host_test_fail;                                                  \
+        _test();                                                                     \
+        printf("%s %s\n", host_test_fail == _fail ? "pass" : "FAIL", #_test);        \
+    } while (0)
+
+#define TEST_RESULT() (host_test_fail ? 1 : 0)
+
+/* simulated clock of host_stub.c, systime and rt_thread_delay run on it */
+void host_time_set_us(uint64_t time_us);
+void host_time_advance_us(uint64_t time_us);
+
+#endif
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+
+"""
+Build and run the host tests of firmware sources.
+
+Each test_*.c is built with the firmware include paths and defines of the
+pixhawk target, host_stub.c in place of RT-Thread, and the firmware sources
+it names in a comment line of the form
+
+    // host_test: src/module/HIL/hil_frame.c src/module/Utils/ringbuffer.c
+
+paths relative to fmt_fmu. Unused firmware code is dropped at link time, so
+a test only stubs the calls its path really makes. Tests which need a
+source's statics include the .c file instead.
+
+Micro-benchmarks bench_*.c are built the same way with --bench, they print
+their timings and do not fail.
+
+Examples:
+    host_test.py
+    host_test.py --only gps --keep
+    host_test.py --bench
+"""
+
+from __future__ import print_function
+import glob
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+from argparse import ArgumentParser
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+FMU = os.path.abspath(os.path.join(HERE, '..', '..'))
+
+# firmware headers, warnings are on
+INCLUDE = ['include', 'target/pixhawk', 'src/module', 'src/hal', 'src/driver', 'src/task',
+           'src/module/FS_Manager', 'src/module/Controller/codegen', 'src/module/FMS/codegen']
+# library headers, as system headers to keep their LP64 warnings quiet
+SYS_INCLUDE = ['rtos/include', 'rtos/components/finsh', 'rtos/components/dfs/include',
+               'src/lib/STM_Lib/CMSIS/Include', 'src/lib/STM_Lib/CMSIS/Device/ST/STM32F4xx/Include',
+               'src/lib/STM_Lib/STM32F4xx_StdPeriph_Driver/inc', 'src/lib/mavlink',
+               'src/lib/mavlink/v2.0/firmament']
+DEFINES = ['-DUSE_STDPERIPH_DRIVER', '-DSTM32F427X', '-DARM_MATH_CM4']
+FLAGS = ['-O2', '-g', '-std=gnu99', '-Wall', '-Wno-unused-function', '-ffunction-sections', '-fdata-sections']
+
+SOURCE_RE = re.compile(r'^//\s*host_test:(.*)$', re.M)
+
+
+def tests(prefix='test'):
+    return sorted(os.path.basename(f)[len(prefix) + 1:-2] for f in glob.glob(os.path.join(HERE, prefix + '_*.c')))
+
+
+def build(name, work, prefix='test'):
+    test = os.path.join(HERE, '%s_%s.c' % (prefix, name))
+    with open(test) as f:
+        extra = ' '.join(SOURCE_RE.findall(f.read())).split()
+    exe = os.path.join(work, '%s_%s' % (prefix, name))
+    cmd = ['gcc'] + FLAGS + DEFINES + ['-I' + HERE] + ['-I' + os.path.join(FMU, d) for d in INCLUDE]
+    cmd += ['-isystem' + os.path.join(FMU, d) for d in SYS_INCLUDE]
+    cmd += [test, os.path.join(HERE, 'host_stub.c')] + [os.path.join(FMU, s) for s in extra]
+    cmd += ['-Wl,--gc-sections', '-lm', '-pthread', '-o', exe]
+    proc = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    print(proc.stdout, end='')
+    return exe if proc.returncode == 0 else None
+
+
+def main():
+    parser = ArgumentParser(description=__doc__)
+    parser.add_argument('--only', action='append', choices=tests() + tests('bench'), help='only run this test')
+    parser.add_argument('--bench', action='store_true', help='run micro-benchmarks instead of tests')
+    parser.add_argument('--keep', action='store_true', help='keep build directory')
+    args = parser.parse_args()
+
+    prefix = 'bench' if args.bench else 'test'
+    names = args.only or tests(prefix)
+    work = tempfile.mkdtemp(prefix='host_test_')
+    failed = []
+    try:
+        for name in names:
+            print("== %s" % name)
+            sys.stdout.flush()
+            exe = build(name, work, prefix)
+            if exe is None or subprocess.call([exe]) != 0:
+                failed.append(name)
+    finally:
+        if args.keep:
+            print("build directory: %s" % work)
+        else:
+            shutil.rmtree(work)
+
+    print("%d of %d %s failed%s" % (len(failed), len(names), 'benchmarks' if args.bench else 'tests',
+                                     (': ' + ', '.join(failed)) if failed else ''))
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,10 @@
+/*
+ * Host stand-in of the stm32f10x device header for the fmt_io sources built
+ * by the host tests (see fmtio_client.c), which only need the stdint types.
+ */
+#ifndef __STM32F10x_H
+#define __STM32F10x_H
+
+#include <stdint.h>
+
+#endif
@@ -0,0 +1,242 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * blog_push_msg of module/Log/blog.c called by several threads at once, as
+ * the model threads do, with the logger draining the sectors. The critical
+ * section is a recursive mutex here, and the sector event yields, so a
+ * producer is preempted in the middle of a message.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "../../src/module/Log/blog.c"
+
+#include "host_test.h"
+
+#define SECTOR_NUM   4
+#define PRODUCER_NUM 4
+#define PRODUCER_MSG 20000
+#define MSG_LEN      61
+
+static const uint8_t _msg_id[PRODUCER_NUM] = { BLOG_IMU_ID, BLOG_MAG_ID, BLOG_INS_OUT_ID, BLOG_CONTROL_OUT_ID };
+
+static uint8_t _sector[SECTOR_NUM * BLOG_SECTOR_SIZE];
+static uint8_t _stream[PRODUCER_NUM * PRODUCER_MSG * (MSG_LEN + 4) + BLOG_SECTOR_SIZE];
+static uint32_t _stream_len;
+
+static pthread_mutex_t _lock;
+static int _lock_depth;
+static int _lock_count;
+static volatile int _producer_done;
+
+void rt_enter_critical(void)
+{
+    pthread_mutex_lock(&_lock);
+    _lock_depth++;
+    _lock_count++;
+}
+
+void rt_exit_critical(void)
+{
+    _lock_depth--;
+    pthread_mutex_unlock(&_lock);
+}
+
+void ulog_output(rt_uint32_t level, const char* tag, rt_bool_t newline, const char* format, ...)
+{
+}
+
+uint8_t check_timetag(TimeTag* timetag)
+{
+    return 0;
+}
+
+/* a new sector is ready, give the other producers a chance to run */
+fmt_err logger_send_event(uint32_t event)
+{
+    sched_yield();
+    return FMT_EOK;
+}
+
+static void _reset(void)
+{
+    memset(&blog.buffer, 0, sizeof(blog.buffer));
+    memset(blog.monitor, 0, sizeof(blog.monitor));
+    blog.buffer.data = _sector;
+    blog.buffer.num_sector = SECTOR_NUM;
+    blog.log_status = BLOG_STATUS_LOGGING;
+    _stream_len = 0;
+    _lock_depth = _lock_count = 0;
+}
+
+/* logger side of blog_async_output, sectors go to _stream instead of a file */
+static void _drain(int last)
+{
+    uint32_t head, tail;
+
+    OS_ENTER_CRITICAL;
+    head = blog.buffer.head;
+    tail = blog.buffer.tail;
+    OS_EXIT_CRITICAL;
+
+    while (tail != head) {
+        memcpy(&_stream[_stream_len], &_sector[tail * BLOG_SECTOR_SIZE], BLOG_SECTOR_SIZE);
+        _stream_len += BLOG_SECTOR_SIZE;
+        tail = (tail + 1) % SECTOR_NUM;
+        OS_ENTER_CRITICAL;
+        blog.buffer.tail = tail;
+        OS_EXIT_CRITICAL;
+    }
+
+    if (last) {
+        memcpy(&_stream[_stream_len], &_sector[head * BLOG_SECTOR_SIZE], blog.buffer.index);
+        _stream_len += blog.buffer.index;
+    }
+}
+
+static void* _producer(void* arg)
+{
+    int id = (int)(intptr_t)arg;
+    uint8_t payload[MSG_LEN];
+
+    for (uint32_t seq = 0; seq < PRODUCER_MSG; seq++) {
+        memset(payload, id, sizeof(payload));
+        memcpy(payload, &seq, sizeof(seq));
+
+        while (blog_push_msg(payload, _msg_id[id], sizeof(payload)) == FMT_EFULL) {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static void* _logger(void* arg)
+{
+    while (!_producer_done) {
+        _drain(0);
+        sched_yield();
+    }
+
+    return NULL;
+}
+
+static void test_lock_balance(void)
+{
+    uint8_t payload[MSG_LEN] = { 0 };
+
+    _reset();
+
+    blog.log_status = BLOG_STATUS_IDLE;
+    TEST_CHECK(blog_push_msg(payload, BLOG_IMU_ID, sizeof(payload)) == FMT_EEMPTY);
+    TEST_CHECK(blog_push_data(payload, sizeof(payload)) == FMT_EEMPTY);
+    blog.log_status = BLOG_STATUS_LOGGING;
+
+    /* fill until full, nothing drains */
+    while (blog_push_msg(payload, BLOG_IMU_ID, sizeof(payload)) == FMT_EOK)
+        ;
+    TEST_CHECK(blog_push_msg(payload, BLOG_IMU_ID, sizeof(payload)) == FMT_EFULL);
+    TEST_CHECK(blog_push_data(payload, sizeof(payload)) == FMT_EFULL);
+
+    TEST_CHECK(_lock_depth == 0);
+    TEST_CHECK(_lock_count > 0);
+}
+
+/* names are read as C strings by the header dump and the log tools */
+static void test_names(void)
+{
+    for (int i = 0; i < sizeof(_blog_bus) / sizeof(blog_bus_t); i++) {
+        TEST_CHECK(memchr(_blog_bus[i].name, '\0', BLOG_MAX_NAME_LEN) != NULL);
+
+        for (int k = 0; k < _blog_bus[i].num_elem; k++) {
+            if (memchr(_blog_bus[i].elem_list[k].name, '\0', BLOG_MAX_NAME_LEN) == NULL) {
+                printf("  %s element %.*s has no terminator\n", _blog_bus[i].name, BLOG_MAX_NAME_LEN,
+                       _blog_bus[i].elem_list[k].name);
+                host_test_fail++;
+            }
+        }
+    }
+}
+
+static void test_threads(void)
+{
+    pthread_t producer[PRODUCER_NUM], logger;
+    uint32_t next_seq[PRODUCER_NUM] = { 0 };
+    uint32_t pos = 0, bad = 0;
+
+    _reset();
+    _producer_done = 0;
+
+    pthread_create(&logger, NULL, _logger, NULL);
+    for (int i = 0; i < PRODUCER_NUM; i++) {
+        pthread_create(&producer[i], NULL, _producer, (void*)(intptr_t)i);
+    }
+    for (int i = 0; i < PRODUCER_NUM; i++) {
+        pthread_join(producer[i], NULL);
+    }
+    _producer_done = 1;
+    pthread_join(logger, NULL);
+    _drain(1);
+
+    TEST_CHECK(_stream_len == PRODUCER_NUM * PRODUCER_MSG * (MSG_LEN + 4));
+
+    /* every message is whole and each producer's are in order */
+    while (pos + MSG_LEN + 4 <= _stream_len) {
+        const uint8_t* msg = &_stream[pos];
+        int id = -1;
+        uint32_t seq;
+
+        for (int i = 0; i < PRODUCER_NUM; i++) {
+            if (msg[2] == _msg_id[i])
+                id = i;
+        }
+        if (msg[0] != BLOG_BEGIN_MSG1 || msg[1] != BLOG_BEGIN_MSG2 || id < 0 || msg[MSG_LEN + 3] != BLOG_END_MSG) {
+            bad++;
+            pos++;
+            continue;
+        }
+        memcpy(&seq, &msg[3], sizeof(seq));
+        if (seq != next_seq[id] || msg[3 + MSG_LEN - 1] != id) {
+            bad++;
+        }
+        next_seq[id] = seq + 1;
+        pos += MSG_LEN + 4;
+    }
+
+    TEST_CHECK(bad == 0);
+    for (int i = 0; i < PRODUCER_NUM; i++) {
+        TEST_CHECK(next_seq[i] == PRODUCER_MSG);
+        TEST_CHECK(blog.monitor[_get_bus_index(_msg_id[i])].total_msg == PRODUCER_MSG);
+    }
+    TEST_CHECK(_lock_depth == 0);
+}
+
+int main(void)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&_lock, &attr);
+
+    TEST_RUN(test_names);
+    TEST_RUN(test_lock_balance);
+    TEST_RUN(test_threads);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,224 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * DShot frame and bidirectional telemetry codec of module/DShot/dshot.c.
+ * Telemetry is encoded here as an esc sends it and sampled from a port the
+ * way the pwm driver does, then decoded by the firmware.
+ */
+// host_test: src/module/DShot/dshot.c
+
+#include <string.h>
+
+#include "host_test.h"
+#include "module/dshot/dshot.h"
+
+#define PIN       (1 << 9)
+#define OTHER_PIN (1 << 13)
+
+/* nibble to 5 bit gcr code */
+static const uint8_t _gcr_encode[16] = {
+    0x19, 0x1B, 0x12, 0x13, 0x1D, 0x15, 0x16, 0x17,
+    0x1A, 0x09, 0x0A, 0x0B, 0x1E, 0x0D, 0x0E, 0x0F
+};
+
+/* 20 bit gcr of a 12 bit telemetry value and its checksum nibble */
+static uint32_t _telem_gcr(uint16_t value)
+{
+    uint16_t data = value << 4;
+    uint16_t csum = value ^ (value >> 4) ^ (value >> 8);
+    uint32_t gcr = 0;
+
+    data |= ~csum & 0x0F;
+
+    for (int i = 3; i >= 0; i--) {
+        gcr = (gcr << 5) | _gcr_encode[(data >> (i * 4)) & 0x0F];
+    }
+
+    return gcr;
+}
+
+/* sample the esc reply on PIN: idle high for delay samples, then a start bit
+ * and the 20 gcr bits, a bit 1 toggles the line. The esc releases the line
+ * after the last bit and the pull-up takes it high. spb is the samples per
+ * telemetry bit, not exactly DSHOT_TELEM_OVERSAMPLE if the esc clock drifts.
+ * OTHER_PIN toggles on every sample to check the pin mask. */
+static void _telem_samples(uint16_t* samples, uint16_t num, uint32_t gcr, uint16_t delay, double spb)
+{
+    uint32_t bits = (1UL << 20) | gcr;
+    uint8_t level = 1;
+    uint16_t i;
+
+    for (i = 0; i < num; i++) {
+        double t = (i - (double)delay) / spb;
+
+        if (i >= delay && t < 21) {
+            int bit = (int)t;
+
+            level = 1;
+            for (int k = 0; k <= bit; k++) {
+                if (bits & (1UL << (20 - k))) {
+                    level = !level;
+                }
+            }
+        } else {
+            level = 1;
+        }
+
+        samples[i] = (level ? PIN : 0) | ((i & 1) ? OTHER_PIN : 0) | 0x0004;
+    }
+}
+
+static void test_pack(void)
+{
+    /* example of the dshot spec: throttle 1046, no telemetry request */
+    TEST_CHECK(dshot_pack(1046, 0, 0) == 0x82C6);
+    /* crc is inverted for bidirectional dshot */
+    TEST_CHECK(dshot_pack(1046, 0, 1) == 0x82C9);
+    TEST_CHECK(dshot_pack(1046, 1, 0) == ((0x82D << 4) | ((0x82D ^ 0x82 ^ 0x8) & 0x0F)));
+    TEST_CHECK(dshot_pack(DSHOT_CMD_MOTOR_STOP, 0, 0) == 0x0000);
+    TEST_CHECK(dshot_pack(DSHOT_CMD_MOTOR_STOP, 0, 1) == 0x000F);
+    /* value is 11 bits */
+    TEST_CHECK(dshot_pack(0x800 | 48, 0, 0) == dshot_pack(48, 0, 0));
+
+    for (uint16_t v = 0; v < 2048; v++) {
+        uint16_t frame = dshot_pack(v, v & 1, 0);
+        uint16_t crc = (frame >> 4 ^ frame >> 8 ^ frame >> 12) & 0x0F;
+
+        if ((frame >> 5) != v || (frame & 0x0F) != crc) {
+            TEST_CHECK((frame >> 5) == v && (frame & 0x0F) == crc);
+            break;
+        }
+    }
+}
+
+static void test_throttle(void)
+{
+    TEST_CHECK(dshot_throttle(900, 1000, 2000) == DSHOT_CMD_MOTOR_STOP);
+    TEST_CHECK(dshot_throttle(1000, 1000, 2000) == DSHOT_CMD_MOTOR_STOP);
+    TEST_CHECK(dshot_throttle(1001, 1000, 2000) == DSHOT_THROTTLE_MIN + 1);
+    TEST_CHECK(dshot_throttle(1500, 1000, 2000) == DSHOT_THROTTLE_MIN + (DSHOT_THROTTLE_MAX - DSHOT_THROTTLE_MIN) / 2);
+    TEST_CHECK(dshot_throttle(2000, 1000, 2000) == DSHOT_THROTTLE_MAX);
+    TEST_CHECK(dshot_throttle(2100, 1000, 2000) == DSHOT_THROTTLE_MAX);
+    /* bad range stops the motor */
+    TEST_CHECK(dshot_throttle(1500, 2000, 1000) == DSHOT_CMD_MOTOR_STOP);
+}
+
+static void test_fill_slots(void)
+{
+    uint16_t burst[DSHOT_FRAME_SLOTS][4];
+    uint16_t frame = dshot_pack(1046, 0, 0);
+
+    memset(burst, 0xAA, sizeof(burst));
+    dshot_fill_slots(frame, &burst[0][2], 4, 105, 210);
+
+    for (int i = 0; i < DSHOT_FRAME_BITS; i++) {
+        TEST_CHECK(burst[i][2] == ((frame & (0x8000 >> i)) ? 210 : 105));
+        /* slots of the other channels are left */
+        TEST_CHECK(burst[i][0] == 0xAAAA && burst[i][3] == 0xAAAA);
+    }
+    for (int i = DSHOT_FRAME_BITS; i < DSHOT_FRAME_SLOTS; i++) {
+        TEST_CHECK(burst[i][2] == 0);
+    }
+}
+
+static void test_gcr(void)
+{
+    uint16_t value;
+
+    for (uint16_t v = 0; v < 4096; v++) {
+        if (dshot_decode_gcr(_telem_gcr(v), &value) != FMT_EOK || value != v) {
+            TEST_CHECK(dshot_decode_gcr(_telem_gcr(v), &value) == FMT_EOK && value == v);
+            break;
+        }
+    }
+
+    /* wrong checksum */
+    TEST_CHECK(dshot_decode_gcr(_telem_gcr(0x123) ^ _gcr_encode[0] ^ _gcr_encode[1], &value) == FMT_EINVAL);
+    /* invalid code */
+    TEST_CHECK(dshot_decode_gcr(0, &value) == FMT_EINVAL);
+}
+
+static void test_erpm(void)
+{
+    /* period 1000us, 60000 erpm */
+    TEST_CHECK(dshot_value_to_erpm((1 << 9) | 500) == 60000);
+    /* period 100us, 600000 erpm */
+    TEST_CHECK(dshot_value_to_erpm(100) == 600000);
+    TEST_CHECK(dshot_value_to_erpm(0x0FFF) == 0);
+    TEST_CHECK(dshot_value_to_erpm(0) == 0);
+}
+
+/* every telemetry value through the sampled line, on time and with the esc
+ * clock off by 5% */
+static void test_telem_roundtrip(void)
+{
+    const double spb[] = { DSHOT_TELEM_OVERSAMPLE, DSHOT_TELEM_OVERSAMPLE * 0.95, DSHOT_TELEM_OVERSAMPLE * 1.05 };
+    uint16_t samples[DSHOT_TELEM_SAMPLES];
+    uint32_t erpm;
+    fmt_err err;
+
+    for (unsigned s = 0; s < sizeof(spb) / sizeof(spb[0]); s++) {
+        int fail = 0;
+
+        for (uint16_t v = 0; v < 4096; v++) {
+            _telem_samples(samples, DSHOT_TELEM_SAMPLES, _telem_gcr(v), 40 + v % 7, spb[s]);
+
+            erpm = 0xDEAD;
+            err = dshot_decode_telem(samples, DSHOT_TELEM_SAMPLES, PIN, &erpm);
+
+            if (err != FMT_EOK || erpm != dshot_value_to_erpm(v)) {
+                if (fail++ == 0) {
+                    printf("  spb %.2f value 0x%03x: err %d erpm %u\n", spb[s], v, err, (unsigned)erpm);
+                }
+            }
+        }
+
+        TEST_CHECK(fail == 0);
+    }
+}
+
+static void test_telem_bad(void)
+{
+    uint16_t samples[DSHOT_TELEM_SAMPLES];
+    uint32_t erpm;
+
+    /* no reply */
+    _telem_samples(samples, DSHOT_TELEM_SAMPLES, 0, DSHOT_TELEM_SAMPLES, DSHOT_TELEM_OVERSAMPLE);
+    TEST_CHECK(dshot_decode_telem(samples, DSHOT_TELEM_SAMPLES, PIN, &erpm) == FMT_EEMPTY);
+
+    /* reply cut by the end of sampling */
+    _telem_samples(samples, DSHOT_TELEM_SAMPLES, _telem_gcr(0x2F4), DSHOT_TELEM_SAMPLES - 30, DSHOT_TELEM_OVERSAMPLE);
+    TEST_CHECK(dshot_decode_telem(samples, DSHOT_TELEM_SAMPLES, PIN, &erpm) != FMT_EOK);
+
+    /* a glitch inside the reply */
+    _telem_samples(samples, DSHOT_TELEM_SAMPLES, _telem_gcr(0x2F4), 40, DSHOT_TELEM_OVERSAMPLE);
+    samples[40 + 10 * DSHOT_TELEM_OVERSAMPLE + 1] ^= PIN;
+    TEST_CHECK(dshot_decode_telem(samples, DSHOT_TELEM_SAMPLES, PIN, &erpm) != FMT_EOK);
+}
+
+int main(void)
+{
+    TEST_RUN(test_pack);
+    TEST_RUN(test_throttle);
+    TEST_RUN(test_fill_slots);
+    TEST_RUN(test_gcr);
+    TEST_RUN(test_erpm);
+    TEST_RUN(test_telem_roundtrip);
+    TEST_RUN(test_telem_bad);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,260 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * Loopback of the fmtio protocol: frames of the fmu side parsed by the io
+ * side and back, in any chunking, with false frame starts, corrupted and
+ * oversized frames in the stream.
+ */
+// host_test: src/module/FMTIO/fmtio_protocol.c src/module/Math/ap_math.c target/host_test/fmtio_client.c
+
+#include <firmament.h>
+#include <string.h>
+
+#include "fmtio_client.h"
+#include "host_test.h"
+#include "module/fmtio/fmtio_protocol.h"
+
+#define MAX_MSG 16
+
+static ParserStruct _fmu_parser;
+static LinkStatStruct _fmu_stat;
+static io_msg_t _fmu_msg[MAX_MSG];
+static uint16_t _fmu_msg_num;
+
+static fmt_err _fmu_handler(const PackageStruct* pkg)
+{
+    if (_fmu_msg_num < MAX_MSG) {
+        _fmu_msg[_fmu_msg_num].cmd = pkg->cmd;
+        _fmu_msg[_fmu_msg_num].len = pkg->len;
+        memcpy(_fmu_msg[_fmu_msg_num].content, pkg->content, pkg->len);
+    }
+    _fmu_msg_num++;
+
+    return FMT_EOK;
+}
+
+static void _reset(void)
+{
+    memset(&_fmu_stat, 0, sizeof(_fmu_stat));
+    proto_parser_init(&_fmu_parser, &_fmu_stat);
+    _fmu_msg_num = 0;
+    io_init();
+}
+
+/* a fmu frame with a motor command of 4 channels */
+static uint16_t _fmu_motor_frame(uint8_t* buff, uint8_t seq)
+{
+    FrameStruct frame;
+    uint16_t motor[5] = { 0x000F, 1000 + seq, 1100, 1200, 1300 };
+    uint16_t size;
+
+    proto_frame_init(&frame);
+    proto_frame_append(&frame, PROTO_CMD_MOTOR, motor, sizeof(motor));
+    size = proto_frame_finalize(&frame, seq);
+    memcpy(buff, frame.buff, size);
+
+    return size;
+}
+
+static void _check_motor(const io_msg_t* msg, uint8_t seq)
+{
+    uint16_t val;
+
+    TEST_CHECK(msg->cmd == PROTO_CMD_MOTOR);
+    TEST_CHECK(msg->len == 10);
+    memcpy(&val, &msg->content[2], sizeof(val));
+    TEST_CHECK(val == 1000 + seq);
+}
+
+static void test_fmu_to_io(void)
+{
+    FrameStruct frame;
+    io_msg_t msg[MAX_MSG];
+    uint16_t msg_num, size;
+    uint8_t text[] = "hello";
+    uint8_t sync = 1;
+
+    _reset();
+
+    proto_frame_init(&frame);
+    TEST_CHECK(proto_frame_append(&frame, PROTO_CMD_SYNC, &sync, 1) == FMT_EOK);
+    TEST_CHECK(proto_frame_append(&frame, PROTO_DBG_TEXT, text, sizeof(text)) == FMT_EOK);
+    TEST_CHECK(proto_frame_append(&frame, PROTO_GET_MOTOR_VAL, NULL, 0) == FMT_EOK);
+    size = proto_frame_finalize(&frame, 7);
+
+    TEST_CHECK(io_parse(frame.buff, size, msg, MAX_MSG, &msg_num) == 1);
+    TEST_CHECK(msg_num == 3);
+    TEST_CHECK(msg[0].cmd == PROTO_CMD_SYNC && msg[0].len == 1 && msg[0].content[0] == 1);
+    TEST_CHECK(msg[1].cmd == PROTO_DBG_TEXT && msg[1].len == sizeof(text));
+    TEST_CHECK(memcmp(msg[1].content, text, sizeof(text)) == 0);
+    TEST_CHECK(msg[2].cmd == PROTO_GET_MOTOR_VAL && msg[2].len == 0);
+
+    /* the fmu does not take its own frames */
+    TEST_CHECK(proto_parse_buffer(&_fmu_parser, frame.buff, size, _fmu_handler) == 0);
+}
+
+static void test_io_to_fmu(void)
+{
+    io_msg_t msg[2] = { { PROTO_ACK_SYNC, 1, { 1 } }, { PROTO_DATA_RC, 4, { 1, 2, 3, 4 } } };
+    uint8_t buff[MAX_FRAME_SIZE];
+    uint16_t size;
+
+    _reset();
+
+    size = io_encode(buff, 0, msg, 2);
+    TEST_CHECK(size == FRAME_HEAD_SIZE + 2 * FRAME_MSG_HEAD_SIZE + 5 + FRAME_CRC_SIZE);
+
+    TEST_CHECK(proto_parse_buffer(&_fmu_parser, buff, size, _fmu_handler) == 1);
+    TEST_CHECK(_fmu_msg_num == 2);
+    TEST_CHECK(_fmu_msg[0].cmd == PROTO_ACK_SYNC && _fmu_msg[0].content[0] == 1);
+    TEST_CHECK(_fmu_msg[1].cmd == PROTO_DATA_RC && _fmu_msg[1].len == 4);
+    TEST_CHECK(memcmp(_fmu_msg[1].content, msg[1].content, 4) == 0);
+    TEST_CHECK(_fmu_stat.rx_frame == 1 && _fmu_stat.rx_msg == 2);
+}
+
+/* a frame start in front of a valid frame whose length takes in the valid
+ * frame, the valid frame is found once the false one failed its crc */
+static void test_false_start(void)
+{
+    uint8_t buff[2 * MAX_FRAME_SIZE];
+    uint8_t false_head[] = { 0xFA, 0x5A, 0x00, 0x01, 12, 0x00 };
+    io_msg_t msg[MAX_MSG];
+    uint16_t msg_num, size;
+    uint32_t rx_frame, crc_err, len_err, lost;
+
+    _reset();
+
+    memcpy(buff, false_head, sizeof(false_head));
+    size = sizeof(false_head);
+    size += _fmu_motor_frame(&buff[size], 1);
+
+    TEST_CHECK(io_parse(buff, size, msg, MAX_MSG, &msg_num) == 1);
+    TEST_CHECK(msg_num == 1);
+    _check_motor(&msg[0], 1);
+
+    io_stat(&rx_frame, &crc_err, &len_err, &lost);
+    TEST_CHECK(rx_frame == 1);
+    TEST_CHECK(crc_err == 1);
+}
+
+/* a corrupted frame, an oversized length and a wrong head, each right in
+ * front of a valid frame */
+static void test_bad_frames(void)
+{
+    uint8_t buff[4 * MAX_FRAME_SIZE];
+    uint8_t big_len[] = { 0xFA, 0x5A, 0x00, 0x01, 0xFF, 0xFF };
+    uint8_t bad_head[] = { 0xFA, 0x33 };
+    io_msg_t msg[MAX_MSG];
+    uint16_t msg_num, size, n;
+    uint32_t rx_frame, crc_err, len_err, lost;
+
+    _reset();
+
+    size = _fmu_motor_frame(buff, 0);
+    buff[7] ^= 0x10;
+    size += _fmu_motor_frame(&buff[size], 1);
+    memcpy(&buff[size], big_len, sizeof(big_len));
+    size += sizeof(big_len);
+    size += _fmu_motor_frame(&buff[size], 2);
+    memcpy(&buff[size], bad_head, sizeof(bad_head));
+    size += sizeof(bad_head);
+    n = size;
+    size += _fmu_motor_frame(&buff[size], 3);
+
+    TEST_CHECK(io_parse(buff, size, msg, MAX_MSG, &msg_num) == 3);
+    TEST_CHECK(msg_num == 3);
+    _check_motor(&msg[0], 1);
+    _check_motor(&msg[1], 2);
+    _check_motor(&msg[2], 3);
+
+    io_stat(&rx_frame, &crc_err, &len_err, &lost);
+    TEST_CHECK(rx_frame == 3);
+    TEST_CHECK(crc_err == 1);
+    TEST_CHECK(len_err == 1);
+    TEST_CHECK(lost == 0);
+
+    /* same stream again, but the last frame cut right after the wrong head */
+    _reset();
+    TEST_CHECK(io_parse(buff, n, msg, MAX_MSG, &msg_num) == 2);
+    TEST_CHECK(io_parse(&buff[n], size - n, msg, MAX_MSG, &msg_num) == 1);
+    _check_motor(&msg[0], 3);
+}
+
+/* a stream of frames and noise fed in every chunk size */
+static void test_chunks(void)
+{
+    uint8_t buff[8 * MAX_FRAME_SIZE];
+    uint8_t noise[] = { 0x00, 0xFA, 0xFA, 0x5A, 0x11, 0xFA };
+    io_msg_t msg[MAX_MSG];
+    uint16_t msg_num, size = 0, found;
+    uint32_t rx_frame, crc_err, len_err, lost;
+
+    for (uint8_t seq = 0; seq < 6; seq++) {
+        memcpy(&buff[size], noise, sizeof(noise));
+        size += sizeof(noise);
+        size += _fmu_motor_frame(&buff[size], seq);
+    }
+
+    for (uint16_t chunk = 1; chunk <= size; chunk++) {
+        _reset();
+        found = 0;
+
+        for (uint16_t i = 0; i < size; i += chunk) {
+            uint16_t n = size - i < chunk ? size - i : chunk;
+
+            found += io_parse(&buff[i], n, msg, MAX_MSG, &msg_num);
+        }
+
+        io_stat(&rx_frame, &crc_err, &len_err, &lost);
+        if (found != 6 || rx_frame != 6 || lost != 0) {
+            printf("  chunk %u: %u frames, %u lost\n", chunk, found, (unsigned)lost);
+            TEST_CHECK(found == 6 && rx_frame == 6 && lost == 0);
+            break;
+        }
+    }
+}
+
+static void test_lost(void)
+{
+    uint8_t buff[4 * MAX_FRAME_SIZE];
+    io_msg_t msg[MAX_MSG];
+    uint16_t msg_num, size = 0;
+    uint32_t rx_frame, crc_err, len_err, lost;
+
+    _reset();
+
+    size += _fmu_motor_frame(&buff[size], 254);
+    size += _fmu_motor_frame(&buff[size], 255);
+    size += _fmu_motor_frame(&buff[size], 2);
+
+    TEST_CHECK(io_parse(buff, size, msg, MAX_MSG, &msg_num) == 3);
+
+    io_stat(&rx_frame, &crc_err, &len_err, &lost);
+    TEST_CHECK(lost == 2);
+}
+
+int main(void)
+{
+    TEST_RUN(test_fmu_to_io);
+    TEST_RUN(test_io_to_fmu);
+    TEST_RUN(test_false_start);
+    TEST_RUN(test_bad_frames);
+    TEST_RUN(test_chunks);
+    TEST_RUN(test_lost);
+
+    return TEST_RESULT();
+}
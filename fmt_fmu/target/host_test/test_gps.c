@@ -0,0 +1,378 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * UBX decoder and configuration of driver/gps/gps.c.
+ *
+ * A recorded stream is replayed byte by byte into the parser: NAV-PVT alone
+ * and with RELPOSNED of the same epoch, broken checksums and jittered
+ * receive times. The configuration runs against a fake receiver answering
+ * the CFG messages like an M8N or an F9P would.
+ */
+
+#include <firmament.h>
+#include <string.h>
+
+#include "host_test.h"
+
+static int32_t _gps_rate_hz = 10;
+
+/* the driver reads its rate from the param system */
+#undef PARAM_GET_INT32
+#define PARAM_GET_INT32(_group, _name) (_gps_rate_hz)
+
+#include "../../src/driver/gps/gps.c"
+
+typedef enum {
+    RECEIVER_M8N,
+    RECEIVER_F9P,
+} receiver_t;
+
+static struct serial_device _serial;
+static receiver_t _receiver;
+
+/* tx of the driver is collected until a frame is complete */
+static uint8_t _tx[512];
+static uint16_t _tx_len;
+/* answer of the fake receiver, given to the parser while the driver waits */
+static uint8_t _rx[64];
+static uint16_t _rx_len;
+
+static uint16_t _ubx_frame(uint8_t* buf, uint16_t msg, const void* payload, uint16_t len)
+{
+    uint8_t ck_a = 0, ck_b = 0;
+
+    buf[0] = UBX_SYNC1;
+    buf[1] = UBX_SYNC2;
+    buf[2] = msg & 0xFF;
+    buf[3] = msg >> 8;
+    buf[4] = len & 0xFF;
+    buf[5] = len >> 8;
+    memcpy(&buf[6], payload, len);
+
+    for (uint16_t i = 2; i < 6 + len; i++) {
+        ck_a += buf[i];
+        ck_b += ck_a;
+    }
+    buf[6 + len] = ck_a;
+    buf[7 + len] = ck_b;
+
+    return len + 8;
+}
+
+// feed one message to the parser, return the last non zero result of the parser
+static int _feed(uint16_t msg, const void* payload, uint16_t len, int corrupt)
+{
+    uint8_t buf[300];
+    uint16_t size = _ubx_frame(buf, msg, payload, len);
+    int ret = 0;
+
+    if (corrupt) {
+        buf[6 + len / 2] ^= 0x40;
+    }
+
+    for (uint16_t i = 0; i < size; i++) {
+        int r = _parse_ubx_char(buf[i]);
+
+        ret = r ? r : ret;
+    }
+
+    return ret;
+}
+
+static void _receiver_answer(uint16_t msg, const uint8_t* payload)
+{
+    uint16_t acked = UBX_MSG_CFG_MSG;
+    uint16_t answer = UBX_MSG_ACK_ACK;
+
+    switch (msg) {
+    case UBX_MSG_CFG_PRT:
+        /* the receiver starts at 38400, it can not hear the other baudrates */
+        if (_serial.config.baud_rate != 38400 && _serial.config.baud_rate != UBX_TX_CFG_PRT_BAUDRATE) {
+            return;
+        }
+        acked = msg;
+        break;
+    case UBX_MSG_CFG_RATE:
+    case UBX_MSG_CFG_NAV5:
+        acked = msg;
+        break;
+    case UBX_MSG_CFG_MSG: {
+        uint16_t cfg = payload[0] | payload[1] << 8;
+
+        if (_receiver == RECEIVER_F9P && (cfg == UBX_MSG_NAV_SVINFO || cfg == UBX_MSG_MON_HW)) {
+            answer = UBX_MSG_ACK_NAK;
+        }
+        if (_receiver == RECEIVER_M8N && cfg == UBX_MSG_NAV_RELPOSNED) {
+            answer = UBX_MSG_ACK_NAK;
+        }
+    } break;
+    default:
+        return;
+    }
+
+    _rx_len = _ubx_frame(_rx, answer, &acked, sizeof(acked));
+}
+
+rt_size_t rt_device_write(rt_device_t dev, rt_off_t pos, const void* buffer, rt_size_t size)
+{
+    memcpy(&_tx[_tx_len], buffer, size);
+    _tx_len += size;
+
+    if (_tx_len >= 8 && _tx_len >= 8 + (_tx[4] | _tx[5] << 8)) {
+        _receiver_answer(_tx[2] | _tx[3] << 8, &_tx[6]);
+        _tx_len = 0;
+    }
+
+    return size;
+}
+
+/* the driver polls for the ack with a delay, the gps thread would parse meanwhile */
+rt_err_t rt_thread_delay(rt_tick_t tick)
+{
+    host_time_advance_us(tick * 1000);
+
+    for (uint16_t i = 0; i < _rx_len; i++) {
+        _parse_ubx_char(_rx[i]);
+    }
+    _rx_len = 0;
+
+    return RT_EOK;
+}
+
+static void _reset(rt_bool_t relposned)
+{
+    _decode_init();
+    _configured = RT_TRUE;
+    _use_relposned = relposned;
+    _pvt_pending = RT_FALSE;
+    _relposned_miss = 0;
+    _epoch_offset_valid = RT_FALSE;
+    memset(&_gps_position, 0, sizeof(_gps_position));
+}
+
+static void _pvt(ubx_payload_rx_nav_pvt_t* pvt, uint32_t iTOW)
+{
+    memset(pvt, 0, sizeof(*pvt));
+    pvt->iTOW = iTOW;
+    pvt->fixType = 3;
+    pvt->flags = UBX_RX_NAV_PVT_FLAGS_GNSSFIXOK | (2 << 6);
+    pvt->numSV = 17;
+    pvt->lat = 312345678;
+    pvt->lon = 1212345678;
+    pvt->height = 45000;
+    pvt->hMSL = 40000;
+    pvt->hAcc = 1500;
+    pvt->vAcc = 2500;
+    pvt->velN = 1000;
+    pvt->velE = -2000;
+    pvt->velD = 300;
+    pvt->sAcc = 200;
+    pvt->headMot = 9000000;
+}
+
+static void test_nav_pvt(void)
+{
+    ubx_payload_rx_nav_pvt_t pvt;
+    struct vehicle_gps_position_s report;
+    uint32_t seq;
+
+    _reset(RT_FALSE);
+    _pvt(&pvt, 100000);
+    _rx_timestamp_us = 5000000;
+    seq = _copy_report(&report);
+
+    TEST_CHECK(_feed(UBX_MSG_NAV_PVT, &pvt, sizeof(pvt), 0) == 1);
+    TEST_CHECK(_copy_report(&report) == seq + 1);
+    TEST_CHECK(report.fix_type == 3);
+    TEST_CHECK(report.carr_soln == 2);
+    TEST_CHECK(report.satellites_used == 17);
+    TEST_CHECK(report.lat == 312345678 && report.lon == 1212345678);
+    TEST_CHECK(report.alt == 40000 && report.alt_ellipsoid == 45000);
+    TEST_CHECK_NEAR(report.eph, 1.5, 1e-6);
+    TEST_CHECK_NEAR(report.vel_n_m_s, 1.0, 1e-6);
+    TEST_CHECK_NEAR(report.vel_e_m_s, -2.0, 1e-6);
+    TEST_CHECK_NEAR(report.vel_d_m_s, 0.3, 1e-6);
+    TEST_CHECK_NEAR(report.cog_rad, M_PI_F / 2, 1e-5);
+    TEST_CHECK(report.iTOW == 100000);
+    TEST_CHECK(report.rx_timestamp_us == 5000000);
+
+    /* ubx7 has a shorter NAV-PVT */
+    TEST_CHECK(_feed(UBX_MSG_NAV_PVT, &pvt, UBX_PAYLOAD_RX_NAV_PVT_SIZE_UBX7, 0) == 1);
+    TEST_CHECK(_copy_report(&report) == seq + 2);
+
+    /* no fix */
+    pvt.flags = 0;
+    _feed(UBX_MSG_NAV_PVT, &pvt, sizeof(pvt), 0);
+    _copy_report(&report);
+    TEST_CHECK(report.fix_type == 0 && report.vel_ned_valid == 0);
+}
+
+static void test_bad_stream(void)
+{
+    ubx_payload_rx_nav_pvt_t pvt;
+    struct vehicle_gps_position_s report;
+    uint8_t garbage[] = { 0xB5, 0x00, 0xB5, 0x62, 0x01 };
+    uint32_t seq;
+
+    _reset(RT_FALSE);
+    _pvt(&pvt, 200000);
+    seq = _copy_report(&report);
+
+    TEST_CHECK(_feed(UBX_MSG_NAV_PVT, &pvt, sizeof(pvt), 1) == 0);
+    TEST_CHECK(_copy_report(&report) == seq);
+
+    /* a wrong length is dropped */
+    TEST_CHECK(_feed(UBX_MSG_NAV_PVT, &pvt, sizeof(pvt) - 1, 0) == 0);
+    TEST_CHECK(_copy_report(&report) == seq);
+
+    /* the decoder resyncs on the next frame after garbage */
+    for (uint16_t i = 0; i < sizeof(garbage); i++) {
+        _parse_ubx_char(garbage[i]);
+    }
+    _decode_init();
+    TEST_CHECK(_feed(UBX_MSG_NAV_PVT, &pvt, sizeof(pvt), 0) == 1);
+    TEST_CHECK(_copy_report(&report) == seq + 1);
+
+    /* nothing is published before configured */
+    _configured = RT_FALSE;
+    TEST_CHECK(_feed(UBX_MSG_NAV_PVT, &pvt, sizeof(pvt), 0) == 0);
+    TEST_CHECK(_copy_report(&report) == seq + 1);
+}
+
+static void test_relposned(void)
+{
+    ubx_payload_rx_nav_pvt_t pvt;
+    ubx_payload_rx_nav_relposned_t rel;
+    struct vehicle_gps_position_s report;
+    uint32_t seq;
+
+    _reset(RT_TRUE);
+    _pvt(&pvt, 300000);
+    memset(&rel, 0, sizeof(rel));
+    rel.version = 1;
+    rel.iTOW = 300000;
+    rel.relPosN = 150;
+    rel.relPosHPN = 25;
+    rel.relPosE = -80;
+    rel.relPosD = 3;
+    rel.relPosHeading = 27000000;
+    rel.accHeading = 50000;
+    rel.flags = UBX_RX_NAV_RELPOSNED_FLAGS_RELPOSVALID | UBX_RX_NAV_RELPOSNED_FLAGS_HEADINGVALID
+                | UBX_RX_NAV_RELPOSNED_FLAGS_ISMOVING;
+    seq = _copy_report(&report);
+
+    /* the epoch waits for its RELPOSNED */
+    _feed(UBX_MSG_NAV_PVT, &pvt, sizeof(pvt), 0);
+    TEST_CHECK(_copy_report(&report) == seq);
+    _feed(UBX_MSG_NAV_RELPOSNED, &rel, sizeof(rel), 0);
+    TEST_CHECK(_copy_report(&report) == seq + 1);
+    TEST_CHECK(report.iTOW == 300000);
+    TEST_CHECK(report.rel_pos_valid && report.heading_valid);
+    TEST_CHECK_NEAR(report.rel_pos_n_m, 1.5025, 1e-5);
+    TEST_CHECK_NEAR(report.rel_pos_e_m, -0.8, 1e-5);
+    /* 270 deg is wrapped into -PI..PI */
+    TEST_CHECK_NEAR(report.heading_rad, -M_PI_F / 2, 1e-5);
+
+    /* RELPOSNED of another epoch does not complete it, the next NAV-PVT does */
+    pvt.iTOW = rel.iTOW = 300100;
+    _feed(UBX_MSG_NAV_PVT, &pvt, sizeof(pvt), 0);
+    rel.iTOW = 300000;
+    _feed(UBX_MSG_NAV_RELPOSNED, &rel, sizeof(rel), 0);
+    TEST_CHECK(_copy_report(&report) == seq + 1);
+    pvt.iTOW = 300200;
+    _feed(UBX_MSG_NAV_PVT, &pvt, sizeof(pvt), 0);
+    TEST_CHECK(_copy_report(&report) == seq + 2 && report.iTOW == 300100);
+
+    /* a module acking RELPOSNED without sending it is given up */
+    for (int i = 0; i < GPS_RELPOSNED_MISS_MAX + 1; i++) {
+        pvt.iTOW += 100;
+        _feed(UBX_MSG_NAV_PVT, &pvt, sizeof(pvt), 0);
+    }
+    TEST_CHECK(_use_relposned == RT_FALSE);
+    seq = _copy_report(&report);
+    pvt.iTOW += 100;
+    _feed(UBX_MSG_NAV_PVT, &pvt, sizeof(pvt), 0);
+    TEST_CHECK(_copy_report(&report) == seq + 1 && report.iTOW == pvt.iTOW);
+}
+
+static void test_epoch_align(void)
+{
+    /* 10 Hz epochs received 60 ms after the epoch plus 0~15 ms queuing delay */
+    const uint32_t delay_us[] = { 12000, 3000, 15000, 0, 7000, 9000, 1000, 14000, 0, 5000 };
+    ubx_payload_rx_nav_pvt_t pvt;
+    struct vehicle_gps_position_s report;
+    uint64_t base_us = 20000000;
+
+    _reset(RT_FALSE);
+    _pvt(&pvt, 400000);
+
+    for (int i = 0; i < 40; i++) {
+        pvt.iTOW = 400000 + i * 100;
+        _rx_timestamp_us = base_us + i * 100000 + 60000 + delay_us[i % 10];
+        _feed(UBX_MSG_NAV_PVT, &pvt, sizeof(pvt), 0);
+        _copy_report(&report);
+
+        /* once the zero delay epoch is seen, reports are on the epoch grid */
+        if (i >= 3) {
+            TEST_CHECK_NEAR((double)report.timestamp_us, (double)(base_us + i * 100000 + 60000), 100);
+        }
+    }
+
+    /* week rollover resyncs */
+    pvt.iTOW = 0;
+    _rx_timestamp_us += 100000;
+    _feed(UBX_MSG_NAV_PVT, &pvt, sizeof(pvt), 0);
+    _copy_report(&report);
+    TEST_CHECK(report.timestamp_us == _rx_timestamp_us);
+}
+
+static void _configure(receiver_t receiver)
+{
+    serial_device = (rt_device_t)&_serial;
+    _serial.config.baud_rate = 9600;
+    _receiver = receiver;
+    _tx_len = _rx_len = 0;
+    _use_relposned = RT_FALSE;
+    _configured = RT_FALSE;
+}
+
+static void test_configure(void)
+{
+    /* F9 has no NAV-SVINFO and MON-HW, it is still configured with RELPOSNED */
+    _configure(RECEIVER_F9P);
+    TEST_CHECK(_configure_by_ubx() == 0);
+    TEST_CHECK(_configured == RT_TRUE);
+    TEST_CHECK(_use_relposned == RT_TRUE);
+    TEST_CHECK(_serial.config.baud_rate == UBX_TX_CFG_PRT_BAUDRATE);
+
+    /* M8N has no RELPOSNED */
+    _configure(RECEIVER_M8N);
+    TEST_CHECK(_configure_by_ubx() == 0);
+    TEST_CHECK(_configured == RT_TRUE);
+    TEST_CHECK(_use_relposned == RT_FALSE);
+}
+
+int main(void)
+{
+    TEST_RUN(test_nav_pvt);
+    TEST_RUN(test_bad_stream);
+    TEST_RUN(test_relposned);
+    TEST_RUN(test_epoch_align);
+    TEST_RUN(test_configure);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,257 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * Frame parser of the hil bridge: SENSOR frames round trip, and every frame
+ * found behind a false sync whose length covers it, behind corrupted frames
+ * and in random garbage, in order and none left in the parser at the end.
+ */
+// host_test: src/module/HIL/hil_frame.c
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "module/hil/hil_frame.h"
+
+#define MAX_FRAME   64
+#define STREAM_LEN  (MAX_FRAME * (HIL_FRAME_MAX_LEN + 16))
+
+typedef struct {
+    uint8_t data[STREAM_LEN];
+    uint32_t len;
+    /* seq and end offset of the frames put in the stream */
+    uint32_t seq[MAX_FRAME];
+    uint32_t end[MAX_FRAME];
+    uint32_t frame_num;
+} stream_t;
+
+static hil_parser_t _parser;
+static stream_t _stream;
+
+static void _reset(void)
+{
+    memset(&_parser, 0, sizeof(_parser));
+    memset(&_stream, 0, sizeof(_stream));
+}
+
+static void _put(const void* data, uint32_t len)
+{
+    memcpy(&_stream.data[_stream.len], data, len);
+    _stream.len += len;
+}
+
+/* a SENSOR frame of imu_num samples and sequence seq */
+static uint16_t _sensor_frame(uint8_t* buf, uint32_t seq, uint8_t imu_num)
+{
+    hil_sensor_t sensor = { 0 };
+    uint8_t payload[HIL_FRAME_MAX_PAYLOAD];
+
+    sensor.seq = seq;
+    sensor.time_us = (uint64_t)seq * 2000;
+    sensor.imu_num = imu_num;
+    for (int k = 0; k < imu_num; k++) {
+        sensor.imu[k].dt_us = -(imu_num - 1 - k) * 2000;
+        sensor.imu[k].gyr[0] = 0.01f * seq;
+        sensor.imu[k].acc[2] = -9.8f;
+    }
+
+    return hil_frame_pack(buf, HIL_FRAME_SENSOR, payload, hil_sensor_encode(payload, &sensor));
+}
+
+static void _put_frame(uint32_t seq, uint8_t imu_num)
+{
+    uint8_t buf[HIL_FRAME_MAX_LEN];
+    uint16_t len = _sensor_frame(buf, seq, imu_num);
+
+    _put(buf, len);
+    _stream.seq[_stream.frame_num] = seq;
+    _stream.end[_stream.frame_num] = _stream.len;
+    _stream.frame_num++;
+}
+
+/* feed the stream byte by byte, every frame has to come out whole and in order */
+static void _check_stream(void)
+{
+    uint32_t found = 0;
+
+    for (uint32_t i = 0; i < _stream.len; i++) {
+        int ready = hil_frame_parse(&_parser, _stream.data[i]);
+
+        for (; ready; ready = hil_frame_parse_next(&_parser)) {
+            hil_sensor_t sensor;
+
+            TEST_CHECK(_parser.type == HIL_FRAME_SENSOR);
+            TEST_CHECK(hil_sensor_decode(_parser.payload, _parser.len, &sensor) == 0);
+            TEST_CHECK(found < _stream.frame_num);
+            if (found >= _stream.frame_num) {
+                return;
+            }
+            TEST_CHECK(sensor.seq == _stream.seq[found]);
+            /* a frame covered by a false sync comes out when the false frame is complete */
+            TEST_CHECK(i + 1 >= _stream.end[found]);
+            found++;
+        }
+    }
+
+    TEST_CHECK(found == _stream.frame_num);
+}
+
+static void test_round_trip(void)
+{
+    hil_sensor_t in = { 0 }, out;
+    uint8_t payload[HIL_FRAME_MAX_PAYLOAD];
+    uint8_t buf[HIL_FRAME_MAX_LEN];
+    uint16_t size;
+    int ready = 0;
+
+    _reset();
+
+    /* the largest frame: 4 imu samples and every other sensor */
+    in.seq = 7;
+    in.time_us = 123456789;
+    in.imu_num = HIL_SENSOR_MAX_IMU;
+    in.mask = HIL_SENSOR_MAG | HIL_SENSOR_BARO | HIL_SENSOR_GPS;
+    for (int k = 0; k < HIL_SENSOR_MAX_IMU; k++) {
+        in.imu[k].dt_us = -2000 * k;
+        in.imu[k].gyr[k % 3] = 0.5f * k;
+    }
+    in.mag.mag[0] = 0.3f;
+    in.baro.pressure = 101325.0f;
+    in.gps.lat = 311234567;
+    in.gps.numSV = 12;
+
+    size = hil_frame_pack(buf, HIL_FRAME_SENSOR, payload, hil_sensor_encode(payload, &in));
+    TEST_CHECK(size <= HIL_FRAME_MAX_LEN);
+
+    for (uint16_t i = 0; i < size; i++) {
+        ready = hil_frame_parse(&_parser, buf[i]);
+        TEST_CHECK(ready == (i == size - 1));
+    }
+
+    TEST_CHECK(ready && hil_sensor_decode(_parser.payload, _parser.len, &out) == 0);
+    TEST_CHECK(out.seq == in.seq && out.time_us == in.time_us);
+    TEST_CHECK(out.imu_num == in.imu_num && out.mask == in.mask);
+    TEST_CHECK(memcmp(out.imu, in.imu, sizeof(in.imu)) == 0);
+    TEST_CHECK(memcmp(&out.gps, &in.gps, sizeof(in.gps)) == 0);
+    TEST_CHECK(hil_frame_parse_next(&_parser) == 0);
+    TEST_CHECK(_parser.crc_err == 0);
+}
+
+/* a false sync whose length covers the next frames, they must not be lost with it */
+static void test_false_sync(void)
+{
+    const uint8_t false_head[] = { HIL_FRAME_SYNC0, HIL_FRAME_SYNC1, HIL_FRAME_SENSOR, 200 };
+
+    _reset();
+
+    _put_frame(1, 1);
+    _put(false_head, sizeof(false_head));
+    for (uint32_t seq = 2; seq < 10; seq++) {
+        _put_frame(seq, 1);
+    }
+
+    _check_stream();
+    TEST_CHECK(_parser.crc_err >= 1);
+}
+
+/* a false sync ending right on a frame: the frame is only found by the rescan */
+static void test_false_sync_tail(void)
+{
+    const uint8_t false_head[] = { HIL_FRAME_SYNC0, HIL_FRAME_SYNC1, HIL_FRAME_SENSOR, 0 };
+    uint8_t buf[HIL_FRAME_MAX_LEN];
+    uint16_t len = _sensor_frame(buf, 2, 1);
+    uint8_t head[4];
+
+    _reset();
+
+    /* the false frame is exactly as long as the frame after its head */
+    memcpy(head, false_head, sizeof(head));
+    head[3] = len - HIL_FRAME_OVERHEAD + 4;
+    _put(head, sizeof(head));
+    _put_frame(2, 1);
+    /* the next frame comes after the answer in lockstep, nothing follows */
+
+    _check_stream();
+    TEST_CHECK(_parser.crc_err == 1);
+}
+
+static void test_corrupted(void)
+{
+    uint32_t dropped = 0;
+
+    _reset();
+
+    for (uint32_t seq = 1; seq < 20; seq++) {
+        uint32_t start = _stream.len;
+
+        _put_frame(seq, 1 + seq % HIL_SENSOR_MAX_IMU);
+
+        if (seq % 3 == 0) {
+            /* flip a bit of the payload, the frame is dropped */
+            _stream.data[start + 4 + seq % 10] ^= 0x10;
+            _stream.frame_num--;
+            dropped++;
+        } else if (seq % 5 == 0) {
+            /* cut, the next frame starts where the crc was expected */
+            _stream.len -= 3;
+            _stream.frame_num--;
+            dropped++;
+        }
+    }
+
+    _check_stream();
+    TEST_CHECK(_parser.crc_err >= dropped);
+}
+
+static void test_garbage(void)
+{
+    srand(2020);
+
+    for (int round = 0; round < 50; round++) {
+        _reset();
+
+        for (uint32_t seq = 1; seq < 40; seq++) {
+            int junk = rand() % 12;
+
+            for (int n = 0; n < junk; n++) {
+                /* mostly sync bytes to provoke false starts */
+                int r = rand() % 4;
+                uint8_t c = r == 0 ? HIL_FRAME_SYNC0 : (r == 1 ? HIL_FRAME_SYNC1 : (uint8_t)rand());
+
+                _put(&c, 1);
+            }
+            _put_frame(seq, 1 + rand() % HIL_SENSOR_MAX_IMU);
+        }
+
+        /* a false sync in the junk covers the last frames until the bytes after them arrive */
+        memset(&_stream.data[_stream.len], 0, HIL_FRAME_MAX_LEN);
+        _stream.len += HIL_FRAME_MAX_LEN;
+
+        _check_stream();
+    }
+}
+
+int main(void)
+{
+    TEST_RUN(test_round_trip);
+    TEST_RUN(test_false_sync);
+    TEST_RUN(test_false_sync_tail);
+    TEST_RUN(test_corrupted);
+    TEST_RUN(test_garbage);
+
+    return TEST_RESULT();
+}
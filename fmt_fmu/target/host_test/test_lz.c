@@ -0,0 +1,303 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * LZ block codec of module/Utils/lz.c, the wire format of the log download
+ * (target/pixhawk/log_download.py decodes it): round trips on random and
+ * BLog like data, blocks cut by the output bound and continued, malformed
+ * blocks, and the chunks of ftp_log_pack_chunk with their crc and raw
+ * fallback.
+ */
+// host_test: src/module/Utils/lz.c src/module/FTP/ftp_log.c src/module/Math/ap_math.c
+
+#include <firmament.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "module/ftp/ftp_log.h"
+#include "module/log/blog.h"
+#include "module/math/ap_math.h"
+#include "module/utils/lz.h"
+
+#define DATA_LEN    8192
+/* worst case growth of incompressible data, token and length bytes */
+#define BLOCK_CAP   (DATA_LEN + DATA_LEN / 255 + 16)
+#define GUARD       16
+#define GUARD_BYTE  0xCD
+
+static uint16_t _hash_table[LZ_HASH_SIZE];
+static uint8_t _data[DATA_LEN];
+static uint8_t _block[BLOCK_CAP];
+static uint8_t _out[DATA_LEN + GUARD];
+
+static void _random_data(uint8_t* buf, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)rand();
+    }
+}
+
+/* blog messages of a slowly moving vehicle, as the logger writes them */
+static void _blog_data(uint8_t* buf, uint32_t len)
+{
+    uint32_t pos = 0;
+    uint32_t t = 0;
+
+    while (pos < len) {
+        uint8_t msg[4 + 4 + 6 * 4 + 1];
+        float v[6];
+
+        msg[0] = BLOG_BEGIN_MSG1;
+        msg[1] = BLOG_BEGIN_MSG2;
+        msg[2] = (t % 5) ? BLOG_IMU_ID : BLOG_INS_OUT_ID;
+        msg[3] = 0;
+        memcpy(&msg[4], &t, 4);
+        for (int i = 0; i < 6; i++) {
+            v[i] = (i < 3 ? 0.01f : 9.8f) * (float)(((t / 50) + i) % 7) + (float)(rand() % 4) * 1e-3f;
+        }
+        memcpy(&msg[8], v, sizeof(v));
+        msg[sizeof(msg) - 1] = BLOG_END_MSG;
+
+        for (uint32_t i = 0; i < sizeof(msg) && pos < len; i++) {
+            buf[pos++] = msg[i];
+        }
+        t += 2;
+    }
+}
+
+/* compress len bytes of data into one block and back, return compressed size */
+static uint32_t _round_trip(const uint8_t* data, uint32_t len)
+{
+    uint32_t block_len, consumed = 0;
+    int32_t out_len;
+
+    block_len = lz_compress(data, len, _block, sizeof(_block), &consumed, _hash_table);
+    TEST_CHECK(consumed == len);
+    TEST_CHECK(block_len <= sizeof(_block));
+
+    memset(_out, GUARD_BYTE, sizeof(_out));
+    out_len = lz_decompress(_block, block_len, _out, len);
+    TEST_CHECK(out_len == (int32_t)len);
+    TEST_CHECK(memcmp(_out, data, len) == 0);
+    TEST_CHECK(len + GUARD > sizeof(_out) || _out[len] == GUARD_BYTE);
+
+    return block_len;
+}
+
+static void test_round_trip(void)
+{
+    static const uint32_t len[] = { 0, 1, 3, 4, 5, 15, 16, 19, 270, 271, 1000, DATA_LEN };
+
+    srand(40);
+
+    for (int i = 0; i < sizeof(len) / sizeof(len[0]); i++) {
+        _random_data(_data, len[i]);
+        _round_trip(_data, len[i]);
+
+        _blog_data(_data, len[i]);
+        _round_trip(_data, len[i]);
+
+        /* runs, long matches with length extension */
+        memset(_data, 0x5A, len[i]);
+        _round_trip(_data, len[i]);
+    }
+
+    /* blog data has to shrink, it is why the download compresses */
+    _blog_data(_data, DATA_LEN);
+    TEST_CHECK(_round_trip(_data, DATA_LEN) < DATA_LEN * 3 / 4);
+}
+
+/* blocks bounded by dst_cap, each decodes on its own and they continue at consumed */
+static void test_bounded(void)
+{
+    static const uint32_t cap[] = { 1, 2, 5, 17, 64, 233, 1000 };
+
+    srand(41);
+
+    for (int kind = 0; kind < 2; kind++) {
+        if (kind == 0) {
+            _random_data(_data, DATA_LEN);
+        } else {
+            _blog_data(_data, DATA_LEN);
+        }
+
+        for (int i = 0; i < sizeof(cap) / sizeof(cap[0]); i++) {
+            uint32_t pos = 0;
+            uint32_t blocks = 0;
+
+            while (pos < DATA_LEN && blocks < DATA_LEN) {
+                uint32_t consumed = 0;
+                uint32_t block_len;
+                int32_t out_len;
+
+                memset(_block, GUARD_BYTE, cap[i] + GUARD);
+                block_len = lz_compress(&_data[pos], DATA_LEN - pos, _block, cap[i], &consumed, _hash_table);
+                blocks++;
+
+                TEST_CHECK(block_len <= cap[i]);
+                TEST_CHECK(_block[cap[i]] == GUARD_BYTE);
+                TEST_CHECK(consumed <= DATA_LEN - pos);
+
+                if (cap[i] == 1) {
+                    /* a token alone carries nothing */
+                    TEST_CHECK(consumed == 0);
+                    break;
+                }
+                TEST_CHECK(consumed > 0);
+
+                out_len = lz_decompress(_block, block_len, _out, consumed);
+                TEST_CHECK(out_len == (int32_t)consumed);
+                TEST_CHECK(memcmp(_out, &_data[pos], consumed) == 0);
+
+                if (consumed == 0) {
+                    break;
+                }
+                pos += consumed;
+            }
+
+            TEST_CHECK(cap[i] == 1 || pos == DATA_LEN);
+        }
+    }
+}
+
+static void test_malformed(void)
+{
+    /* literal length beyond the block */
+    static const uint8_t lit_over[] = { 0x50, 'a', 'b' };
+    /* literal length extension cut */
+    static const uint8_t lit_ext_cut[] = { 0xF0, 255 };
+    /* match offset cut */
+    static const uint8_t offset_cut[] = { 0x10, 'a', 0x01 };
+    /* offset 0 */
+    static const uint8_t offset_zero[] = { 0x10, 'a', 0x00, 0x00 };
+    /* offset before the start of the block */
+    static const uint8_t offset_before[] = { 0x10, 'a', 0x02, 0x00 };
+    /* match length extension cut */
+    static const uint8_t match_ext_cut[] = { 0x1F, 'a', 0x01, 0x00, 255 };
+    /* a valid block, 'a' and a match of 19 */
+    static const uint8_t valid[] = { 0x1F, 'a', 0x01, 0x00, 0x00 };
+    int32_t len;
+
+    TEST_CHECK(lz_decompress(lit_over, sizeof(lit_over), _out, DATA_LEN) == -1);
+    TEST_CHECK(lz_decompress(lit_ext_cut, sizeof(lit_ext_cut), _out, DATA_LEN) == -1);
+    TEST_CHECK(lz_decompress(offset_cut, sizeof(offset_cut), _out, DATA_LEN) == -1);
+    TEST_CHECK(lz_decompress(offset_zero, sizeof(offset_zero), _out, DATA_LEN) == -1);
+    TEST_CHECK(lz_decompress(offset_before, sizeof(offset_before), _out, DATA_LEN) == -1);
+    TEST_CHECK(lz_decompress(match_ext_cut, sizeof(match_ext_cut), _out, DATA_LEN) == -1);
+
+    len = lz_decompress(valid, sizeof(valid), _out, DATA_LEN);
+    TEST_CHECK(len == 1 + 15 + LZ_MIN_MATCH);
+    TEST_CHECK(_out[0] == 'a' && _out[len - 1] == 'a');
+    /* output one byte short */
+    TEST_CHECK(lz_decompress(valid, sizeof(valid), _out, len - 1) == -1);
+    TEST_CHECK(lz_decompress(valid, 0, _out, DATA_LEN) == 0);
+
+    /* corrupted and random blocks never write past dst_cap */
+    srand(42);
+    for (int round = 0; round < 20000; round++) {
+        uint32_t block_len = 1 + rand() % 64;
+        uint32_t cap = rand() % 256;
+
+        if (round % 2) {
+            /* a real block with a few bytes changed */
+            _blog_data(_data, 512);
+            block_len = lz_compress(_data, 512, _block, sizeof(_block), &(uint32_t) { 0 }, _hash_table);
+            for (int n = 1 + rand() % 3; n > 0; n--) {
+                _block[rand() % block_len] = (uint8_t)rand();
+            }
+            cap = 512;
+        } else {
+            _random_data(_block, block_len);
+        }
+
+        memset(_out, GUARD_BYTE, sizeof(_out));
+        len = lz_decompress(_block, block_len, _out, cap);
+        TEST_CHECK(len >= -1 && len <= (int32_t)cap);
+        TEST_CHECK(_out[cap] == GUARD_BYTE);
+        if (host_test_fail) {
+            break;
+        }
+    }
+}
+
+/* chunk of ftp_log_pack_chunk back to file bytes, as log_download.py does */
+static void _check_chunk(const uint8_t* raw, const FTP_Msg_Payload* payload, uint32_t chunk_raw_len)
+{
+    FTP_Log_Chunk_Header header;
+    const uint8_t* data = (const uint8_t*)&payload->data[sizeof(header)];
+    uint32_t data_len = payload->size - sizeof(header);
+
+    memcpy(&header, payload->data, sizeof(header));
+
+    TEST_CHECK(payload->size <= MAX_FTP_DATA_LEN);
+    TEST_CHECK(header.raw_len == chunk_raw_len);
+    TEST_CHECK(header.crc32 == math_crc32(0, raw, header.raw_len));
+
+    if (header.method == kLogChunkLz) {
+        TEST_CHECK(lz_decompress(data, data_len, _out, sizeof(_out)) == header.raw_len);
+    } else {
+        TEST_CHECK(header.method == kLogChunkRaw);
+        TEST_CHECK(data_len == header.raw_len);
+        memcpy(_out, data, data_len);
+    }
+
+    TEST_CHECK(memcmp(_out, raw, header.raw_len) == 0);
+}
+
+static void test_pack_chunk(void)
+{
+    FTP_Msg_Payload* payload;
+    static uint8_t buf[sizeof(FTP_Msg_Payload) + MAX_FTP_DATA_LEN];
+    const uint32_t cap = MAX_FTP_DATA_LEN - sizeof(FTP_Log_Chunk_Header);
+    uint32_t chunk_raw_len;
+
+    payload = (FTP_Msg_Payload*)buf;
+    srand(43);
+
+    /* compressible, the chunk carries more file bytes than it has room for */
+    _blog_data(_data, FTP_LOG_CHUNK_RAW_MAX);
+    TEST_CHECK(ftp_log_pack_chunk(_data, FTP_LOG_CHUNK_RAW_MAX, payload, &chunk_raw_len) == kErrNone);
+    TEST_CHECK(payload->data[6] == kLogChunkLz);
+    TEST_CHECK(chunk_raw_len > cap);
+    _check_chunk(_data, payload, chunk_raw_len);
+
+    /* incompressible, sent raw */
+    _random_data(_data, FTP_LOG_CHUNK_RAW_MAX);
+    TEST_CHECK(ftp_log_pack_chunk(_data, FTP_LOG_CHUNK_RAW_MAX, payload, &chunk_raw_len) == kErrNone);
+    TEST_CHECK(payload->data[6] == kLogChunkRaw);
+    TEST_CHECK(chunk_raw_len == cap);
+    _check_chunk(_data, payload, chunk_raw_len);
+
+    /* tail of a file, shorter than a chunk */
+    for (uint32_t len = 1; len < 300; len += 37) {
+        TEST_CHECK(ftp_log_pack_chunk(_data, len, payload, &chunk_raw_len) == kErrNone);
+        TEST_CHECK(chunk_raw_len == (len < cap ? len : cap));
+        _check_chunk(_data, payload, chunk_raw_len);
+    }
+
+    TEST_CHECK(ftp_log_pack_chunk(_data, 0, payload, &chunk_raw_len) == kErrEOF);
+}
+
+int main(void)
+{
+    TEST_RUN(test_round_trip);
+    TEST_RUN(test_bounded);
+    TEST_RUN(test_malformed);
+    TEST_RUN(test_pack_chunk);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,173 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * Tests of the LU kernels of module/Math/matrix.c and the light_matrix
+ * determinant and inverse built on them, up to and past MATRIX_MAX_DIM.
+ */
+// host_test: src/module/Math/matrix.c src/module/Math/light_matrix.c
+// host_test: src/lib/STM_Lib/CMSIS/DSP_Lib/Source/BasicMathFunctions/arm_add_f32.c
+// host_test: src/lib/STM_Lib/CMSIS/DSP_Lib/Source/BasicMathFunctions/arm_sub_f32.c
+// host_test: src/lib/STM_Lib/CMSIS/DSP_Lib/Source/BasicMathFunctions/arm_dot_prod_f32.c
+// host_test: src/lib/STM_Lib/CMSIS/DSP_Lib/Source/MatrixFunctions/arm_mat_mult_f32.c
+
+#include <firmament.h>
+#include <stdlib.h>
+
+#include "host_test.h"
+#include "module/math/light_matrix.h"
+#include "module/math/matrix.h"
+
+#define N_MAX (MATRIX_MAX_DIM + 1)
+
+void* rt_malloc(rt_size_t size)
+{
+    return malloc(size);
+}
+
+void rt_free(void* ptr)
+{
+    free(ptr);
+}
+
+/* upper triangular with a known determinant, mixed with row swaps and row
+ * additions which keep it up to the sign */
+static float _fill(float* a, uint8_t n)
+{
+    float det = 1.0f;
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            a[i * n + j] = (j > i) ? 0.25f * (1 + (i + j) % 3) : 0.0f;
+        }
+        a[i * n + i] = 1.0f + 0.5f * i;
+        det *= a[i * n + i];
+    }
+    for (int i = 1; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            a[i * n + j] += 0.5f * a[(i - 1) * n + j];
+        }
+    }
+    if (n > 1) {
+        for (int j = 0; j < n; j++) {
+            float t = a[j];
+            a[j] = a[(n - 1) * n + j];
+            a[(n - 1) * n + j] = t;
+        }
+        det = -det;
+    }
+
+    return det;
+}
+
+static void test_det(void)
+{
+    float a[MATRIX_MAX_DIM * MATRIX_MAX_DIM];
+    Mat m;
+
+    for (uint8_t n = 1; n <= MATRIX_MAX_DIM; n++) {
+        float det = _fill(a, n);
+
+        MatCreate(&m, n, n);
+        MatSetVal(&m, a);
+        TEST_CHECK_NEAR(matrix_det(a, n), det, 1e-4 * fabs(det));
+        TEST_CHECK_NEAR(MatDet(&m), det, 1e-4 * fabs(det));
+        MatDelete(&m);
+    }
+}
+
+static void test_inv(void)
+{
+    float a[MATRIX_MAX_DIM * MATRIX_MAX_DIM], inv[MATRIX_MAX_DIM * MATRIX_MAX_DIM];
+    float eye[MATRIX_MAX_DIM * MATRIX_MAX_DIM];
+    Mat m, mi;
+
+    for (uint8_t n = 1; n <= MATRIX_MAX_DIM; n++) {
+        _fill(a, n);
+
+        TEST_CHECK(matrix_inv(a, inv, n) == FMT_EOK);
+        matrix_mul(a, inv, eye, n, n, n);
+        for (int i = 0; i < n * n; i++) {
+            TEST_CHECK_NEAR(eye[i], (i % (n + 1)) == 0 ? 1.0 : 0.0, 1e-4);
+        }
+
+        MatCreate(&m, n, n);
+        MatCreate(&mi, n, n);
+        MatSetVal(&m, a);
+        TEST_CHECK(MatInv(&m, &mi) == &mi);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                TEST_CHECK_NEAR(mi.element[i][j], inv[i * n + j], 1e-5);
+            }
+        }
+        MatDelete(&m);
+        MatDelete(&mi);
+    }
+}
+
+static void test_singular(void)
+{
+    float a[9] = { 1, 2, 3, 2, 4, 6, 0, 1, 1 };
+    float inv[9];
+    Mat m, mi;
+
+    TEST_CHECK(matrix_det(a, 3) == 0.0f);
+    TEST_CHECK(matrix_inv(a, inv, 3) != FMT_EOK);
+
+    MatCreate(&m, 3, 3);
+    MatCreate(&mi, 3, 3);
+    MatSetVal(&m, a);
+    TEST_CHECK(MatDet(&m) == 0.0f);
+    TEST_CHECK(MatInv(&m, &mi) == NULL);
+    MatDelete(&m);
+    MatDelete(&mi);
+}
+
+/* past MATRIX_MAX_DIM there is no result, and it must not read as singular */
+static void test_limit(void)
+{
+    static float a[N_MAX * N_MAX], inv[N_MAX * N_MAX], b[N_MAX], x[N_MAX];
+    Mat m, mi;
+
+    _fill(a, N_MAX);
+
+    TEST_CHECK(isnan(matrix_det(a, N_MAX)));
+    TEST_CHECK(matrix_inv(a, inv, N_MAX) == FMT_EINVAL);
+    TEST_CHECK(matrix_solve(a, b, x, N_MAX) == FMT_EINVAL);
+
+    MatCreate(&m, N_MAX, N_MAX);
+    MatCreate(&mi, N_MAX, N_MAX);
+    MatSetVal(&m, a);
+    TEST_CHECK(isnan(MatDet(&m)));
+    TEST_CHECK(MatInv(&m, &mi) == NULL);
+    MatDelete(&m);
+    MatDelete(&mi);
+
+    /* not square */
+    MatCreate(&m, 3, 4);
+    TEST_CHECK(isnan(MatDet(&m)));
+    MatDelete(&m);
+}
+
+int main(void)
+{
+    TEST_RUN(test_det);
+    TEST_RUN(test_inv);
+    TEST_RUN(test_singular);
+    TEST_RUN(test_limit);
+
+    return TEST_RESULT();
+}
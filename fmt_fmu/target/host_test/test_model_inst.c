@@ -0,0 +1,149 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * Instances of module/System/model_inst.c on the Controller codegen: two
+ * instances stepped interleaved on different inputs give bit for bit the
+ * outputs of two single instance runs, one after the other.
+ */
+// host_test: src/module/System/model_inst.c src/module/System/perf.c
+// host_test: src/module/Controller/controller_model.c src/module/Controller/codegen/Controller.c
+// host_test: src/module/Controller/codegen/Controller_data.c
+// host_test: src/lib/STM_Lib/CMSIS/DSP_Lib/Source/FastMathFunctions/arm_sin_f32.c
+// host_test: src/lib/STM_Lib/CMSIS/DSP_Lib/Source/FastMathFunctions/arm_cos_f32.c
+// host_test: src/lib/STM_Lib/CMSIS/DSP_Lib/Source/CommonTables/arm_common_tables.c
+
+#include <Controller.h>
+#include <firmament.h>
+#include <stdlib.h>
+
+#include "host_test.h"
+#include "module/controller/controller_model.h"
+#include "module/system/model_inst.h"
+
+#define STEP_NUM 2000
+
+/* the other topics of controller_model.c */
+MCN_DEFINE(fms_output, sizeof(FMS_Out_Bus));
+MCN_DEFINE(ins_output, sizeof(INS_Out_Bus));
+MCN_DEFINE(control_param, sizeof(CONTROL_PARAM));
+
+static Control_Out_Bus _ref[2][STEP_NUM];
+
+void* rt_malloc(rt_size_t size)
+{
+    return malloc(size);
+}
+
+void rt_free(void* ptr)
+{
+    free(ptr);
+}
+
+/* instance 0 flies position mode, instance 1 manual mode, on other motion */
+static void _input(int id, int k)
+{
+    float t = k * 0.004f;
+    float w = id ? 3.1f : 1.7f;
+
+    memset(&Controller_U, 0, sizeof(Controller_U));
+
+    Controller_U.FMS_Out.timestamp = k * 4;
+    Controller_U.FMS_Out.state = 2;
+    Controller_U.FMS_Out.mode = id ? 4 : 2;
+    Controller_U.FMS_Out.u_cmd = 2.0f * sinf(w * t);
+    Controller_U.FMS_Out.v_cmd = 1.0f * cosf(w * t);
+    Controller_U.FMS_Out.w_cmd = -0.5f;
+    Controller_U.FMS_Out.phi_cmd = 0.2f * sinf(w * t);
+    Controller_U.FMS_Out.theta_cmd = -0.1f * cosf(w * t);
+    Controller_U.FMS_Out.psi_rate_cmd = 0.3f;
+    Controller_U.FMS_Out.throttle_cmd = 1400 + id * 100;
+
+    Controller_U.INS_Out.timestamp = k * 4;
+    Controller_U.INS_Out.phi = 0.05f * sinf(2.0f * w * t);
+    Controller_U.INS_Out.theta = 0.04f * cosf(2.0f * w * t);
+    Controller_U.INS_Out.psi = 0.5f * t;
+    Controller_U.INS_Out.p = 0.1f * cosf(2.0f * w * t);
+    Controller_U.INS_Out.q = -0.08f * sinf(2.0f * w * t);
+    Controller_U.INS_Out.r = 0.02f;
+    Controller_U.INS_Out.vn = 1.5f * sinf(0.5f * w * t);
+    Controller_U.INS_Out.ve = 0.5f;
+    Controller_U.INS_Out.vd = 0.2f * cosf(w * t);
+}
+
+/* each instance alone, the way a single instance build runs it */
+static void _reference(void)
+{
+    for (int id = 0; id < 2; id++) {
+        Controller_init();
+
+        for (int k = 0; k < STEP_NUM; k++) {
+            _input(id, k);
+            Controller_step();
+            _ref[id][k] = Controller_Y.Control_Out;
+        }
+    }
+}
+
+static void test_interleaved(void)
+{
+    model_inst_t inst[2];
+    int step[2] = { 0, 0 };
+    uint32_t mismatch[2] = { 0, 0 };
+    uint32_t n = 0;
+
+    TEST_CHECK(model_inst_create(&inst[0], MODEL_CLASS_ID(Controller)) == FMT_EOK);
+    TEST_CHECK(model_inst_create(&inst[1], MODEL_CLASS_ID(Controller)) == FMT_EOK);
+
+    /* irregular order, an instance runs up to 3 steps before the other */
+    while (step[0] < STEP_NUM || step[1] < STEP_NUM) {
+        int id = ((n * 7) % 5) < 3 ? 0 : 1;
+
+        n++;
+        if (step[id] == STEP_NUM) {
+            id = !id;
+        }
+
+        model_inst_switch(&inst[id]);
+        _input(id, step[id]);
+        Controller_step();
+
+        if (memcmp(&Controller_Y.Control_Out, &_ref[id][step[id]], sizeof(Control_Out_Bus)) != 0) {
+            mismatch[id]++;
+        }
+        step[id]++;
+    }
+
+    TEST_CHECK(mismatch[0] == 0);
+    TEST_CHECK(mismatch[1] == 0);
+    TEST_CHECK(MODEL_CLASS_ID(Controller)->inst_num == 2);
+}
+
+/* otherwise the check above would pass on a shared state */
+static void test_outputs_differ(void)
+{
+    TEST_CHECK(memcmp(&_ref[0][STEP_NUM - 1], &_ref[1][STEP_NUM - 1], sizeof(Control_Out_Bus)) != 0);
+}
+
+int main(void)
+{
+    _reference();
+
+    TEST_RUN(test_interleaved);
+    TEST_RUN(test_outputs_differ);
+
+    return TEST_RESULT();
+}
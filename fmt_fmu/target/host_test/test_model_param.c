@@ -0,0 +1,192 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * CONTROL and FMS params of module/Parameter/model_param.c reaching the
+ * CONTROL_PARAM and FMS_PARAM structs of the codegen models: a set param
+ * leaves the struct alone until the next step of the model wrapper, which
+ * copies the whole table in.
+ */
+// host_test: src/module/Parameter/param.c src/module/Parameter/model_param.c src/module/IPC/uMCN.c
+// host_test: src/module/System/model_inst.c src/module/System/perf.c
+// host_test: src/lib/STM_Lib/CMSIS/DSP_Lib/Source/FastMathFunctions/arm_sin_f32.c
+// host_test: src/lib/STM_Lib/CMSIS/DSP_Lib/Source/FastMathFunctions/arm_cos_f32.c
+// host_test: src/lib/STM_Lib/CMSIS/DSP_Lib/Source/CommonTables/arm_common_tables.c
+// host_test: src/module/Controller/controller_model.c src/module/Controller/codegen/Controller.c
+// host_test: src/module/Controller/codegen/Controller_data.c
+// host_test: src/module/FMS/fms_model.c src/module/FMS/codegen/FMS.c src/module/FMS/codegen/FMS_data.c
+
+#include <Controller.h>
+#include <FMS.h>
+#include <firmament.h>
+#include <stdlib.h>
+
+#include "host_test.h"
+#include "module/controller/controller_model.h"
+#include "module/fms/fms_model.h"
+#include "module/param/model_param.h"
+
+MCN_DECLARE(control_param);
+
+/* inputs of the models, published by INS and the pilot on board */
+MCN_DEFINE(ins_output, sizeof(INS_Out_Bus));
+MCN_DEFINE(pilot_cmd, sizeof(Pilot_Cmd_Bus));
+
+void* rt_malloc(rt_size_t size)
+{
+    return malloc(size);
+}
+
+void rt_free(void* ptr)
+{
+    free(ptr);
+}
+
+rt_err_t rt_mutex_init(rt_mutex_t mutex, const char* name, rt_uint8_t flag)
+{
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
+{
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_release(rt_mutex_t mutex)
+{
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_release(rt_sem_t sem)
+{
+    return RT_EOK;
+}
+
+void ulog_output(rt_uint32_t level, const char* tag, rt_bool_t newline, const char* format, ...)
+{
+}
+
+uint8_t check_timetag(TimeTag* timetag)
+{
+    return 0;
+}
+
+fmt_err blog_push_msg(const uint8_t* payload, uint8_t msg_id, uint16_t len)
+{
+    return FMT_EOK;
+}
+
+static void _set(char* group, char* name, float val)
+{
+    param_t* param = param_get(group, name);
+
+    TEST_CHECK(param != NULL);
+    if (param) {
+        TEST_CHECK(param_set_val(param, &val) == FMT_EOK);
+    }
+}
+
+static float _get(char* group, char* name)
+{
+    param_t* param = param_get(group, name);
+
+    TEST_CHECK(param != NULL);
+    return param ? param->val.f : NAN;
+}
+
+/* the groups start at the codegen defaults */
+static void test_defaults(void)
+{
+    TEST_CHECK(_get("CONTROL", "VEL_XY_P") == CONTROL_PARAM.VEL_XY_P);
+    TEST_CHECK(_get("CONTROL", "RP_CMD_LIM") == CONTROL_PARAM.ROLL_PITCH_CMD_LIM);
+    TEST_CHECK(_get("CONTROL", "ROLL_RATE_P") == CONTROL_PARAM.ROLL_RATE_P);
+    TEST_CHECK(_get("CONTROL", "RATE_D_MAX") == CONTROL_PARAM.RATE_D_MAX);
+    TEST_CHECK(_get("FMS", "STICK_DEADZONE") == FMS_PARAM.StickDeadZone);
+    TEST_CHECK(_get("FMS", "ROLL_PITCH_LIM") == FMS_PARAM.ROLL_PITCH_LIM);
+    TEST_CHECK(CONTROL_PARAM.ROLL_RATE_P != 0.0f);
+}
+
+static void test_control(void)
+{
+    float roll_rate_p = CONTROL_PARAM.ROLL_RATE_P;
+    float rp_rate_lim = CONTROL_PARAM.ROLL_PITCH_RATE_CMD_LIM;
+
+    controller_model_step();
+
+    _set("CONTROL", "ROLL_RATE_P", 2.0f * roll_rate_p);
+    _set("CONTROL", "RP_RATE_CMD_LIM", 0.5f * rp_rate_lim);
+    TEST_CHECK(param_set_string_val(param_get("CONTROL", "RATE_D_MAX"), "0.125") == FMT_EOK);
+
+    /* no change in the middle of the step period */
+    TEST_CHECK(CONTROL_PARAM.ROLL_RATE_P == roll_rate_p);
+    TEST_CHECK(CONTROL_PARAM.ROLL_PITCH_RATE_CMD_LIM == rp_rate_lim);
+
+    controller_model_step();
+
+    TEST_CHECK(CONTROL_PARAM.ROLL_RATE_P == 2.0f * roll_rate_p);
+    TEST_CHECK(CONTROL_PARAM.ROLL_PITCH_RATE_CMD_LIM == 0.5f * rp_rate_lim);
+    TEST_CHECK(CONTROL_PARAM.RATE_D_MAX == 0.125f);
+
+    /* the rest of the table is untouched */
+    TEST_CHECK(CONTROL_PARAM.PITCH_RATE_P == _get("CONTROL", "PITCH_RATE_P"));
+    TEST_CHECK(CONTROL_PARAM.VEL_XY_P == _get("CONTROL", "VEL_XY_P"));
+}
+
+static void test_fms(void)
+{
+    float yaw_p = FMS_PARAM.YAW_P;
+
+    fms_model_step();
+
+    _set("FMS", "STICK_DEADZONE", 0.2f);
+    _set("FMS", "YAW_P", yaw_p + 1.0f);
+
+    TEST_CHECK(FMS_PARAM.YAW_P == yaw_p);
+
+    fms_model_step();
+
+    TEST_CHECK(FMS_PARAM.StickDeadZone == 0.2f);
+    TEST_CHECK(FMS_PARAM.YAW_P == yaw_p + 1.0f);
+}
+
+/* a param of another group publishes no table */
+static void test_other_group(void)
+{
+    McnNode_t node = mcn_subscribe(MCN_ID(control_param), NULL, NULL);
+    param_t* param = param_get("CALIB", "ACC0_XOFF");
+    float val = 0.1f;
+
+    TEST_CHECK(param != NULL);
+    TEST_CHECK(param_set_val(param, &val) == FMT_EOK);
+    TEST_CHECK(!mcn_poll(node));
+
+    _set("CONTROL", "YAW_RATE_P", 0.3f);
+    TEST_CHECK(mcn_poll(node));
+}
+
+int main(void)
+{
+    TEST_CHECK(model_param_init() == FMT_EOK);
+    TEST_CHECK(controller_model_init() == FMT_EOK);
+    TEST_CHECK(fms_model_init() == FMT_EOK);
+
+    TEST_RUN(test_defaults);
+    TEST_RUN(test_control);
+    TEST_RUN(test_fms);
+    TEST_RUN(test_other_group);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,361 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * ring_spsc and ring_mpsc of module/utils/ring.h, single threaded and with
+ * real producer and consumer threads, and the locked byte ring of
+ * module/Utils/ringbuffer.c on top of it.
+ */
+// host_test: src/module/Utils/ringbuffer.c
+
+#include <firmament.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+#include "host_test.h"
+#include "module/utils/ring.h"
+#include "module/utils/ringbuffer.h"
+
+#define THREAD_BYTES   (4 * 1024 * 1024)
+#define PRODUCER_NUM   4
+#define PRODUCER_ELEMS (256 * 1024)
+
+static int _lock_depth;
+static int _lock_count;
+
+void rt_enter_critical(void)
+{
+    _lock_depth++;
+    _lock_count++;
+}
+
+void rt_exit_critical(void)
+{
+    _lock_depth--;
+}
+
+void* rt_malloc(rt_size_t size)
+{
+    return malloc(size);
+}
+
+void rt_free(void* ptr)
+{
+    free(ptr);
+}
+
+static void test_spsc_copy(void)
+{
+    ring_spsc r;
+    uint8_t buff[16];
+    uint8_t in[32], out[32];
+
+    TEST_CHECK(ring_spsc_init(&r, buff, 12, 1) != 0);
+    TEST_CHECK(ring_spsc_init(&r, buff, 16, 0) != 0);
+    TEST_CHECK(ring_spsc_init(&r, buff, 16, 1) == 0);
+    TEST_CHECK(ring_spsc_capacity(&r) == 16);
+
+    for (int i = 0; i < 32; i++) {
+        in[i] = i;
+    }
+
+    /* all slots are usable */
+    TEST_CHECK(ring_spsc_put(&r, in, 32) == 16);
+    TEST_CHECK(ring_spsc_space(&r) == 0 && ring_spsc_count(&r) == 16);
+    TEST_CHECK(ring_spsc_put(&r, in, 1) == 0);
+    TEST_CHECK(ring_spsc_get(&r, out, 10) == 10);
+    TEST_CHECK(memcmp(out, in, 10) == 0);
+
+    /* wrap around the end */
+    TEST_CHECK(ring_spsc_put(&r, &in[16], 10) == 10);
+    TEST_CHECK(ring_spsc_get(&r, out, 32) == 16);
+    TEST_CHECK(memcmp(out, &in[10], 16) == 0);
+    TEST_CHECK(ring_spsc_get(&r, out, 1) == 0);
+
+    /* free running indexes wrap over 2^32 */
+    r.head = r.tail = 0xFFFFFFF8;
+    TEST_CHECK(ring_spsc_put(&r, in, 16) == 16);
+    TEST_CHECK(ring_spsc_count(&r) == 16);
+    TEST_CHECK(ring_spsc_get(&r, out, 16) == 16);
+    TEST_CHECK(memcmp(out, in, 16) == 0);
+
+    ring_spsc_put(&r, in, 5);
+    ring_spsc_flush(&r);
+    TEST_CHECK(ring_spsc_count(&r) == 0 && ring_spsc_space(&r) == 16);
+}
+
+static void test_spsc_span(void)
+{
+    ring_spsc r;
+    uint32_t buff[8];
+    uint32_t* p;
+
+    ring_spsc_init(&r, buff, 8, sizeof(uint32_t));
+
+    /* span is cut at the end of the buffer */
+    r.head = r.tail = 5;
+    TEST_CHECK(ring_spsc_reserve(&r, (void**)&p) == 3);
+    TEST_CHECK(p == &buff[5]);
+    p[0] = 50;
+    p[1] = 60;
+    ring_spsc_commit(&r, 2);
+
+    TEST_CHECK(ring_spsc_reserve(&r, (void**)&p) == 1);
+    p[0] = 70;
+    ring_spsc_commit(&r, 1);
+    TEST_CHECK(ring_spsc_reserve(&r, (void**)&p) == 5);
+    TEST_CHECK(p == &buff[0]);
+
+    TEST_CHECK(ring_spsc_peek(&r, (void**)&p) == 3);
+    TEST_CHECK(p[0] == 50 && p[1] == 60 && p[2] == 70);
+    ring_spsc_consume(&r, 3);
+    TEST_CHECK(ring_spsc_peek(&r, (void**)&p) == 0);
+
+    /* full ring has nothing to reserve */
+    for (int i = 0; i < 8; i++) {
+        uint32_t v = i;
+        ring_spsc_put(&r, &v, 1);
+    }
+    TEST_CHECK(ring_spsc_reserve(&r, (void**)&p) == 0);
+}
+
+static void test_mpsc_order(void)
+{
+    ring_mpsc r;
+    uint16_t buff[4];
+    uint32_t seq[4];
+    uint16_t v;
+
+    TEST_CHECK(ring_mpsc_init(&r, buff, seq, 3, sizeof(v)) != 0);
+    TEST_CHECK(ring_mpsc_init(&r, buff, seq, 4, sizeof(v)) == 0);
+    TEST_CHECK(ring_mpsc_pop(&r, &v) == 1);
+
+    for (v = 0; v < 4; v++) {
+        TEST_CHECK(ring_mpsc_push(&r, &v) == 0);
+    }
+    TEST_CHECK(ring_mpsc_push(&r, &v) == 1);
+
+    for (uint16_t i = 0; i < 10; i++) {
+        TEST_CHECK(ring_mpsc_pop(&r, &v) == 0 && v == i);
+        v = i + 4;
+        TEST_CHECK(ring_mpsc_push(&r, &v) == 0);
+    }
+}
+
+/* a producer preempted between claim and publish holds back the slots
+ * claimed after its own */
+static void test_mpsc_stall(void)
+{
+    ring_mpsc r;
+    uint16_t buff[4];
+    uint32_t seq[4];
+    uint16_t v = 7;
+    uint32_t claimed;
+
+    ring_mpsc_init(&r, buff, seq, 4, sizeof(v));
+
+    /* first producer claims slot 0 and is preempted */
+    claimed = r.head;
+    r.head = claimed + 1;
+
+    /* second producer is not blocked */
+    TEST_CHECK(ring_mpsc_push(&r, &v) == 0);
+    /* but the consumer is */
+    TEST_CHECK(ring_mpsc_peek(&r) == NULL);
+
+    /* first producer resumes */
+    buff[claimed & r.mask] = 3;
+    RING_STORE_RELEASE(&r.seq[claimed & r.mask], claimed + 1);
+
+    TEST_CHECK(ring_mpsc_pop(&r, &v) == 0 && v == 3);
+    TEST_CHECK(ring_mpsc_pop(&r, &v) == 0 && v == 7);
+    TEST_CHECK(ring_mpsc_pop(&r, &v) == 1);
+}
+
+static ring_spsc _spsc;
+static uint8_t _spsc_buff[256];
+
+static void* _spsc_producer(void* arg)
+{
+    uint8_t chunk[61];
+    uint32_t sent = 0;
+    uint32_t n, i;
+    uint8_t* p;
+
+    (void)arg;
+
+    while (sent < THREAD_BYTES) {
+        /* copy in and reserve/commit by turns, in odd sizes */
+        if (sent & 1) {
+            n = 1 + sent % sizeof(chunk);
+            n = n < THREAD_BYTES - sent ? n : THREAD_BYTES - sent;
+            for (i = 0; i < n; i++) {
+                chunk[i] = (uint8_t)(sent + i);
+            }
+            n = ring_spsc_put(&_spsc, chunk, n);
+            sent += n;
+        } else {
+            n = ring_spsc_reserve(&_spsc, (void**)&p);
+            n = n < THREAD_BYTES - sent ? n : THREAD_BYTES - sent;
+            for (i = 0; i < n; i++) {
+                p[i] = (uint8_t)(sent + i);
+            }
+            ring_spsc_commit(&_spsc, n);
+            sent += n;
+        }
+        if (n == 0) {
+            /* full, let the consumer run on a single core host */
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static void test_spsc_threads(void)
+{
+    pthread_t producer;
+    uint8_t chunk[47];
+    uint32_t recv = 0, bad = 0;
+    uint32_t n, i;
+    uint8_t* p;
+
+    ring_spsc_init(&_spsc, _spsc_buff, sizeof(_spsc_buff), 1);
+    pthread_create(&producer, NULL, _spsc_producer, NULL);
+
+    while (recv < THREAD_BYTES) {
+        if (recv & 1) {
+            n = ring_spsc_get(&_spsc, chunk, 1 + recv % sizeof(chunk));
+            p = chunk;
+        } else {
+            n = ring_spsc_peek(&_spsc, (void**)&p);
+        }
+        for (i = 0; i < n; i++) {
+            bad += p[i] != (uint8_t)(recv + i);
+        }
+        if (!(recv & 1)) {
+            ring_spsc_consume(&_spsc, n);
+        }
+        if (n == 0) {
+            sched_yield();
+        }
+        recv += n;
+    }
+
+    pthread_join(producer, NULL);
+
+    TEST_CHECK(bad == 0);
+    TEST_CHECK(ring_spsc_count(&_spsc) == 0);
+}
+
+typedef struct {
+    uint32_t id;
+    uint32_t n;
+} elem_t;
+
+static ring_mpsc _mpsc;
+static elem_t _mpsc_buff[64];
+static uint32_t _mpsc_seq[64];
+
+static void* _mpsc_producer(void* arg)
+{
+    elem_t e = { (uint32_t)(uintptr_t)arg, 0 };
+
+    while (e.n < PRODUCER_ELEMS) {
+        if (ring_mpsc_push(&_mpsc, &e) == 0) {
+            e.n++;
+        } else {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static void test_mpsc_threads(void)
+{
+    pthread_t producer[PRODUCER_NUM];
+    uint32_t next[PRODUCER_NUM] = { 0 };
+    uint32_t recv = 0, bad = 0;
+    elem_t e;
+
+    ring_mpsc_init(&_mpsc, _mpsc_buff, _mpsc_seq, 64, sizeof(elem_t));
+
+    for (uintptr_t i = 0; i < PRODUCER_NUM; i++) {
+        pthread_create(&producer[i], NULL, _mpsc_producer, (void*)i);
+    }
+
+    while (recv < PRODUCER_NUM * PRODUCER_ELEMS) {
+        if (ring_mpsc_pop(&_mpsc, &e)) {
+            sched_yield();
+            continue;
+        }
+        /* each producer's elements arrive complete and in order */
+        if (e.id >= PRODUCER_NUM || e.n != next[e.id]) {
+            bad++;
+        } else {
+            next[e.id]++;
+        }
+        recv++;
+    }
+
+    for (int i = 0; i < PRODUCER_NUM; i++) {
+        pthread_join(producer[i], NULL);
+    }
+
+    TEST_CHECK(bad == 0);
+    TEST_CHECK(ring_mpsc_pop(&_mpsc, &e) == 1);
+}
+
+static void test_ringbuffer(void)
+{
+    uint8_t buff[64];
+    uint8_t out[64];
+    ringbuffer* rb;
+
+    TEST_CHECK(ringbuffer_static_create(buff, 60) == NULL);
+    rb = ringbuffer_static_create(buff, sizeof(buff));
+    TEST_CHECK(rb != NULL);
+
+    _lock_count = 0;
+    TEST_CHECK(ringbuffer_put(rb, (const uint8_t*)"0123456789", 10) == 10);
+    TEST_CHECK(ringbuffer_putc(rb, 'a') == 1);
+    TEST_CHECK(ringbuffer_getlen(rb) == 11);
+    TEST_CHECK(ringbuffer_getc(rb) == '0');
+    TEST_CHECK(ringbuffer_get(rb, out, sizeof(out)) == 10);
+    TEST_CHECK(memcmp(out, "123456789a", 10) == 0);
+    ringbuffer_flush(rb);
+
+    /* every operation which moves an index holds the lock */
+    TEST_CHECK(_lock_count == 5);
+    TEST_CHECK(_lock_depth == 0);
+
+    ringbuffer_delete(rb);
+}
+
+int main(void)
+{
+    TEST_RUN(test_spsc_copy);
+    TEST_RUN(test_spsc_span);
+    TEST_RUN(test_mpsc_order);
+    TEST_RUN(test_mpsc_stall);
+    TEST_RUN(test_spsc_threads);
+    TEST_RUN(test_mpsc_threads);
+    TEST_RUN(test_ringbuffer);
+
+    return TEST_RESULT();
+}
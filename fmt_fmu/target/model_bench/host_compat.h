@@ -0,0 +1,36 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+#ifndef __HOST_COMPAT_H__
+#define __HOST_COMPAT_H__
+
+/*
+ * Force included when the models are built for a LP64 host.
+ *
+ * The codegen checks long is 32 bit as on the target. The models only use
+ * the fixed size types of rtwtypes.h, so the check is satisfied here instead
+ * of building for a 32 bit host.
+ */
+#include <limits.h>
+
+#if ULONG_MAX != 0xFFFFFFFFU
+#undef ULONG_MAX
+#define ULONG_MAX 0xFFFFFFFFU
+#undef LONG_MAX
+#define LONG_MAX 0x7FFFFFFF
+#endif
+
+#endif
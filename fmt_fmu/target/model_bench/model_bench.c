@@ -0,0 +1,293 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * Host benchmark of one generated model, built by model_bench.py with one of
+ * BENCH_INS, BENCH_FMS, BENCH_CONTROLLER or BENCH_PLANT defined.
+ *
+ * The model inputs are fed from a replay file extracted from a BLog file,
+ * each record is | bus(1) | len(2) | payload(len) |. A REPLAY_STEP record
+ * runs one model step. Without replay file the model steps on its initial
+ * inputs.
+ *
+ * The model source is instrumented by model_bench.py, bench_probe(id) is
+ * called where a top level subsystem begins, so step time can be split
+ * into subsystems.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#if defined(BENCH_INS)
+#include <INS.h>
+#define MODEL_NAME "INS"
+#define MODEL_INIT INS_init
+#define MODEL_STEP INS_step
+#elif defined(BENCH_FMS)
+#include <FMS.h>
+#define MODEL_NAME "FMS"
+#define MODEL_INIT FMS_init
+#define MODEL_STEP FMS_step
+#elif defined(BENCH_CONTROLLER)
+#include <Controller.h>
+#define MODEL_NAME "Controller"
+#define MODEL_INIT Controller_init
+#define MODEL_STEP Controller_step
+#elif defined(BENCH_PLANT)
+#include <Plant.h>
+#define MODEL_NAME "Plant"
+#define MODEL_INIT Plant_init
+#define MODEL_STEP Plant_step
+#else
+#error "no model selected"
+#endif
+
+/* keep in sync with REPLAY_BUS in model_bench.py */
+enum {
+    REPLAY_IMU = 0,
+    REPLAY_MAG,
+    REPLAY_BARO,
+    REPLAY_GPS,
+    REPLAY_PILOT_CMD,
+    REPLAY_INS_OUT,
+    REPLAY_FMS_OUT,
+    REPLAY_CONTROL_OUT,
+    REPLAY_BUS_NUM,
+    REPLAY_STEP = 0xFF,
+};
+
+#define BENCH_MAX_PROBE 64
+
+typedef struct {
+    void* dst;
+    size_t size;
+} bench_input_t;
+
+/* generated into the instrumented model source */
+extern const char* bench_probe_name[];
+extern const int bench_probe_num;
+
+static bench_input_t _input[REPLAY_BUS_NUM];
+
+static uint64_t _probe_cycle[BENCH_MAX_PROBE];
+static uint64_t _probe_last;
+static int _probe_cur;
+
+static uint64_t* _step_cycle;
+static uint32_t _step_num;
+static uint32_t _step_cap;
+
+static inline uint64_t _cycle_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/* called inside the step, time until now belongs to the previous probe */
+void bench_probe(int id)
+{
+    uint64_t now = _cycle_now();
+
+    _probe_cycle[_probe_cur] += now - _probe_last;
+    _probe_last = now;
+    _probe_cur = id;
+}
+
+static void _bind_inputs(void)
+{
+#if defined(BENCH_INS)
+    _input[REPLAY_IMU] = (bench_input_t) { &INS_U.IMU1, sizeof(INS_U.IMU1) };
+    _input[REPLAY_MAG] = (bench_input_t) { &INS_U.MAG, sizeof(INS_U.MAG) };
+    _input[REPLAY_BARO] = (bench_input_t) { &INS_U.Barometer, sizeof(INS_U.Barometer) };
+    _input[REPLAY_GPS] = (bench_input_t) { &INS_U.GPS_uBlox, sizeof(INS_U.GPS_uBlox) };
+#elif defined(BENCH_FMS)
+    _input[REPLAY_PILOT_CMD] = (bench_input_t) { &FMS_U.Pilot_Cmd, sizeof(FMS_U.Pilot_Cmd) };
+    _input[REPLAY_INS_OUT] = (bench_input_t) { &FMS_U.INS_Output, sizeof(FMS_U.INS_Output) };
+    _input[REPLAY_CONTROL_OUT] = (bench_input_t) { &FMS_U.Control_Out, sizeof(FMS_U.Control_Out) };
+#elif defined(BENCH_CONTROLLER)
+    _input[REPLAY_FMS_OUT] = (bench_input_t) { &Controller_U.FMS_Out, sizeof(Controller_U.FMS_Out) };
+    _input[REPLAY_INS_OUT] = (bench_input_t) { &Controller_U.INS_Out, sizeof(Controller_U.INS_Out) };
+#elif defined(BENCH_PLANT)
+    _input[REPLAY_CONTROL_OUT] = (bench_input_t) { &Plant_U.Control_Out, sizeof(Plant_U.Control_Out) };
+#endif
+}
+
+static void _step(void)
+{
+    uint64_t start;
+
+    if (_step_num == _step_cap) {
+        _step_cap = _step_cap ? _step_cap * 2 : 4096;
+        _step_cycle = realloc(_step_cycle, _step_cap * sizeof(uint64_t));
+        if (_step_cycle == NULL) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+
+    _probe_cur = 0;
+    start = _cycle_now();
+    _probe_last = start;
+
+    MODEL_STEP();
+
+    bench_probe(0);
+    _step_cycle[_step_num++] = _probe_last - start;
+}
+
+static int _replay(FILE* fp)
+{
+    uint8_t head[3];
+    uint8_t payload[65536];
+    uint16_t len;
+
+    while (fread(head, 1, sizeof(head), fp) == sizeof(head)) {
+        len = head[1] | (head[2] << 8);
+
+        if (fread(payload, 1, len, fp) != len) {
+            fprintf(stderr, "truncated replay record\n");
+            return -1;
+        }
+
+        if (head[0] == REPLAY_STEP) {
+            _step();
+        } else if (head[0] < REPLAY_BUS_NUM && _input[head[0]].dst) {
+            /* sensor bus may carry extra fields appended by logger */
+            memcpy(_input[head[0]].dst, payload, len < _input[head[0]].size ? len : _input[head[0]].size);
+        }
+    }
+
+    return 0;
+}
+
+static int _cmp_cycle(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void _report(void)
+{
+    uint64_t total = 0;
+    uint64_t probe_total = 0;
+    uint64_t worst;
+    uint32_t worst_step = 0;
+
+    if (_step_num == 0) {
+        printf("%s: no step executed\n", MODEL_NAME);
+        return;
+    }
+
+    for (uint32_t i = 0; i < _step_num; i++) {
+        total += _step_cycle[i];
+        if (_step_cycle[i] > _step_cycle[worst_step]) {
+            worst_step = i;
+        }
+    }
+    worst = _step_cycle[worst_step];
+
+    qsort(_step_cycle, _step_num, sizeof(uint64_t), _cmp_cycle);
+
+    /* parsed by model_bench.py, keep the format */
+    printf("model %s\n", MODEL_NAME);
+    printf("steps %u\n", _step_num);
+    printf("min %llu\n", (unsigned long long)_step_cycle[0]);
+    printf("mean %llu\n", (unsigned long long)(total / _step_num));
+    printf("p50 %llu\n", (unsigned long long)_step_cycle[_step_num / 2]);
+    printf("p99 %llu\n", (unsigned long long)_step_cycle[(uint64_t)_step_num * 99 / 100]);
+    printf("max %llu\n", (unsigned long long)worst);
+    printf("worst_step %u\n", worst_step);
+
+    for (int i = 0; i < bench_probe_num; i++) {
+        probe_total += _probe_cycle[i];
+    }
+
+    for (int i = 0; i < bench_probe_num; i++) {
+        if (_probe_cycle[i]) {
+            printf("probe %llu %.1f %s\n", (unsigned long long)(_probe_cycle[i] / _step_num),
+                   100.0 * _probe_cycle[i] / probe_total, bench_probe_name[i]);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int steps = 1000;
+    int repeat = 1;
+    const char* replay = NULL;
+    int opt_i;
+
+    for (opt_i = 1; opt_i < argc; opt_i++) {
+        if (strcmp(argv[opt_i], "-n") == 0 && opt_i + 1 < argc) {
+            steps = atoi(argv[++opt_i]);
+        } else if (strcmp(argv[opt_i], "-r") == 0 && opt_i + 1 < argc) {
+            repeat = atoi(argv[++opt_i]);
+        } else {
+            replay = argv[opt_i];
+        }
+    }
+
+    if (bench_probe_num > BENCH_MAX_PROBE) {
+        fprintf(stderr, "too many probes: %d\n", bench_probe_num);
+        return 1;
+    }
+
+    _bind_inputs();
+
+    for (int r = 0; r < repeat; r++) {
+        /* every pass starts from the initial model state */
+        MODEL_INIT();
+
+        if (replay) {
+            FILE* fp = fopen(replay, "rb");
+
+            if (fp == NULL) {
+                perror(replay);
+                return 1;
+            }
+
+            if (_replay(fp) != 0) {
+                fclose(fp);
+                return 1;
+            }
+
+            fclose(fp);
+        } else {
+            for (int i = 0; i < steps; i++) {
+                _step();
+            }
+        }
+    }
+
+    _report();
+
+    return 0;
+}
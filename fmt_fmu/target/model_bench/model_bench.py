@@ -0,0 +1,424 @@
+#!/usr/bin/env python3
+
+"""
+Profile the generated models (INS, FMS, Controller, Plant) off target.
+
+  footprint  static RAM/ROM of each model data structure, for host and arm
+  doubles    double precision math in the model source and objects
+  bench      run model steps on host over recorded BLog input, report cycles
+             per step, worst case and the share of each top level subsystem
+
+Examples:
+    model_bench.py footprint
+    model_bench.py doubles --model INS
+    model_bench.py bench --log fmt.bin --repeat 5
+"""
+
+from __future__ import print_function
+import os
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+from argparse import ArgumentParser
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+FMU = os.path.abspath(os.path.join(HERE, '..', '..'))
+CMSIS = os.path.join(FMU, 'src', 'lib', 'STM_Lib', 'CMSIS')
+
+MODELS = {
+    'INS': ('src/module/INS/lib', 'INS'),
+    'FMS': ('src/module/FMS/codegen', 'FMS'),
+    'Controller': ('src/module/Controller/codegen', 'Controller'),
+    'Plant': ('src/module/Plant/lib', 'Plant'),
+}
+
+# CMSIS-DSP sources the models call into
+CMSIS_SRC = [
+    'DSP_Lib/Source/FastMathFunctions/arm_sin_f32.c',
+    'DSP_Lib/Source/FastMathFunctions/arm_cos_f32.c',
+    'DSP_Lib/Source/CommonTables/arm_common_tables.c',
+]
+
+COMMON_FLAGS = ['-O2', '-std=gnu99', '-ffunction-sections', '-fdata-sections',
+                '-DARM_MATH_CM4', '-D__FPU_PRESENT=1', '-I' + os.path.join(CMSIS, 'Include')]
+
+# same as target/pixhawk/rtconfig.py
+ARM_PREFIX = 'arm-none-eabi-'
+ARM_FLAGS = ['-mcpu=cortex-m4', '-mthumb', '-mfpu=fpv4-sp-d16', '-mfloat-abi=hard', '-D__VFP_FP__']
+
+HOST_FLAGS = ['-include', os.path.join(HERE, 'host_compat.h')]
+
+# keep in sync with REPLAY_* in model_bench.c
+REPLAY_BUS = ['IMU', 'MAG', 'Barometer', 'GPS_uBlox', 'Pilot_Cmd', 'INS_Out', 'FMS_Out', 'Control_Out']
+REPLAY_STEP = 0xFF
+
+# double precision libm, float versions end with 'f'
+DOUBLE_LIBM = ['sin', 'cos', 'tan', 'asin', 'acos', 'atan', 'atan2', 'sinh', 'cosh', 'tanh', 'sqrt',
+               'exp', 'log', 'log10', 'pow', 'floor', 'ceil', 'fmod', 'fabs', 'hypot', 'round', 'trunc']
+DOUBLE_SRC_RE = re.compile(r'(?<![\w.])(%s|rt_\w*d_snf)\s*\(' % '|'.join(DOUBLE_LIBM))
+# soft double helpers of the arm eabi, every call is a few hundred cycles on M4F
+DOUBLE_HELPER_RE = re.compile(r'^(__aeabi_(d\w+|[iuf]2d|u?l2d)|%s)$' % '|'.join(DOUBLE_LIBM))
+
+
+def model_sources(model):
+    path = os.path.join(FMU, MODELS[model][0])
+    return path, sorted(os.path.join(path, f) for f in os.listdir(path) if f.endswith('.c'))
+
+
+def run(cmd, **kwargs):
+    try:
+        return subprocess.check_output(cmd, universal_newlines=True, **kwargs)
+    except subprocess.CalledProcessError as e:
+        sys.exit("command failed: %s\n%s" % (' '.join(cmd), e.output or ''))
+
+
+def toolchain(arch):
+    '''return (cc, prefix, flags) or None if not installed'''
+    if arch == 'arm':
+        if shutil.which(ARM_PREFIX + 'gcc') is None:
+            return None
+        return ARM_PREFIX + 'gcc', ARM_PREFIX, COMMON_FLAGS + ARM_FLAGS
+    return 'gcc', '', COMMON_FLAGS + HOST_FLAGS
+
+
+def compile_model(model, arch, out_dir, sources=None):
+    tc = toolchain(arch)
+    if tc is None:
+        return None
+    cc, _, flags = tc
+    inc, files = model_sources(model)
+    objs = []
+    for src in sources or files:
+        obj = os.path.join(out_dir, '%s_%s_%s.o' % (arch, model, os.path.splitext(os.path.basename(src))[0]))
+        run([cc] + flags + ['-I' + inc, '-c', src, '-o', obj], stderr=subprocess.STDOUT)
+        objs.append(obj)
+    return objs
+
+
+# ----------------------------------------------------------------------------
+# footprint
+
+def symbols(prefix, objs):
+    '''[(name, type, size)] of defined symbols with size'''
+    syms = []
+    for line in run([prefix + 'nm', '-S', '-t', 'd'] + objs).splitlines():
+        parts = line.split()
+        if len(parts) == 4:
+            syms.append((parts[3], parts[2], int(parts[1])))
+    return syms
+
+
+def footprint(models, archs, work):
+    for arch in archs:
+        tc = toolchain(arch)
+        if tc is None:
+            print("%s: %sgcc not found, skipped\n" % (arch, ARM_PREFIX))
+            continue
+        for model in models:
+            objs = compile_model(model, arch, work)
+            syms = symbols(tc[1], objs)
+            ram = sum(s for _, t, s in syms if t in 'bBdDC')
+            rom = sum(s for _, t, s in syms if t in 'tTrRdD')
+            code = sum(s for _, t, s in syms if t in 'tT')
+            print("%s [%s] RAM %d bytes, ROM %d bytes (code %d)" % (model, arch, ram, rom, code))
+            print("  %-40s %-8s %10s" % ("symbol", "section", "bytes"))
+            for name, t, size in sorted(syms, key=lambda s: -s[2]):
+                if t in 'tT' or size == 0:
+                    continue
+                section = {'b': 'bss', 'B': 'bss', 'C': 'bss', 'd': 'data', 'D': 'data'}.get(t, 'rodata')
+                print("  %-40s %-8s %10d" % (name, section, size))
+            print("")
+
+
+# ----------------------------------------------------------------------------
+# double precision math
+
+def doubles(models, work):
+    for model in models:
+        _, files = model_sources(model)
+        print("%s: double precision calls in source" % model)
+        for src in files:
+            with open(src) as f:
+                for n, line in enumerate(f, 1):
+                    code = line.split('/*')[0]
+                    m = DOUBLE_SRC_RE.search(code)
+                    if m:
+                        print("  %s:%d: %s" % (os.path.relpath(src, FMU), n, code.strip()))
+
+        # arm objects show the soft double helpers the compiler had to call
+        tc = toolchain('arm')
+        if tc is None:
+            print("  (%sgcc not found, object check skipped)\n" % ARM_PREFIX)
+            continue
+        print("%s: double precision calls in arm objects" % model)
+        for obj in compile_model(model, 'arm', work):
+            func = None
+            count = {}
+            for line in run([tc[1] + 'objdump', '-r', obj]).splitlines():
+                m = re.match(r'RELOCATION RECORDS FOR \[\.text\.(\w+)\]', line)
+                if m:
+                    func = m.group(1)
+                    continue
+                parts = line.split()
+                if func and len(parts) == 3 and DOUBLE_HELPER_RE.match(parts[2]):
+                    key = (func, parts[2])
+                    count[key] = count.get(key, 0) + 1
+            for (func, helper), n in sorted(count.items(), key=lambda c: -c[1]):
+                print("  %-32s %-16s %4d" % (func, helper, n))
+        print("")
+
+
+# ----------------------------------------------------------------------------
+# step instrumentation
+
+def hierarchy(model):
+    '''map '<Sn>' to its top level subsystem from the codegen header'''
+    inc, _ = model_sources(model)
+    groups = {'<Root>': '(root)'}
+    with open(os.path.join(inc, MODELS[model][1] + '.h')) as f:
+        for m in re.finditer(r"'(<S\d+>)'\s*:\s*'([^']*)'", f.read()):
+            path = m.group(2).split('/')
+            groups[m.group(1)] = path[1] if len(path) > 1 else '(root)'
+    return groups
+
+
+def _skip_space_comment(src, i):
+    while i < len(src):
+        if src[i].isspace():
+            i += 1
+        elif src.startswith('/*', i):
+            i = src.index('*/', i) + 2
+        else:
+            break
+    return i
+
+
+def instrument(model, src_file, out_file):
+    '''insert bench_probe() where the step enters another top level subsystem,
+    return the probe names'''
+    groups = hierarchy(model)
+    names = ['(unattributed)']
+    with open(src_file) as f:
+        src = f.read()
+
+    m = re.search(r'^void %s_step\(void\)\s*\{' % MODELS[model][1], src, re.M)
+    if m is None:
+        sys.exit("%s_step not found in %s" % (MODELS[model][1], src_file))
+
+    out = [src[:m.end()]]
+    i = m.end()
+    # kind of each open brace, probes only go into code blocks
+    braces = ['code']
+    paren = 0
+    last = '{'
+    group = None
+    crossed = True
+
+    while braces:
+        c = src[i]
+        if src.startswith('/*', i):
+            end = src.index('*/', i) + 2
+            comment = src[i:end]
+            sm = re.search(r"'(<S\d+>|<Root>)", comment)
+            nxt = src[_skip_space_comment(src, end):]
+            if (sm and sm.group(1) in groups and braces[-1] == 'code' and paren == 0 and last in ';{}'
+                    and not re.match(r'(else|while|case|default)\b', nxt)):
+                name = groups[sm.group(1)]
+                # straight line code stays in the same subsystem, skip the probe
+                if name != group or crossed:
+                    if name not in names:
+                        names.append(name)
+                    out.append('bench_probe(%d);\n  ' % names.index(name))
+                    group = name
+                    crossed = False
+            out.append(comment)
+            i = end
+            continue
+        if c == '"' or c == "'":
+            end = i + 1
+            while src[end] != c:
+                end += 2 if src[end] == '\\' else 1
+            out.append(src[i:end + 1])
+            i = end + 1
+            last = c
+            continue
+        if c == '{':
+            braces.append('init' if last in '=,' else 'code')
+            crossed = True
+        elif c == '}':
+            braces.pop()
+            crossed = True
+        elif c == '(':
+            paren += 1
+        elif c == ')':
+            paren -= 1
+        if not c.isspace():
+            last = c
+        out.append(c)
+        i += 1
+
+    out.append(src[i:])
+    out.append('\n/* generated by model_bench.py */\n')
+    out.append('const char* bench_probe_name[] = {\n%s};\n' % ''.join('  "%s",\n' % n for n in names))
+    out.append('const int bench_probe_num = %d;\n' % len(names))
+    with open(out_file, 'w') as f:
+        # the probe is called inside the step, declare it ahead
+        f.write('void bench_probe(int id);\n')
+        f.write(''.join(out))
+    return names
+
+
+def build_bench(model, work, probe):
+    inc, files = model_sources(model)
+    step_src = os.path.join(inc, MODELS[model][1] + '.c')
+    sources = [f for f in files if f != step_src]
+    tag = 'probe' if probe else 'plain'
+    inst = os.path.join(work, '%s_%s.c' % (MODELS[model][1], tag))
+    if probe:
+        instrument(model, step_src, inst)
+    else:
+        # no probe, only the name table for the harness
+        with open(step_src) as f:
+            src = f.read()
+        with open(inst, 'w') as f:
+            f.write(src)
+            f.write('\nconst char* bench_probe_name[] = { "(unattributed)" };\nconst int bench_probe_num = 1;\n')
+    sources.append(inst)
+    sources.append(os.path.join(HERE, 'model_bench.c'))
+    sources += [os.path.join(CMSIS, s) for s in CMSIS_SRC]
+
+    exe = os.path.join(work, '%s_%s' % (model, tag))
+    cc, _, flags = toolchain('host')
+    run([cc] + flags + ['-DBENCH_%s' % model.upper(), '-I' + inc] + sources + ['-lm', '-o', exe],
+        stderr=subprocess.STDOUT)
+    return exe
+
+
+# ----------------------------------------------------------------------------
+# BLog replay
+
+BLOG_TYPE_SIZE = [1, 1, 2, 2, 4, 4, 4, 8, 1, 8, 8]
+PARAM_TYPE_SIZE = [1, 1, 2, 2, 4, 4, 4, 8]
+
+
+def read_blog(path):
+    '''yield (bus_name, payload) of each message, see module/log/blog.c'''
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    _, _, name_len, desc_len = struct.unpack_from('<HIHH', data, 0)
+    pos = 10 + desc_len
+
+    def name(pos):
+        return data[pos:pos + name_len].split(b'\0')[0].decode()
+
+    buses = {}
+    num_bus = data[pos]
+    pos += 1
+    for _ in range(num_bus):
+        bus = name(pos)
+        msg_id, num_elem = data[pos + name_len], data[pos + name_len + 1]
+        pos += name_len + 2
+        size = 0
+        for _ in range(num_elem):
+            elem_type, number = struct.unpack_from('<HH', data, pos + name_len)
+            size += BLOG_TYPE_SIZE[elem_type] * number
+            pos += name_len + 4
+        buses[msg_id] = (bus, size)
+
+    num_group = data[pos]
+    pos += 1
+    for _ in range(num_group):
+        param_num = struct.unpack_from('<I', data, pos + name_len)[0]
+        pos += name_len + 4
+        for _ in range(param_num):
+            pos += name_len + 1 + PARAM_TYPE_SIZE[data[pos + name_len]]
+
+    # | 0x92 | 0x05 | msg_id | payload | 0x26 |
+    while pos + 3 <= len(data):
+        if data[pos] != 0x92 or data[pos + 1] != 0x05 or data[pos + 2] not in buses:
+            pos += 1
+            continue
+        bus, size = buses[data[pos + 2]]
+        end = pos + 3 + size
+        if end >= len(data) or data[end] != 0x26:
+            pos += 1
+            continue
+        yield bus, data[pos + 3:end]
+        pos = end + 1
+
+
+def make_replay(log, clock, out_file):
+    '''a step follows each message of the clock bus, other inputs are held'''
+    steps = 0
+    with open(out_file, 'wb') as f:
+        for bus, payload in read_blog(log):
+            if bus not in REPLAY_BUS:
+                continue
+            f.write(struct.pack('<BH', REPLAY_BUS.index(bus), len(payload)) + payload)
+            if bus == clock:
+                f.write(struct.pack('<BH', REPLAY_STEP, 0))
+                steps += 1
+    if steps == 0:
+        sys.exit("no %s message in %s" % (clock, log))
+    return steps
+
+
+def bench(models, work, log, clock, steps, repeat):
+    args = ['-r', str(repeat)]
+    if log:
+        replay = os.path.join(work, 'replay.bin')
+        make_replay(log, clock, replay)
+        args.append(replay)
+    else:
+        args += ['-n', str(steps)]
+
+    unit = 'tsc cycles' if os.uname()[4] in ('x86_64', 'i686') else 'ns'
+    for model in models:
+        # timing is taken without probes, the probed build only gives the split
+        plain = dict(l.split(' ', 1) for l in run([build_bench(model, work, False)] + args).splitlines())
+        probes = [l.split(' ', 3)[1:] for l in run([build_bench(model, work, True)] + args).splitlines()
+                  if l.startswith('probe ')]
+        print("%s: %s steps, %s per step" % (model, plain['steps'], unit))
+        print("  min %s  mean %s  p50 %s  p99 %s  max %s (step %s)" % (
+            plain['min'], plain['mean'], plain['p50'], plain['p99'], plain['max'], plain['worst_step']))
+        for _, share, name in sorted(probes, key=lambda p: -float(p[1])):
+            print("  %6s%%  %s" % (share, name))
+        print("")
+
+
+def main():
+    parser = ArgumentParser(description=__doc__)
+    parser.add_argument('action', choices=['footprint', 'doubles', 'bench'])
+    parser.add_argument('--model', choices=sorted(MODELS), action='append',
+                        help='model to profile, all models if not given')
+    parser.add_argument('--arch', choices=['host', 'arm', 'both'], default='both', help='footprint target')
+    parser.add_argument('--log', help='BLog file to replay as model input')
+    parser.add_argument('--clock', default='IMU', help='bus that triggers a step in replay (default IMU)')
+    parser.add_argument('--steps', type=int, default=10000, help='steps to run without log')
+    parser.add_argument('--repeat', type=int, default=1, help='passes over the input')
+    parser.add_argument('--keep', action='store_true', help='keep build directory')
+    args = parser.parse_args()
+
+    models = args.model or ['INS', 'FMS', 'Controller', 'Plant']
+    work = tempfile.mkdtemp(prefix='model_bench_')
+
+    try:
+        if args.action == 'footprint':
+            footprint(models, ['host', 'arm'] if args.arch == 'both' else [args.arch], work)
+        elif args.action == 'doubles':
+            doubles(models, work)
+        else:
+            bench(models, work, args.log, args.clock, args.steps, args.repeat)
+    finally:
+        if args.keep:
+            print("build directory: %s" % work)
+        else:
+            shutil.rmtree(work)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,415 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+/*
+ * Closed loop flight of Plant, INS, FMS and Controller on host, built by
+ * monte_carlo.py.
+ *
+ * Scenarios are read from stdin, one per line, see _parse_scenario(). Each
+ * flight runs in a forked child. The generated models keep their state in
+ * globals (*_U, *_Y, *_DW, *_B, the rtModel timing and the parameter
+ * structs), so a child starts from the untouched state of the parent and
+ * the flights can not leak into each other. Up to -j children run at the
+ * same time, each prints one result line to stdout.
+ *
+ * The models step as scheduled on board: Plant and INS every 2 ms,
+ * Controller every 4 ms and FMS every 8 ms. The pilot flies a fixed
+ * profile in position mode: arm, climb, hold, move, brake and hold.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <Controller.h>
+#include <FMS.h>
+#include <INS.h>
+#include <Plant.h>
+
+/* mass of the Plant model ('<S35>/mass'), replaced by mc_mass in the build */
+#define MC_MASS_NOMINAL 1.4f
+/* linear air drag of the Plant model ('<S8>/Gain') */
+#define MC_AIR_DRAG     0.15f
+/* time constant of the wind gust */
+#define MC_GUST_TAU     2.0f
+
+#define MC_STEP_MS      2
+#define MC_FLIGHT_MS    30000
+#define MC_MAX_JOBS     256
+#define MC_LINE_MAX     1024
+
+#define D2R             0.017453292f
+#define R2D             57.29578f
+
+/* flight profile in ms */
+#define T_ARM           4000
+#define T_STANDBY       5000
+#define T_CLIMB         6000
+#define T_HOLD1         9000
+#define T_MOVE          15000
+#define T_HOLD2         20000
+/* position drift is measured after the vehicle settles */
+#define T_SETTLE        3000
+
+/* keep in sync with SCENARIO in monte_carlo.py */
+typedef struct {
+    int id;
+    uint32_t seed;
+    float mass;       /* kg */
+    float noise_imu;  /* scale of gyro and accel noise */
+    float noise_mag;  /* scale of mag noise */
+    float noise_gps;  /* scale of gps position and velocity noise */
+    float wind_n;     /* steady wind, m/s */
+    float wind_e;
+    float gust;       /* gust standard deviation, m/s */
+    float yaw0;       /* initial heading, deg */
+    float move_dir;   /* direction of the move stick, deg */
+} scenario_t;
+
+typedef struct {
+    double vel_err_sum2;
+    uint32_t vel_err_num;
+    float vel_err_max;
+    float drift_max;
+    float sat_time;
+    float ins_att_err_max;
+    float ins_vel_err_max;
+    float ins_h_err_max;
+    float h_max;
+    uint8_t armed;
+} result_t;
+
+/* referenced by the patched Plant model */
+float mc_mass = MC_MASS_NOMINAL;
+
+/* random sources of Plant, see Plant_private.h */
+extern void RandSrcCreateSeeds_32(uint32_T initSeed, uint32_T seedArray[], int32_T numSeeds);
+extern void RandSrcInitState_GZ(const uint32_T seed[], uint32_T state[], int32_T nChans);
+
+static uint64_t _rng_state;
+
+static float _rand_uniform(void)
+{
+    /* xorshift64* */
+    _rng_state ^= _rng_state >> 12;
+    _rng_state ^= _rng_state << 25;
+    _rng_state ^= _rng_state >> 27;
+
+    return ((_rng_state * 2685821657736338717ULL) >> 40) * (1.0f / 16777216.0f);
+}
+
+static float _rand_normal(void)
+{
+    float u = _rand_uniform();
+
+    if (u < 1e-7f) {
+        u = 1e-7f;
+    }
+
+    return sqrtf(-2.0f * logf(u)) * cosf(6.2831853f * _rand_uniform());
+}
+
+static float _wrap_pi(float angle)
+{
+    while (angle > M_PI) {
+        angle -= 2 * M_PI;
+    }
+    while (angle < -M_PI) {
+        angle += 2 * M_PI;
+    }
+
+    return angle;
+}
+
+static void _scale(real32_T* array, int len, float scale)
+{
+    for (int i = 0; i < len; i++) {
+        array[i] *= scale;
+    }
+}
+
+static void _plant_setup(const scenario_t* sc)
+{
+    uint32_t seed = sc->seed;
+
+    /* inertia grows with the mass, the frame is the same */
+    mc_mass = sc->mass;
+    _scale(Plant_ConstP.Inertia_Matrix_Value, 9, sc->mass / MC_MASS_NOMINAL);
+
+    /* variances of the white noise sources */
+    _scale(Plant_ConstP.RandomSource_VarianceRTP, 3, sc->noise_imu * sc->noise_imu);
+    _scale(Plant_ConstP.RandomSource_VarianceRTP_f, 3, sc->noise_imu * sc->noise_imu);
+    _scale(Plant_ConstP.RandomSource_VarianceRTP_a, 3, sc->noise_mag * sc->noise_mag);
+    _scale(Plant_ConstP.RandomSource_VarianceRTP_b, 3, sc->noise_gps * sc->noise_gps);
+    _scale(Plant_ConstP.RandomSource1_VarianceRTP, 3, sc->noise_gps * sc->noise_gps);
+
+    Plant_init();
+
+    /* each flight draws its own noise sequence */
+    RandSrcCreateSeeds_32(seed++, Plant_DW.RandomSource_SEED_DWORK, 3);
+    RandSrcInitState_GZ(Plant_DW.RandomSource_SEED_DWORK, Plant_DW.RandomSource_STATE_DWORK, 3);
+    RandSrcCreateSeeds_32(seed++, Plant_DW.RandomSource_SEED_DWORK_f, 3);
+    RandSrcInitState_GZ(Plant_DW.RandomSource_SEED_DWORK_f, Plant_DW.RandomSource_STATE_DWORK_k, 3);
+    RandSrcCreateSeeds_32(seed++, Plant_DW.RandomSource_SEED_DWORK_b, 3);
+    RandSrcInitState_GZ(Plant_DW.RandomSource_SEED_DWORK_b, Plant_DW.RandomSource_STATE_DWORK_j, 3);
+    RandSrcCreateSeeds_32(seed++, Plant_DW.RandomSource_SEED_DWORK_m, 3);
+    RandSrcInitState_GZ(Plant_DW.RandomSource_SEED_DWORK_m, Plant_DW.RandomSource_STATE_DWORK_l, 3);
+    RandSrcCreateSeeds_32(seed++, Plant_DW.RandomSource1_SEED_DWORK, 3);
+    RandSrcInitState_GZ(Plant_DW.RandomSource1_SEED_DWORK, Plant_DW.RandomSource1_STATE_DWORK, 3);
+    RandSrcInitState_GZ(&seed, Plant_DW.RandomSource_STATE_DWORK_b, 1);
+
+    /* initial heading, attitude quaternion of '<S36>' */
+    Plant_DW.DiscreteTimeIntegrator_DSTATE[0] = cosf(0.5f * sc->yaw0 * D2R);
+    Plant_DW.DiscreteTimeIntegrator_DSTATE[1] = 0.0f;
+    Plant_DW.DiscreteTimeIntegrator_DSTATE[2] = 0.0f;
+    Plant_DW.DiscreteTimeIntegrator_DSTATE[3] = sinf(0.5f * sc->yaw0 * D2R);
+}
+
+static void _pilot_cmd(const scenario_t* sc, uint32_t time, Pilot_Cmd_Bus* cmd)
+{
+    memset(cmd, 0, sizeof(Pilot_Cmd_Bus));
+
+    cmd->timestamp = time;
+    cmd->mode = 2; /* position mode */
+
+    if (time < T_STANDBY) {
+        cmd->ls_ud = -1.0f;
+        if (time >= T_ARM) {
+            /* arm gesture */
+            cmd->rs_lr = -1.0f;
+            cmd->rs_ud = -1.0f;
+        }
+    } else if (time < T_CLIMB) {
+        cmd->ls_ud = -1.0f;
+    } else if (time < T_HOLD1) {
+        cmd->ls_ud = 0.8f;
+    } else if (time >= T_MOVE && time < T_HOLD2) {
+        cmd->rs_ud = 0.6f * cosf(sc->move_dir * D2R);
+        cmd->rs_lr = 0.6f * sinf(sc->move_dir * D2R);
+    }
+}
+
+static void _fly(const scenario_t* sc, result_t* res)
+{
+    float gust[2] = { 0.0f, 0.0f };
+    float hold_x = 0.0f, hold_y = 0.0f;
+    const float dt = MC_STEP_MS * 1e-3f;
+
+    memset(res, 0, sizeof(result_t));
+    _rng_state = ((uint64_t)sc->seed << 32) | 0x9E3779B9u;
+
+    _plant_setup(sc);
+    INS_init();
+    FMS_init();
+    Controller_init();
+
+    for (uint32_t time = 0; time < MC_FLIGHT_MS; time += MC_STEP_MS) {
+        /* Plant runs on the last actuator command */
+        Plant_U.Control_Out = Controller_Y.Control_Out;
+        Plant_step();
+
+        /* wind pushes the vehicle through the linear air drag of the model */
+        for (int i = 0; i < 2; i++) {
+            gust[i] += -gust[i] / MC_GUST_TAU * dt + sc->gust * sqrtf(2.0f * dt / MC_GUST_TAU) * _rand_normal();
+        }
+        Plant_DW.DiscreteTimeIntegrator_DSTATE_f[0] += dt * MC_AIR_DRAG * (sc->wind_n + gust[0]) / sc->mass;
+        Plant_DW.DiscreteTimeIntegrator_DSTATE_f[1] += dt * MC_AIR_DRAG * (sc->wind_e + gust[1]) / sc->mass;
+
+        INS_U.IMU1 = Plant_Y.IMU;
+        INS_U.MAG = Plant_Y.MAG;
+        INS_U.Barometer = Plant_Y.Barometer;
+        INS_U.GPS_uBlox = Plant_Y.GPS_uBlox;
+        INS_step();
+
+        if (time % 8 == 0) {
+            _pilot_cmd(sc, time, &FMS_U.Pilot_Cmd);
+            FMS_U.INS_Output = INS_Y.INS_Out;
+            FMS_U.Control_Out = Controller_Y.Control_Out;
+            FMS_step();
+        }
+
+        if (time % 4 == 0) {
+            Controller_U.FMS_Out = FMS_Y.FMS_Output;
+            Controller_U.INS_Out = INS_Y.INS_Out;
+            Controller_step();
+        }
+
+        if (time < T_HOLD1) {
+            continue;
+        }
+
+        {
+            const Plant_States_Bus* truth = &Plant_Y.Plant_States;
+            const INS_Out_Bus* ins = &INS_Y.INS_Out;
+            const FMS_Out_Bus* fms = &FMS_Y.FMS_Output;
+            float cos_psi = cosf(truth->psi);
+            float sin_psi = sinf(truth->psi);
+            float err[3];
+            float norm;
+
+            /* velocity command is given in the heading frame */
+            err[0] = fms->u_cmd - (cos_psi * truth->vel_x_O + sin_psi * truth->vel_y_O);
+            err[1] = fms->v_cmd - (-sin_psi * truth->vel_x_O + cos_psi * truth->vel_y_O);
+            err[2] = fms->w_cmd - truth->vel_z_O;
+            norm = sqrtf(err[0] * err[0] + err[1] * err[1] + err[2] * err[2]);
+            res->vel_err_sum2 += norm * norm;
+            res->vel_err_num++;
+            res->vel_err_max = fmaxf(res->vel_err_max, norm);
+
+            if (time == T_HOLD1 + T_SETTLE || time == T_HOLD2 + T_SETTLE) {
+                hold_x = truth->x_R;
+                hold_y = truth->y_R;
+            }
+            if ((time > T_HOLD1 + T_SETTLE && time < T_MOVE) || time > T_HOLD2 + T_SETTLE) {
+                res->drift_max = fmaxf(res->drift_max, hypotf(truth->x_R - hold_x, truth->y_R - hold_y));
+            }
+
+            if (fms->state == 2) {
+                for (int i = 0; i < 4; i++) {
+                    uint16_t pwm = Controller_Y.Control_Out.actuator_cmd[i];
+
+                    if (pwm <= 1100 || pwm >= 2000) {
+                        res->sat_time += dt;
+                        break;
+                    }
+                }
+            }
+
+            norm = fmaxf(fabsf(_wrap_pi(ins->phi - truth->phi)), fabsf(_wrap_pi(ins->theta - truth->theta)));
+            norm = fmaxf(norm, fabsf(_wrap_pi(ins->psi - truth->psi)));
+            res->ins_att_err_max = fmaxf(res->ins_att_err_max, norm * R2D);
+            err[0] = ins->vn - truth->vel_x_O;
+            err[1] = ins->ve - truth->vel_y_O;
+            err[2] = ins->vd - truth->vel_z_O;
+            res->ins_vel_err_max = fmaxf(res->ins_vel_err_max, sqrtf(err[0] * err[0] + err[1] * err[1] + err[2] * err[2]));
+            res->ins_h_err_max = fmaxf(res->ins_h_err_max, fabsf(ins->h_R - truth->h_R));
+            res->h_max = fmaxf(res->h_max, truth->h_R);
+        }
+    }
+
+    res->armed = FMS_Y.FMS_Output.state == 2;
+}
+
+static int _parse_scenario(const char* line, scenario_t* sc)
+{
+    return sscanf(line, "%d %u %f %f %f %f %f %f %f %f %f", &sc->id, &sc->seed, &sc->mass, &sc->noise_imu,
+                  &sc->noise_mag, &sc->noise_gps, &sc->wind_n, &sc->wind_e, &sc->gust, &sc->yaw0, &sc->move_dir)
+        == 11;
+}
+
+static void _run_child(const scenario_t* sc)
+{
+    result_t res;
+    char line[MC_LINE_MAX];
+    int len;
+
+    _fly(sc, &res);
+
+    /* parsed by monte_carlo.py, one write so lines of children do not mix */
+    len = snprintf(line, sizeof(line),
+                   "id=%d vel_err_rms=%.4f vel_err_max=%.4f drift_max=%.4f sat_time=%.3f "
+                   "ins_att_err_max=%.3f ins_vel_err_max=%.4f ins_h_err_max=%.4f h_max=%.3f armed=%u\n",
+                   sc->id, res.vel_err_num ? sqrt(res.vel_err_sum2 / res.vel_err_num) : 0.0, res.vel_err_max,
+                   res.drift_max, res.sat_time, res.ins_att_err_max, res.ins_vel_err_max, res.ins_h_err_max,
+                   res.h_max, res.armed);
+
+    if (write(STDOUT_FILENO, line, len) != len) {
+        _exit(1);
+    }
+
+    _exit(0);
+}
+
+static void _reap(pid_t* pid, int* id, int jobs, int* running)
+{
+    int status;
+    pid_t done = wait(&status);
+
+    for (int i = 0; i < jobs; i++) {
+        if (pid[i] == done) {
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                printf("id=%d error=%d\n", id[i], WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status));
+                fflush(stdout);
+            }
+            pid[i] = 0;
+            (*running)--;
+            return;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    pid_t pid[MC_MAX_JOBS] = { 0 };
+    int id[MC_MAX_JOBS];
+    int jobs = 1;
+    int running = 0;
+    char line[MC_LINE_MAX];
+    scenario_t sc;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        }
+    }
+
+    if (jobs < 1 || jobs > MC_MAX_JOBS) {
+        fprintf(stderr, "jobs should be 1 ~ %d\n", MC_MAX_JOBS);
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), stdin)) {
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if (!_parse_scenario(line, &sc)) {
+            fprintf(stderr, "invalid scenario: %s", line);
+            return 1;
+        }
+
+        if (running == jobs) {
+            _reap(pid, id, jobs, &running);
+        }
+
+        for (int i = 0; i < jobs; i++) {
+            if (pid[i] == 0) {
+                /* nothing buffered may be duplicated into the child */
+                fflush(stdout);
+                pid[i] = fork();
+                if (pid[i] < 0) {
+                    perror("fork");
+                    return 1;
+                }
+                if (pid[i] == 0) {
+                    _run_child(&sc);
+                }
+                id[i] = sc.id;
+                running++;
+                break;
+            }
+        }
+    }
+
+    while (running) {
+        _reap(pid, id, jobs, &running);
+    }
+
+    return 0;
+}
@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+
+"""
+Monte-Carlo flights of the closed loop Plant, INS, FMS and Controller on host.
+
+Each flight gets its own sensor noise, wind, mass and initial heading drawn
+from the ranges below, flies the fixed profile of monte_carlo.c and reports
+velocity tracking error, position drift, actuator saturation time and INS
+error against the plant truth. Flights run in parallel processes, one per
+core by default.
+
+Examples:
+    monte_carlo.py --runs 1000
+    monte_carlo.py --runs 500 --mass 1.2 2.0 --wind 8 --csv result.csv
+    monte_carlo.py --runs 1000 --only 417     # replay one flight of the batch
+"""
+
+from __future__ import print_function
+import math
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+from argparse import ArgumentParser
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HERE, '..', 'model_bench'))
+
+from model_bench import CMSIS, CMSIS_SRC, MODELS, compile_model, model_sources, run, toolchain  # noqa: E402
+
+# keep in sync with scenario_t in monte_carlo.c
+SCENARIO = ['id', 'seed', 'mass', 'noise_imu', 'noise_mag', 'noise_gps', 'wind_n', 'wind_e', 'gust', 'yaw0',
+            'move_dir']
+
+# (metric, unit, fails the flight above this value)
+METRICS = [
+    ('vel_err_rms', 'm/s', None),
+    ('vel_err_max', 'm/s', None),
+    ('drift_max', 'm', None),
+    ('sat_time', 's', None),
+    ('ins_att_err_max', 'deg', 10.0),
+    ('ins_vel_err_max', 'm/s', 2.0),
+    ('ins_h_err_max', 'm', 5.0),
+]
+
+# the Plant model is built with variable mass and writable noise variances,
+# (file, original, replacement, expected count)
+PLANT_PATCH = [
+    ('Plant.h', 'extern const ConstP_Plant_T Plant_ConstP;', 'extern ConstP_Plant_T Plant_ConstP;', 1),
+    ('Plant_data.c', 'const ConstP_Plant_T Plant_ConstP', 'ConstP_Plant_T Plant_ConstP', 1),
+    # '<S35>/mass'
+    ('Plant.c', '/ 1.4F', '/ mc_mass', 3),
+    # '<S27>' gravity, mass * g
+    ('Plant.c', '* 13.734F', '* (mc_mass * 9.81F)', 1),
+]
+
+
+def patch_plant(work):
+    src, _ = model_sources('Plant')
+    dst = os.path.join(work, 'plant')
+    shutil.copytree(src, dst)
+    for name, old, new, count in PLANT_PATCH:
+        path = os.path.join(dst, name)
+        with open(path) as f:
+            text = f.read()
+        if text.count(old) != count:
+            sys.exit("%s: expect %d of '%s', found %d, the Plant model has changed" % (
+                name, count, old, text.count(old)))
+        text = text.replace(old, new)
+        if name == 'Plant.c':
+            text = 'extern float mc_mass;\n' + text
+        with open(path, 'w') as f:
+            f.write(text)
+    return dst
+
+
+def build(work):
+    plant = patch_plant(work)
+    objs = []
+    incs = ['-I' + plant]
+    for model in ['INS', 'FMS', 'Controller']:
+        objs += compile_model(model, 'host', work)
+        incs.append('-I' + model_sources(model)[0])
+    # patched sources include the patched header of their own directory
+    objs += compile_model('Plant', 'host', work, sorted(os.path.join(plant, f) for f in os.listdir(plant)
+                                                        if f.endswith('.c')))
+
+    exe = os.path.join(work, 'monte_carlo')
+    cc, _, flags = toolchain('host')
+    sources = [os.path.join(HERE, 'monte_carlo.c')] + [os.path.join(CMSIS, s) for s in CMSIS_SRC]
+    run([cc] + flags + incs + sources + objs + ['-lm', '-o', exe], stderr=subprocess.STDOUT)
+    return exe
+
+
+def scenarios(args):
+    '''same seed gives the same batch, so a flight can be replayed by its id'''
+    rnd = random.Random(args.seed)
+    batch = []
+    for i in range(args.runs):
+        wind = rnd.uniform(0, args.wind)
+        wind_dir = rnd.uniform(0, 360)
+        batch.append({
+            'id': i,
+            'seed': rnd.randrange(1, 1 << 31),
+            'mass': rnd.uniform(*args.mass),
+            'noise_imu': rnd.uniform(*args.noise),
+            'noise_mag': rnd.uniform(*args.noise),
+            'noise_gps': rnd.uniform(*args.noise),
+            'wind_n': wind * math.cos(math.radians(wind_dir)),
+            'wind_e': wind * math.sin(math.radians(wind_dir)),
+            'gust': rnd.uniform(0, args.gust),
+            'yaw0': rnd.uniform(-180, 180),
+            'move_dir': rnd.uniform(0, 360),
+        })
+    return batch
+
+
+def fly(exe, batch, jobs):
+    lines = ''.join(' '.join(str(s[k]) for k in SCENARIO) + '\n' for s in batch)
+    proc = subprocess.run([exe, '-j', str(jobs)], input=lines, stdout=subprocess.PIPE, universal_newlines=True,
+                          check=True)
+    results = {}
+    for line in proc.stdout.splitlines():
+        fields = dict(f.split('=', 1) for f in line.split())
+        results[int(fields.pop('id'))] = fields
+    return results
+
+
+def failed(res):
+    if 'error' in res:
+        return 'crashed (%s)' % res['error']
+    if res['armed'] != '1':
+        return 'disarmed'
+    reasons = ['%s %s' % (m, res[m]) for m, _, limit in METRICS if limit is not None and float(res[m]) > limit]
+    return ', '.join(reasons)
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def report(batch, results, elapsed, jobs):
+    ok = [results[s['id']] for s in batch if s['id'] in results and 'error' not in results[s['id']]]
+    print("%d flights in %.1f s with %d jobs (%.1f flights/s)\n" % (len(batch), elapsed, jobs, len(batch) / elapsed))
+    if ok:
+        print("  %-18s %-5s %9s %9s %9s %9s" % ('metric', 'unit', 'mean', 'p50', 'p95', 'max'))
+        for metric, unit, _ in METRICS:
+            values = [float(r[metric]) for r in ok]
+            print("  %-18s %-5s %9.3f %9.3f %9.3f %9.3f" % (metric, unit, sum(values) / len(values),
+                                                          percentile(values, 50), percentile(values, 95),
+                                                          max(values)))
+        print("")
+
+    failures = 0
+    for s in batch:
+        res = results.get(s['id'], {'error': 'no result'})
+        reason = failed(res)
+        if reason:
+            failures += 1
+            print("  flight %d failed: %s" % (s['id'], reason))
+            print("    %s" % ' '.join('%s=%.4g' % (k, s[k]) for k in SCENARIO[2:]))
+    print("%d of %d flights failed" % (failures, len(batch)))
+    return failures
+
+
+def write_csv(path, batch, results):
+    keys = [m for m, _, _ in METRICS] + ['h_max', 'armed']
+    with open(path, 'w') as f:
+        f.write(','.join(SCENARIO + keys) + '\n')
+        for s in batch:
+            res = results.get(s['id'], {})
+            f.write(','.join([str(s[k]) for k in SCENARIO] + [res.get(k, '') for k in keys]) + '\n')
+
+
+def main():
+    parser = ArgumentParser(description=__doc__)
+    parser.add_argument('--runs', type=int, default=100, help='number of flights')
+    parser.add_argument('--jobs', type=int, default=os.cpu_count(), help='parallel flights (default cores)')
+    parser.add_argument('--seed', type=int, default=1, help='seed of the batch')
+    parser.add_argument('--mass', type=float, nargs=2, default=[1.2, 1.7], help='mass range, kg')
+    parser.add_argument('--noise', type=float, nargs=2, default=[0.5, 2.0], help='sensor noise scale range')
+    parser.add_argument('--wind', type=float, default=5.0, help='max steady wind, m/s')
+    parser.add_argument('--gust', type=float, default=1.5, help='max gust standard deviation, m/s')
+    parser.add_argument('--only', type=int, action='append', help='only fly the flight with this id')
+    parser.add_argument('--csv', help='write scenario and metrics of each flight')
+    parser.add_argument('--keep', action='store_true', help='keep build directory')
+    args = parser.parse_args()
+
+    batch = scenarios(args)
+    if args.only:
+        batch = [s for s in batch if s['id'] in args.only]
+
+    work = tempfile.mkdtemp(prefix='monte_carlo_')
+    try:
+        exe = build(work)
+        start = time.time()
+        results = fly(exe, batch, args.jobs)
+        elapsed = time.time() - start
+        if args.csv:
+            write_csv(args.csv, batch, results)
+        failures = report(batch, results, elapsed, args.jobs)
+    finally:
+        if args.keep:
+            print("build directory: %s" % work)
+        else:
+            shutil.rmtree(work)
+
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == '__main__':
+    main()
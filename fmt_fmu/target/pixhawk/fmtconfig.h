@@ -22,9 +22,13 @@
 /* HIL simulation */
 // #define FMT_USING_HIL
 #ifdef FMT_USING_HIL
+/* plant is simulated on board (SIH), or by an external simulator through the hil bridge */
 #define FMT_USING_SIH
+// #define FMT_USING_HIL_BRIDGE
 // #define FMT_HIL_WITH_ACTUATOR
 #define FMT_OUTPUT_PILOT_CMD
+/* sih thread wakes every 1ms, the plant steps by the period it is generated with */
+// #define FMT_SIH_PERIOD 1
 #endif
 
 /* Mavlink */
@@ -39,6 +43,18 @@
 #define ENABLE_ULOG_CONSOLE_BACKEND
 #endif
 
+/* BLog */
+/* append 64-bit sample timestamp(us) to the logged sensor buses */
+// #define FMT_BLOG_SENSOR_TIMESTAMP_US
+
+/* Perf */
+/* measure control loop scopes with the cycle counter, see 'perf' command */
+#define FMT_USING_PERF
+
+/* INS */
+/* run a second INS on the second imu (gyro1 and accel1, if present), published as ins_output1 */
+// #define FMT_INS_INSTANCE_NUM 2
+
 /* Cortex-M Backtrace */
 #define FMT_USING_CM_BACKTRACE
 
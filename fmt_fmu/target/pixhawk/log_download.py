@@ -0,0 +1,373 @@
+#!/usr/bin/env python3
+
+"""
+Download log files over MAVLink FTP with the compressed log chunk service.
+
+Each chunk is decompressed and checked with its crc32. Chunks lost in the burst
+are requested again one by one, and an interrupted download is resumed from
+the .part file by reconnecting and opening the file again.
+
+Examples:
+    log_download.py /dev/ttyACM0 sessions
+    log_download.py /dev/ttyACM0 bus /log/session_3/fmt.bin
+    log_download.py /dev/ttyACM0 get /log/session_3
+"""
+
+from __future__ import print_function
+import os
+import struct
+import sys
+import time
+import zlib
+
+try:
+    from pymavlink import mavutil
+except:
+    print("Failed to import pymavlink.")
+    print("You may need to install it with 'pip install pymavlink pyserial'")
+    print("")
+    raise
+from argparse import ArgumentParser
+
+# opcodes and error codes, see module/ftp/ftp_manager.h
+CMD_TERMINATE_SESSION = 1
+CMD_LIST_DIRECTORY = 3
+CMD_OPEN_FILE_RO = 4
+CMD_LOG_LIST_SESSIONS = 64
+CMD_LOG_LIST_BUS = 65
+CMD_LOG_READ_CHUNK = 66
+CMD_LOG_BURST_CHUNK = 67
+RSP_ACK = 128
+RSP_NAK = 129
+
+ERR_EOF = 6
+
+# chunk header, see module/ftp/ftp_log.h
+CHUNK_RAW = 0
+CHUNK_LZ = 1
+CHUNK_HEADER = struct.Struct('<HIB')
+
+PAYLOAD_HEADER = struct.Struct('<HBBBBBBI')
+MAX_DATA_LEN = 251 - PAYLOAD_HEADER.size
+LZ_MIN_MATCH = 4
+
+
+def lz_decompress(src):
+    '''python version of lz_decompress() in module/utils/lz.c'''
+    out = bytearray()
+    ip = 0
+
+    def read_len(n, ip):
+        if n == 15:
+            while True:
+                b = src[ip]
+                ip += 1
+                n += b
+                if b != 255:
+                    break
+        return n, ip
+
+    while ip < len(src):
+        token = src[ip]
+        ip += 1
+        lit_len, ip = read_len(token >> 4, ip)
+        out += src[ip:ip + lit_len]
+        ip += lit_len
+        if ip >= len(src):
+            break
+        offset = src[ip] | (src[ip + 1] << 8)
+        ip += 2
+        match_len, ip = read_len(token & 0x0F, ip)
+        match_len += LZ_MIN_MATCH
+        if offset == 0 or offset > len(out):
+            raise ValueError("bad match offset")
+        # source may overlap
+        for _ in range(match_len):
+            out.append(out[-offset])
+
+    return bytes(out)
+
+
+def decode_chunk(data):
+    '''return raw bytes of a chunk, or None if it is corrupted'''
+    raw_len, crc, method = CHUNK_HEADER.unpack_from(data)
+    body = data[CHUNK_HEADER.size:]
+    try:
+        raw = lz_decompress(body) if method == CHUNK_LZ else bytes(body)
+    except (ValueError, IndexError):
+        return None
+    if len(raw) != raw_len or (zlib.crc32(raw) & 0xFFFFFFFF) != crc:
+        return None
+    return raw
+
+
+class FtpError(Exception):
+    def __init__(self, code):
+        Exception.__init__(self, "ftp nak, error code %d" % code)
+        self.code = code
+
+
+class LogFtp():
+    '''minimal mavlink ftp client for the log download service'''
+    def __init__(self, portname, baudrate, timeout=1.0, debug=0):
+        self.portname = portname
+        self.baudrate = baudrate
+        self.timeout = timeout
+        self._debug = debug
+        self.seq = 0
+        self.connect()
+
+    def debug(self, s, level=1):
+        if self._debug >= level:
+            print(s)
+
+    def connect(self):
+        self.debug("Connecting with MAVLink to %s ..." % self.portname)
+        self.mav = mavutil.mavlink_connection(self.portname, autoreconnect=True, baud=self.baudrate)
+        self.mav.wait_heartbeat()
+        self.debug("HEARTBEAT OK")
+
+    def send(self, opcode, session=0, offset=0, data=b''):
+        self.seq = (self.seq + 1) & 0xFFFF
+        payload = PAYLOAD_HEADER.pack(self.seq, session, opcode, len(data), 0, 0, 0, offset) + data
+        payload += b'\0' * (251 - len(payload))
+        self.mav.mav.file_transfer_protocol_send(0, self.mav.target_system, self.mav.target_component,
+                                                 bytearray(payload))
+
+    def recv(self, timeout=None):
+        '''return (session, opcode, req_opcode, burst_complete, offset, data) or None on timeout'''
+        m = self.mav.recv_match(type='FILE_TRANSFER_PROTOCOL', blocking=True,
+                                timeout=self.timeout if timeout is None else timeout)
+        if m is None:
+            return None
+        payload = bytes(bytearray(m.payload))
+        _, session, opcode, size, req_opcode, burst_complete, _, offset = PAYLOAD_HEADER.unpack_from(payload)
+        data = payload[PAYLOAD_HEADER.size:PAYLOAD_HEADER.size + size]
+        return session, opcode, req_opcode, burst_complete, offset, data
+
+    def request(self, opcode, session=0, offset=0, data=b'', retry=3):
+        '''send a request and wait for its ack'''
+        for _ in range(retry):
+            self.send(opcode, session, offset, data)
+            deadline = time.time() + self.timeout
+            while time.time() < deadline:
+                rsp = self.recv(max(deadline - time.time(), 0.01))
+                # skip stale burst packets and responses of other requests
+                if rsp is None or rsp[2] != opcode:
+                    continue
+                if opcode == CMD_LOG_READ_CHUNK and rsp[1] == RSP_ACK and rsp[4] != offset:
+                    continue
+                if rsp[1] == RSP_NAK:
+                    raise FtpError(bytearray(rsp[5])[0])
+                return rsp
+        raise IOError("no response for opcode %d" % opcode)
+
+    def list_entries(self, opcode, data=b''):
+        '''collect "\\0" separated entries of a paged list request'''
+        entries = []
+        while True:
+            try:
+                rsp = self.request(opcode, offset=len(entries), data=data)
+            except FtpError as e:
+                if e.code == ERR_EOF:
+                    return entries
+                raise
+            page = [e.decode() for e in rsp[5].split(b'\0') if e]
+            if not page:
+                return entries
+            entries += page
+
+
+def list_sessions(ftp):
+    for entry in ftp.list_entries(CMD_LOG_LIST_SESSIONS):
+        name, size, num = entry.split('\t')
+        print("%-16s %10s bytes %4s files" % (name, size, num))
+
+
+def list_bus(ftp, path):
+    for entry in ftp.list_entries(CMD_LOG_LIST_BUS, path.encode()):
+        msg_id, name, num = entry.split('\t')
+        print("%4s %-24s %3s elements" % (msg_id, name, num))
+
+
+def list_files(ftp, path):
+    '''return [(name, size)] of files in remote folder'''
+    files = []
+    # offset counts all directory entries, including skipped ones
+    offset = 0
+    while True:
+        try:
+            rsp = ftp.request(CMD_LIST_DIRECTORY, offset=offset, data=path.encode())
+        except FtpError as e:
+            if e.code == ERR_EOF:
+                return files
+            raise
+        entries = [e.decode() for e in rsp[5].split(b'\0') if e]
+        if not entries:
+            return files
+        offset += len(entries)
+        for e in entries:
+            if e[0] == 'F':
+                name, size = e[1:].split('\t')
+                files.append((name, int(size)))
+
+
+class Download():
+    '''download of one file. only contiguous data is appended to the .part
+    file, so its size is where an interrupted download continues'''
+    def __init__(self, ftp, remote, local):
+        self.ftp = ftp
+        self.remote = remote
+        self.local = local
+        self.part = local + ".part"
+        self.pos = os.path.getsize(self.part) if os.path.exists(self.part) else 0
+        # chunks received ahead of pos, {offset: raw}
+        self.pending = {}
+        self.wire = 0
+        self.retry = 0
+        self.session = None
+
+    def open(self):
+        rsp = self.ftp.request(CMD_OPEN_FILE_RO, data=self.remote.encode())
+        self.session = rsp[0]
+        self.size = struct.unpack_from('<I', rsp[5])[0]
+
+    def feed(self, f, offset, data):
+        '''take a chunk, return False if it is corrupted'''
+        raw = decode_chunk(data)
+        if raw is None:
+            return False
+        self.wire += len(data)
+        if offset > self.pos:
+            self.pending[offset] = raw
+            return True
+        self.write(f, offset, raw)
+        # pending chunks may continue now, chunk boundaries of different requests need not match
+        progress = True
+        while progress:
+            progress = False
+            for o in sorted(self.pending):
+                raw = self.pending[o]
+                if o + len(raw) <= self.pos:
+                    del self.pending[o]
+                elif o <= self.pos:
+                    del self.pending[o]
+                    self.write(f, o, raw)
+                    progress = True
+                    break
+        return True
+
+    def write(self, f, offset, raw):
+        if offset + len(raw) > self.pos:
+            f.write(raw[self.pos - offset:])
+            f.flush()
+            self.pos = offset + len(raw)
+
+    def fill(self, f):
+        '''request chunk at pos until the gap is closed or burst has to restart'''
+        rsp = self.ftp.request(CMD_LOG_READ_CHUNK, self.session, self.pos)
+        if not self.feed(f, rsp[4], rsp[5]):
+            raise IOError("chunk at %d corrupted" % self.pos)
+
+    def burst(self, f):
+        self.ftp.send(CMD_LOG_BURST_CHUNK, self.session, self.pos)
+        while self.pos < self.size:
+            rsp = self.ftp.recv()
+            if rsp is None:
+                # burst stalled, get the rest by single chunks or a new burst
+                return
+            session, opcode, req_opcode, complete, offset, data = rsp
+            if session != self.session or req_opcode != CMD_LOG_BURST_CHUNK:
+                continue
+            if opcode == RSP_NAK:
+                raise FtpError(bytearray(data)[0])
+            if not self.feed(f, offset, data) or offset > self.pos:
+                self.fill(f)
+            if complete:
+                return
+            self.progress()
+
+    def progress(self):
+        sys.stdout.write("\r%s %d/%d bytes" % (self.remote, self.pos, self.size))
+        sys.stdout.flush()
+
+    def run(self, max_retry):
+        start = time.time()
+        start_pos = self.pos
+        with open(self.part, 'ab') as f:
+            while True:
+                try:
+                    self.open()
+                    if self.pos > self.size:
+                        raise IOError("local file is larger than remote file")
+                    while self.pos < self.size:
+                        self.burst(f)
+                        while self.pending and self.pos < self.size:
+                            self.fill(f)
+                    self.ftp.request(CMD_TERMINATE_SESSION, self.session)
+                    break
+                except IOError as e:
+                    # link lost, reconnect and continue from the .part file
+                    self.retry += 1
+                    if self.retry > max_retry:
+                        raise
+                    print("\n%s, resume at %d" % (e, self.pos))
+                    self.pending = {}
+                    self.ftp.connect()
+                    # free the old session, the fmu only takes over an idle one after its timeout
+                    if self.session is not None:
+                        try:
+                            self.ftp.request(CMD_TERMINATE_SESSION, self.session)
+                        except (IOError, FtpError):
+                            pass
+                        self.session = None
+
+        os.rename(self.part, self.local)
+        dt = max(time.time() - start, 1e-3)
+        got = self.pos - start_pos
+        self.progress()
+        print("\n%d bytes in %.1fs, %.1fKB/s, compression ratio %.2f" %
+              (got, dt, got / dt / 1024, float(got) / self.wire if self.wire else 1.0))
+
+
+def main():
+    parser = ArgumentParser(description=__doc__)
+    parser.add_argument('port', metavar='PORT', help='Mavlink port name: serial: DEVICE[,BAUD], udp: IP:PORT, tcp: tcp:IP:PORT')
+    parser.add_argument("--baudrate", "-b", dest="baudrate", type=int,
+                        help="Mavlink port baud rate (default=57600)", default=57600)
+    parser.add_argument("--output", "-o", default=".", help="local folder to save logs")
+    parser.add_argument("--retry", type=int, default=10, help="max reconnect number")
+    parser.add_argument("--debug", type=int, default=0)
+    parser.add_argument('action', choices=['sessions', 'bus', 'get'])
+    parser.add_argument('path', nargs='?', help='blog file for bus, file or session folder for get')
+    args = parser.parse_args()
+
+    if args.action != 'sessions' and args.path is None:
+        parser.error("path is required")
+
+    ftp = LogFtp(args.port, args.baudrate, debug=args.debug)
+
+    if args.action == 'sessions':
+        list_sessions(ftp)
+    elif args.action == 'bus':
+        list_bus(ftp, args.path)
+    else:
+        path = args.path.rstrip('/')
+        files = list_files(ftp, path)
+        if files:
+            folder = os.path.join(args.output, os.path.basename(path))
+            targets = [(path + '/' + name, os.path.join(folder, name)) for name, _ in files]
+        else:
+            folder = args.output
+            targets = [(path, os.path.join(folder, os.path.basename(path)))]
+        if not os.path.isdir(folder):
+            os.makedirs(folder)
+        for remote, local in targets:
+            if os.path.exists(local):
+                print("%s exists, skip" % local)
+                continue
+            Download(ftp, remote, local).run(args.retry)
+
+
+if __name__ == '__main__':
+    main()
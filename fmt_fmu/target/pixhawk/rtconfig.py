@@ -56,6 +56,9 @@ if PLATFORM == 'gcc':
     if BUILD == 'debug':
         CFLAGS += ' -O0 -gdwarf-2'
         AFLAGS += ' -gdwarf-2'
+        # record heap allocation call sites, see memstat.c
+        CFLAGS += ' -DFMT_MEMSTAT_TRACK_ALLOC'
+        LFLAGS += ' -Wl,--wrap=rt_malloc,--wrap=rt_calloc,--wrap=rt_realloc'
     else:
         CFLAGS += ' -O2'
 
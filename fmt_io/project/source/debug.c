@@ -22,7 +22,6 @@
 #define DEBUG_BUFFER_SIZE 100
 
 static char _dbg_buf[DEBUG_BUFFER_SIZE];
-static PackageStruct _dbg_pkg;
 
 int debug(const char* fmt, ...)
 {
@@ -37,14 +36,9 @@ int debug(const char* fmt, ...)
 
     /* send dbg info to FMU */
     if (length <= DEBUG_BUFFER_SIZE && length) {
-        fmt_send_pkg(_dbg_buf, length, &_dbg_pkg);
+        fmt_send_message(PROTO_DBG_TEXT, _dbg_buf, length);
     }
 
     return length;
 }
 
-void debug_init(void)
-{
-    // fmt_create_pkg(PROTO_DBG_TEXT, DEBUG_BUFFER_SIZE, _dbg_buf, &_dbg_pkg);
-    fmt_init_pkg(PROTO_DBG_TEXT, _dbg_buf, &_dbg_pkg);
-}
@@ -0,0 +1,190 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+
+#include "dshot.h"
+
+/* 5 bit gcr code to nibble, 0xFF for invalid code */
+static const uint8_t _gcr_decode[32] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x09, 0x0A, 0x0B, 0xFF, 0x0D, 0x0E, 0x0F,
+	0xFF, 0xFF, 0x02, 0x03, 0xFF, 0x05, 0x06, 0x07,
+	0xFF, 0x00, 0x08, 0x01, 0xFF, 0x04, 0x0C, 0xFF
+};
+
+// map motor value to dshot throttle, value not greater than min_val stops the motor
+uint16_t dshot_throttle(uint16_t val, uint16_t min_val, uint16_t max_val)
+{
+	if(val <= min_val || max_val <= min_val) {
+		return DSHOT_CMD_MOTOR_STOP;
+	}
+
+	if(val >= max_val) {
+		return DSHOT_THROTTLE_MAX;
+	}
+
+	return DSHOT_THROTTLE_MIN + (uint32_t)(val - min_val) * (DSHOT_THROTTLE_MAX - DSHOT_THROTTLE_MIN) / (max_val - min_val);
+}
+
+// build 16 bit frame, crc is inverted for bidirectional dshot
+uint16_t dshot_pack(uint16_t value, uint8_t telem_req, uint8_t bidir)
+{
+	uint16_t data = ((value & 0x7FF) << 1) | (telem_req ? 1 : 0);
+	uint16_t crc = (data ^ (data >> 4) ^ (data >> 8)) & 0x0F;
+
+	if(bidir) {
+		crc = ~crc & 0x0F;
+	}
+
+	return (data << 4) | crc;
+}
+
+// fill timer compare values of one channel, buf[i * stride] is the slot of bit i
+void dshot_fill_slots(uint16_t frame, uint16_t* buf, uint8_t stride, uint16_t t0h, uint16_t t1h)
+{
+	for(uint8_t i = 0 ; i < DSHOT_FRAME_BITS ; i++) {
+		buf[i * stride] = (frame & (0x8000 >> i)) ? t1h : t0h;
+	}
+
+	for(uint8_t i = DSHOT_FRAME_BITS ; i < DSHOT_FRAME_SLOTS ; i++) {
+		buf[i * stride] = 0;
+	}
+}
+
+/* recover gcr bits from port samples of one pin. a level change marks bit 1 and
+ * the bits within a run are 0. the line idles high, so telemetry begins with a
+ * falling edge and the length of the last (high) run has to be inferred */
+FMT_Error dshot_decode_samples(const uint16_t* samples, uint16_t num, uint16_t pin_mask, uint8_t spb, uint32_t* gcr)
+{
+	uint32_t value = 0;
+	uint16_t i = 0;
+	uint16_t last;
+	uint8_t level = 0;
+	uint8_t bits = 0;
+	uint8_t len;
+
+	while(i < num && (samples[i] & pin_mask)) {
+		i++;
+	}
+
+	if(i >= num) {
+		/* no response */
+		return SYS_EEMPTY;
+	}
+
+	last = i;
+
+	for(i = i + 1 ; i < num ; i++) {
+		if(((samples[i] & pin_mask) != 0) == level) {
+			continue;
+		}
+
+		len = (i - last + spb / 2) / spb;
+
+		if(len == 0 || bits + len >= DSHOT_TELEM_BITS) {
+			return SYS_EINVAL;
+		}
+
+		value = (value << len) | (1UL << (len - 1));
+		bits += len;
+		last = i;
+		level = !level;
+	}
+
+	if(level == 0) {
+		/* sampling ended before the response */
+		return SYS_EEMPTY;
+	}
+
+	len = DSHOT_TELEM_BITS - bits;
+	value = (value << len) | (1UL << (len - 1));
+
+	*gcr = value & 0xFFFFF;
+
+	return SYS_EOK;
+}
+
+// decode 20 bit gcr to 12 bit telemetry value and check crc
+FMT_Error dshot_decode_gcr(uint32_t gcr, uint16_t* value)
+{
+	uint16_t data = 0;
+	uint8_t nibble;
+	uint16_t csum;
+
+	for(uint8_t i = 0 ; i < 4 ; i++) {
+		nibble = _gcr_decode[(gcr >> (15 - i * 5)) & 0x1F];
+
+		if(nibble == 0xFF) {
+			return SYS_EINVAL;
+		}
+
+		data = (data << 4) | nibble;
+	}
+
+	/* all nibbles xor to 0xF */
+	csum = data ^ (data >> 8);
+	csum ^= csum >> 4;
+
+	if((csum & 0x0F) != 0x0F) {
+		return SYS_EINVAL;
+	}
+
+	*value = data >> 4;
+
+	return SYS_EOK;
+}
+
+// telemetry value is the eletrical period in us: | exponent(3) | mantissa(9) |
+uint32_t dshot_value_to_erpm(uint16_t value)
+{
+	uint32_t period_us;
+
+	if(value == 0x0FFF) {
+		/* motor stopped */
+		return 0;
+	}
+
+	period_us = (uint32_t)(value & 0x1FF) << (value >> 9);
+
+	if(period_us == 0) {
+		return 0;
+	}
+
+	return 60000000UL / period_us;
+}
+
+FMT_Error dshot_decode_telem(const uint16_t* samples, uint16_t num, uint16_t pin_mask, uint32_t* erpm)
+{
+	uint32_t gcr;
+	uint16_t value;
+	FMT_Error err;
+
+	err = dshot_decode_samples(samples, num, pin_mask, DSHOT_TELEM_OVERSAMPLE, &gcr);
+
+	if(err != SYS_EOK) {
+		return err;
+	}
+
+	err = dshot_decode_gcr(gcr, &value);
+
+	if(err != SYS_EOK) {
+		return err;
+	}
+
+	*erpm = dshot_value_to_erpm(value);
+
+	return SYS_EOK;
+}
@@ -0,0 +1,52 @@
+/******************************************************************************
+ * Copyright 2020 The Firmament Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *****************************************************************************/
+
+
+#ifndef __DSHOT_H__
+#define __DSHOT_H__
+
+/* same codec as fmu module/dshot */
+#include "stm32f10x.h"
+#include "protocol.h"
+
+/* frame: | throttle(11) | telemetry request(1) | crc(4) |, msb first */
+#define DSHOT_FRAME_BITS		16
+/* idle slots after the frame, so the last bit is completed by the timer */
+#define DSHOT_RESET_SLOTS		2
+#define DSHOT_FRAME_SLOTS		(DSHOT_FRAME_BITS + DSHOT_RESET_SLOTS)
+
+#define DSHOT_CMD_MOTOR_STOP	0
+#define DSHOT_THROTTLE_MIN		48
+#define DSHOT_THROTTLE_MAX		2047
+
+/* bidirectional telemetry is sent 30us after the frame at 5/4 of the bit rate,
+ * gcr coded into 21 bits. the line is sampled at DSHOT_TELEM_OVERSAMPLE times
+ * the telemetry bit rate */
+#define DSHOT_TELEM_BITS		21
+#define DSHOT_TELEM_OVERSAMPLE	3
+#define DSHOT_TELEM_DELAY_US	30
+/* sample count covering the delay and a frame at any bit rate, with margin */
+#define DSHOT_TELEM_SAMPLES		180
+
+uint16_t dshot_throttle(uint16_t val, uint16_t min_val, uint16_t max_val);
+uint16_t dshot_pack(uint16_t value, uint8_t telem_req, uint8_t bidir);
+void dshot_fill_slots(uint16_t frame, uint16_t* buf, uint8_t stride, uint16_t t0h, uint16_t t1h);
+FMT_Error dshot_decode_samples(const uint16_t* samples, uint16_t num, uint16_t pin_mask, uint8_t spb, uint32_t* gcr);
+FMT_Error dshot_decode_gcr(uint32_t gcr, uint16_t* value);
+uint32_t dshot_value_to_erpm(uint16_t value);
+FMT_Error dshot_decode_telem(const uint16_t* samples, uint16_t num, uint16_t pin_mask, uint32_t* erpm);
+
+#endif
@@ -17,61 +17,251 @@
 #include "debug.h"
 #include "ppm_decoder.h"
 #include "pwm.h"
+#include "time.h"
 #include "usart.h"
 #include <stdlib.h>
 #include <string.h>
 
 static uint8_t _recv_sync = 0;
-/* send package data buffer */
-static uint8_t _pkg_data[256];
+/* tx frames, one is being filled while the other is sent by dma */
+static FrameStruct _tx_frame[2];
+static uint8_t _tx_frame_idx = 0;
+static uint8_t _tx_seq = 0;
+/* rx, frames are parsed in usart rx interrupt */
+static uint8_t _rx_buff[64];
+static ParserStruct _rx_parser;
+static LinkStatStruct _link_stat;
+static uint32_t _rx_stamp_us;
+/* messages other than motor command are handled in main loop */
+static struct {
+    uint16_t cmd;
+    uint16_t len;
+    uint8_t content[MAX_PACKAGE_SIZE];
+} _pkg_queue[PKG_QUEUE_SIZE];
+static volatile uint8_t _pkg_head = 0;
+static volatile uint8_t _pkg_tail = 0;
+/* timestamps of latest motor command, echoed back to fmu in main loop */
+static volatile uint8_t _motor_echo_ready = 0;
+static uint32_t _motor_echo_stamp;
+static uint32_t _motor_echo_rx_us;
+static uint16_t _motor_echo_proc_us;
 
 extern ppm_encoder_t ppm_param;
 
-FMT_Error fmt_init_pkg(uint16_t cmd, void* buffer, PackageStruct* pkg)
+static FMT_Error _apply_motor(uint16_t chan_mask, const uint8_t* content, uint16_t len)
 {
-    return init_static_package(cmd, (uint8_t*)buffer, pkg);
-}
+    uint16_t val;
+    uint16_t chan_num = 0;
+    float duty_cyc[MAX_PWM_CHAN] = { 0.0 };
 
-FMT_Error fmt_create_pkg(uint16_t cmd, uint16_t buff_len, PackageStruct* pkg)
-{
-    return init_package(cmd, buff_len, pkg);
+    for (uint8_t i = 0; i < MAX_PWM_CHAN; i++) {
+        chan_num += (chan_mask >> i) & 1;
+    }
+
+    /* content holds a value for each channel set in mask */
+    if (len < 2 * chan_num) {
+        return SYS_EINVAL;
+    }
+
+    for (uint8_t i = 0; i < MAX_PWM_CHAN; i++) {
+        if (chan_mask & 1 << i) {
+            val = (uint16_t)content[0] | ((uint16_t)content[1] << 8);
+            if (val > 2000) {
+                val = 2000;
+            } else if (val < 1000) {
+                val = 1000;
+            }
+            content += 2;
+            duty_cyc[i] = 0.00005f * val;
+        }
+    }
+
+    pwm_write(duty_cyc, (uint8_t)chan_mask);
+
+    return SYS_EOK;
 }
 
-FMT_Error fmt_send_pkg(const void* data, uint16_t len, PackageStruct* pkg)
+/* called in usart rx interrupt */
+static FMT_Error _handle_rx_package(const PackageStruct* pkg)
 {
-    SendPkgStruct send_pkg;
+    switch (pkg->cmd) {
+    case PROTO_CMD_MOTOR_TS: {
+        uint16_t chan_mask;
 
-    if (write_package((uint8_t*)data, len, pkg) != SYS_EOK) {
-        return SYS_ERROR;
-    }
+        if (pkg->len < PROTO_MOTOR_TS_HEAD_SIZE) {
+            return SYS_EINVAL;
+        }
+
+        memcpy(&chan_mask, &pkg->content[4], 2);
+
+        if (_apply_motor(chan_mask, &pkg->content[PROTO_MOTOR_TS_HEAD_SIZE], pkg->len - PROTO_MOTOR_TS_HEAD_SIZE)
+            != SYS_EOK) {
+            return SYS_EINVAL;
+        }
 
-    send_pkg.send_buff = _pkg_data;
+        memcpy(&_motor_echo_stamp, &pkg->content[0], 4);
+        _motor_echo_rx_us = _rx_stamp_us;
+        _motor_echo_proc_us = (uint16_t)((uint32_t)time_nowUs() - _rx_stamp_us);
+        _motor_echo_ready = 1;
+    } break;
+
+    case PROTO_CMD_MOTOR: {
+        uint16_t chan_mask;
 
-    make_send_package(*pkg, &send_pkg);
+        if (pkg->len < 2) {
+            return SYS_EINVAL;
+        }
 
-    /* send via usart */
-    send(send_pkg.send_buff, send_pkg.buff_size);
+        memcpy(&chan_mask, &pkg->content[0], 2);
 
-    /* after send, free it */
-    free_package(pkg);
+        if (_apply_motor(chan_mask, &pkg->content[2], pkg->len - 2) != SYS_EOK) {
+            return SYS_EINVAL;
+        }
+    } break;
+
+    default: {
+        uint8_t next = (_pkg_head + 1) % PKG_QUEUE_SIZE;
+
+        /* drop the message if main loop can not keep up */
+        if (next == _pkg_tail || pkg->len > MAX_PACKAGE_SIZE) {
+            return SYS_EFULL;
+        }
+
+        _pkg_queue[_pkg_head].cmd = pkg->cmd;
+        _pkg_queue[_pkg_head].len = pkg->len;
+        memcpy(_pkg_queue[_pkg_head].content, pkg->content, pkg->len);
+        _pkg_head = next;
+    }
+    }
+
+    /* set sync flag if we receive a valid pkg */
+    _recv_sync = 1;
 
     return SYS_EOK;
 }
 
+static void _rx_isr(void)
+{
+    uint16_t len;
+
+    _rx_stamp_us = (uint32_t)time_nowUs();
+
+    while ((len = read_buf(_rx_buff, sizeof(_rx_buff))) > 0) {
+        proto_parse_buffer(&_rx_parser, _rx_buff, len, _handle_rx_package);
+    }
+}
+
 FMT_Error fmt_send_message(uint16_t cmd, const void* data, uint16_t len)
 {
     FMT_Error err;
-    PackageStruct pkg;
 
-    err = fmt_create_pkg(cmd, len, &pkg);
+    /* messages are batched into current frame until fmt_flush() */
+    err = proto_frame_append(&_tx_frame[_tx_frame_idx], cmd, data, len);
+
+    if (err == SYS_EFULL) {
+        fmt_flush();
+        err = proto_frame_append(&_tx_frame[_tx_frame_idx], cmd, data, len);
+    }
 
     if (err == SYS_EOK) {
-        err = fmt_send_pkg(data, len, &pkg);
+        _link_stat.tx_msg++;
+    } else {
+        _link_stat.tx_drop++;
     }
 
     return err;
 }
 
+void fmt_flush(void)
+{
+    FrameStruct* frame = &_tx_frame[_tx_frame_idx];
+    uint16_t size;
+
+    if (frame->msg_num == 0) {
+        return;
+    }
+
+    size = proto_frame_finalize(frame, _tx_seq++);
+
+    /* start dma transfer, this only waits if the other frame is still being sent */
+    send(frame->buff, size);
+
+    _link_stat.tx_frame++;
+    _link_stat.tx_byte += size;
+
+    /* switch to the other frame */
+    _tx_frame_idx ^= 1;
+    proto_frame_init(&_tx_frame[_tx_frame_idx]);
+}
+
+void fmt_poll_rx(void)
+{
+    PackageStruct pkg;
+    uint8_t echo[PROTO_ACK_MOTOR_TS_SIZE];
+    uint16_t hold_us;
+
+    if (_motor_echo_ready) {
+        __disable_irq();
+        memcpy(&echo[0], &_motor_echo_stamp, 4);
+        memcpy(&echo[4], &_motor_echo_proc_us, 2);
+        hold_us = (uint16_t)((uint32_t)time_nowUs() - _motor_echo_rx_us);
+        _motor_echo_ready = 0;
+        __enable_irq();
+
+        memcpy(&echo[6], &hold_us, 2);
+
+        /* send out right away so the hold time is accurate */
+        fmt_send_message(PROTO_ACK_MOTOR_TS, echo, sizeof(echo));
+        fmt_flush();
+    }
+
+    while (_pkg_tail != _pkg_head) {
+        pkg.cmd = _pkg_queue[_pkg_tail].cmd;
+        pkg.len = _pkg_queue[_pkg_tail].len;
+        pkg.content = _pkg_queue[_pkg_tail].content;
+
+        handle_fmu_package(&pkg);
+
+        _pkg_tail = (_pkg_tail + 1) % PKG_QUEUE_SIZE;
+    }
+}
+
+void send_erpm_value(void)
+{
+    uint32_t erpm[MAX_PWM_CHAN];
+    uint16_t mask;
+    uint8_t msg[2 + MAX_PWM_CHAN * 4];
+    uint16_t len = 2;
+
+    if (!pwm_get_erpm(erpm, &mask)) {
+        return;
+    }
+
+    memcpy(&msg[0], &mask, 2);
+    for (uint8_t i = 0; i < MAX_PWM_CHAN; i++) {
+        if (mask & (1 << i)) {
+            memcpy(&msg[len], &erpm[i], 4);
+            len += 4;
+        }
+    }
+
+    fmt_send_message(PROTO_DATA_ERPM, msg, len);
+}
+
+void fmt_get_link_stat(LinkStatStruct* stat)
+{
+    *stat = _link_stat;
+}
+
+void fmu_manager_init(void)
+{
+    proto_frame_init(&_tx_frame[0]);
+    proto_frame_init(&_tx_frame[1]);
+    proto_parser_init(&_rx_parser, &_link_stat);
+
+    usart_set_rx_callback(_rx_isr);
+}
+
 uint8_t fmt_sync_finish(void)
 {
     return _recv_sync;
@@ -79,9 +269,6 @@ uint8_t fmt_sync_finish(void)
 
 FMT_Error handle_fmu_package(const PackageStruct* pkg)
 {
-    FMT_Error err = SYS_EOK;
-    PackageStruct reply_pkg;
-
     switch (pkg->cmd) {
     case PROTO_CMD_SYNC: {
         /* send sync ack */
@@ -93,31 +280,12 @@ FMT_Error handle_fmu_package(const PackageStruct* pkg)
         NVIC_SystemReset();
     } break;
 
-    case PROTO_CMD_MOTOR: {
-        uint16_t chan_mask = *(uint16_t*)pkg->content;
-        uint16_t val;
-        float duty_cyc[MAX_PWM_CHAN] = { 0.0 };
-        uint16_t* val_ptr = (uint16_t*)&pkg->content[2];
-
-        for (uint8_t i = 0; i < MAX_PWM_CHAN; i++) {
-            if (chan_mask & 1 << i) {
-                val = *val_ptr;
-                if (val > 2000) {
-                    val = 2000;
-                } else if (val < 1000) {
-                    val = 1000;
-                }
-                val_ptr++;
-                duty_cyc[i] = 0.00005f * val;
-            }
-        }
-
-        pwm_write(duty_cyc, (uint8_t)chan_mask);
-    } break;
-
     case PROTO_CMD_PWM_SWITCH: {
         int enable = pkg->content[0];
+        /* pwm is also written by motor command in rx interrupt */
+        __disable_irq();
         pwm_configure(PWM_CMD_ENABLE, &enable);
+        __enable_irq();
     } break;
 
     case PROTO_CMD_CONFIG: {
@@ -146,11 +314,29 @@ FMT_Error handle_fmu_package(const PackageStruct* pkg)
         }
 
         if (pwm_freq) {
+            __disable_irq();
             pwm_configure(PWM_CMD_SET_FREQ, &pwm_freq);
+            __enable_irq();
             debug("set pwm frequency:%d\n", pwm_freq);
         }
     } break;
 
+    case PROTO_CMD_MOTOR_PROTOCOL: {
+        PWM_PROTOCOL_MSG msg;
+
+        if (pkg->len != PROTO_MOTOR_PROTOCOL_SIZE) {
+            return SYS_EINVAL;
+        }
+
+        msg.protocol = pkg->content[0];
+        msg.bidir = pkg->content[1];
+
+        __disable_irq();
+        pwm_configure(PWM_CMD_SET_PROTOCOL, &msg);
+        __enable_irq();
+        debug("set motor protocol:%d bidir:%d\n", msg.protocol, msg.bidir);
+    } break;
+
     case PROTO_DBG_TEXT: {
         char recv_str[256];
 
@@ -169,8 +355,5 @@ FMT_Error handle_fmu_package(const PackageStruct* pkg)
     }
     }
 
-    /* set sync flag if we receive a valid pkg */
-    _recv_sync = 1;
-
     return SYS_EOK;
 }
\ No newline at end of file
@@ -20,11 +20,16 @@
 #include "stm32f10x.h"
 #include "protocol.h"
 
+/* number of received messages waiting for main loop */
+#define PKG_QUEUE_SIZE 4
+
 FMT_Error handle_fmu_package(const PackageStruct* pkg);
-FMT_Error fmt_init_pkg(uint16_t cmd, void* buffer, PackageStruct* pkg);
-FMT_Error fmt_create_pkg(uint16_t cmd, uint16_t buff_len, PackageStruct* pkg);
-FMT_Error fmt_send_pkg(const void* data, uint16_t len, PackageStruct* pkg);
 FMT_Error fmt_send_message(uint16_t cmd, const void* data, uint16_t len);
+void fmt_flush(void);
+void fmt_poll_rx(void);
+void send_erpm_value(void);
+void fmt_get_link_stat(LinkStatStruct* stat);
+void fmu_manager_init(void);
 uint8_t fmt_sync_finish(void);
 
 #endif
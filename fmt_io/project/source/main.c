@@ -26,15 +26,8 @@
 #include "usart.h"
 #include <stdio.h>
 
-/* io rx pkg */
-static uint8_t _rx_pkg_buff[MAX_PACKAGE_SIZE];
-static PackageStruct _rx_pkg = {
-    .content = _rx_pkg_buff
-};
-
 int main(void)
 {
-    uint8_t ch;
     uint32_t time_led, time_sync;
     uint32_t now;
     LED_Type led_type;
@@ -48,17 +41,13 @@ int main(void)
 #ifdef USE_LIDAR
     lidar_lite_init();
 #endif
-    debug_init();
+    fmu_manager_init();
 
     led_on(LED_BLUE);
     led_on(LED_RED);
 
     while (1) {
-        if (read_ch(&ch)) {
-            if (proto_parse_package(ch, &_rx_pkg) == SYS_EOK) {
-                handle_fmu_package(&_rx_pkg);
-            }
-        }
+        fmt_poll_rx();
 
         if (fmt_sync_finish()) {
             led_type = LED_BLUE;
@@ -69,6 +58,9 @@ int main(void)
             if (ppm_ready()) {
                 send_ppm_value();
             }
+
+            /* telemetry is decoded at motor command rate, report at 100Hz */
+            TIMETAG_CHECK_EXECUTE(esc_erpm, 10, send_erpm_value();)
         } else {
             led_type = LED_RED;
             led_on(LED_BLUE);
@@ -78,5 +70,8 @@ int main(void)
         }
 
         TIMETAG_CHECK_EXECUTE(led_toggle, 1000, led_toggle(led_type);)
+
+        /* send out messages queued in this loop as one frame */
+        fmt_flush();
     }
 }
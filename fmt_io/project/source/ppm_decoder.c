@@ -33,7 +33,6 @@ static uint8_t _config_rc_chan_num = MAX_PPM_CHANNEL;
 static uint8_t _ppm_sending = 0;
 
 ppm_encoder_t ppm_param;
-PackageStruct _rc_pkg;
 
 void ppm_status_machine(uint16_t IC_Val)
 {
@@ -138,7 +137,7 @@ uint8_t send_ppm_value(void)
     //TIMETAG_CHECK_EXECUTE(ppm_test, 200, debug("chan:%d\n", rc_chan_num);)
     if (rc_chan_num) {
         _ppm_sending = 1;
-        fmt_send_pkg(NULL, 2 * rc_chan_num, &_rc_pkg);
+        fmt_send_message(PROTO_DATA_RC, ppm_param.ppm_val, 2 * rc_chan_num);
         _ppm_sending = 0;
         return 1;
     }
@@ -196,8 +195,5 @@ uint8_t ppm_decoder_init(void)
     ppm_param.total_chan = 0;
     ppm_param.last_ic = 0;
 
-    // fmt_create_pkg(PROTO_DATA_RC, 16, ppm_param.ppm_val, &_rc_pkg);
-    fmt_init_pkg(PROTO_DATA_RC, ppm_param.ppm_val, &_rc_pkg);
-
     return 1;
 }
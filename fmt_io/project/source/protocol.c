@@ -18,9 +18,6 @@
 #include <stdlib.h>
 #include <string.h>
 #include "protocol.h"
-#include "ppm_decoder.h"
-#include "usart.h"
-#include "pwm.h"
 
 /* Work as client */
 #define PROTOCOL_CLIENT
@@ -38,298 +35,261 @@
 #else
 	#error Please define PROTOCOL_SERVER or PROTOCOL_CLIENT
 #endif
-#define PROTOCOL_END                0xFC
+/* parser states define */
+#define STATE_MAGIC                 0x00
+#define STATE_HEAD                  0x01
+#define STATE_BODY                  0x02
+
+#define CRC16_INIT                  0xFFFF
 
 /**************************** Local Function ********************************/
 
-static void _fill_head(PackageStruct* pkg)
+static uint16_t _crc16(uint16_t crc, const void* data, uint16_t len)
 {
-	pkg->head[0] = PROTOCOL_HEAD_MAGIC;
-	pkg->head[1] = PROTOCOL_HEAD_TX;
+	/* crc16-ccitt, same as math_crc16() on fmu side */
+	const static uint16_t crc_tab[16] = {
+		0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+		0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+	};
+	uint8_t h_crc;
+	const uint8_t* ptr = (const uint8_t*)data;
+
+	while(len--) {
+		h_crc = (uint8_t)(crc >> 12);
+		crc <<= 4;
+		crc ^= crc_tab[h_crc ^ ((*ptr) >> 4)];
+
+		h_crc = crc >> 12;
+		crc <<= 4;
+		crc ^= crc_tab[h_crc ^ ((*ptr) & 0x0F)];
+
+		ptr++;
+	}
+
+	return crc;
 }
 
-static void _fill_end(PackageStruct* pkg)
+static uint16_t _get_uint16(const uint8_t* buff)
 {
-	pkg->end = PROTOCOL_END;
+	return (uint16_t)buff[0] | ((uint16_t)buff[1] << 8);
 }
 
-static uint16_t _calc_checksum(PackageStruct* pkg)
+static void _put_uint16(uint8_t* buff, uint16_t val)
 {
-	uint16_t cheksum;
-	uint16_t i;
-
-	cheksum = pkg->head[0] + pkg->head[1] + ((pkg->len & 0xFF) + ((pkg->len >> 8) & 0xFF)) + pkg->cmd;
-
-	for(i = 0 ; i < pkg->len ; i++) {
-		cheksum += pkg->content[i];
-	}
-
-	cheksum += pkg->alloc;
-
-	return cheksum;
+	buff[0] = val & 0xFF;
+	buff[1] = (val >> 8) & 0xFF;
 }
 
-/**************************** Public Function ********************************/
-
-FMT_Error init_package(uint16_t cmd, uint16_t buff_len, PackageStruct* pkg)
+static void _handle_frame(ParserStruct* parser, pkg_handler_t handler)
 {
-	/* fill head */
-	_fill_head(pkg);
-
-	/* set length filed */
-	pkg->len = 0;
-	/* set command filed */
-	pkg->cmd = cmd;
-
-	/* content filed allocation */
-	if(buff_len) {
-		pkg->content = malloc(buff_len);
-
-		if(pkg->content == NULL) {
-			return SYS_ERROR;
-		}
-	} else {
-		pkg->content = NULL;
+	PackageStruct pkg;
+	uint8_t seq = parser->buff[2];
+	uint8_t msg_num = parser->buff[3];
+	uint16_t end = FRAME_HEAD_SIZE + parser->payload_len;
+	uint16_t offset = FRAME_HEAD_SIZE;
+
+	if(parser->seq_valid && seq != (uint8_t)(parser->last_seq + 1)) {
+		parser->stat->rx_lost += (uint8_t)(seq - parser->last_seq - 1);
 	}
 
-	/* set default value */
-	pkg->alloc = 1;
+	parser->last_seq = seq;
+	parser->seq_valid = 1;
+	parser->stat->rx_frame++;
 
-	if(pkg->len == 0) {
-		/* calculate init checksum */
-		pkg->checksum = _calc_checksum(pkg);
-	} else {
-		pkg->checksum  = 0;
-	}
+	for(uint8_t i = 0 ; i < msg_num ; i++) {
+		if(offset + FRAME_MSG_HEAD_SIZE > end) {
+			parser->stat->rx_len_err++;
+			break;
+		}
 
-	/* fill end */
-	_fill_end(pkg);
+		pkg.cmd = _get_uint16(&parser->buff[offset]);
+		pkg.len = _get_uint16(&parser->buff[offset + 2]);
+		pkg.content = &parser->buff[offset + FRAME_MSG_HEAD_SIZE];
 
-	return SYS_EOK;
-}
+		if(offset + FRAME_MSG_HEAD_SIZE + pkg.len > end) {
+			parser->stat->rx_len_err++;
+			break;
+		}
 
-FMT_Error init_static_package(uint16_t cmd, uint8_t* buffer, PackageStruct* pkg)
-{
-	if(buffer == NULL)
-		return SYS_EINVAL;
+		offset += FRAME_MSG_HEAD_SIZE + pkg.len;
+		parser->stat->rx_msg++;
 
-	/* fill head */
-	_fill_head(pkg);
-
-	/* set length filed */
-	pkg->len = 0;
-	/* set command filed */
-	pkg->cmd = cmd;
-	/* allocate a static memory for content filed */
-	pkg->content = buffer;
-	/* set default value */
-	pkg->alloc = 0;
-
-	if(pkg->len == 0) {
-		/* calculate init checksum */
-		pkg->checksum = _calc_checksum(pkg);
+		if(handler) {
+			handler(&pkg);
+		}
 	}
-
-	/* fill end */
-	_fill_end(pkg);
-
-	return SYS_EOK;
 }
 
-FMT_Error write_package(uint8_t* content, uint16_t len, PackageStruct* pkg)
+/* drop the first n bytes taken for a frame and look for the next magic in the
+ * rest, a frame may start inside the bytes of a false magic or a bad frame */
+static void _parser_skip(ParserStruct* parser, uint16_t n)
 {
-	pkg->len = len;
+	uint8_t* magic = NULL;
 
-	/* check if content filed valid */
-	if(pkg->len && pkg->content == NULL) {
-		return SYS_ERROR;
+	if(parser->index > n) {
+		magic = memchr(&parser->buff[n], PROTOCOL_HEAD_MAGIC, parser->index - n);
 	}
 
-	/* copy content */
-	if(pkg->len && content && pkg->content != content) {
-		memcpy(pkg->content, content, pkg->len);
+	if(magic == NULL) {
+		parser->index = 0;
+		parser->state = STATE_MAGIC;
+		return;
 	}
 
-	/* calculate checksum */
-	pkg->checksum = _calc_checksum(pkg);
-
-	return SYS_EOK;
+	parser->index -= magic - parser->buff;
+	memmove(parser->buff, magic, parser->index);
+	parser->state = STATE_HEAD;
 }
 
-void free_package(PackageStruct* pkg)
+/**************************** Public Function ********************************/
+
+void proto_frame_init(FrameStruct* frame)
 {
-	if(pkg->alloc == 1 && pkg->content) {
-		/* free memory if it's allocated before */
-		free(pkg->content);
-		pkg->content = NULL;
-		pkg->alloc = 0;
-	}
+	frame->size = FRAME_HEAD_SIZE;
+	frame->msg_num = 0;
 }
 
-FMT_Error make_send_package(const PackageStruct pkg, SendPkgStruct* send_pkg)
+FMT_Error proto_frame_append(FrameStruct* frame, uint16_t cmd, const void* data, uint16_t len)
 {
-	/* user should assgin a valid address for send_buff */
-	if(send_pkg->send_buff == NULL)
-		return SYS_EINVAL;
+	uint8_t* msg;
 
-	send_pkg->send_buff[0] = pkg.head[0];
-	send_pkg->send_buff[1] = pkg.head[1];
-
-	/* little-endian */
-	*((uint16_t*)&send_pkg->send_buff[2]) = pkg.len;
-	*((uint16_t*)&send_pkg->send_buff[4]) = pkg.cmd;
+	if(len > MAX_PACKAGE_SIZE || (len && data == NULL)) {
+		return SYS_EINVAL;
+	}
 
-	if(pkg.len > 0) {
-		memcpy(&send_pkg->send_buff[6], pkg.content, pkg.len);
+	if(frame->size + FRAME_MSG_HEAD_SIZE + len + FRAME_CRC_SIZE > MAX_FRAME_SIZE || frame->msg_num == 0xFF) {
+		return SYS_EFULL;
 	}
 
-	send_pkg->send_buff[6 + pkg.len] = pkg.alloc;
+	msg = &frame->buff[frame->size];
+
+	_put_uint16(&msg[0], cmd);
+	_put_uint16(&msg[2], len);
 
-	*((uint16_t*)&send_pkg->send_buff[7 + pkg.len]) = pkg.checksum;
-	send_pkg->send_buff[9 + pkg.len] = pkg.end;
+	if(len) {
+		memcpy(&msg[FRAME_MSG_HEAD_SIZE], data, len);
+	}
 
-	/* buff_size = content_len + len_except_content */
-	send_pkg->buff_size = pkg.len + 10;
+	frame->size += FRAME_MSG_HEAD_SIZE + len;
+	frame->msg_num++;
 
 	return SYS_EOK;
 }
 
-/* pkg parse states define */
-#define STATE_HEAD_1	        0x00
-#define STATE_HEAD_2	        0x01
-#define STATE_LEN_1	            0x02
-#define STATE_LEN_2	            0x03
-#define STATE_CMD_1	            0x04
-#define STATE_CMD_2	            0x05
-#define STATE_CONTENT	        0x06
-#define STATE_ALLOC             0x07
-#define STATE_CS_1	            0x08
-#define STATE_CS_2	            0x09
-#define STATE_END	            0x0A
-
-FMT_Error proto_parse_package(uint8_t c, PackageStruct* pkg)
+uint16_t proto_frame_finalize(FrameStruct* frame, uint8_t seq)
 {
-	FMT_Error err = SYS_ERROR;
-	static uint8_t state = STATE_HEAD_1;
-	static uint16_t data_cnt;
-
-	switch(state) {
-		case STATE_HEAD_1:
-			if(c == PROTOCOL_HEAD_MAGIC) {
-				pkg->head[0] = c;
+	uint16_t crc;
 
-				state = STATE_HEAD_2;
-			}
-
-			/* wait more data */
-			err = SYS_EEMPTY;
-			break;
-
-		case STATE_HEAD_2:
-			if(c == PROTOCOL_HEAD_RX) {
-				pkg->head[1] = c;
-
-				state = STATE_LEN_1;
-			} else {
-				/* wrong data, go back to init state */
-				state = STATE_HEAD_1;
-			}
-
-			err = SYS_EEMPTY;
-			break;
-
-		case STATE_LEN_1:
-			/* little-endian, so we first receive low byte data */
-			pkg->len = c;
-
-			state = STATE_LEN_2;
-			err = SYS_EEMPTY;
-			break;
-
-		case STATE_LEN_2:
-			/* little-endian, receive high byte data */
-			pkg->len |= c << 8;
-
-			if(pkg->len > MAX_PACKAGE_SIZE) {
-				state = STATE_HEAD_1;
-			} else {
-				state = STATE_CMD_1;
-			}
-
-			err = SYS_EEMPTY;
-			break;
-
-		case STATE_CMD_1:
-			pkg->cmd = c;
+	frame->buff[0] = PROTOCOL_HEAD_MAGIC;
+	frame->buff[1] = PROTOCOL_HEAD_TX;
+	frame->buff[2] = seq;
+	frame->buff[3] = frame->msg_num;
+	_put_uint16(&frame->buff[4], frame->size - FRAME_HEAD_SIZE);
 
-			state = STATE_CMD_2;
-			err = SYS_EEMPTY;
-			break;
+	/* magic byte is not included */
+	crc = _crc16(CRC16_INIT, &frame->buff[1], frame->size - 1);
+	_put_uint16(&frame->buff[frame->size], crc);
 
-		case STATE_CMD_2:
-			pkg->cmd |= c << 8;
-
-			if(pkg->len) {
-				data_cnt = 0;
-				state = STATE_CONTENT;
-			} else {
-				/* if there is no content, we skip content state */
-				state = STATE_ALLOC;
-			}
-
-			err = SYS_EEMPTY;
-			break;
+	return frame->size + FRAME_CRC_SIZE;
+}
 
-		case STATE_CONTENT:
-			pkg->content[data_cnt++] = c;
+void proto_parser_init(ParserStruct* parser, LinkStatStruct* stat)
+{
+	parser->state = STATE_MAGIC;
+	parser->index = 0;
+	parser->payload_len = 0;
+	parser->last_seq = 0;
+	parser->seq_valid = 0;
+	parser->stat = stat;
+}
 
-			if(data_cnt >= pkg->len) {
-				state = STATE_ALLOC;
-			}
+uint16_t proto_parse_buffer(ParserStruct* parser, const uint8_t* data, uint16_t len, pkg_handler_t handler)
+{
+	uint16_t frame_cnt = 0;
+	uint16_t frame_size;
+	uint16_t n;
 
-			err = SYS_EEMPTY;
-			break;
+	parser->stat->rx_byte += len;
 
-		case STATE_ALLOC:
-			pkg->alloc = c;
+	/* bytes put back by _parser_skip() are parsed again before new data */
+	while(1) {
+		switch(parser->state) {
+			case STATE_MAGIC: {
+				const uint8_t* magic = len ? memchr(data, PROTOCOL_HEAD_MAGIC, len) : NULL;
 
-			state = STATE_CS_1;
-			err = SYS_EEMPTY;
-			break;
+				if(magic == NULL) {
+					/* no frame start in this chunk */
+					return frame_cnt;
+				}
 
-		case STATE_CS_1:
-			pkg->checksum = c;
+				len -= magic - data + 1;
+				data = magic + 1;
 
-			state = STATE_CS_2;
-			err = SYS_EEMPTY;
-			break;
-
-		case STATE_CS_2:
-			pkg->checksum |= c << 8;
-
-			if(_calc_checksum(pkg) != pkg->checksum) {
-				state = STATE_HEAD_1;
-			} else {
-				state = STATE_END;
+				parser->buff[0] = PROTOCOL_HEAD_MAGIC;
+				parser->index = 1;
+				parser->state = STATE_HEAD;
 			}
-
-			err = SYS_EEMPTY;
 			break;
 
-		case STATE_END:
-			if(c == PROTOCOL_END) {
-				pkg->end = c;
-				/* we have received a complate pkg */
-				state = STATE_HEAD_1;
-				err = SYS_EOK;
-			} else {
-				state = STATE_HEAD_1;
-				err = SYS_EEMPTY;
-			}
-
-			break;
+			case STATE_HEAD:
+				if(parser->index < FRAME_HEAD_SIZE) {
+					n = FRAME_HEAD_SIZE - parser->index;
+					n = n < len ? n : len;
+					memcpy(&parser->buff[parser->index], data, n);
+					parser->index += n;
+					data += n;
+					len -= n;
+
+					if(parser->index < FRAME_HEAD_SIZE) {
+						return frame_cnt;
+					}
+				}
+
+				parser->payload_len = _get_uint16(&parser->buff[4]);
+
+				if(parser->buff[1] != PROTOCOL_HEAD_RX) {
+					_parser_skip(parser, 1);
+				} else if(parser->payload_len > MAX_FRAME_PAYLOAD_SIZE) {
+					parser->stat->rx_len_err++;
+					_parser_skip(parser, 1);
+				} else {
+					parser->state = STATE_BODY;
+				}
+
+				break;
+
+			case STATE_BODY:
+				frame_size = FRAME_HEAD_SIZE + parser->payload_len + FRAME_CRC_SIZE;
+
+				if(parser->index < frame_size) {
+					n = frame_size - parser->index;
+					n = n < len ? n : len;
+					memcpy(&parser->buff[parser->index], data, n);
+					parser->index += n;
+					data += n;
+					len -= n;
+
+					if(parser->index < frame_size) {
+						return frame_cnt;
+					}
+				}
+
+				if(_crc16(CRC16_INIT, &parser->buff[1], frame_size - FRAME_CRC_SIZE - 1)
+				        != _get_uint16(&parser->buff[frame_size - FRAME_CRC_SIZE])) {
+					parser->stat->rx_crc_err++;
+					_parser_skip(parser, 1);
+				} else {
+					_handle_frame(parser, handler);
+					frame_cnt++;
+					_parser_skip(parser, frame_size);
+				}
+
+				break;
+
+			default:
+				parser->state = STATE_MAGIC;
+				parser->index = 0;
+				break;
+		}
 	}
-
-	return err;
 }
-
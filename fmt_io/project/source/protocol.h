@@ -33,22 +33,55 @@ typedef enum {
 	SYS_EINVAL          = 10               /**< Invalid argument */
 } FMT_Error;
 
+/* frame layout (little-endian):
+ * | magic | head | seq | msg_num | payload_len(2) | payload | crc16(2) |
+ * payload is a batch of messages:
+ * | cmd(2) | len(2) | content | cmd(2) | len(2) | content | ...
+ * crc16 (ccitt) covers everything between magic and crc16 */
 #define MAX_PACKAGE_SIZE            128
+#define MAX_FRAME_SIZE              256
+#define FRAME_HEAD_SIZE             6
+#define FRAME_CRC_SIZE              2
+#define FRAME_MSG_HEAD_SIZE         4
+#define MAX_FRAME_PAYLOAD_SIZE      (MAX_FRAME_SIZE - FRAME_HEAD_SIZE - FRAME_CRC_SIZE)
 
+/* a message inside a received frame, content points into the frame buffer */
 typedef struct {
-	uint8_t		head[2];
-	uint16_t	len;
 	uint16_t	cmd;
+	uint16_t	len;
 	uint8_t* 	content;
-	uint8_t     alloc;
-	uint16_t 	checksum;
-	uint8_t		end;
 } PackageStruct;
 
 typedef struct {
-	uint8_t* 	send_buff;
-	uint16_t 	buff_size;
-} SendPkgStruct;
+	uint16_t	size;
+	uint8_t		msg_num;
+	uint8_t		buff[MAX_FRAME_SIZE];
+} FrameStruct;
+
+typedef struct {
+	uint32_t	tx_frame;
+	uint32_t	tx_msg;
+	uint32_t	tx_byte;
+	uint32_t	tx_drop;
+	uint32_t	rx_frame;
+	uint32_t	rx_msg;
+	uint32_t	rx_byte;
+	uint32_t	rx_crc_err;
+	uint32_t	rx_len_err;
+	uint32_t	rx_lost;
+} LinkStatStruct;
+
+typedef struct {
+	uint8_t		state;
+	uint16_t	index;
+	uint16_t	payload_len;
+	uint8_t		last_seq;
+	uint8_t		seq_valid;
+	LinkStatStruct* stat;
+	uint8_t		buff[MAX_FRAME_SIZE];
+} ParserStruct;
+
+typedef FMT_Error (*pkg_handler_t)(const PackageStruct* pkg);
 
 /* Command Define */
 enum {
@@ -62,13 +95,31 @@ enum {
 	PROTO_ACK_MOTOR_VAL = 8,
 	PROTO_CMD_PWM_SWITCH = 9,
 	PROTO_CMD_CONFIG = 10,
+	PROTO_CMD_MOTOR_TS = 11,
+	PROTO_ACK_MOTOR_TS = 12,
+	PROTO_CMD_MOTOR_PROTOCOL = 13,
+	PROTO_DATA_ERPM = 14,
 };
 
-FMT_Error init_package(uint16_t cmd, uint16_t buff_len, PackageStruct* pkg);
-FMT_Error init_static_package(uint16_t cmd, uint8_t* buffer, PackageStruct* pkg);
-FMT_Error write_package(uint8_t* content, uint16_t len, PackageStruct* pkg);
-void free_package(PackageStruct* pkg);
-FMT_Error make_send_package(const PackageStruct pkg, SendPkgStruct* send_pkg);
-FMT_Error proto_parse_package(uint8_t c, PackageStruct* pkg);
+/* PROTO_CMD_MOTOR_TS content:
+ * | timestamp_us(4) | chan_mask(2) | chan_val(2) of each channel set in mask |
+ * PROTO_ACK_MOTOR_TS content, sent back for each motor command:
+ * | timestamp_us(4) | io_proc_us(2) | io_hold_us(2) |
+ * timestamp_us is echoed from the command, io_proc_us is the time from frame
+ * received to pwm updated and io_hold_us the time from frame received to ack sent */
+#define PROTO_MOTOR_TS_HEAD_SIZE	6
+#define PROTO_ACK_MOTOR_TS_SIZE		8
+
+/* PROTO_CMD_MOTOR_PROTOCOL content:
+ * | protocol(1) | bidir(1) |
+ * PROTO_DATA_ERPM content, sent when bidirectional dshot telemetry is decoded:
+ * | valid_mask(2) | erpm(4) of each channel set in mask | */
+#define PROTO_MOTOR_PROTOCOL_SIZE	2
+
+void proto_frame_init(FrameStruct* frame);
+FMT_Error proto_frame_append(FrameStruct* frame, uint16_t cmd, const void* data, uint16_t len);
+uint16_t proto_frame_finalize(FrameStruct* frame, uint8_t seq);
+void proto_parser_init(ParserStruct* parser, LinkStatStruct* stat);
+uint16_t proto_parse_buffer(ParserStruct* parser, const uint8_t* data, uint16_t len, pkg_handler_t handler);
 
 #endif
@@ -16,13 +16,57 @@
 
 #include "pwm.h"
 #include "debug.h"
+#include "dshot.h"
 
 #define PWM_ARR(freq) (TIMER_FREQUENCY / freq) // CCR reload value, Timer frequency = 3M/60K = 50 Hz
 
+/* dshot frames are streamed into CCR registers by timer dma burst:
+ * TIM2 UP (DMA1 Channel2), TIM3 UP (DMA1 Channel3) and TIM4 CH1 requested on
+ * update event (DMA1 Channel1, TIM4 UP shares Channel7 with usart2 tx).
+ * bidirectional telemetry is sampled from GPIOA/GPIOB input data register by
+ * TIM4 CH1/CH2 requests (DMA1 Channel1/4), TIM4 is re-timed for sampling */
+#define TIM2_BURST_NUM 2 /* CCR1 ~ CCR2 */
+#define TIM3_BURST_NUM 4 /* CCR1 ~ CCR4 */
+#define TIM4_BURST_NUM 2 /* CCR3 ~ CCR4 */
+#define GPIOA_PIN_MASK (GPIO_Pin_0 | GPIO_Pin_1 | GPIO_Pin_6 | GPIO_Pin_7)
+#define GPIOB_PIN_MASK (GPIO_Pin_0 | GPIO_Pin_1 | GPIO_Pin_8 | GPIO_Pin_9)
+
 uint8_t _pwm_freq = PWM_DEFAULT_FREQUENCY;
 static float _tim_duty_cycle[MAX_PWM_CHAN] = { 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00, 0.00 };
 static int _enable = 0;
 
+static uint8_t _protocol = PWM_PROTOCOL_PWM;
+static uint8_t _bidir = 0;
+static uint16_t _dshot_throttle[MAX_PWM_CHAN];
+static uint16_t _tim2_burst[DSHOT_FRAME_SLOTS][TIM2_BURST_NUM];
+static uint16_t _tim3_burst[DSHOT_FRAME_SLOTS][TIM3_BURST_NUM];
+static uint16_t _tim4_burst[DSHOT_FRAME_SLOTS][TIM4_BURST_NUM];
+static uint16_t _samples_a[DSHOT_TELEM_SAMPLES];
+static uint16_t _samples_b[DSHOT_TELEM_SAMPLES];
+static uint16_t _tim4_bit_arr;
+static volatile uint8_t _dshot_busy = 0;
+static volatile uint8_t _dma_pending = 0;
+static uint32_t _erpm[MAX_PWM_CHAN];
+static uint16_t _erpm_mask = 0;
+static volatile uint8_t _erpm_updated = 0;
+
+/* position of each channel in burst buffer and its gpio */
+static const struct {
+    uint16_t* burst;
+    uint8_t stride;
+    uint16_t pin;
+    uint16_t* samples;
+} _dshot_chan[MAX_PWM_CHAN] = {
+    { &_tim2_burst[0][0], TIM2_BURST_NUM, GPIO_Pin_0, _samples_a },
+    { &_tim2_burst[0][1], TIM2_BURST_NUM, GPIO_Pin_1, _samples_a },
+    { &_tim4_burst[0][0], TIM4_BURST_NUM, GPIO_Pin_8, _samples_b },
+    { &_tim4_burst[0][1], TIM4_BURST_NUM, GPIO_Pin_9, _samples_b },
+    { &_tim3_burst[0][0], TIM3_BURST_NUM, GPIO_Pin_6, _samples_a },
+    { &_tim3_burst[0][1], TIM3_BURST_NUM, GPIO_Pin_7, _samples_a },
+    { &_tim3_burst[0][2], TIM3_BURST_NUM, GPIO_Pin_0, _samples_b },
+    { &_tim3_burst[0][3], TIM3_BURST_NUM, GPIO_Pin_1, _samples_b },
+};
+
 void pwm_gpio_init(void)
 {
     GPIO_InitTypeDef GPIO_InitStructure;
@@ -125,8 +169,311 @@ void pwm_timer_init(void)
     TIM_ARRPreloadConfig(TIM4, ENABLE);
 }
 
+static uint32_t _dshot_bitrate(void)
+{
+    switch (_protocol) {
+    case PWM_PROTOCOL_DSHOT150:
+        return 150000;
+    case PWM_PROTOCOL_DSHOT300:
+        return 300000;
+    case PWM_PROTOCOL_DSHOT600:
+        return 600000;
+    default:
+        return 0;
+    }
+}
+
+/* switch pins between alternate function push-pull (output) and input with pull-up */
+static void _pin_set_input(GPIO_TypeDef* port, uint16_t pin_mask, uint8_t input)
+{
+    uint32_t crl = port->CRL;
+    uint32_t crh = port->CRH;
+    /* mode and cnf bits of each pin */
+    uint32_t cfg = input ? 0x8 : 0xB;
+
+    for (uint8_t i = 0; i < 8; i++) {
+        if (pin_mask & (1 << i)) {
+            crl = (crl & ~(0xFUL << (i * 4))) | (cfg << (i * 4));
+        }
+        if (pin_mask & (1 << (i + 8))) {
+            crh = (crh & ~(0xFUL << (i * 4))) | (cfg << (i * 4));
+        }
+    }
+
+    /* pull-up is selected by output data register */
+    port->BSRR = pin_mask;
+    port->CRL = crl;
+    port->CRH = crh;
+}
+
+static void _dma_config(DMA_Channel_TypeDef* channel, uint32_t periph, uint32_t periph_size, void* buf, uint16_t num, uint32_t dir)
+{
+    DMA_InitTypeDef DMA_InitStructure;
+
+    DMA_DeInit(channel);
+
+    DMA_InitStructure.DMA_PeripheralBaseAddr = periph;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)buf;
+    DMA_InitStructure.DMA_DIR = dir;
+    DMA_InitStructure.DMA_BufferSize = num;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = periph_size;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_Init(channel, &DMA_InitStructure);
+
+    DMA_ITConfig(channel, DMA_IT_TC, ENABLE);
+}
+
+static void _dma_irq_config(uint8_t irq)
+{
+    NVIC_InitTypeDef NVIC_InitStructure;
+
+    /* lower than usart2, motor command is applied in usart rx interrupt */
+    NVIC_InitStructure.NVIC_IRQChannel = irq;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+}
+
+static void _dshot_timer_init(void)
+{
+    TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+    TIM_OCInitTypeDef TIM_OCInitStructure;
+    RCC_ClocksTypeDef rcc_clocks;
+
+    RCC_GetClocksFreq(&rcc_clocks);
+    uint8_t APB1_Prescaler = rcc_clocks.HCLK_Frequency / rcc_clocks.PCLK1_Frequency;
+    uint32_t TimClk = APB1_Prescaler == 1 ? rcc_clocks.PCLK1_Frequency : rcc_clocks.PCLK1_Frequency * 2;
+
+    /* one bit per timer period */
+    TIM_TimeBaseStructure.TIM_Period = TimClk / _dshot_bitrate() - 1;
+    TIM_TimeBaseStructure.TIM_Prescaler = 0;
+    TIM_TimeBaseStructure.TIM_ClockDivision = TIM_CKD_DIV1;
+    TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+
+    TIM_OCInitStructure.TIM_OCMode = TIM_OCMode_PWM1;
+    TIM_OCInitStructure.TIM_OutputState = TIM_OutputState_Enable;
+    TIM_OCInitStructure.TIM_Pulse = 0;
+    /* bidirectional dshot is inverted, line idles high */
+    TIM_OCInitStructure.TIM_OCPolarity = _bidir ? TIM_OCPolarity_Low : TIM_OCPolarity_High;
+    TIM_OCInitStructure.TIM_OutputNState = TIM_OutputNState_Disable;
+    TIM_OCInitStructure.TIM_OCNPolarity = TIM_OCNPolarity_High;
+    TIM_OCInitStructure.TIM_OCIdleState = TIM_OCIdleState_Reset;
+    TIM_OCInitStructure.TIM_OCNIdleState = TIM_OCIdleState_Reset;
+
+    _tim4_bit_arr = TIM_TimeBaseStructure.TIM_Period;
+
+    TIM_TimeBaseInit(TIM2, &TIM_TimeBaseStructure);
+    TIM_OC1Init(TIM2, &TIM_OCInitStructure);
+    TIM_OC1PreloadConfig(TIM2, TIM_OCPreload_Enable);
+    TIM_OC2Init(TIM2, &TIM_OCInitStructure);
+    TIM_OC2PreloadConfig(TIM2, TIM_OCPreload_Enable);
+    TIM_ARRPreloadConfig(TIM2, ENABLE);
+    TIM_DMAConfig(TIM2, TIM_DMABase_CCR1, TIM_DMABurstLength_2Transfers);
+    TIM_DMACmd(TIM2, TIM_DMA_Update, ENABLE);
+
+    TIM_TimeBaseInit(TIM3, &TIM_TimeBaseStructure);
+    TIM_OC1Init(TIM3, &TIM_OCInitStructure);
+    TIM_OC1PreloadConfig(TIM3, TIM_OCPreload_Enable);
+    TIM_OC2Init(TIM3, &TIM_OCInitStructure);
+    TIM_OC2PreloadConfig(TIM3, TIM_OCPreload_Enable);
+    TIM_OC3Init(TIM3, &TIM_OCInitStructure);
+    TIM_OC3PreloadConfig(TIM3, TIM_OCPreload_Enable);
+    TIM_OC4Init(TIM3, &TIM_OCInitStructure);
+    TIM_OC4PreloadConfig(TIM3, TIM_OCPreload_Enable);
+    TIM_ARRPreloadConfig(TIM3, ENABLE);
+    TIM_DMAConfig(TIM3, TIM_DMABase_CCR1, TIM_DMABurstLength_4Transfers);
+    TIM_DMACmd(TIM3, TIM_DMA_Update, ENABLE);
+
+    TIM_TimeBaseInit(TIM4, &TIM_TimeBaseStructure);
+    TIM_OC3Init(TIM4, &TIM_OCInitStructure);
+    TIM_OC3PreloadConfig(TIM4, TIM_OCPreload_Enable);
+    TIM_OC4Init(TIM4, &TIM_OCInitStructure);
+    TIM_OC4PreloadConfig(TIM4, TIM_OCPreload_Enable);
+    TIM_ARRPreloadConfig(TIM4, ENABLE);
+    TIM_DMAConfig(TIM4, TIM_DMABase_CCR3, TIM_DMABurstLength_2Transfers);
+    TIM_SelectCCDMA(TIM4, ENABLE);
+    TIM_DMACmd(TIM4, TIM_DMA_CC1, ENABLE);
+
+    RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+
+    _dma_irq_config(DMA1_Channel1_IRQn);
+    _dma_irq_config(DMA1_Channel2_IRQn);
+    _dma_irq_config(DMA1_Channel3_IRQn);
+    if (_bidir) {
+        _dma_irq_config(DMA1_Channel4_IRQn);
+    }
+}
+
+/* disable dshot dma requests, used when switching back to pwm */
+static void _dshot_timer_deinit(void)
+{
+    TIM_DMACmd(TIM2, TIM_DMA_Update, DISABLE);
+    TIM_DMACmd(TIM3, TIM_DMA_Update, DISABLE);
+    TIM_DMACmd(TIM4, TIM_DMA_CC1 | TIM_DMA_CC2, DISABLE);
+    TIM_SelectCCDMA(TIM4, DISABLE);
+
+    DMA_Cmd(DMA1_Channel1, DISABLE);
+    DMA_Cmd(DMA1_Channel2, DISABLE);
+    DMA_Cmd(DMA1_Channel3, DISABLE);
+    DMA_Cmd(DMA1_Channel4, DISABLE);
+
+    _pin_set_input(GPIOA, GPIOA_PIN_MASK, 0);
+    _pin_set_input(GPIOB, GPIOB_PIN_MASK, 0);
+
+    _dshot_busy = 0;
+}
+
+static void _dshot_send(void)
+{
+    uint16_t period;
+    uint16_t frame;
+
+    if (_dshot_busy || !_enable) {
+        /* previous frame or telemetry is not finished, send next time */
+        return;
+    }
+
+    /* all timers run with the same period */
+    period = _tim4_bit_arr + 1;
+
+    for (uint8_t i = 0; i < MAX_PWM_CHAN; i++) {
+        /* telemetry request bit is for esc serial telemetry, which is not used */
+        frame = dshot_pack(_dshot_throttle[i], 0, _bidir);
+        /* bit 0 is high for 3/8 of period, bit 1 for 3/4 */
+        dshot_fill_slots(frame, _dshot_chan[i].burst, _dshot_chan[i].stride, period * 3 / 8, period * 3 / 4);
+    }
+
+    _dshot_busy = 1;
+    _dma_pending = 3;
+
+    _dma_config(DMA1_Channel2, (uint32_t)&TIM2->DMAR, DMA_PeripheralDataSize_HalfWord, _tim2_burst, sizeof(_tim2_burst) / 2, DMA_DIR_PeripheralDST);
+    _dma_config(DMA1_Channel3, (uint32_t)&TIM3->DMAR, DMA_PeripheralDataSize_HalfWord, _tim3_burst, sizeof(_tim3_burst) / 2, DMA_DIR_PeripheralDST);
+    _dma_config(DMA1_Channel1, (uint32_t)&TIM4->DMAR, DMA_PeripheralDataSize_HalfWord, _tim4_burst, sizeof(_tim4_burst) / 2, DMA_DIR_PeripheralDST);
+
+    DMA_Cmd(DMA1_Channel2, ENABLE);
+    DMA_Cmd(DMA1_Channel3, ENABLE);
+    DMA_Cmd(DMA1_Channel1, ENABLE);
+}
+
+static void _dshot_telem_start(void)
+{
+    _pin_set_input(GPIOA, GPIOA_PIN_MASK, 1);
+    _pin_set_input(GPIOB, GPIOB_PIN_MASK, 1);
+
+    /* re-time TIM4 to the sample rate, its outputs are released as input now */
+    TIM_DMACmd(TIM4, TIM_DMA_CC1, DISABLE);
+    TIM_SetAutoreload(TIM4, (_tim4_bit_arr + 1) * 4 / (5 * DSHOT_TELEM_OVERSAMPLE) - 1);
+    TIM_GenerateEvent(TIM4, TIM_EventSource_Update);
+
+    _dma_pending = 2;
+
+    /* gpio registers are word access only, dma keeps the lower half word */
+    _dma_config(DMA1_Channel1, (uint32_t)&GPIOA->IDR, DMA_PeripheralDataSize_Word, _samples_a, DSHOT_TELEM_SAMPLES, DMA_DIR_PeripheralSRC);
+    _dma_config(DMA1_Channel4, (uint32_t)&GPIOB->IDR, DMA_PeripheralDataSize_Word, _samples_b, DSHOT_TELEM_SAMPLES, DMA_DIR_PeripheralSRC);
+
+    DMA_Cmd(DMA1_Channel1, ENABLE);
+    DMA_Cmd(DMA1_Channel4, ENABLE);
+
+    TIM_DMACmd(TIM4, TIM_DMA_CC1 | TIM_DMA_CC2, ENABLE);
+}
+
+static void _dshot_telem_done(void)
+{
+    uint32_t erpm;
+
+    /* restore TIM4 for frame output */
+    TIM_DMACmd(TIM4, TIM_DMA_CC1 | TIM_DMA_CC2, DISABLE);
+    TIM_SetAutoreload(TIM4, _tim4_bit_arr);
+    TIM_GenerateEvent(TIM4, TIM_EventSource_Update);
+    TIM_DMACmd(TIM4, TIM_DMA_CC1, ENABLE);
+
+    _pin_set_input(GPIOA, GPIOA_PIN_MASK, 0);
+    _pin_set_input(GPIOB, GPIOB_PIN_MASK, 0);
+
+    _erpm_mask = 0;
+
+    for (uint8_t i = 0; i < MAX_PWM_CHAN; i++) {
+        if (dshot_decode_telem(_dshot_chan[i].samples, DSHOT_TELEM_SAMPLES, _dshot_chan[i].pin, &erpm) == SYS_EOK) {
+            _erpm[i] = erpm;
+            _erpm_mask |= 1 << i;
+        }
+    }
+
+    _erpm_updated = 1;
+    _dshot_busy = 0;
+}
+
+/* called when one of the dma channels completes */
+static void _dshot_dma_done(void)
+{
+    if (--_dma_pending) {
+        return;
+    }
+
+    if (!_bidir) {
+        _dshot_busy = 0;
+    } else if (TIM4->ARR == _tim4_bit_arr) {
+        /* frames are sent, esc replies 30us later */
+        _dshot_telem_start();
+    } else {
+        _dshot_telem_done();
+    }
+}
+
+void DMA1_Channel1_irq_event_handler(void)
+{
+    if (DMA_GetITStatus(DMA1_IT_TC1) != RESET) {
+        DMA_ClearITPendingBit(DMA1_IT_TC1);
+        _dshot_dma_done();
+    }
+}
+
+void DMA1_Channel2_irq_event_handler(void)
+{
+    if (DMA_GetITStatus(DMA1_IT_TC2) != RESET) {
+        DMA_ClearITPendingBit(DMA1_IT_TC2);
+        _dshot_dma_done();
+    }
+}
+
+void DMA1_Channel3_irq_event_handler(void)
+{
+    if (DMA_GetITStatus(DMA1_IT_TC3) != RESET) {
+        DMA_ClearITPendingBit(DMA1_IT_TC3);
+        _dshot_dma_done();
+    }
+}
+
+void DMA1_Channel4_irq_event_handler(void)
+{
+    if (DMA_GetITStatus(DMA1_IT_TC4) != RESET) {
+        DMA_ClearITPendingBit(DMA1_IT_TC4);
+        _dshot_dma_done();
+    }
+}
+
 uint8_t pwm_write(float* duty_cyc, uint8_t chan_id)
 {
+    if (_protocol != PWM_PROTOCOL_PWM) {
+        for (uint8_t i = 0; i < MAX_PWM_CHAN; i++) {
+            if (chan_id & (1 << i)) {
+                /* duty cycle of 1000~2000us pulse at 50Hz */
+                _dshot_throttle[i] = dshot_throttle((uint16_t)(duty_cyc[i] / 0.00005f + 0.5f), 1000, 2000);
+                _tim_duty_cycle[i] = duty_cyc[i];
+            }
+        }
+
+        _dshot_send();
+
+        return 0;
+    }
+
     if (chan_id & PWM_CHAN_1) {
         TIM_SetCompare1(TIM2, PWM_ARR(_pwm_freq) * duty_cyc[0]);
         _tim_duty_cycle[0] = duty_cyc[0];
@@ -186,10 +533,13 @@ uint8_t pwm_configure(uint8_t cmd, void* args)
     if (cmd == PWM_CMD_SET_FREQ) {
         _pwm_freq = *((int*)args);
 
-        // configure timer
-        pwm_timer_init();
-        // after frequency changing, the timer compare value should be re-configured also
-        pwm_write(_tim_duty_cycle, PWM_CHAN_ALL);
+        /* dshot frame rate follows motor command, frequency only applies to pwm */
+        if (_protocol == PWM_PROTOCOL_PWM) {
+            // configure timer
+            pwm_timer_init();
+            // after frequency changing, the timer compare value should be re-configured also
+            pwm_write(_tim_duty_cycle, PWM_CHAN_ALL);
+        }
 
         return 0;
     } else if (cmd == PWM_CMD_ENABLE) {
@@ -198,12 +548,13 @@ uint8_t pwm_configure(uint8_t cmd, void* args)
         if (enable) {
             /* set to min value when motor is opened */
             float min_dc[8] = { 0.05f, 0.05f, 0.05f, 0.05f, 0.05f, 0.05f, 0.05f, 0.05f };
-            pwm_write(min_dc, PWM_CHAN_ALL);
 
             TIM_Cmd(TIM2, ENABLE);
             TIM_Cmd(TIM4, ENABLE);
             TIM_Cmd(TIM3, ENABLE);
             _enable = 1;
+
+            pwm_write(min_dc, PWM_CHAN_ALL);
         } else {
             // float pwm[] = { 0, 0, 0, 0, 0, 0, 0, 0 };
             // pwm_write(pwm, PWM_CHAN_ALL);
@@ -211,6 +562,38 @@ uint8_t pwm_configure(uint8_t cmd, void* args)
             TIM_Cmd(TIM4, DISABLE);
             TIM_Cmd(TIM3, DISABLE);
             _enable = 0;
+
+            if (_protocol != PWM_PROTOCOL_PWM) {
+                /* drop the frame in flight */
+                _dshot_timer_deinit();
+                _dshot_timer_init();
+            }
+        }
+
+        return 0;
+    } else if (cmd == PWM_CMD_SET_PROTOCOL) {
+        PWM_PROTOCOL_MSG* msg = (PWM_PROTOCOL_MSG*)args;
+
+        if (msg->protocol > PWM_PROTOCOL_DSHOT600) {
+            return 1;
+        }
+
+        if (_protocol != PWM_PROTOCOL_PWM) {
+            _dshot_timer_deinit();
+        }
+
+        _protocol = msg->protocol;
+        _bidir = _protocol != PWM_PROTOCOL_PWM && msg->bidir;
+        _erpm_mask = 0;
+
+        if (_protocol == PWM_PROTOCOL_PWM) {
+            pwm_timer_init();
+            pwm_write(_tim_duty_cycle, PWM_CHAN_ALL);
+        } else {
+            for (uint8_t i = 0; i < MAX_PWM_CHAN; i++) {
+                _dshot_throttle[i] = DSHOT_CMD_MOTOR_STOP;
+            }
+            _dshot_timer_init();
         }
 
         return 0;
@@ -220,6 +603,23 @@ uint8_t pwm_configure(uint8_t cmd, void* args)
     }
 }
 
+/* get esc erpm from bidirectional dshot telemetry, return 1 if updated since last call */
+uint8_t pwm_get_erpm(uint32_t* erpm, uint16_t* valid_mask)
+{
+    uint8_t updated;
+
+    __disable_irq();
+    updated = _erpm_updated;
+    for (uint8_t i = 0; i < MAX_PWM_CHAN; i++) {
+        erpm[i] = _erpm[i];
+    }
+    *valid_mask = _erpm_mask;
+    _erpm_updated = 0;
+    __enable_irq();
+
+    return updated;
+}
+
 uint8_t pwm_init(void)
 {
     pwm_gpio_init();
@@ -26,6 +26,13 @@
 // PWM configure command
 #define PWM_CMD_SET_FREQ      0x01
 #define PWM_CMD_ENABLE        0x02
+#define PWM_CMD_SET_PROTOCOL  0x03
+
+// PWM output protocol, same value as MOTOR_PROTOCOL_xxx of fmu
+#define PWM_PROTOCOL_PWM      0
+#define PWM_PROTOCOL_DSHOT150 1
+#define PWM_PROTOCOL_DSHOT300 2
+#define PWM_PROTOCOL_DSHOT600 3
 
 // PWM channel id
 #define	PWM_CHAN_1            1
@@ -48,9 +55,15 @@ typedef struct {
 	int val;
 } PWM_CONFIG_MSG;
 
+typedef struct {
+	uint8_t protocol;
+	uint8_t bidir;
+} PWM_PROTOCOL_MSG;
+
 uint8_t pwm_init(void);
 uint8_t pwm_write(float* duty_cyc, uint8_t chan_id);
 uint8_t pwm_read(float* buffer, uint8_t chan_id);
 uint8_t pwm_configure(uint8_t cmd, void* args);
+uint8_t pwm_get_erpm(uint32_t* erpm, uint16_t* valid_mask);
 
 #endif
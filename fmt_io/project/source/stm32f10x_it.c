@@ -160,6 +160,11 @@ void PendSV_Handler(void)
 void TIM1_irq_event_handler(void);
 void TIM3_irq_event_handler(void);
 void USART2_irq_event_handler(void);
+void DMA1_Channel6_irq_event_handler(void);
+void DMA1_Channel1_irq_event_handler(void);
+void DMA1_Channel2_irq_event_handler(void);
+void DMA1_Channel3_irq_event_handler(void);
+void DMA1_Channel4_irq_event_handler(void);
 
 void TIM1_CC_IRQHandler(void)
 {
@@ -176,6 +181,31 @@ void USART2_IRQHandler(void)
 	USART2_irq_event_handler();
 }
 
+void DMA1_Channel6_IRQHandler(void)
+{
+	DMA1_Channel6_irq_event_handler();
+}
+
+void DMA1_Channel1_IRQHandler(void)
+{
+	DMA1_Channel1_irq_event_handler();
+}
+
+void DMA1_Channel2_IRQHandler(void)
+{
+	DMA1_Channel2_irq_event_handler();
+}
+
+void DMA1_Channel3_IRQHandler(void)
+{
+	DMA1_Channel3_irq_event_handler();
+}
+
+void DMA1_Channel4_IRQHandler(void)
+{
+	DMA1_Channel4_irq_event_handler();
+}
+
 /**
   * @}
   */
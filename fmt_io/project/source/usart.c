@@ -17,40 +17,134 @@
 #include "usart.h"
 #include "debug.h"
 #include <stdio.h>
+#include <string.h>
 
+/* USART2 rx/tx dma channels */
+#define USART2_RX_DMA_CHANNEL DMA1_Channel6
+#define USART2_TX_DMA_CHANNEL DMA1_Channel7
+
+/* rx ring buffer is filled by circular dma, head is the dma write position */
 RING_BUFFER_Def rb;
+/* invoked from interrupt when line gets idle or half of rx buffer is filled */
+static void (*_rx_callback)(void) = NULL;
 
-uint8_t send_ch(uint8_t ch)
+static void _dma_rx_config(void)
 {
-    USART_SendData(USART2, (uint8_t)ch);
+    DMA_InitTypeDef DMA_InitStructure;
+
+    DMA_DeInit(USART2_RX_DMA_CHANNEL);
+
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&USART2->DR;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)rb.buff;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+    DMA_InitStructure.DMA_BufferSize = RING_BUFFER_SIZE;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_Init(USART2_RX_DMA_CHANNEL, &DMA_InitStructure);
+
+    /* half/full transfer interrupt in case of a long burst without idle */
+    DMA_ITConfig(USART2_RX_DMA_CHANNEL, DMA_IT_HT | DMA_IT_TC, ENABLE);
+
+    DMA_Cmd(USART2_RX_DMA_CHANNEL, ENABLE);
+}
 
-    /* Loop until the end of transmission */
-    while (USART_GetFlagStatus(USART2, USART_FLAG_TC) == RESET)
-        ;
+static void _rx_irq_config(void)
+{
+    NVIC_InitTypeDef NVIC_InitStructure;
 
-    return ch;
+    /* highest priority, motor command is applied in rx interrupt */
+    NVIC_InitStructure.NVIC_IRQChannel = USART2_IRQn;
+    NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
+    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&NVIC_InitStructure);
+
+    NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel6_IRQn;
+    NVIC_Init(&NVIC_InitStructure);
+
+    USART_ITConfig(USART2, USART_IT_IDLE, ENABLE);
 }
 
-uint16_t send(uint8_t* data, uint16_t len)
+void usart_set_rx_callback(void (*callback)(void))
+{
+    _rx_callback = callback;
+}
+
+static void _dma_tx_config(void)
 {
-    uint16_t i;
+    DMA_InitTypeDef DMA_InitStructure;
+
+    DMA_DeInit(USART2_TX_DMA_CHANNEL);
+
+    /* memory address and size are set for each transfer */
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&USART2->DR;
+    DMA_InitStructure.DMA_MemoryBaseAddr = 0;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+    DMA_InitStructure.DMA_BufferSize = 0;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_Medium;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_Init(USART2_TX_DMA_CHANNEL, &DMA_InitStructure);
+}
 
-    for (i = 0; i < len; i++) {
-        send_ch(data[i]);
+uint8_t usart_tx_busy(void)
+{
+    /* counter reaches 0 when the transfer completes */
+    return DMA_GetCurrDataCounter(USART2_TX_DMA_CHANNEL) != 0;
+}
+
+/* data must stay valid until the dma transfer completes (see usart_tx_busy()) */
+uint16_t send(uint8_t* data, uint16_t len)
+{
+    if (len == 0) {
+        return 0;
     }
 
+    /* only wait if previous transfer is still ongoing */
+    while (usart_tx_busy()) { }
+
+    DMA_Cmd(USART2_TX_DMA_CHANNEL, DISABLE);
+    USART2_TX_DMA_CHANNEL->CMAR = (uint32_t)data;
+    DMA_SetCurrDataCounter(USART2_TX_DMA_CHANNEL, len);
+    DMA_Cmd(USART2_TX_DMA_CHANNEL, ENABLE);
+
     return len;
 }
 
-uint8_t read_ch(uint8_t* ch)
+uint16_t read_buf(uint8_t* buf, uint16_t len)
 {
-    if (rb.head != rb.tail) {
-        *ch = rb.buff[rb.tail];
-        rb.tail = (rb.tail + 1) % RING_BUFFER_SIZE;
-        return 1;
+    uint16_t avail, first;
+
+    rb.head = (RING_BUFFER_SIZE - DMA_GetCurrDataCounter(USART2_RX_DMA_CHANNEL)) % RING_BUFFER_SIZE;
+
+    avail = (rb.head + RING_BUFFER_SIZE - rb.tail) % RING_BUFFER_SIZE;
+
+    if (len > avail) {
+        len = avail;
+    }
+
+    /* copy in two parts if data wraps around */
+    first = RING_BUFFER_SIZE - rb.tail;
+
+    if (first > len) {
+        first = len;
     }
 
-    return 0;
+    memcpy(buf, &rb.buff[rb.tail], first);
+    memcpy(&buf[first], rb.buff, len - first);
+
+    rb.tail = (rb.tail + len) % RING_BUFFER_SIZE;
+
+    return len;
 }
 
 uint8_t usart_config_baud_rate(USART_TypeDef* USARTx, uint32_t baud_rate)
@@ -63,19 +157,23 @@ uint8_t usart_config_baud_rate(USART_TypeDef* USARTx, uint32_t baud_rate)
     USART_InitStructure.USART_Parity = USART_Parity_No;
     USART_InitStructure.USART_HardwareFlowControl = USART_HardwareFlowControl_None;
     USART_InitStructure.USART_Mode = USART_Mode_Rx | USART_Mode_Tx;
+    /* let the last byte shift out before changing baud rate */
+    while (usart_tx_busy() || USART_GetFlagStatus(USARTx, USART_FLAG_TC) == RESET) { }
+
     USART_Init(USARTx, &USART_InitStructure);
 
-    USART_ITConfig(USARTx, USART_IT_RXNE, ENABLE);
+    USART_DMACmd(USARTx, USART_DMAReq_Rx | USART_DMAReq_Tx, ENABLE);
 
     /* Enable USART */
     USART_Cmd(USARTx, ENABLE);
+
+    return 1;
 }
 
 uint8_t usart_init(void)
 {
     GPIO_InitTypeDef GPIO_InitStructure;
     USART_InitTypeDef USART_InitStructure;
-    NVIC_InitTypeDef NVIC_InitStructure;
 
     /*init ring budder*/
     rb.head = rb.tail = 0;
@@ -83,16 +181,11 @@ uint8_t usart_init(void)
     /* Enable Clock */
     RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA | RCC_APB2Periph_AFIO, ENABLE);
     RCC_APB1PeriphClockCmd(RCC_APB1Periph_USART2, ENABLE);
+    RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
 
     /* Configure the NVIC Preemption Priority Bits */
     NVIC_PriorityGroupConfig(NVIC_PriorityGroup_1);
 
-    /* Enable the USART2 Interrupt */
-    NVIC_InitStructure.NVIC_IRQChannel = USART2_IRQn;
-    NVIC_InitStructure.NVIC_IRQChannelSubPriority = 1;
-    NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
-    NVIC_Init(&NVIC_InitStructure);
-
     /* Configure USART Tx as alternate function push-pull */
     GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF_PP;
     GPIO_InitStructure.GPIO_Pin = GPIO_Pin_2;
@@ -111,8 +204,11 @@ uint8_t usart_init(void)
     USART_InitStructure.USART_Mode = USART_Mode_Rx | USART_Mode_Tx;
     USART_Init(USART2, &USART_InitStructure);
 
-    /* Enable USART2 Receive interrupts */
-    USART_ITConfig(USART2, USART_IT_RXNE, ENABLE);
+    /* USART2 rx/tx are handled by dma */
+    _dma_rx_config();
+    _dma_tx_config();
+    USART_DMACmd(USART2, USART_DMAReq_Rx | USART_DMAReq_Tx, ENABLE);
+    _rx_irq_config();
 
     /* Enable USART */
     USART_Cmd(USART2, ENABLE);
@@ -173,11 +269,23 @@ void console_putc(uint8_t ch)
 
 void USART2_irq_event_handler(void)
 {
-    if (USART_GetITStatus(USART2, USART_IT_RXNE) != RESET) {
-        rb.buff[rb.head] = USART_ReceiveData(USART2); /* this process will clear EXNE flag */
-        rb.head = (rb.head + 1) % RING_BUFFER_SIZE;
+    if (USART_GetITStatus(USART2, USART_IT_IDLE) != RESET) {
+        /* idle flag is cleared by reading SR followed by DR */
+        USART_ReceiveData(USART2);
+
+        if (_rx_callback) {
+            _rx_callback();
+        }
+    }
+}
+
+void DMA1_Channel6_irq_event_handler(void)
+{
+    if (DMA_GetITStatus(DMA1_IT_HT6) != RESET || DMA_GetITStatus(DMA1_IT_TC6) != RESET) {
+        DMA_ClearITPendingBit(DMA1_IT_HT6 | DMA1_IT_TC6);
 
-        // if(rb.head == rb.tail)
-        // 	debug("ring buffer is full\n");
+        if (_rx_callback) {
+            _rx_callback();
+        }
     }
 }
@@ -29,9 +29,10 @@ typedef struct {
 
 uint8_t usart_config_baud_rate(USART_TypeDef* USARTx, uint32_t baud_rate);
 uint8_t usart_init(void);
-uint8_t read_ch(uint8_t* ch);
-uint8_t send_ch(uint8_t ch);
+uint16_t read_buf(uint8_t* buf, uint16_t len);
 uint16_t send(uint8_t* data, uint16_t len);
+uint8_t usart_tx_busy(void);
+void usart_set_rx_callback(void (*callback)(void));
 void console_putc(uint8_t ch);
 
 #endif